@@ -21,21 +21,20 @@
 //include files for the application
 #include "data.h"
 #include "klustersdoc.h"
+#include "taskpool.h"
 
 //include files for QT
-#include <qthread.h>
-
 #include <QEvent>
 #include <QDebug>
 
 
 
-/**Thread used to save automatically the document on a defined schedule.
- * The thread calls the Data object which will do the work.
+/**Task used to save automatically the document on a defined schedule, it runs on the TaskPool
+ * with the lowest priority. The task calls the Data object which will do the work.
  *@author Lynn Hazan
  */
 
-class AutoSaveThread : public QThread {
+class AutoSaveThread : public TaskPool::Task {
 public:
 
     ~AutoSaveThread(){qDebug()<<"in ~AutoSaveThread";}
@@ -0,0 +1,126 @@
+/***************************************************************************
+                          featurelayoutbenchmark.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Compares the row by row and the dimension by dimension storage of the features on the loops
+ * used when a new pair of dimensions is displayed (projection of every cluster, spikes visited
+ * in cluster order) and when the minimum and maximum of a dimension are computed.
+ * For each layout the time of the loops and the number of distinct 64 bytes cache lines they touch
+ * are reported, the latter being the number of cache misses of a cold cache.
+ *
+ * Usage: featurelayoutbenchmark [nbSpikes] [nbDimensions] [nbClusters]
+ */
+
+#include "featurearray.h"
+#include "timer.h"
+
+//C include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static const int kCACHE_LINE = 64;
+
+/**Counts the cache lines touched when reading @p column for the spikes of @p order, in that order.*/
+static long cacheLinesTouched(const FeatureArray& features,const std::vector<dataType>& order,int column){
+    long nbLines = 0;
+    qint64 lastLine = -1;
+    for(size_t i = 0; i < order.size(); ++i){
+        qint64 line = features.valueOffset(order[i],column) / kCACHE_LINE;
+        if(line != lastLine) nbLines++;
+        lastLine = line;
+    }
+    return nbLines;
+}
+
+static void runBenchmark(FeatureArray::Layout layout,const std::vector<dataType>& wideValues,dataType nbSpikes,int nbDimensions,
+                         const std::vector<dataType>& clusterOrder,int dimensionX,int dimensionY){
+    FeatureArray features;
+    features.setLayout(layout);
+    features.setSize(nbSpikes,nbDimensions);
+    for(size_t i = 0; i < wideValues.size(); ++i) features[i] = wideValues[i];
+    features.compact();
+
+    //Projection of all the clusters on (dimensionX,dimensionY), as done by ClusterView.
+    RestartTimer();
+    long long checksum = 0;
+    for(int repeat = 0; repeat < 5; ++repeat){
+        for(size_t i = 0; i < clusterOrder.size(); ++i){
+            dataType row = clusterOrder[i];
+            checksum += features(row,dimensionX) - features(row,dimensionY);
+        }
+    }
+    float projectionTime = Timer() / 5;
+
+    //Minimum and maximum of every dimension but the time, as done by Data::minMaxDimensionCalculation.
+    RestartTimer();
+    for(int dimension = 1; dimension < nbDimensions; ++dimension){
+        FeatureArray::Column values = features.column(dimension);
+        dataType min = values[1];
+        dataType max = min;
+        for(size_t i = 0; i < clusterOrder.size(); ++i){
+            dataType value = values[clusterOrder[i]];
+            if(value < min) min = value;
+            if(value > max) max = value;
+        }
+        checksum += max - min;
+    }
+    float minMaxTime = Timer();
+
+    long projectionLines = cacheLinesTouched(features,clusterOrder,dimensionX) + cacheLinesTouched(features,clusterOrder,dimensionY);
+    long minMaxLines = 0;
+    for(int dimension = 1; dimension < nbDimensions; ++dimension) minMaxLines += cacheLinesTouched(features,clusterOrder,dimension);
+
+    printf("%-14s size %8.1f MB  projection %8.3f s  %10ld lines  min/max %8.3f s  %10ld lines  (checksum %lld)\n",
+           layout == FeatureArray::ROW_MAJOR ? "row major" : "column major",
+           features.dataSize() / (1024.0 * 1024.0),projectionTime,projectionLines,minMaxTime,minMaxLines,checksum);
+}
+
+int main(int argc,char** argv){
+    dataType nbSpikes = argc > 1 ? atol(argv[1]) : 5000000;
+    int nbDimensions = argc > 2 ? atoi(argv[2]) : 13;
+    int nbClusters = argc > 3 ? atoi(argv[3]) : 40;
+    if(nbSpikes < 1 || nbDimensions < 3 || nbClusters < 1){
+        fprintf(stderr,"usage: %s [nbSpikes] [nbDimensions>=3] [nbClusters]\n",argv[0]);
+        return 1;
+    }
+
+    //Synthetic features: PCs in the 16 bits range and an increasing time.
+    srand(1);
+    std::vector<dataType> wideValues(static_cast<size_t>(nbSpikes) * nbDimensions);
+    std::vector<int> clusterIds(nbSpikes);
+    dataType time = 0;
+    for(dataType spike = 0; spike < nbSpikes; ++spike){
+        for(int dimension = 0; dimension < nbDimensions - 1; ++dimension)
+            wideValues[spike * nbDimensions + dimension] = (rand() % 20000) - 10000;
+        time += 1 + rand() % 400;
+        wideValues[spike * nbDimensions + nbDimensions - 1] = time;
+        clusterIds[spike] = rand() % nbClusters;
+    }
+
+    //Spikes sorted by cluster and by time inside a cluster, as in spikesByCluster.
+    std::vector<dataType> clusterOrder;
+    clusterOrder.reserve(nbSpikes);
+    for(int cluster = 0; cluster < nbClusters; ++cluster)
+        for(dataType spike = 0; spike < nbSpikes; ++spike)
+            if(clusterIds[spike] == cluster) clusterOrder.push_back(spike + 1);
+
+    printf("%ld spikes, %d dimensions, %d clusters, projection on dimensions 2 and %d\n",nbSpikes,nbDimensions,nbClusters,nbDimensions - 1);
+    runBenchmark(FeatureArray::ROW_MAJOR,wideValues,nbSpikes,nbDimensions,clusterOrder,2,nbDimensions - 1);
+    runBenchmark(FeatureArray::COLUMN_MAJOR,wideValues,nbSpikes,nbDimensions,clusterOrder,2,nbDimensions - 1);
+    return 0;
+}
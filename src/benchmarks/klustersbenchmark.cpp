@@ -0,0 +1,447 @@
+/***************************************************************************
+                          klustersbenchmark.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Headless benchmark of the Klusters data core. A dataset is loaded in a Data object, without
+ * creating any widget, and a scripted set of operations is timed: the loading, the creation of a
+ * cluster from a polygon, the grouping of two clusters, undo and redo, the saving of the clusters,
+ * the correlograms, the error matrix, the waveform extraction and the cluster and trace providers.
+ * The results are written as JSON, so that they can be compared between builds.
+ *
+ * Usage: klusters-bench [options] baseName electrodeGroup
+ *   -x dimension      abscissa dimension of the polygon (default 1)
+ *   -y dimension      ordinate dimension of the polygon (default 2)
+ *   -p "x,y x,y ..."  polygon used to create the new cluster, in feature units
+ *                     (default: the central part of the range of the two dimensions)
+ *   -s nbSpikes       number of spikes extracted per cluster for the waveforms (default 100)
+ *   -c nbClusters     number of clusters, the largest ones, used for the correlograms (default 5)
+ *   -o file           file where to write the JSON results (default: standard output)
+ *
+ * The files are looked up as in Klusters: baseName.fet.n, baseName.clu.n, baseName.spk.n,
+ * baseName.xml (or baseName.par.n and baseName.par) and baseName.dat.
+ */
+
+#include "data.h"
+#include "groupingassistant.h"
+#include "clustersprovider.h"
+#include "tracesprovider.h"
+#include "pair.h"
+#include "polygonmask.h"
+
+//Qt include files
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QPolygon>
+#include <QFileInfo>
+#include <QDir>
+
+//C include files
+#include <stdio.h>
+#include <stdlib.h>
+
+//Number of undo kept by Data, defined in main.cpp for the application.
+int nbUndo = 2;
+
+/**One timed operation.*/
+struct Measure{
+    QString name;
+    double seconds;
+    /**Number of items processed by the operation (spikes, pairs, clusters...), -1 if not relevant.*/
+    long count;
+};
+
+/**
+* Runs the scripted operations on a Data object, calling on the main thread the functions
+* used by the computing threads of the application.
+*/
+class DataBenchmark{
+public:
+    DataBenchmark(const QString& baseName,const QString& electrodeGroup)
+        :baseName(baseName),electrodeGroup(electrodeGroup),dimensionX(1),dimensionY(2),nbSpikesToExtract(100),nbCorrelogramClusters(5),
+          waveformCacheHits(0),waveformCacheMisses(0){}
+
+    void setDimensions(int x,int y){dimensionX = x; dimensionY = y;}
+    void setPolygon(const QPolygon& selection){polygon = selection;}
+    void setNbSpikesToExtract(long nbSpikes){nbSpikesToExtract = nbSpikes;}
+    void setNbCorrelogramClusters(int nbClusters){nbCorrelogramClusters = nbClusters;}
+
+    /**Runs all the operations, returns false if the dataset could not be loaded.*/
+    bool run(QString& errorInformation);
+
+    /**Writes the dataset description and the measures as JSON in @p output.*/
+    void writeJson(FILE* output) const;
+
+private:
+    bool load(QString& errorInformation);
+    void createNewCluster();
+    void groupClusters();
+    void undoRedo(const QString& name,QList<int>& addedClusters,QList<int>& modifiedClusters,QList<int>& deletedClusters);
+    void saveClusters();
+    void correlograms();
+    void errorMatrix();
+    void waveforms();
+    void providers();
+
+    /**Returns the ids of the clusters sorted by decreasing size, the noise and artefact clusters (0 and 1) excluded.*/
+    QList<int> largestClusters();
+
+    /**Returns the number of spikes of the cluster @p clusterId.*/
+    long clusterSize(dataType clusterId);
+
+    void startMeasure(){timer.start();}
+    void endMeasure(const QString& name,long count = -1);
+
+    QString baseName;
+    QString electrodeGroup;
+    QString cluFileName;
+    int dimensionX;
+    int dimensionY;
+    QPolygon polygon;
+    long nbSpikesToExtract;
+    int nbCorrelogramClusters;
+    /**Requests for waveforms served by, or missing from, the waveforms already collected.*/
+    qint64 waveformCacheHits;
+    qint64 waveformCacheMisses;
+
+    Data data;
+    QElapsedTimer timer;
+    QList<Measure> measures;
+};
+
+bool DataBenchmark::run(QString& errorInformation){
+    if(!load(errorInformation)) return false;
+    createNewCluster();
+    groupClusters();
+    saveClusters();
+    correlograms();
+    errorMatrix();
+    waveforms();
+    providers();
+    return true;
+}
+
+bool DataBenchmark::load(QString& errorInformation){
+    QString fetFileName = baseName + ".fet." + electrodeGroup;
+    QString spkFileName = baseName + ".spk." + electrodeGroup;
+    QString xmlFileName = baseName + ".xml";
+    cluFileName = baseName + ".clu." + electrodeGroup;
+
+    QFile fetFile(fetFileName);
+    if(!fetFile.open(QIODevice::ReadOnly)){
+        errorInformation = "Could not open " + fetFileName;
+        return false;
+    }
+    QFileInfo spkFileInfo(spkFileName);
+    if(!spkFileInfo.exists()){
+        errorInformation = "Could not find " + spkFileName;
+        return false;
+    }
+    long spkFileLength = static_cast<long>(spkFileInfo.size());
+    QFile cluFile(cluFileName);
+    bool clusterFileExists = cluFile.exists() && cluFile.open(QIODevice::ReadOnly);
+
+    bool status;
+    startMeasure();
+    if(QFileInfo(xmlFileName).exists()){
+        QFile xmlFile(xmlFileName);
+        if(!xmlFile.open(QIODevice::ReadOnly)){
+            errorInformation = "Could not open " + xmlFileName;
+            return false;
+        }
+        if(clusterFileExists) status = data.initialize(fetFile,cluFile,spkFileLength,spkFileName,xmlFile,electrodeGroup.toInt(),errorInformation);
+        else status = data.initialize(fetFile,spkFileLength,spkFileName,xmlFile,electrodeGroup.toInt(),errorInformation);
+    }
+    else{
+        QFile parXFile(baseName + ".par." + electrodeGroup);
+        QFile parFile(baseName + ".par");
+        if(!parXFile.open(QIODevice::ReadOnly) || !parFile.open(QIODevice::ReadOnly)){
+            errorInformation = "Could not open the parameter files of " + baseName;
+            return false;
+        }
+        if(clusterFileExists) status = data.initialize(fetFile,cluFile,spkFileLength,spkFileName,parXFile,parFile,errorInformation);
+        else status = data.initialize(fetFile,spkFileLength,spkFileName,parXFile,parFile,errorInformation);
+    }
+    if(status) data.waitForAllDimensions();
+    endMeasure("load",data.totalNbOfSpikes());
+    return status;
+}
+
+void DataBenchmark::createNewCluster(){
+    if(polygon.isEmpty()){
+        //Central half of the range of each dimension.
+        long minX = data.minDimension(dimensionX);
+        long maxX = data.maxDimension(dimensionX);
+        long minY = data.minDimension(dimensionY);
+        long maxY = data.maxDimension(dimensionY);
+        long quarterX = (maxX - minX) / 4;
+        long quarterY = (maxY - minY) / 4;
+        polygon.putPoints(0,4,minX + quarterX,minY + quarterY,maxX - quarterX,minY + quarterY,maxX - quarterX,maxY - quarterY,minX + quarterX,maxY - quarterY);
+    }
+    PolygonMask region(polygon);
+
+    QList<int> clustersOfOrigin;
+    QList<dataType> clusterIds = data.clusterIds();
+    for(int i = 0; i < clusterIds.count(); ++i) clustersOfOrigin.append(static_cast<int>(clusterIds[i]));
+
+    QList<int> fromClusters;
+    QList<int> emptyClusters;
+    startMeasure();
+    dataType newClusterId = data.createNewCluster(region,clustersOfOrigin,dimensionX,dimensionY,fromClusters,emptyClusters);
+    endMeasure("createNewCluster",newClusterId == 0 ? 0 : clusterSize(newClusterId));
+
+    if(newClusterId != 0){
+        QList<int> addedClusters;
+        addedClusters.append(static_cast<int>(newClusterId));
+        undoRedo("createNewCluster",addedClusters,fromClusters,emptyClusters);
+    }
+}
+
+void DataBenchmark::groupClusters(){
+    QList<int> clusters = largestClusters();
+    if(clusters.count() < 2) return;
+
+    QList<int> clustersToGroup;
+    clustersToGroup.append(clusters[0]);
+    clustersToGroup.append(clusters[1]);
+    startMeasure();
+    dataType newClusterId = data.groupClusters(clustersToGroup);
+    endMeasure("groupClusters",clusterSize(newClusterId));
+
+    QList<int> addedClusters;
+    addedClusters.append(static_cast<int>(newClusterId));
+    QList<int> modifiedClusters;
+    undoRedo("groupClusters",addedClusters,modifiedClusters,clustersToGroup);
+}
+
+void DataBenchmark::undoRedo(const QString& name,QList<int>& addedClusters,QList<int>& modifiedClusters,QList<int>& deletedClusters){
+    startMeasure();
+    data.undo(addedClusters,modifiedClusters);
+    endMeasure("undo " + name);
+
+    startMeasure();
+    data.redo(addedClusters,modifiedClusters,deletedClusters);
+    endMeasure("redo " + name);
+}
+
+void DataBenchmark::saveClusters(){
+    QString fileName = QDir::tempPath() + "/klusters-bench.clu." + electrodeGroup;
+    FILE* clusterFile = fopen(fileName.toLatin1(),"w");
+    if(clusterFile == NULL) return;
+    startMeasure();
+    data.saveClusters(clusterFile);
+    fclose(clusterFile);
+    endMeasure("saveClusters",data.totalNbOfSpikes());
+    QFile::remove(fileName);
+}
+
+void DataBenchmark::correlograms(){
+    //Parameters used by default in the correlation view.
+    int binSize = 1;
+    int timeWindow = 61;
+    double binSizeInRU = static_cast<double>(binSize) * 1000.0 / data.intervalOfSampling();
+    double timeWindowInRU = static_cast<double>(timeWindow) * 1000.0 / data.intervalOfSampling();
+    int halfBins = ((timeWindow / binSize) - 1) / 2;
+
+    QList<int> clusters = largestClusters().mid(0,nbCorrelogramClusters);
+    long nbPairs = 0;
+    startMeasure();
+    for(int i = 0; i < clusters.count(); ++i){
+        for(int j = i; j < clusters.count(); ++j){
+            Pair pair(clusters[i],clusters[j]);
+            data.getCorrelograms(pair,binSize,timeWindow,binSizeInRU,timeWindowInRU,halfBins);
+            nbPairs++;
+        }
+    }
+    endMeasure("correlograms",nbPairs);
+}
+
+void DataBenchmark::errorMatrix(){
+    GroupingAssistant assistant;
+    QList<int> clusterList;
+    QList<int> computedClusterList;
+    QList<int> ignoreClusterIndex;
+    startMeasure();
+    Array<double>* probabilities = assistant.computeMeanProbabilities(data,clusterList,computedClusterList,ignoreClusterIndex);
+    endMeasure("errorMatrix",clusterList.count());
+    delete probabilities;
+}
+
+void DataBenchmark::waveforms(){
+    QList<dataType> clusterIds = data.clusterIds();
+
+    startMeasure();
+    for(int i = 0; i < clusterIds.count(); ++i) data.getSampleWaveformPoints(static_cast<int>(clusterIds[i]),nbSpikesToExtract);
+    endMeasure("sampleWaveforms",clusterIds.count());
+
+    //Selecting the same clusters again is served by the waveforms already collected.
+    startMeasure();
+    for(int i = 0; i < clusterIds.count(); ++i) data.getSampleWaveformPoints(static_cast<int>(clusterIds[i]),nbSpikesToExtract);
+    endMeasure("sampleWaveformsCached",clusterIds.count());
+
+    startMeasure();
+    for(int i = 0; i < clusterIds.count(); ++i) data.calculateSampleMean(static_cast<int>(clusterIds[i]),nbSpikesToExtract);
+    endMeasure("sampleMeans",clusterIds.count());
+
+    //All the spikes of the first minute.
+    startMeasure();
+    for(int i = 0; i < clusterIds.count(); ++i) data.getTimeFrameWaveformPoints(static_cast<int>(clusterIds[i]),0,60);
+    endMeasure("timeFrameWaveforms",clusterIds.count());
+
+    waveformCacheHits = data.waveformCacheHits();
+    waveformCacheMisses = data.waveformCacheMisses();
+}
+
+void DataBenchmark::providers(){
+    //One second of data, in milliseconds.
+    long endTime = 1000;
+
+    if(QFileInfo(cluFileName).exists()){
+        ClustersProvider clustersProvider(cluFileName,data.getSamplingRate(),data.getSamplingRate(),data,data.maxDimension(data.timeDimension()));
+        startMeasure();
+        clustersProvider.requestData(0,endTime,0L,0);
+        endMeasure("clustersProvider");
+    }
+
+    QString datFileName = baseName + ".dat";
+    if(data.isTraceViewVariablesAvailable() && QFileInfo(datFileName).exists()){
+        TracesProvider tracesProvider(datFileName,data.getTotalNbChannels(),data.getResolution(),data.getSamplingRate(),data.getOffset());
+        startMeasure();
+        tracesProvider.requestData(0,endTime,0L,0);
+        endMeasure("tracesProvider");
+    }
+}
+
+QList<int> DataBenchmark::largestClusters(){
+    QMultiMap<dataType,int> clustersBySize;
+    QList<dataType> clusterIds = data.clusterIds();
+    for(int i = 0; i < clusterIds.count(); ++i)
+        if(clusterIds[i] > 1) clustersBySize.insert(data.nbOfSpikes(clusterIds[i]),static_cast<int>(clusterIds[i]));
+
+    QList<int> clusters;
+    QMultiMap<dataType,int>::ConstIterator sizeIterator = clustersBySize.constEnd();
+    while(sizeIterator != clustersBySize.constBegin()){
+        --sizeIterator;
+        clusters.append(sizeIterator.value());
+    }
+    return clusters;
+}
+
+long DataBenchmark::clusterSize(dataType clusterId){
+    return data.nbOfSpikes(clusterId);
+}
+
+void DataBenchmark::endMeasure(const QString& name,long count){
+    Measure measure;
+    measure.name = name;
+    measure.seconds = static_cast<double>(timer.nsecsElapsed()) / 1.0e9;
+    measure.count = count;
+    measures.append(measure);
+}
+
+static QByteArray jsonString(const QString& value){
+    QByteArray escaped = value.toUtf8();
+    escaped.replace('\\',"\\\\");
+    escaped.replace('"',"\\\"");
+    return "\"" + escaped + "\"";
+}
+
+void DataBenchmark::writeJson(FILE* output) const{
+    fprintf(output,"{\n");
+    fprintf(output,"  \"dataset\": %s,\n",jsonString(baseName).constData());
+    fprintf(output,"  \"electrodeGroup\": %s,\n",jsonString(electrodeGroup).constData());
+    fprintf(output,"  \"nbSpikes\": %ld,\n",data.totalNbOfSpikes());
+    fprintf(output,"  \"nbDimensions\": %d,\n",data.timeDimension());
+    fprintf(output,"  \"nbChannels\": %d,\n",data.nbOfchannels());
+    fprintf(output,"  \"nbSamplesInWaveform\": %d,\n",data.nbOfSampleInWaveform());
+    fprintf(output,"  \"waveformCacheHits\": %lld,\n",static_cast<long long>(waveformCacheHits));
+    fprintf(output,"  \"waveformCacheMisses\": %lld,\n",static_cast<long long>(waveformCacheMisses));
+    fprintf(output,"  \"operations\": [\n");
+    for(int i = 0; i < measures.count(); ++i){
+        const Measure& measure = measures[i];
+        fprintf(output,"    {\"name\": %s, \"seconds\": %.6f",jsonString(measure.name).constData(),measure.seconds);
+        if(measure.count >= 0) fprintf(output,", \"count\": %ld",measure.count);
+        fprintf(output,"}%s\n",i < measures.count() - 1 ? "," : "");
+    }
+    fprintf(output,"  ]\n}\n");
+}
+
+static void printUsage(const char* program){
+    fprintf(stderr,"usage: %s [-x dimension] [-y dimension] [-p \"x,y x,y ...\"] [-s nbSpikes] [-c nbClusters] [-o file] baseName electrodeGroup\n",program);
+}
+
+int main(int argc,char** argv){
+    QCoreApplication app(argc,argv);
+    QStringList args = app.arguments();
+
+    int dimensionX = 1;
+    int dimensionY = 2;
+    QPolygon polygon;
+    long nbSpikesToExtract = 100;
+    int nbCorrelogramClusters = 5;
+    QString outputFileName;
+    QStringList positional;
+    for(int i = 1; i < args.count(); ++i){
+        QString arg = args[i];
+        bool hasValue = i + 1 < args.count();
+        if(arg == "-x" && hasValue) dimensionX = args[++i].toInt();
+        else if(arg == "-y" && hasValue) dimensionY = args[++i].toInt();
+        else if(arg == "-s" && hasValue) nbSpikesToExtract = args[++i].toLong();
+        else if(arg == "-c" && hasValue) nbCorrelogramClusters = args[++i].toInt();
+        else if(arg == "-o" && hasValue) outputFileName = args[++i];
+        else if(arg == "-p" && hasValue){
+            QStringList points = args[++i].split(' ',QString::SkipEmptyParts);
+            for(int j = 0; j < points.count(); ++j){
+                QStringList coordinates = points[j].split(',');
+                if(coordinates.count() == 2) polygon.putPoints(j,1,coordinates[0].toInt(),coordinates[1].toInt());
+            }
+        }
+        else if(arg.startsWith('-')){
+            printUsage(argv[0]);
+            return 1;
+        }
+        else positional.append(arg);
+    }
+    if(positional.count() != 2 || dimensionX < 1 || dimensionY < 1 || nbSpikesToExtract < 1){
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    DataBenchmark benchmark(positional[0],positional[1]);
+    benchmark.setDimensions(dimensionX,dimensionY);
+    benchmark.setPolygon(polygon);
+    benchmark.setNbSpikesToExtract(nbSpikesToExtract);
+    benchmark.setNbCorrelogramClusters(nbCorrelogramClusters);
+
+    QString errorInformation;
+    if(!benchmark.run(errorInformation)){
+        fprintf(stderr,"%s\n",errorInformation.toLocal8Bit().constData());
+        return 1;
+    }
+
+    FILE* output = stdout;
+    if(!outputFileName.isEmpty()){
+        output = fopen(outputFileName.toLocal8Bit(),"w");
+        if(output == NULL){
+            fprintf(stderr,"could not open %s\n",outputFileName.toLocal8Bit().constData());
+            return 1;
+        }
+    }
+    benchmark.writeJson(output);
+    if(output != stdout) fclose(output);
+    return 0;
+}
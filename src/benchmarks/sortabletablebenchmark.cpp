@@ -0,0 +1,122 @@
+/***************************************************************************
+                          sortabletablebenchmark.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Times the sort of a two row SortableTable by its first row on sorted, reversed and random inputs,
+ * and on the spike times of several clusters put one after the other, as sorted by the ClustersProvider
+ * and by Data::integrateReclusteredClusters. Each sort is checked and compared with std::sort on pairs.
+ *
+ * Usage: sortabletablebenchmark [nbValues] [nbClusters]
+ */
+
+#include "sortabletable.h"
+#include "timer.h"
+
+//C include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+enum Input{SORTED,REVERSED,RANDOM,CLUSTERS,FEW_VALUES};
+
+static const char* inputName(Input input){
+    switch(input){
+    case SORTED: return "sorted";
+    case REVERSED: return "reversed";
+    case RANDOM: return "random";
+    case CLUSTERS: return "by cluster";
+    default: return "few values";
+    }
+}
+
+/**Fills @p keys with @p nbValues values of the kind @p input.*/
+static void fillKeys(std::vector<dataType>& keys,dataType nbValues,int nbClusters,Input input){
+    keys.resize(nbValues);
+    dataType time = 0;
+    for(dataType i = 0; i < nbValues; ++i){
+        time += 1 + rand() % 400;
+        switch(input){
+        case SORTED: keys[i] = time; break;
+        case REVERSED: keys[i] = 400 * nbValues - time; break;
+        case RANDOM: keys[i] = (static_cast<dataType>(rand()) << 16) ^ rand(); break;
+        case FEW_VALUES: keys[i] = rand() % 16; break;
+        default: keys[i] = time;
+        }
+    }
+
+    //Spikes of each cluster sorted by time, the clusters one after the other.
+    if(input == CLUSTERS){
+        std::vector<dataType> clusterKeys;
+        clusterKeys.reserve(nbValues);
+        std::vector<int> clusterIds(nbValues);
+        for(dataType i = 0; i < nbValues; ++i) clusterIds[i] = rand() % nbClusters;
+        for(int cluster = 0; cluster < nbClusters; ++cluster)
+            for(dataType i = 0; i < nbValues; ++i)
+                if(clusterIds[i] == cluster) clusterKeys.push_back(keys[i]);
+        keys.swap(clusterKeys);
+    }
+}
+
+static void runBenchmark(dataType nbValues,int nbClusters,Input input){
+    std::vector<dataType> keys;
+    fillKeys(keys,nbValues,nbClusters,input);
+
+    SortableTable table;
+    table.setSize(nbValues);
+    for(dataType i = 0; i < nbValues; ++i){
+        table(1,i + 1) = keys[i];
+        table(2,i + 1) = i;
+    }
+    RestartTimer();
+    table.sort(1);
+    float tableTime = Timer();
+
+    //Check that the keys are sorted and still paired with their original column.
+    bool correct = true;
+    for(dataType i = 1; i <= nbValues && correct; ++i){
+        if(i > 1 && table(1,i - 1) > table(1,i)) correct = false;
+        if(keys[table(2,i)] != table(1,i)) correct = false;
+    }
+
+    std::vector<std::pair<dataType,dataType> > pairs(nbValues);
+    for(dataType i = 0; i < nbValues; ++i) pairs[i] = std::make_pair(keys[i],i);
+    RestartTimer();
+    std::sort(pairs.begin(),pairs.end());
+    float referenceTime = Timer();
+
+    printf("%-12s SortableTable %8.3f s  std::sort %8.3f s  %s\n",inputName(input),tableTime,referenceTime,correct ? "ok" : "NOT SORTED");
+}
+
+int main(int argc,char** argv){
+    dataType nbValues = argc > 1 ? atol(argv[1]) : 5000000;
+    int nbClusters = argc > 2 ? atoi(argv[2]) : 40;
+    if(nbValues < 1 || nbClusters < 1){
+        fprintf(stderr,"usage: %s [nbValues] [nbClusters]\n",argv[0]);
+        return 1;
+    }
+
+    srand(1);
+    printf("%ld values, %d clusters\n",nbValues,nbClusters);
+    runBenchmark(nbValues,nbClusters,SORTED);
+    runBenchmark(nbValues,nbClusters,REVERSED);
+    runBenchmark(nbValues,nbClusters,RANDOM);
+    runBenchmark(nbValues,nbClusters,CLUSTERS);
+    runBenchmark(nbValues,nbClusters,FEW_VALUES);
+    return 0;
+}
@@ -0,0 +1,514 @@
+/***************************************************************************
+                          syntheticdataset.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Writes a synthetic dataset which can be opened by Klusters, so that performance measures can be
+ * reproduced without sharing recordings: baseName.xml, baseName.par, baseName.par.n, baseName.spk.n,
+ * baseName.fet.n, baseName.clu.n, baseName.dat and baseName.stm.evt.
+ *
+ * Each cluster is a Gaussian in feature space (diagonal covariance) and has a waveform template,
+ * largest on one channel of the group and decreasing on the neighbouring ones. The waveforms are the
+ * template plus noise, the spike times follow a Poisson process and the size of the clusters follows
+ * a power law (cluster of rank r gets a share proportional to 1/r^skew). Cluster 1 contains broad noise
+ * spikes. The output only depends on the parameters and the seed, and the spikes are written as they are
+ * drawn without being kept in memory, so that 10^8 spikes can be generated on any machine.
+ *
+ * Usage: syntheticdataset [options] baseName
+ *   -n nbSpikes        number of spikes (default 100000)
+ *   -c nbChannels      number of channels of the electrode group (default 4)
+ *   -t nbChannels      total number of channels of the recording (default: the channels of the group)
+ *   -w nbSamples       number of samples per waveform (default 32)
+ *   -f nbFeatures      number of features per channel (default 3)
+ *   -k nbClusters      number of clusters, the noise cluster excluded (default 20)
+ *   -s skew            exponent of the cluster size power law, 0 for clusters of equal size (default 1)
+ *   -x fraction        fraction of the spikes in the noise cluster (default 0.05)
+ *   -d duration        duration of the recording in seconds (default 3600)
+ *   -r samplingRate    sampling rate in Hz (default 20000)
+ *   -D duration        duration of the .dat file in seconds, 0 to skip it (default: the whole recording)
+ *   -e nbEvents        number of events (default 100)
+ *   -g group           electrode group number used in the file names (default 1)
+ *   -S seed            seed of the random generator (default 1)
+ */
+
+//C include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+static const int kNB_BITS = 16;
+static const int kNOISE_TABLE_SIZE = 1 << 16;
+static const double kFEATURE_RANGE = 1500.0;
+static const double kNOISE_AMPLITUDE = 25.0;
+
+/**Small xorshift generator, it gives the same sequence on every platform unlike rand().*/
+class Random{
+public:
+    explicit Random(unsigned long long seed):state(seed * 2685821657736338717ULL + 1),hasSpare(false),spare(0.0){}
+
+    unsigned long long next(){
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ULL;
+    }
+
+    /**Returns a value uniformly distributed in [0,1).*/
+    double uniform(){return static_cast<double>(next() >> 11) / 9007199254740992.0;}
+
+    /**Returns a value uniformly distributed in [min,max).*/
+    double uniform(double min,double max){return min + (max - min) * uniform();}
+
+    /**Returns a value of a standard normal distribution (Box-Muller).*/
+    double gaussian(){
+        if(hasSpare){
+            hasSpare = false;
+            return spare;
+        }
+        double u = 0;
+        while(u == 0) u = uniform();
+        double v = uniform();
+        double radius = sqrt(-2.0 * log(u));
+        spare = radius * sin(2.0 * M_PI * v);
+        hasSpare = true;
+        return radius * cos(2.0 * M_PI * v);
+    }
+
+    /**Returns a value of an exponential distribution of mean @p mean.*/
+    double exponential(double mean){
+        double u = 0;
+        while(u == 0) u = uniform();
+        return -mean * log(u);
+    }
+
+private:
+    unsigned long long state;
+    bool hasSpare;
+    double spare;
+};
+
+/**Buffered writer of integer values in text files, faster than fprintf for hundreds of millions of values.*/
+class TextWriter{
+public:
+    explicit TextWriter(FILE* file):file(file),buffer(kBUFFER_SIZE),length(0){}
+    ~TextWriter(){flush();}
+
+    void write(long long value){
+        if(length > kBUFFER_SIZE - 32) flush();
+        char digits[24];
+        int nbDigits = 0;
+        bool negative = value < 0;
+        unsigned long long absolute = negative ? -static_cast<unsigned long long>(value) : value;
+        do{
+            digits[nbDigits++] = '0' + static_cast<char>(absolute % 10);
+            absolute /= 10;
+        } while(absolute != 0);
+        if(negative) buffer[length++] = '-';
+        while(nbDigits > 0) buffer[length++] = digits[--nbDigits];
+    }
+    void write(char c){
+        if(length == kBUFFER_SIZE) flush();
+        buffer[length++] = c;
+    }
+    void flush(){
+        fwrite(&buffer[0],1,length,file);
+        length = 0;
+    }
+
+private:
+    enum{kBUFFER_SIZE = 1 << 20};
+    FILE* file;
+    std::vector<char> buffer;
+    int length;
+};
+
+struct Parameters{
+    long long nbSpikes;
+    int nbChannels;
+    int totalNbChannels;
+    int nbSamples;
+    int peakSample;
+    int nbFeatures;
+    int nbClusters;
+    double skew;
+    double noiseFraction;
+    double duration;
+    double samplingRate;
+    double datDuration;
+    int nbEvents;
+    int group;
+    unsigned long long seed;
+    std::string baseName;
+};
+
+/**A cluster: a Gaussian in feature space and a waveform template.*/
+struct Cluster{
+    int id;
+    double share;
+    std::vector<double> means;
+    std::vector<double> deviations;
+    /**nbSamples * nbChannels values, the channels varying the fastest as in the .spk files.*/
+    std::vector<short> waveformTemplate;
+};
+
+/**Draws the cluster of each spike and the spike times. Two generators built with the same seed give the same train,
+* this is used to write the .dat file after the other ones without keeping the spikes in memory.*/
+class SpikeTrain{
+public:
+    SpikeTrain(const Parameters& parameters,const std::vector<Cluster>& clusters)
+        :random(parameters.seed + 4),time(0){
+        meanInterval = parameters.duration * parameters.samplingRate / static_cast<double>(parameters.nbSpikes);
+        double total = 0;
+        for(size_t i = 0; i < clusters.size(); ++i){
+            total += clusters[i].share;
+            cumulativeShares.push_back(total);
+        }
+    }
+
+    /**Moves to the next spike, returns the index of its cluster.*/
+    int next(){
+        time += static_cast<long long>(random.exponential(meanInterval) + 0.5);
+        double draw = random.uniform() * cumulativeShares.back();
+        size_t low = 0;
+        size_t high = cumulativeShares.size() - 1;
+        while(low < high){
+            size_t middle = (low + high) / 2;
+            if(cumulativeShares[middle] < draw) low = middle + 1;
+            else high = middle;
+        }
+        return static_cast<int>(low);
+    }
+
+    /**Time of the current spike, in samples.*/
+    long long currentTime() const{return time;}
+
+private:
+    Random random;
+    std::vector<double> cumulativeShares;
+    double meanInterval;
+    long long time;
+};
+
+static short clip(double value){
+    if(value > 32767) return 32767;
+    if(value < -32768) return -32768;
+    return static_cast<short>(value < 0 ? value - 0.5 : value + 0.5);
+}
+
+static std::vector<Cluster> createClusters(const Parameters& parameters,Random& random){
+    std::vector<Cluster> clusters;
+    int nbDimensions = parameters.nbChannels * parameters.nbFeatures;
+
+    //Noise cluster (1) first, then clusters 2 to nbClusters + 1.
+    int first = parameters.noiseFraction > 0 ? 0 : 1;
+    for(int i = first; i <= parameters.nbClusters; ++i){
+        Cluster cluster;
+        bool noise = (i == 0);
+        cluster.id = i + 1;
+        if(noise) cluster.share = parameters.noiseFraction;
+        else{
+            double weight = 1.0 / pow(static_cast<double>(i),parameters.skew);
+            cluster.share = weight;
+        }
+
+        for(int dimension = 0; dimension < nbDimensions; ++dimension){
+            cluster.means.push_back(noise ? 0.0 : random.uniform(-kFEATURE_RANGE,kFEATURE_RANGE));
+            cluster.deviations.push_back(noise ? kFEATURE_RANGE / 2 : random.uniform(20.0,120.0));
+        }
+
+        //Biphasic spike: a narrow trough at the peak sample followed by a wider positive bump.
+        double amplitude = noise ? 60.0 : random.uniform(150.0,1200.0);
+        int mainChannel = static_cast<int>(random.uniform() * parameters.nbChannels);
+        double troughWidth = random.uniform(1.0,2.0);
+        double bumpDelay = random.uniform(4.0,8.0);
+        cluster.waveformTemplate.resize(parameters.nbSamples * parameters.nbChannels);
+        for(int sample = 0; sample < parameters.nbSamples; ++sample){
+            double t = static_cast<double>(sample - parameters.peakSample);
+            double trough = exp(-(t * t) / (2 * troughWidth * troughWidth));
+            double bump = exp(-((t - bumpDelay) * (t - bumpDelay)) / (2 * 9.0));
+            double shape = -trough + 0.35 * bump;
+            for(int channel = 0; channel < parameters.nbChannels; ++channel){
+                double distance = static_cast<double>(channel - mainChannel);
+                double channelGain = noise ? 1.0 : exp(-(distance * distance) / 2.0);
+                cluster.waveformTemplate[sample * parameters.nbChannels + channel] = clip(amplitude * channelGain * shape);
+            }
+        }
+        clusters.push_back(cluster);
+    }
+
+    //Normalize the shares of the real clusters so that they take what the noise cluster leaves.
+    double total = 0;
+    for(size_t i = 0; i < clusters.size(); ++i) if(clusters[i].id != 1) total += clusters[i].share;
+    for(size_t i = 0; i < clusters.size(); ++i)
+        if(clusters[i].id != 1) clusters[i].share *= (1.0 - (first == 0 ? parameters.noiseFraction : 0.0)) / total;
+    return clusters;
+}
+
+static FILE* openFile(const std::string& fileName,const char* mode){
+    FILE* file = fopen(fileName.c_str(),mode);
+    if(file == NULL) fprintf(stderr,"could not create %s\n",fileName.c_str());
+    return file;
+}
+
+static bool writeParameterFiles(const Parameters& parameters){
+    std::vector<int> channels;
+    for(int i = 0; i < parameters.nbChannels; ++i) channels.push_back(i);
+
+    FILE* xml = openFile(parameters.baseName + ".xml","w");
+    if(xml == NULL) return false;
+    fprintf(xml,"<?xml version='1.0'?>\n<parameters version=\"1.0\" creator=\"syntheticdataset\">\n");
+    fprintf(xml," <acquisitionSystem>\n  <nBits>%d</nBits>\n  <nChannels>%d</nChannels>\n  <samplingRate>%g</samplingRate>\n",
+            kNB_BITS,parameters.totalNbChannels,parameters.samplingRate);
+    fprintf(xml,"  <voltageRange>20</voltageRange>\n  <amplification>1000</amplification>\n  <offset>0</offset>\n </acquisitionSystem>\n");
+    fprintf(xml," <spikeDetection>\n  <channelGroups>\n");
+    for(int group = 1; group <= parameters.group; ++group){
+        //Only the generated group has spikes, the previous ones are there so that the group number is valid.
+        fprintf(xml,"   <group>\n    <channels>\n");
+        for(size_t i = 0; i < channels.size(); ++i) fprintf(xml,"     <channel>%d</channel>\n",channels[i]);
+        fprintf(xml,"    </channels>\n    <nSamples>%d</nSamples>\n    <peakSampleIndex>%d</peakSampleIndex>\n    <nFeatures>%d</nFeatures>\n   </group>\n",
+                parameters.nbSamples,parameters.peakSample,parameters.nbFeatures);
+    }
+    fprintf(xml,"  </channelGroups>\n </spikeDetection>\n</parameters>\n");
+    fclose(xml);
+
+    double samplingInterval = 1000000.0 / parameters.samplingRate;
+    FILE* par = openFile(parameters.baseName + ".par","w");
+    if(par == NULL) return false;
+    fprintf(par,"%d %d\n%g %g\n%d 0\n",parameters.totalNbChannels,kNB_BITS,samplingInterval,samplingInterval * 16,parameters.group);
+    for(int group = 1; group <= parameters.group; ++group){
+        fprintf(par,"%d",parameters.nbChannels);
+        for(size_t i = 0; i < channels.size(); ++i) fprintf(par," %d",channels[i]);
+        fprintf(par,"\n");
+    }
+    fclose(par);
+
+    char groupName[16];
+    sprintf(groupName,".par.%d",parameters.group);
+    FILE* parX = openFile(parameters.baseName + groupName,"w");
+    if(parX == NULL) return false;
+    fprintf(parX,"%d %d %g\n",parameters.totalNbChannels,parameters.nbChannels,samplingInterval);
+    for(size_t i = 0; i < channels.size(); ++i) fprintf(parX,"%d ",channels[i]);
+    fprintf(parX,"\n10 2\n0.0\n%d %d\n%d %d\n%d %d\n%d %d\n800\n",parameters.nbSamples,parameters.peakSample,
+            parameters.nbSamples,parameters.peakSample,parameters.peakSample,parameters.nbSamples - parameters.peakSample,
+            parameters.nbFeatures,parameters.nbSamples);
+    fclose(parX);
+    return true;
+}
+
+/**Writes the .spk, .fet and .clu files in a single pass over the spikes.*/
+static bool writeSpikeFiles(const Parameters& parameters,const std::vector<Cluster>& clusters,const std::vector<short>& noise){
+    char suffix[16];
+    sprintf(suffix,".%d",parameters.group);
+    FILE* spk = openFile(parameters.baseName + ".spk" + suffix,"wb");
+    FILE* fet = openFile(parameters.baseName + ".fet" + suffix,"wb");
+    FILE* clu = openFile(parameters.baseName + ".clu" + suffix,"wb");
+    if(spk == NULL || fet == NULL || clu == NULL) return false;
+
+    int nbDimensions = parameters.nbChannels * parameters.nbFeatures;
+    int nbPoints = parameters.nbSamples * parameters.nbChannels;
+    Random random(parameters.seed + 1);
+    SpikeTrain train(parameters,clusters);
+    std::vector<short> waveform(nbPoints);
+
+    TextWriter features(fet);
+    TextWriter clusterIds(clu);
+    features.write(static_cast<long long>(nbDimensions + 1));
+    features.write('\n');
+    clusterIds.write(static_cast<long long>(clusters.size()));
+    clusterIds.write('\n');
+
+    for(long long spike = 0; spike < parameters.nbSpikes; ++spike){
+        const Cluster& cluster = clusters[train.next()];
+
+        int noiseOffset = static_cast<int>(random.next() % (kNOISE_TABLE_SIZE - nbPoints));
+        for(int i = 0; i < nbPoints; ++i) waveform[i] = clip(cluster.waveformTemplate[i] + noise[noiseOffset + i]);
+        fwrite(&waveform[0],sizeof(short),nbPoints,spk);
+
+        for(int dimension = 0; dimension < nbDimensions; ++dimension){
+            features.write(static_cast<long long>(cluster.means[dimension] + cluster.deviations[dimension] * random.gaussian()));
+            features.write(' ');
+        }
+        features.write(train.currentTime());
+        features.write('\n');
+
+        clusterIds.write(static_cast<long long>(cluster.id));
+        clusterIds.write('\n');
+    }
+
+    features.flush();
+    clusterIds.flush();
+    bool status = !ferror(spk) && !ferror(fet) && !ferror(clu);
+    fclose(spk);
+    fclose(fet);
+    fclose(clu);
+    return status;
+}
+
+/**Writes the .dat file: noise on all the channels plus the templates of the spikes on the channels of the group.*/
+static bool writeDatFile(const Parameters& parameters,const std::vector<Cluster>& clusters,const std::vector<short>& noise){
+    FILE* dat = openFile(parameters.baseName + ".dat","wb");
+    if(dat == NULL) return false;
+
+    long long nbSamples = static_cast<long long>(parameters.datDuration * parameters.samplingRate);
+    const long long kBLOCK_SAMPLES = 65536;
+    int nbChannels = parameters.totalNbChannels;
+    std::vector<short> block(kBLOCK_SAMPLES * nbChannels);
+    Random random(parameters.seed + 2);
+
+    //The same spike train as the one used for the other files. The spikes overlapping the end of a block
+    //are kept, with the index of their cluster, to add the rest of their waveform in the next block.
+    SpikeTrain train(parameters,clusters);
+    long long nbSpikesDrawn = 0;
+    std::vector<std::pair<long long,int> > pendingSpikes;
+
+    for(long long blockStart = 0; blockStart < nbSamples; blockStart += kBLOCK_SAMPLES){
+        long long blockSize = nbSamples - blockStart < kBLOCK_SAMPLES ? nbSamples - blockStart : kBLOCK_SAMPLES;
+        long long blockEnd = blockStart + blockSize;
+        for(long long i = 0; i < blockSize * nbChannels; i += kNOISE_TABLE_SIZE / 2){
+            long long length = blockSize * nbChannels - i < kNOISE_TABLE_SIZE / 2 ? blockSize * nbChannels - i : kNOISE_TABLE_SIZE / 2;
+            int noiseOffset = static_cast<int>(random.next() % (kNOISE_TABLE_SIZE / 2));
+            memcpy(&block[i],&noise[noiseOffset],length * sizeof(short));
+        }
+
+        std::vector<std::pair<long long,int> > spikes;
+        spikes.swap(pendingSpikes);
+        while(nbSpikesDrawn < parameters.nbSpikes){
+            int clusterIndex = train.next();
+            ++nbSpikesDrawn;
+            spikes.push_back(std::make_pair(train.currentTime() - parameters.peakSample,clusterIndex));
+            if(train.currentTime() - parameters.peakSample >= blockEnd) break;
+        }
+
+        for(size_t i = 0; i < spikes.size(); ++i){
+            long long start = spikes[i].first;
+            if(start >= blockEnd){
+                pendingSpikes.push_back(spikes[i]);
+                continue;
+            }
+            const Cluster& cluster = clusters[spikes[i].second];
+            for(int sample = 0; sample < parameters.nbSamples; ++sample){
+                long long time = start + sample;
+                if(time < blockStart || time >= blockEnd) continue;
+                for(int channel = 0; channel < parameters.nbChannels; ++channel){
+                    short& value = block[(time - blockStart) * nbChannels + channel];
+                    value = clip(value + cluster.waveformTemplate[sample * parameters.nbChannels + channel]);
+                }
+            }
+            if(start + parameters.nbSamples > blockEnd) pendingSpikes.push_back(spikes[i]);
+        }
+        fwrite(&block[0],sizeof(short),blockSize * nbChannels,dat);
+    }
+
+    bool status = !ferror(dat);
+    fclose(dat);
+    return status;
+}
+
+static bool writeEventFile(const Parameters& parameters){
+    FILE* evt = openFile(parameters.baseName + ".stm.evt","w");
+    if(evt == NULL) return false;
+    Random random(parameters.seed + 3);
+    double durationInMs = parameters.duration * 1000.0;
+    double time = 0;
+    for(int i = 0; i < parameters.nbEvents; ++i){
+        time += random.exponential(durationInMs / (parameters.nbEvents + 1));
+        fprintf(evt,"%.3f %s\n",time,i % 2 == 0 ? "stimulus on" : "stimulus off");
+    }
+    fclose(evt);
+    return true;
+}
+
+static void printUsage(const char* program){
+    fprintf(stderr,"usage: %s [-n nbSpikes] [-c nbChannels] [-t totalNbChannels] [-w nbSamples] [-f nbFeatures] [-k nbClusters]\n"
+            "          [-s skew] [-x noiseFraction] [-d duration] [-r samplingRate] [-D datDuration] [-e nbEvents] [-g group] [-S seed] baseName\n",program);
+}
+
+int main(int argc,char** argv){
+    Parameters parameters;
+    parameters.nbSpikes = 100000;
+    parameters.nbChannels = 4;
+    parameters.totalNbChannels = 0;
+    parameters.nbSamples = 32;
+    parameters.nbFeatures = 3;
+    parameters.nbClusters = 20;
+    parameters.skew = 1.0;
+    parameters.noiseFraction = 0.05;
+    parameters.duration = 3600;
+    parameters.samplingRate = 20000;
+    parameters.datDuration = -1;
+    parameters.nbEvents = 100;
+    parameters.group = 1;
+    parameters.seed = 1;
+
+    for(int i = 1; i < argc; ++i){
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg[0] == '-' && strlen(arg) == 2 && hasValue){
+            const char* value = argv[++i];
+            switch(arg[1]){
+            case 'n': parameters.nbSpikes = atoll(value); break;
+            case 'c': parameters.nbChannels = atoi(value); break;
+            case 't': parameters.totalNbChannels = atoi(value); break;
+            case 'w': parameters.nbSamples = atoi(value); break;
+            case 'f': parameters.nbFeatures = atoi(value); break;
+            case 'k': parameters.nbClusters = atoi(value); break;
+            case 's': parameters.skew = atof(value); break;
+            case 'x': parameters.noiseFraction = atof(value); break;
+            case 'd': parameters.duration = atof(value); break;
+            case 'r': parameters.samplingRate = atof(value); break;
+            case 'D': parameters.datDuration = atof(value); break;
+            case 'e': parameters.nbEvents = atoi(value); break;
+            case 'g': parameters.group = atoi(value); break;
+            case 'S': parameters.seed = strtoull(value,0,10); break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if(arg[0] != '-' && parameters.baseName.empty()) parameters.baseName = arg;
+        else{
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if(parameters.totalNbChannels == 0) parameters.totalNbChannels = parameters.nbChannels;
+    if(parameters.datDuration < 0 || parameters.datDuration > parameters.duration) parameters.datDuration = parameters.duration;
+    parameters.peakSample = parameters.nbSamples / 2;
+    if(parameters.baseName.empty() || parameters.nbSpikes < 1 || parameters.nbChannels < 1 || parameters.totalNbChannels < parameters.nbChannels
+            || parameters.nbSamples < 2 || parameters.nbSamples * parameters.nbChannels > kNOISE_TABLE_SIZE / 2 || parameters.nbFeatures < 1
+            || parameters.nbClusters < 1 || parameters.noiseFraction < 0 || parameters.noiseFraction >= 1 || parameters.duration <= 0
+            || parameters.samplingRate <= 0 || parameters.nbEvents < 0 || parameters.group < 1){
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Random random(parameters.seed);
+    std::vector<Cluster> clusters = createClusters(parameters,random);
+    std::vector<short> noise(kNOISE_TABLE_SIZE);
+    for(int i = 0; i < kNOISE_TABLE_SIZE; ++i) noise[i] = clip(kNOISE_AMPLITUDE * random.gaussian());
+
+    if(!writeParameterFiles(parameters)) return 1;
+    if(!writeSpikeFiles(parameters,clusters,noise)) return 1;
+    if(parameters.datDuration > 0 && !writeDatFile(parameters,clusters,noise)) return 1;
+    if(!writeEventFile(parameters)) return 1;
+
+    printf("%lld spikes in %d clusters written to %s\n",parameters.nbSpikes,static_cast<int>(clusters.size()),parameters.baseName.c_str());
+    return 0;
+}
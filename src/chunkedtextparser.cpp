@@ -0,0 +1,187 @@
+/***************************************************************************
+                          chunkedtextparser.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "chunkedtextparser.h"
+#include "taskpool.h"
+
+//Qt include files
+#include <QByteArray>
+#include <QList>
+#include <QRunnable>
+
+//C include files
+#include <limits>
+
+const qint64 ChunkedTextParser::kBLOCK_SIZE = 64 * 1024 * 1024;
+
+static inline bool isSeparator(char c){
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**Task counting or parsing the values of one chunk.*/
+class ChunkTask : public QRunnable{
+public:
+    ChunkTask(const char* begin,const char* end,bool allowNegativeValues,const QVector<bool>& columnsToStore)
+        :begin(begin),end(end),allowNegativeValues(allowNegativeValues),columnsToStore(columnsToStore),
+          values(0L),nbValues(0),firstIndex(0),count(0),valid(true){
+        setAutoDelete(false);
+    }
+
+    /**Sets the destination of the values, when not set the task only counts the values.*/
+    void setDestination(dataType* destination,dataType nbOfValues,dataType indexOfFirstValue){
+        values = destination;
+        nbValues = nbOfValues;
+        firstIndex = indexOfFirstValue;
+    }
+
+    void run(){
+        if(values == 0L) count = ChunkedTextParser::countValues(begin,end);
+        else valid = ChunkedTextParser::parseValues(begin,end,allowNegativeValues,values,nbValues,firstIndex,columnsToStore);
+    }
+
+    const char* begin;
+    const char* end;
+    bool allowNegativeValues;
+    const QVector<bool>& columnsToStore;
+    dataType* values;
+    dataType nbValues;
+    dataType firstIndex;
+    dataType count;
+    bool valid;
+};
+
+ChunkedTextParser::ChunkedTextParser(QFile& file,bool allowNegativeValues):file(file),allowNegativeValues(allowNegativeValues),cancelFlag(0L),valid(true){
+    nbChunks = TaskPool::globalInstance().threadCount();
+}
+
+dataType ChunkedTextParser::firstValue(const QByteArray& line){
+    dataType value = 0;
+    if(!parseValues(line.constData(),line.constData() + line.size(),false,&value,1)) return 0;
+    return value;
+}
+
+dataType ChunkedTextParser::countValues(const char* begin,const char* end){
+    dataType count = 0;
+    bool inValue = false;
+    for(const char* p = begin; p < end; ++p){
+        bool valueCharacter = !isSeparator(*p);
+        if(valueCharacter && !inValue) ++count;
+        inValue = valueCharacter;
+    }
+    return count;
+}
+
+bool ChunkedTextParser::parseValues(const char* begin,const char* end,bool allowNegativeValues,dataType* values,dataType nbValues,
+                                    dataType firstIndex,const QVector<bool>& columnsToStore){
+    int nbColumns = columnsToStore.size();
+    int column = nbColumns > 0 ? static_cast<int>(firstIndex % nbColumns) : 0;
+    dataType k = 0;
+    const char* p = begin;
+    const dataType maxValue = std::numeric_limits<dataType>::max();
+    while(p < end && k < nbValues){
+        if(isSeparator(*p)){
+            ++p;
+            continue;
+        }
+        bool negative = false;
+        if(*p == '-' && allowNegativeValues){
+            negative = true;
+            ++p;
+        }
+        //A value is made of at least one digit and ends at a separator.
+        const char* digits = p;
+        dataType value = 0;
+        while(p < end && *p >= '0' && *p <= '9'){
+            int digit = *p - '0';
+            if(value > (maxValue - digit) / 10) return false;
+            value = value * 10 + digit;
+            ++p;
+        }
+        if(p == digits || (p < end && !isSeparator(*p))) return false;
+        if(nbColumns == 0 || columnsToStore[column]) values[k] = negative ? -value : value;
+        ++k;
+        if(nbColumns > 0 && ++column == nbColumns) column = 0;
+    }
+    return true;
+}
+
+void ChunkedTextParser::parseBlock(const char* begin,const char* end,dataType* values,dataType nbValues,dataType& nbValuesRead){
+    //Split the block in chunks ending on a line boundary.
+    QList<ChunkTask*> tasks;
+    const char* chunkBegin = begin;
+    qint64 chunkSize = (end - begin) / nbChunks + 1;
+    while(chunkBegin < end){
+        const char* chunkEnd = chunkBegin + chunkSize;
+        if(chunkEnd >= end) chunkEnd = end;
+        else{
+            while(chunkEnd < end && *chunkEnd != '\n') ++chunkEnd;
+            if(chunkEnd < end) ++chunkEnd;
+        }
+        tasks.append(new ChunkTask(chunkBegin,chunkEnd,allowNegativeValues,columnsToStore));
+        chunkBegin = chunkEnd;
+    }
+
+    TaskPool::Group group;
+
+    //First pass: count the values of each chunk.
+    for(int i = 0; i < tasks.count(); ++i) group.start(tasks[i]);
+    group.wait();
+
+    //Second pass: parse each chunk at the offset given by the counts of the previous chunks.
+    dataType offset = nbValuesRead;
+    for(int i = 0; i < tasks.count(); ++i){
+        ChunkTask* task = tasks[i];
+        if(task->count > 0 && offset < nbValues){
+            dataType nbToStore = qMin(task->count,nbValues - offset);
+            task->setDestination(values + offset,nbToStore,offset);
+            group.start(task);
+        }
+        offset += task->count;
+    }
+    group.wait();
+    nbValuesRead = offset;
+    for(int i = 0; i < tasks.count(); ++i) if(!tasks[i]->valid) valid = false;
+
+    qDeleteAll(tasks);
+}
+
+dataType ChunkedTextParser::parse(dataType* values,dataType nbValues){
+    dataType nbValuesRead = 0;
+    QByteArray buffer;
+
+    valid = true;
+
+    while(!file.atEnd()){
+        if(cancelFlag != 0L && *cancelFlag) return nbValuesRead;
+        if(!valid) return nbValuesRead;
+        QByteArray block = file.read(kBLOCK_SIZE);
+        if(block.isEmpty()) break;
+        buffer.append(block);
+
+        //Only parse up to the last complete line, the rest is kept for the next block.
+        int lastNewLine = buffer.lastIndexOf('\n');
+        if(lastNewLine == -1 && !file.atEnd()) continue;
+        int length = file.atEnd() ? buffer.size() : lastNewLine + 1;
+
+        parseBlock(buffer.constData(),buffer.constData() + length,values,nbValues,nbValuesRead);
+        buffer.remove(0,length);
+    }
+    if(!buffer.isEmpty())
+        parseBlock(buffer.constData(),buffer.constData() + buffer.size(),values,nbValues,nbValuesRead);
+
+    return nbValuesRead;
+}
@@ -0,0 +1,100 @@
+/***************************************************************************
+                          chunkedtextparser.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef CHUNKEDTEXTPARSER_H
+#define CHUNKEDTEXTPARSER_H
+
+//Include files of the application
+#include "types.h"
+
+//Include files for QT
+#include <qfile.h>
+#include <QVector>
+
+/**
+* This class parses the integer values contained in a text file (.fet or .clu file).
+* The file is read in large blocks, each block is split on line boundaries in as many chunks as
+* there are processors and the chunks are parsed in parallel: a first pass counts the values of each chunk,
+* which gives the offset at which each chunk writes its values, and a second pass converts and stores them.
+* The values are separated by white spaces, a value which is not an integer or does not fit in a dataType
+* makes the content incorrect, see isValid().
+*/
+class ChunkedTextParser{
+
+public:
+    /**Constructor.
+  * @param file the file to parse, already open. The parsing starts at the current position in the file,
+  * so a header line can be read beforehand.
+  * @param allowNegativeValues true if the values can be negative (features), false otherwise (clusters).
+  */
+    ChunkedTextParser(QFile& file,bool allowNegativeValues);
+    ~ChunkedTextParser(){}
+
+    /**Only stores the values of some columns, the values being laid out row by row.
+  * The values of the other columns are skipped, their place in the destination array being left untouched.
+  * @param columnsToStore one element per column, true if the values of the column have to be stored.
+  */
+    void setColumnsToStore(const QVector<bool>& columnsToStore){this->columnsToStore = columnsToStore;}
+
+    /**Sets a flag checked between two blocks, the parsing stops as soon as it is true.
+  * @param flag pointer on the cancellation flag, 0 to remove it.
+  */
+    void setCancelFlag(const volatile bool* flag){cancelFlag = flag;}
+
+    /**Parses the rest of the file and stores the values in @p values.
+  * @param values preallocated array where to store the values.
+  * @param nbValues number of values which can be stored in @p values, values beyond it are counted but not stored.
+  * @return the number of values found in the file.
+  */
+    dataType parse(dataType* values,dataType nbValues);
+
+    /**Returns false if a value parsed by parse() is malformed (e.g. 12-3, a lone minus sign or stray characters)
+  * or out of range, true otherwise.
+  */
+    bool isValid() const{return valid;}
+
+    /**Returns the first integer value contained in @p line, 0 if there is none or if it is incorrect.*/
+    static dataType firstValue(const QByteArray& line);
+
+    /**Returns the number of values, separated by white spaces, contained in [@p begin,@p end).*/
+    static dataType countValues(const char* begin,const char* end);
+
+    /**Parses the values contained in [@p begin,@p end) and stores them starting at @p values,
+  * no more than @p nbValues values are stored.
+  * @param allowNegativeValues true if the minus sign is part of the values.
+  * @param firstIndex index in the file of the first value, used to find the column of each value.
+  * @param columnsToStore if not empty, only the values of the columns set to true are stored.
+  * @return false if a value is malformed or out of range, in which case the parsing stops, true otherwise.
+  */
+    static bool parseValues(const char* begin,const char* end,bool allowNegativeValues,dataType* values,dataType nbValues,
+                            dataType firstIndex = 0,const QVector<bool>& columnsToStore = QVector<bool>());
+
+private:
+    void parseBlock(const char* begin,const char* end,dataType* values,dataType nbValues,dataType& nbValuesRead);
+
+    QFile& file;
+    bool allowNegativeValues;
+    int nbChunks;
+    QVector<bool> columnsToStore;
+    const volatile bool* cancelFlag;
+    bool valid;
+
+    /**Size of the blocks read from the file.*/
+    static const qint64 kBLOCK_SIZE;
+};
+
+#endif
@@ -0,0 +1,134 @@
+/***************************************************************************
+                          clusterlayout.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "clusterlayout.h"
+#include "taskpool.h"
+
+//Qt include files
+#include <QList>
+#include <QRunnable>
+
+//C include files
+#include <cstring>
+
+const dataType ClusterLayout::kPARALLEL_THRESHOLD = 1000000;
+const dataType ClusterLayout::kMAX_DENSE_ID = 1 << 24;
+const dataType ClusterLayout::kMAX_EXTRA_IDS = 65536;
+
+/**Task computing the histogram of a range of spikes, then scattering them.*/
+class LayoutTask : public QRunnable{
+public:
+    LayoutTask(const dataType* clusterIds,dataType start,dataType end,dataType nbIds)
+        :clusterIds(clusterIds),start(start),end(end),nbIds(nbIds),scatter(false),destinations(0L){
+        setAutoDelete(false);
+        counts = new dataType[nbIds];
+        memset(counts,0,nbIds * sizeof(dataType));
+    }
+    ~LayoutTask(){delete []counts;}
+
+    /**Once the counts have been replaced by the first position of this range in each cluster, scatters the spikes
+  * in @p clusterSpikes, which gives the spikes of each cluster id (0L for the ids without spikes).*/
+    void setDestination(dataType** clusterSpikes){
+        destinations = clusterSpikes;
+        scatter = true;
+    }
+
+    void run(){
+        if(!scatter){
+            for(dataType i = start; i < end; ++i) counts[clusterIds[i]]++;
+        }
+        else{
+            for(dataType i = start; i < end; ++i){
+                dataType clusterId = clusterIds[i];
+                destinations[clusterId][counts[clusterId]++] = i + 1;
+            }
+        }
+    }
+
+    const dataType* clusterIds;
+    dataType start;
+    dataType end;
+    dataType nbIds;
+    bool scatter;
+    dataType** destinations;
+    dataType* counts;
+};
+
+bool ClusterLayout::build(const dataType* clusterIds,dataType nbSpikes,QMap<dataType,QVector<dataType> >& spikesByCluster){
+    //The cluster ids are read from the cluster file as positive values.
+    dataType maxId = 0;
+    for(dataType i = 0; i < nbSpikes; ++i){
+        if(clusterIds[i] < 0) return false;
+        if(clusterIds[i] > maxId) maxId = clusterIds[i];
+    }
+    if(maxId > kMAX_DENSE_ID) return false;
+    dataType nbIds = maxId + 1;
+    //The histogram is scanned entirely, it has to stay in proportion with the spikes.
+    if(nbIds > 2 * nbSpikes + kMAX_EXTRA_IDS) return false;
+
+    //Split the spikes in contiguous ranges, one per thread. The per thread histograms
+    //must stay small compared to the data, otherwise a single range is used.
+    int nbRanges = 1;
+    if(nbSpikes >= kPARALLEL_THRESHOLD){
+        nbRanges = TaskPool::globalInstance().threadCount();
+        while(nbRanges > 1 && nbRanges * nbIds > nbSpikes) nbRanges--;
+    }
+
+    QList<LayoutTask*> tasks;
+    dataType rangeSize = nbSpikes / nbRanges + 1;
+    for(dataType start = 0; start < nbSpikes; start += rangeSize)
+        tasks.append(new LayoutTask(clusterIds,start,qMin(start + rangeSize,nbSpikes),nbIds));
+
+    TaskPool::Group group;
+
+    //Histogram of each range.
+    if(tasks.count() == 1) tasks[0]->run();
+    else{
+        for(int i = 0; i < tasks.count(); ++i) group.start(tasks[i]);
+        group.wait();
+    }
+
+    //Prefix sum inside each cluster ordered by range, so the spikes of a cluster stay in time order.
+    //The vector of each cluster is allocated with its final size and the spikes are scattered directly in it.
+    dataType** destinations = new dataType*[nbIds];
+    for(dataType clusterId = 0; clusterId < nbIds; ++clusterId){
+        dataType clusterSize = 0;
+        for(int i = 0; i < tasks.count(); ++i){
+            dataType count = tasks[i]->counts[clusterId];
+            tasks[i]->counts[clusterId] = clusterSize;
+            clusterSize += count;
+        }
+        destinations[clusterId] = 0L;
+        if(clusterSize != 0){
+            QVector<dataType>& clusterSpikes = spikesByCluster[clusterId];
+            clusterSpikes.resize(static_cast<int>(clusterSize));
+            destinations[clusterId] = clusterSpikes.data();
+        }
+    }
+
+    //Scatter of each range.
+    for(int i = 0; i < tasks.count(); ++i) tasks[i]->setDestination(destinations);
+    if(tasks.count() == 1) tasks[0]->run();
+    else{
+        for(int i = 0; i < tasks.count(); ++i) group.start(tasks[i]);
+        group.wait();
+    }
+
+    qDeleteAll(tasks);
+    delete []destinations;
+    return true;
+}
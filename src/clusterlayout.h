@@ -0,0 +1,56 @@
+/***************************************************************************
+                          clusterlayout.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef CLUSTERLAYOUT_H
+#define CLUSTERLAYOUT_H
+
+//Include files of the application
+#include "types.h"
+
+//Include files for QT
+#include <qmap.h>
+#include <QVector>
+
+/**
+* This class builds the initial layout of the spikes sorted by cluster (and by time inside a cluster)
+* using a counting sort: a dense histogram of the cluster ids giving the size of each cluster, a prefix sum giving
+* the first position of each range of spikes in the clusters and a stable scatter of the spikes in their cluster. For large files the histogram and the scatter are computed in
+* parallel, each thread working on a contiguous range of spikes.
+*/
+class ClusterLayout{
+
+public:
+    /**Sorts the spikes by cluster id, the spikes of a cluster staying in time order.
+  * @param clusterIds cluster id of each spike, in spike order (nbSpikes values).
+  * @param nbSpikes number of spikes.
+  * @param spikesByCluster map, initially empty, receiving for each cluster the row indices (starting at 1)
+  * of its spikes in the feature table.
+  * @return true if the layout has been built, false if the cluster ids are too sparse for a dense histogram
+  * (too large or much more numerous than the spikes), in which case nothing has been done.
+  */
+    static bool build(const dataType* clusterIds,dataType nbSpikes,QMap<dataType,QVector<dataType> >& spikesByCluster);
+
+private:
+    /**Number of spikes under which the layout is built by the calling thread only.*/
+    static const dataType kPARALLEL_THRESHOLD;
+    /**Largest cluster id accepted for the dense histogram.*/
+    static const dataType kMAX_DENSE_ID;
+    /**Number of entries of the dense histogram accepted in addition to twice the number of spikes.*/
+    static const dataType kMAX_EXTRA_IDS;
+};
+
+#endif
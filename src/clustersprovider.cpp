@@ -85,16 +85,15 @@ void ClustersProvider::retrieveData(long startTime,long endTime,QObject* initiat
     //Store the information for the next request
     previousStartTime = startInRecordingUnits;
 
-    SortableTable* spikesByCluster;
-    Data::ClusterInfoMap* clusterInfoMap;
-    //Obtain a copy of the internal variables of data storing the information the clusters.
-    //A copy is needed because the clusters can changed while the look up of information is in process.
-    clusteringData.duplicate(spikesByCluster,clusterInfoMap);
+    //Read the clusters in the last published version, which does not change while the look up of information is in process.
+    const Data::ClusteringSnapshot clusters = clusteringData.snapshot();
+    const Data::SpikesByClusterMap& spikesByCluster = clusters.spikesByCluster();
+    const Data::ClusterInfoMap& clusterInfoMap = clusters.clusterInfoMap();
 
     QList<int>::iterator iterator;
     dataType nbSpikes = 0;
     for(iterator = clusterIds->begin(); iterator != clusterIds->end(); ++iterator){
-        nbSpikes += (*clusterInfoMap)[*iterator].nbSpikes();
+        nbSpikes += clusterInfoMap.nbSpikes(*iterator);
     }
 
     //The exact size (<=> number of spikes is not known yet, so the size of data is set to the maximum possible)
@@ -103,12 +102,12 @@ void ClustersProvider::retrieveData(long startTime,long endTime,QObject* initiat
     long count = 0;
 
     for(iterator = clusterIds->begin(); iterator != clusterIds->end(); ++iterator){
-        dataType firstSpikePosition = (*clusterInfoMap)[*iterator].firstSpikePosition();
-        dataType nbSpikesOfCluster = (*clusterInfoMap)[*iterator].nbSpikes();
-        dataType lastPosition =  firstSpikePosition + nbSpikesOfCluster;
+        const QVector<dataType> clusterSpikes = spikesByCluster.value(*iterator);
+        dataType nbSpikesOfCluster = clusterInfoMap.nbSpikes(*iterator);
+        dataType lastPosition = nbSpikesOfCluster;
 
-        for(dataType i = firstSpikePosition; i < lastPosition;++i){
-            dataType featuresRowIndex = static_cast<dataType>((*spikesByCluster)(1,i));
+        for(dataType i = 0; i < lastPosition;++i){
+            dataType featuresRowIndex = clusterSpikes[i];
             time = static_cast<dataType>(clusteringData.features(featuresRowIndex,nbOfDimensions));
             if(time < startInRecordingUnits) continue;
             if(time > endInRecordingUnits) break;
@@ -118,8 +117,6 @@ void ClustersProvider::retrieveData(long startTime,long endTime,QObject* initiat
         }
     }
 
-    delete spikesByCluster;
-    delete clusterInfoMap;
 
 
     //Store the data in a array of the good size
@@ -156,16 +153,15 @@ void ClustersProvider::requestNextClusterData(long startTime,long timeFrame,QLis
         return;
     }
 
-    SortableTable* spikesByCluster;
-    Data::ClusterInfoMap* clusterInfoMap;
-    //Obtain a copy of the internal variables of data storing the information the clusters.
-    //A copy is needed because the clusters can changed while the look up of information is in process.
-    clusteringData.duplicate(spikesByCluster,clusterInfoMap);
+    //Read the clusters in the last published version, which does not change while the look up of information is in process.
+    const Data::ClusteringSnapshot clusters = clusteringData.snapshot();
+    const Data::SpikesByClusterMap& spikesByCluster = clusters.spikesByCluster();
+    const Data::ClusterInfoMap& clusterInfoMap = clusters.clusterInfoMap();
 
     QList<int>::iterator iterator;
     dataType nbSpikes = 0;
     for(iterator = clusterIds->begin(); iterator != clusterIds->end(); ++iterator){
-        nbSpikes += (*clusterInfoMap)[*iterator].nbSpikes();
+        nbSpikes += clusterInfoMap.nbSpikes(*iterator);
     }
 
     //The exact size (<=> number of spikes is not known yet, so the size of data is set to the maximum possible)
@@ -176,12 +172,12 @@ void ClustersProvider::requestNextClusterData(long startTime,long timeFrame,QLis
     dataType time = 0;
 
     for(iterator = selectedIds.begin(); iterator != selectedIds.end(); ++iterator){
-        dataType firstSpikePosition = (*clusterInfoMap)[*iterator].firstSpikePosition();
-        dataType nbSpikesOfCluster = (*clusterInfoMap)[*iterator].nbSpikes();
-        dataType lastPosition =  firstSpikePosition + nbSpikesOfCluster;
+        const QVector<dataType> clusterSpikes = spikesByCluster.value(*iterator);
+        dataType nbSpikesOfCluster = clusterInfoMap.nbSpikes(*iterator);
+        dataType lastPosition = nbSpikesOfCluster;
 
-        for(dataType i = firstSpikePosition; i < lastPosition;++i){
-            dataType featuresRowIndex = static_cast<dataType>((*spikesByCluster)(1,i));
+        for(dataType i = 0; i < lastPosition;++i){
+            dataType featuresRowIndex = clusterSpikes[i];
             time = static_cast<dataType>(clusteringData.features(featuresRowIndex,nbOfDimensions));
             if(time < startInRecordingUnits) continue;
             if(time > startInRecordingUnits){
@@ -216,12 +212,12 @@ void ClustersProvider::requestNextClusterData(long startTime,long timeFrame,QLis
         firstSpikes.clear();
 
         for(iterator = selectedIds.begin(); iterator != selectedIds.end(); ++iterator){
-            dataType firstSpikePosition = (*clusterInfoMap)[*iterator].firstSpikePosition();
-            dataType nbSpikesOfCluster = (*clusterInfoMap)[*iterator].nbSpikes();
-            dataType lastPosition =  firstSpikePosition + nbSpikesOfCluster;
+            const QVector<dataType> clusterSpikes = spikesByCluster.value(*iterator);
+            dataType nbSpikesOfCluster = clusterInfoMap.nbSpikes(*iterator);
+            dataType lastPosition = nbSpikesOfCluster;
 
-            for(dataType i = firstSpikePosition; i < lastPosition;++i){
-                dataType featuresRowIndex = static_cast<dataType>((*spikesByCluster)(1,i));
+            for(dataType i = 0; i < lastPosition;++i){
+                dataType featuresRowIndex = clusterSpikes[i];
                 time = static_cast<dataType>(clusteringData.features(featuresRowIndex,nbOfDimensions));
                 if(time < startInRecordingUnits) continue;
                 if(time > startInRecordingUnits){
@@ -253,12 +249,12 @@ void ClustersProvider::requestNextClusterData(long startTime,long timeFrame,QLis
 
     long count = 0;
     for(iterator = clusterIds->begin(); iterator != clusterIds->end(); ++iterator){
-        dataType firstSpikePosition = (*clusterInfoMap)[*iterator].firstSpikePosition();
-        dataType nbSpikesOfCluster = (*clusterInfoMap)[*iterator].nbSpikes();
-        dataType lastPosition =  firstSpikePosition + nbSpikesOfCluster;
+        const QVector<dataType> clusterSpikes = spikesByCluster.value(*iterator);
+        dataType nbSpikesOfCluster = clusterInfoMap.nbSpikes(*iterator);
+        dataType lastPosition = nbSpikesOfCluster;
 
-        for(dataType i = firstSpikePosition; i < lastPosition;++i){
-            dataType featuresRowIndex = static_cast<dataType>((*spikesByCluster)(1,i));
+        for(dataType i = 0; i < lastPosition;++i){
+            dataType featuresRowIndex = clusterSpikes[i];
             time = static_cast<dataType>(clusteringData.features(featuresRowIndex,nbOfDimensions));
             if(time < startingInRecordingUnits)
                 continue;
@@ -270,8 +266,6 @@ void ClustersProvider::requestNextClusterData(long startTime,long timeFrame,QLis
         }
     }
 
-    delete spikesByCluster;
-    delete clusterInfoMap;
 
     //Store the data in a array of the good size
     SortableTable finalData;
@@ -310,16 +304,15 @@ void ClustersProvider::requestPreviousClusterData(long startTime,long timeFrame,
     else
         startInRecordingUnits = static_cast<dataType>(startTime * samplingRate / 1000.0);
 
-    SortableTable* spikesByCluster;
-    Data::ClusterInfoMap* clusterInfoMap;
-    //Obtain a copy of the internal variables of data storing the information the clusters.
-    //A copy is needed because the clusters can changed while the look up of information is in process.
-    clusteringData.duplicate(spikesByCluster,clusterInfoMap);
+    //Read the clusters in the last published version, which does not change while the look up of information is in process.
+    const Data::ClusteringSnapshot clusters = clusteringData.snapshot();
+    const Data::SpikesByClusterMap& spikesByCluster = clusters.spikesByCluster();
+    const Data::ClusterInfoMap& clusterInfoMap = clusters.clusterInfoMap();
 
     QList<int>::iterator iterator;
     dataType nbSpikes = 0;
     for(iterator = clusterIds->begin(); iterator != clusterIds->end(); ++iterator){
-        nbSpikes += (*clusterInfoMap)[*iterator].nbSpikes();
+        nbSpikes += clusterInfoMap.nbSpikes(*iterator);
     }
 
     //The exact size (<=> number of spikes is not known yet, so the size of data is set to the maximum possible)
@@ -330,13 +323,13 @@ void ClustersProvider::requestPreviousClusterData(long startTime,long timeFrame,
     dataType time = 0;
 
     for(iterator = selectedIds.begin(); iterator != selectedIds.end(); ++iterator){
-        dataType firstSpikePosition = (*clusterInfoMap)[*iterator].firstSpikePosition();
-        dataType nbSpikesOfCluster = (*clusterInfoMap)[*iterator].nbSpikes();
-        dataType firstPosition =  firstSpikePosition + nbSpikesOfCluster - 1;
-        dataType lastPosition =  firstSpikePosition - 1;
+        const QVector<dataType> clusterSpikes = spikesByCluster.value(*iterator);
+        dataType nbSpikesOfCluster = clusterInfoMap.nbSpikes(*iterator);
+        dataType firstPosition = nbSpikesOfCluster - 1;
+        dataType lastPosition = -1;
 
         for(dataType i = firstPosition; i > lastPosition;--i){
-            dataType featuresRowIndex = static_cast<dataType>((*spikesByCluster)(1,i));
+            dataType featuresRowIndex = clusterSpikes[i];
             time = static_cast<dataType>(clusteringData.features(featuresRowIndex,nbOfDimensions));
             if(time > startInRecordingUnits)
                 continue;
@@ -367,12 +360,12 @@ void ClustersProvider::requestPreviousClusterData(long startTime,long timeFrame,
 
     long count = 0;
     for(iterator = clusterIds->begin(); iterator != clusterIds->end(); ++iterator){
-        dataType firstSpikePosition = (*clusterInfoMap)[*iterator].firstSpikePosition();
-        dataType nbSpikesOfCluster = (*clusterInfoMap)[*iterator].nbSpikes();
-        dataType lastPosition =  firstSpikePosition + nbSpikesOfCluster;
+        const QVector<dataType> clusterSpikes = spikesByCluster.value(*iterator);
+        dataType nbSpikesOfCluster = clusterInfoMap.nbSpikes(*iterator);
+        dataType lastPosition = nbSpikesOfCluster;
 
-        for(dataType i = firstSpikePosition; i < lastPosition;++i){
-            dataType featuresRowIndex = static_cast<dataType>((*spikesByCluster)(1,i));
+        for(dataType i = 0; i < lastPosition;++i){
+            dataType featuresRowIndex = clusterSpikes[i];
             time = static_cast<dataType>(clusteringData.features(featuresRowIndex,nbOfDimensions));
             if(time < startingInRecordingUnits) continue;
             if(time > endInRecordingUnits) break;
@@ -382,8 +375,6 @@ void ClustersProvider::requestPreviousClusterData(long startTime,long timeFrame,
         }
     }
 
-    delete spikesByCluster;
-    delete clusterInfoMap;
 
 
     //Store the data in a array of the good size
@@ -20,6 +20,7 @@
 #include "klustersview.h"
 #include "klustersdoc.h"
 #include "data.h"
+#include "polygonmask.h"
 #include "itemcolors.h"
 
 #include "timer.h"
@@ -89,6 +90,13 @@ void ClusterView::drawClusters(QPainter& painter,const QList<int>& clustersList,
     ItemColors& clusterColors = doc.clusterColors();
     Data& clusteringData = doc.data();
 
+    //The dimensions may still be loading in the background.
+    clusteringData.waitForDimension(dimensionX);
+    clusteringData.waitForDimension(dimensionY);
+
+    //The spikes of a cluster are scattered in the features, do not read ahead.
+    clusteringData.adviseFeatureAccess(FeatureArray::RANDOM);
+
     for(clusterIterator = clustersList.begin(); clusterIterator != clustersList.end(); ++clusterIterator){
         //Get the color associated with the cluster and set the color to use to this color
         painter.setPen(clusterColors.color(*clusterIterator));
@@ -111,6 +119,7 @@ void ClusterView::drawClusters(QPainter& painter,const QList<int>& clustersList,
     }
 
     painter.setBrush(Qt::NoBrush);
+    clusteringData.adviseFeatureAccess(FeatureArray::NORMAL);
 }
 
 void ClusterView::paintEvent ( QPaintEvent*){
@@ -247,6 +256,9 @@ void ClusterView::updatedDimensions(int dimensionX, int dimensionY){
     this->dimensionY = dimensionY;
 
     Data& clusteringData = doc.data();
+    //The dimensions may still be loading in the background.
+    clusteringData.waitForDimension(dimensionX);
+    clusteringData.waitForDimension(dimensionY);
     long maxForDimensionX = static_cast<long>(clusteringData.maxDimension(dimensionX));
     long minForDimensionX = static_cast<long>(clusteringData.minDimension(dimensionX));
     long maxForDimensionY = static_cast<long>(clusteringData.maxDimension(dimensionY));
@@ -426,17 +438,13 @@ void ClusterView::customEvent(QEvent* event){
         ComputeEvent* computeEvent = (ComputeEvent*) event;
         //Get the polygon
         QPolygon polygon = computeEvent->polygon();
-        QRegion selectionArea;
         QPolygon reviewPolygon;
         long Xdimension = 0;
         long Ydimension = 0;
 
-        //The QRegion uses rectangles to define its area and the number of rectangles
-        //increases with the height of the region (y axis). The more rectangles the longer
-        //the search of one point in the region will take. With a dimension like the time
-        //the height has an order of the millon (at least 5 going to 80 or more) given a huge amount
-        //of rectangles. A way of speeding the search of points is to reduce the number of rectangles.
-        //To do so, if the y dimension is the time, x and y axis are inverted.
+        //With a dimension like the time the extent of the polygon has an order of the millon (at least 5 going to 80 or more).
+        //The PolygonMask rasterizes the polygon along its smaller extent, nevertheless if the y dimension is the time,
+        //x and y axis are inverted so that the time is always the abscissa of the selection.
         //Caution: in Qt graphical coordinate system, the Y axis is inverted (increasing downwards),
         //thus a point (x,y) is drawn as (x,-y), before creating the region the points are reset to there raw value (x,y).
 
@@ -455,8 +463,8 @@ void ClusterView::customEvent(QEvent* event){
                 Ydimension = dimensionX;
             }
         }
-        //Create a QRegion with the new selection area in order to use the research facilities offer by a QRegion.
-        selectionArea = QRegion(reviewPolygon);
+        //Rasterize the new selection area once, the spikes are then tested against the mask.
+        PolygonMask selectionArea(reviewPolygon);
         if(!selectionArea.isEmpty()){
             //Call any appropriate method
             switch(mode){
@@ -59,6 +59,14 @@ void Configuration::read() {
     //read waveform view options
     settings.beginGroup("waveformView");
     gain = settings.value("gain",gainDefault).toInt();
+    waveformCacheSize = settings.value("waveformCacheSize",512).toInt();
+    settings.endGroup();
+
+    //read feature storage options
+    settings.beginGroup("features");
+    featuresByDimension = settings.value("featuresByDimension",false).toBool();
+    featuresOutOfCore = settings.value("featuresOutOfCore",false).toBool();
+    lazyFeatureDimensions = settings.value("lazyFeatureDimensions",0).toInt();
     settings.endGroup();
 }
 
@@ -83,7 +91,15 @@ void Configuration::write() const {
     //write waveform view options
     settings.beginGroup("waveformView");
     settings.setValue("gain",gain);
-    settings.beginGroup("General");
+    settings.setValue("waveformCacheSize",waveformCacheSize);
+    settings.endGroup();
+
+    //write feature storage options
+    settings.beginGroup("features");
+    settings.setValue("featuresByDimension",featuresByDimension);
+    settings.setValue("featuresOutOfCore",featuresOutOfCore);
+    settings.setValue("lazyFeatureDimensions",lazyFeatureDimensions);
+    settings.endGroup();
 }
 
 Configuration& configuration() {
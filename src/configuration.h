@@ -159,6 +159,32 @@ public:
 
     void setUseWhiteColorDuringPrinting(bool b) { useWhiteColorDuringPrinting = b; }
 
+    /**Sets the storage of the features dimension by dimension (true) or spike by spike (false).*/
+    void setFeaturesByDimension(bool byDimension){featuresByDimension = byDimension;}
+
+    /**Returns true if the features are stored dimension by dimension, false if they are stored spike by spike.*/
+    bool isFeaturesByDimension() const{return featuresByDimension;}
+
+    /**Sets the out-of-core mode for the features, they are then held in memory-mapped files instead of the memory.*/
+    void setFeaturesOutOfCore(bool outOfCore){featuresOutOfCore = outOfCore;}
+
+    /**Returns true if the features are held in memory-mapped files, false if they are held in memory.*/
+    bool isFeaturesOutOfCore() const{return featuresOutOfCore;}
+
+    /**Sets the number of dimensions loaded before the document is opened, the others being loaded in the background (0 to load them all).
+  * The remaining dimensions are loaded in a single pass, not one by one on demand: using any of them waits until they are all loaded.
+  */
+    void setLazyFeatureDimensions(int nbDimensions){lazyFeatureDimensions = nbDimensions;}
+
+    /**Returns the number of dimensions loaded before the document is opened, 0 if they are all loaded.*/
+    int getLazyFeatureDimensions() const{return lazyFeatureDimensions;}
+
+    /**Sets the memory, in megabytes, the waveforms of the clusters can use before the least recently used ones are discarded.*/
+    void setWaveformCacheSize(int size){waveformCacheSize = size;}
+
+    /**Returns the memory, in megabytes, the waveforms of the clusters can use before the least recently used ones are discarded.*/
+    int getWaveformCacheSize() const{return waveformCacheSize;}
+
 private:
     /**Boolean indicating if a crash and recovery is ask.*/
     bool crashRecovery;
@@ -182,6 +208,14 @@ private:
     QString reclusteringArgs;
 
     bool useWhiteColorDuringPrinting;
+    /**Boolean indicating if the features are stored dimension by dimension.*/
+    bool featuresByDimension;
+    /**Boolean indicating if the features are held in memory-mapped files.*/
+    bool featuresOutOfCore;
+    /**Number of dimensions loaded before the document is opened, 0 if they are all loaded.*/
+    int lazyFeatureDimensions;
+    /**Memory, in megabytes, the waveforms of the clusters can use.*/
+    int waveformCacheSize;
     static const bool crashRecoveryDefault;
     static const int  crashRecoveryIndexDefault;
     static const int  gainDefault;
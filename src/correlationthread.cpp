@@ -26,7 +26,7 @@
 #include <stdlib.h>
 
 void CorrelationThread::run(){
-    if(!haveToStopProcessing){
+    if(!isCancelled()){
         //Convert the miliseconds in recording units.
         double binSizeInRU = static_cast<double>((static_cast<double>(correlationView.binSize) * 1000.0) / data.samplingInterval);
         double timeWindowInRU = static_cast<double>((static_cast<double>(correlationView.timeWindow) * 1000.0) / data.samplingInterval);
@@ -37,14 +37,15 @@ void CorrelationThread::run(){
 
         QList<Pair>::iterator pairIterator;
         for(pairIterator = clusterPairs->begin(); pairIterator != clusterPairs->end(); ++pairIterator){
-            if(!haveToStopProcessing){
+            if(!isCancelled()){
                 Data::Status status = data.getCorrelograms(*pairIterator,correlationView.binSize,correlationView.timeWindow,binSizeInRU,timeWindowInRU,halfBins);
                 if(status == Data::NOT_AVAILABLE)
                     continue;
                 else if(status == Data::IN_PROCESS) {
-                    while(!haveToStopProcessing && (data.getCorrelograms(*pairIterator,correlationView.binSize,correlationView.timeWindow,binSizeInRU,timeWindowInRU,halfBins) == Data::IN_PROCESS))
+                    //Another thread computes the correlogram, wait until it is done.
+                    while(!isCancelled() && (data.getCorrelograms(*pairIterator,correlationView.binSize,correlationView.timeWindow,binSizeInRU,timeWindowInRU,halfBins) == Data::IN_PROCESS))
                     {
-                        sleep(1);
+                        data.waitForCorrelograms(*pairIterator,correlationView.binSize,correlationView.timeWindow,cancelToken());
                     }
                 }
             }
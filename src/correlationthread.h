@@ -22,22 +22,20 @@
 #include "correlationview.h"
 #include "data.h"
 #include "pair.h"
+#include "taskpool.h"
 
 //include files for QT
-#include <qthread.h>
-
-
 #include <QEvent>
 #include <QList>
 
 
-/** Thread used to compute the correlograms displayed in the CorrelationView.
- * No heavy computation is done is this class, the thread calls the Data object which
+/** Task used to compute the correlograms displayed in the CorrelationView. It runs on the TaskPool.
+ * No heavy computation is done is this class, the task calls the Data object which
  * will do the work.
  *@author Lynn Hazan
  */
 
-class CorrelationThread : public QThread {
+class CorrelationThread : public TaskPool::Task {
 
 
 public:
@@ -50,7 +48,10 @@ public:
     QList<int> triggeringClusters() const {return clusterIds;}
 
     /**Asks the thread to stop his work as soon as possible.*/
-    void stopProcessing(){haveToStopProcessing = true;}
+    void stopProcessing(){
+        cancel();
+        data.wakeUpWaitingThreads();
+    }
 
     class CorrelationsEvent;
     friend class CorrelationsEvent;
@@ -85,18 +86,16 @@ protected:
 
 private:
     CorrelationThread(CorrelationView& view,Data& d,QList<Pair>* pairs,const QList<int>& clusterIds)
-        :correlationView(view),data(d),haveToStopProcessing(false){
+        :correlationView(view),data(d){
         clusterPairs = pairs;
         this->clusterIds = clusterIds;
-        start();
+        start(view.taskPriority());
     }
 
     CorrelationView& correlationView;
     Data& data;
     QList<Pair>* clusterPairs;
     QList<int> clusterIds;
-    /**True if the thread has to stop processing, false otherwise.*/
-    bool haveToStopProcessing;
 
 };
 
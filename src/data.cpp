@@ -16,10 +16,13 @@
  ***************************************************************************/
 //Application include files
 #include "data.h"
-#include "minmaxthread.h"
+#include "featureloaderthread.h"
 #include "waveformview.h"
 #include "autosavethread.h"
 #include "klustersxmlreader.h"
+#include "chunkedtextparser.h"
+#include "clusterlayout.h"
+#include "spikemerge.h"
 
 //C include files
 //#define _LARGEFILE_SOURCE already defined in /usr/include/features.h
@@ -31,8 +34,11 @@
 #include <qstringlist.h>
 #include <QString>
 #include <qregexp.h>
+#include <qfileinfo.h>
 
 #include <QList>
+#include <QBitArray>
+#include <QRunnable>
 #include <QDebug>
 
 //kde include files
@@ -45,50 +51,91 @@
 
 extern int nbUndo;
 
+/**Maximum time, in miliseconds, a thread waits for a computation done by another thread before checking its status again.*/
+static const unsigned long kCOMPUTATION_WAIT = 1000;
+
+const qint64 Data::WaveformCache::kDEFAULT_BUDGET = 512 * 1024 * 1024;
+
+/**Task computing the ranges of the clusters pending in the Data object.*/
+class Data::ClusterRangesTask : public QRunnable{
+public:
+    explicit ClusterRangesTask(Data& data):data(data){setAutoDelete(false);}
+
+    void run(){data.computePendingClusterRanges();}
+
+private:
+    Data& data;
+};
+
 Data::Data()
     :nbSpikes(0),
+      featuresOutOfCore(false),
+      lazyFeatureDimensions(0),
+      featureValuesOffset(0),
+      remainingDimensionsLoaded(true),
+      featureLoadingCancelled(false),
+      loadingMonitor(0L),
+      featureLoadingReceiver(0L),
+      featuresToCompact(false),
       traceViewVariablesAvailable(false),
-      undoRedoInProcess(false),
-      clusterZeroJustModified(false)
+      featuresLock(QReadWriteLock::Recursive),
+      clusterRangesRunning(false),
+      clusterRangesGroup(TaskPool::PREFETCH)
 {
 
-    minMaxThread = minMaxCalculator();
-    spikesByCluster = new SortableTable();
+    featureLoaderThread = 0L;
+    clusterRangesTask = new ClusterRangesTask(*this);
+    spikesByCluster = new SpikesByClusterMap();
     clusterInfoMap = new ClusterInfoMap();
 
 }
 
 Data::~Data(){
-    //If the minMaxThread has not finish, wait until it is done
-    while(!minMaxThread->wait()){};
-    delete minMaxThread;
+    //Stop the loading of the remaining dimensions, if any
+    if(featureLoaderThread != 0L){
+        featureLoadingCancelled = true;
+        featureLoaderThread->wait();
+        delete featureLoaderThread;
+    }
+
+    //Stop the computation of the ranges of the clusters, if any
+    clusterRangesGroup.cancel();
+    clusterRangesGroup.wait();
+    delete clusterRangesTask;
 
     //delete the pointers to the tables and maps
     delete spikesByCluster;
     delete clusterInfoMap;
 
-    qDeleteAll(clusterInfoMapUndoList);
-    clusterInfoMapUndoList.clear();
-    qDeleteAll(clusterInfoMapRedoList);
-    clusterInfoMapRedoList.clear();
-    qDeleteAll(spikesByClusterUndoList);
-    spikesByClusterUndoList.clear();
-    qDeleteAll(spikesByClusterRedoList);
-    spikesByClusterRedoList.clear();
-
-    qDeleteAll(waveformDict);
-    waveformDict.clear();
+    qDeleteAll(undoList);
+    undoList.clear();
+    qDeleteAll(redoList);
+    redoList.clear();
+
+    waveformCache.clear();
     qDeleteAll(correlationDict);
     correlationDict.clear();
 
 }
 
-MinMaxThread* Data::minMaxCalculator(){
-    return new MinMaxThread(*this);
+FeatureLoaderThread* Data::featureLoader(){
+    return new FeatureLoaderThread(*this);
 }
 
 
+bool Data::startLoadingStage(LoadingStage stage,QString& errorInformation){
+    if(loadingMonitor == 0L) return true;
+    if(isLoadingCancelled()){
+        errorInformation = QObject::tr("The loading has been cancelled.");
+        return false;
+    }
+    loadingMonitor->loadingStageStarted(stage);
+    return true;
+}
+
 bool Data::configure(QFile& parFile,int electrodeGroupID,QString& errorInformation){
+    if(!startLoadingStage(LOADING_PARAMETERS,errorInformation))
+        return false;
     KlustersXmlReader reader = KlustersXmlReader();
     if(reader.parseFile(parFile,KlustersXmlReader::PARAMETER)){
 
@@ -159,6 +206,8 @@ bool Data::configure(QFile& parFile,int electrodeGroupID,QString& errorInformati
 }
 
 bool Data::configure(QFile& parXFile,QFile& parFile,QString& errorInformation){
+    if(!startLoadingStage(LOADING_PARAMETERS,errorInformation))
+        return false;
     QTextStream parX(&parXFile);
     QTextStream par(&parFile);
     QList <QStringList> parXData;
@@ -241,36 +290,29 @@ bool Data::loadClusters(QFile &clusterFile, long spkFileLength, QString& errorIn
     }
 
     nbSpikes =  spkFileLength / static_cast<long>(static_cast<long>(nbChannels) * static_cast<long>(nbSamplesInWaveform) * static_cast<long>(sampleSize));
-    dataType upperLimit = nbSpikes + 1;
     //Effectively create the table containing the data
-    spikesByCluster->setSize(nbSpikes);
-    bool firstLine = true;
-    dataType k = 1;
-    while (!clusterFile.atEnd()) {
-        QByteArray line = clusterFile.readLine();
-        if (firstLine) {
-            firstLine = false;
-        } else {
-            QByteArray feature;
-            for (int i = 0; i <line.count();++i) {
-                if ( (line.at(i) >= '0' && line.at(i) <='9')) {
-                    feature.append(line.at(i));
-                } else if( !feature.isEmpty()){
-                    (*spikesByCluster)(2,k++) = feature.toLongLong();//Warning if the typedef dataType changes, change will have to be make here.
-                    feature = "";
-                }
-            }
-            if(k > upperLimit)
-                break;
-        }
+    spikeClusterIds.resize(static_cast<int>(nbSpikes));
+
+    //The first line contains the number of clusters, it is not used.
+    clusterFile.readLine();
+
+    ChunkedTextParser parser(clusterFile,false);
+    if(loadingMonitor != 0L) parser.setCancelFlag(loadingMonitor->cancelFlag());
+    dataType nbClustersRead = parser.parse(spikeClusterIds.data(),nbSpikes);
+    if(isLoadingCancelled()){
+        errorInformation = QObject::tr("The loading has been cancelled.");
+        return false;
+    }
+    if(!parser.isValid()){
+        errorInformation = QObject::tr("The cluster file contains a value which is not a valid cluster id.");
+        return false;
     }
 
-    qDebug()<<" nbSpikes:"<< nbSpikes<< "k:"<<k<<" spkFileLength:"<<spkFileLength<< "nbChannels : "<< nbChannels<<" nbSamplesInWaveform "<<nbSamplesInWaveform<< " sampleSize:"<<sampleSize;
+    qDebug()<<" nbSpikes:"<< nbSpikes<< " nbClustersRead:"<<nbClustersRead<<" spkFileLength:"<<spkFileLength<< "nbChannels : "<< nbChannels<<" nbSamplesInWaveform "<<nbSamplesInWaveform<< " sampleSize:"<<sampleSize;
 
-    qDebug()<<" upperLimit"<<upperLimit<< " k "<<k;
     //if the number of clusters read did not correspond to nbSpikes, there is a problem.
-    if(k != upperLimit){
-        errorInformation = QObject::tr("The number of spikes read in the cluster file does not correspond to number of spikes computed.(computed : %1, upperlimit %2)").arg(k).arg(upperLimit);
+    if(nbClustersRead != nbSpikes){
+        errorInformation = QObject::tr("The number of spikes read in the cluster file does not correspond to number of spikes computed.(computed : %1, upperlimit %2)").arg(nbClustersRead + 1).arg(nbSpikes + 1);
         return false;
     } else {
         return true;
@@ -278,35 +320,45 @@ bool Data::loadClusters(QFile &clusterFile, long spkFileLength, QString& errorIn
 }
 
 bool Data::loadFeatures(QFile& featureFile,QString& errorInformation){
+    QFileInfo featureFileInfo(featureFile.fileName());
 
-    bool firstLine = true;
-    dataType k = 0;
-    while (!featureFile.atEnd()) {
-        QByteArray line = featureFile.readLine();
-        //qDebug()<<" line "<<line;
-        if (firstLine) {
-            firstLine = false;
-            int j = 0;
-            for (int i = 0; i <line.count();++i) {
-                if (line.at(i) >= '0' && line.at(i) <='9') {
-                    j++;
-                } else if(j) {
-                    nbDimensions = line.left(j).toInt();
-                    break;
-                }
-            }
-            features.setSize(nbSpikes,nbDimensions);
-        } else {
-            QByteArray feature;
-            for (int i = 0; i <line.count();++i) {
-                if (line.at(i) == '-' || (line.at(i) >= '0' && line.at(i) <='9')) {
-                    feature.append(line.at(i));
-                } else if (!feature.isEmpty()){
-                    features[k++] = feature.toLongLong();//Warning if the typedef dataType changes, change will have to be make here.
-                    feature = "";
-                }
-            }
-        }
+    //Use the binary cache if it is still valid for the feature file, this avoids parsing the whole file.
+    if(!featureCacheFileName.isEmpty() && features.mapCache(featureCacheFileName,featureFileInfo,nbSpikes)){
+        nbDimensions = features.nbOfColumns();
+        return true;
+    }
+
+    //In out-of-core mode, the tables built while loading are memory-mapped files next to the cache.
+    if(featuresOutOfCore)
+        features.setBackingFile(featureCacheFileName.isEmpty() ? FeatureArray::cacheFileName(featureFile.fileName()) : featureCacheFileName);
+
+    //The first line contains the number of dimensions.
+    nbDimensions = static_cast<int>(ChunkedTextParser::firstValue(featureFile.readLine()));
+    features.setSize(nbSpikes,nbDimensions);
+
+    ChunkedTextParser parser(featureFile,true);
+    if(loadingMonitor != 0L) parser.setCancelFlag(loadingMonitor->cancelFlag());
+
+    //In lazy mode, only the first dimensions and the time are parsed now, the other ones
+    //are parsed in the background by the FeatureLoaderThread once the document is open.
+    initiallyLoadedDimensions.clear();
+    if(lazyFeatureDimensions > 0 && lazyFeatureDimensions < nbDimensions - 1){
+        initiallyLoadedDimensions.fill(false,nbDimensions);
+        for(int i = 0; i < lazyFeatureDimensions; ++i) initiallyLoadedDimensions[i] = true;
+        initiallyLoadedDimensions[nbDimensions - 1] = true;
+        parser.setColumnsToStore(initiallyLoadedDimensions);
+        featureFileName = featureFile.fileName();
+        featureValuesOffset = featureFile.pos();
+    }
+
+    dataType k = parser.parse(&features[0],nbSpikes * nbDimensions);
+    if(isLoadingCancelled()){
+        errorInformation = QObject::tr("The loading has been cancelled.");
+        return false;
+    }
+    if(!parser.isValid()){
+        errorInformation = QObject::tr("The feature file contains a value which is not a valid integer.");
+        return false;
     }
 
     //qDebug() << "in loadFeatures,  k: "<<k<< " nbSpikes "<<nbSpikes<< " nbDimensions "<<nbDimensions<< endl;
@@ -316,70 +368,98 @@ bool Data::loadFeatures(QFile& featureFile,QString& errorInformation){
         errorInformation = QObject::tr("The number of features read in the feature file does not correspond to number of spikes times the number of dimensions.");
         return false;
     }
-    else
+
+    //The features are compacted and cached once all the dimensions have been loaded.
+    if(!initiallyLoadedDimensions.isEmpty()){
+        remainingDimensionsLoaded = false;
         return true;
+    }
+
+    //Store each dimension on the narrowest integer width holding its values.
+    features.compact();
+
+    //Write the binary cache for the next opening of the file. A failure (read-only directory for instance) is not an error.
+    if(!featureCacheFileName.isEmpty()){
+        features.adviseAccess(FeatureArray::SEQUENTIAL);
+        if(!features.writeCache(featureCacheFileName,featureFileInfo))
+            qDebug()<<"the feature cache "<<featureCacheFileName<<" could not be written";
+        //In out-of-core mode, use the cache itself and release the backing files.
+        else if(featuresOutOfCore)
+            features.mapCache(featureCacheFileName,featureFileInfo,nbSpikes);
+        features.adviseAccess(FeatureArray::NORMAL);
+    }
+
+    return true;
 }
 
 
 bool Data::initialize(QFile& featureFile,QFile& clusterFile,long spkFileLength,QString& errorInformation){
+    if(!startLoadingStage(LOADING_CLUSTERS,errorInformation))
+        return false;
     if(!loadClusters(clusterFile,spkFileLength,errorInformation))
         return false;
+    if(!startLoadingStage(LOADING_FEATURES,errorInformation))
+        return false;
     if(!loadFeatures(featureFile,errorInformation))
         return false;
+    if(!startLoadingStage(BUILDING_LAYOUT,errorInformation))
+        return false;
 
-    //Fill the first row of spikesByCluster with the row index of the spike,
-    //knowing that for the moment the elements of the table are sorted by spike order.
-    for(dataType i = 1; i <= nbSpikes; ++ i) (*spikesByCluster)(1,i) = i;
-
-    SortableTable* spikesByClusterTemp = new SortableTable();
-    spikesByClusterTemp->setSize(nbSpikes);
     QMap<dataType,dataType> clusters;
-    dataType max = nbSpikes + 1;
-    //Count the number of spikes for each cluster.
-    for(dataType i = 1; i < max; ++i) {
-        dataType clusterId = (*spikesByCluster)(2,i);
-        clusters[clusterId]++;
+
+    //Sort the spikes by cluster and by time (<=> position in the fet file) with a counting sort on the cluster ids,
+    //which fills the spikes of each cluster directly.
+    //If the cluster ids are too sparse for it, count the spikes for each cluster and distribute them below.
+    bool layoutBuilt = nbSpikes > 0 && ClusterLayout::build(spikeClusterIds.constData(),nbSpikes,*spikesByCluster);
+    if(layoutBuilt){
+        SpikesByClusterMap::ConstIterator clusterIterator;
+        for(clusterIterator = spikesByCluster->constBegin(); clusterIterator != spikesByCluster->constEnd(); ++clusterIterator)
+            clusters.insert(clusterIterator.key(),clusterIterator.value().size());
+    }
+    else{
+        //Count the number of spikes for each cluster.
+        for(dataType i = 0; i < nbSpikes; ++i) clusters[spikeClusterIds[i]]++;
     }
 
-    //Initialize positions, for each clusterId the value is set to the position of the first spike.
-    //Add the cluster user information.
-    //The clusters will be sorted by clusterId in spikesByCluster. Initialize clusterInfoMap.
-    QMap<dataType,dataType> positions;
+    //Create the spikes of each cluster and add the cluster user information. Initialize clusterInfoMap.
     QMap<dataType,dataType>::Iterator iterator;
-    int index = 1;
     for(iterator = clusters.begin(); iterator != clusters.end(); ++iterator){
         dataType clusterId = iterator.key();
-        positions[clusterId] =  index;
-        ClusterUserInformation vClusterUserInformation = clusterUserInformationMap[static_cast<int>(clusterId)];
-
-        clusterInfoMap->insert(clusterId,ClusterInfo(index,iterator.value(),vClusterUserInformation.getStructure(),vClusterUserInformation.getType(),vClusterUserInformation.getId(),vClusterUserInformation.getQuality(),vClusterUserInformation.getNotes()));
+        if(!layoutBuilt) (*spikesByCluster)[clusterId].reserve(static_cast<int>(iterator.value()));
+        ClusterUserInformation vClusterUserInformation = clusterUserInformationMap.value(static_cast<int>(clusterId));
 
-        index += iterator.value();
+        clusterInfoMap->setNbSpikes(clusterId,iterator.value());
+        clusterInfoMap->setClusterInformation(clusterId,ClusterInfo(vClusterUserInformation.getStructure(),vClusterUserInformation.getType(),vClusterUserInformation.getId(),vClusterUserInformation.getQuality(),vClusterUserInformation.getNotes()));
     }
 
     //Reset the clusterUserInformationMap which only ne used from now on to store the information before writting it to the xml parameter file.
     clusterUserInformationMap.clear();
 
-    //Fill tmp with the data sorted by cluster and by time (<=> position in the fet file)
-    for(dataType i = 1; i < max; ++i){
-        dataType clusterId = (*spikesByCluster)(2,i);
-        dataType position = positions[clusterId];
-        dataType positionInFet = (*spikesByCluster)(1,i);
-        (*spikesByClusterTemp)(1,position) = positionInFet;
-        (*spikesByClusterTemp)(2,position) = clusterId;
-        positions[clusterId] ++;
+    //Distribute the spikes among the clusters, in the order of time (<=> position in the fet file)
+    if(!layoutBuilt){
+        for(dataType i = 0; i < nbSpikes; ++i)
+            (*spikesByCluster)[spikeClusterIds[i]].append(i + 1);
     }
 
-    //Delete spikesByCluster and assign to the pointer the value of spikesByClusterTemp;
-    delete spikesByCluster;
-    spikesByCluster = 0L;
-    spikesByCluster =  spikesByClusterTemp;
+    //The cluster ids of the spikes are not needed anymore.
+    spikeClusterIds = QVector<dataType>();
+
+    mutex.lock();
+    publishSnapshot();
+    mutex.unlock();
 
 
     //Calculate the minimum and maximum for each dimension and store them in
     //dimensionMinima and dimensionMaxima respectively
-    QList<int> modifiedClusters;
-    minMaxDimensionCalculation(modifiedClusters);
+    if(!startLoadingStage(COMPUTING_MIN_MAX,errorInformation))
+        return false;
+    minMaxDimensionCalculation();
+    clusterRangesGroup.wait();
+
+    //Map the spike file once for all the waveform extractions.
+    if(!spikeFile.open(spkFileName)) qDebug()<<"the spike file "<<spkFileName<<" could not be opened";
+
+    startFeatureLoading();
     return true;
 }
 
@@ -433,26 +513,37 @@ bool Data::initialize(QFile& featureFile,long spkFileLength,QString& errorInform
         return false;
     }
     nbSpikes =  spkFileLength / static_cast<long>(static_cast<long>(nbChannels) * static_cast<long>(nbSamplesInWaveform) * static_cast<long>(sampleSize));
-    spikesByCluster->setSize(nbSpikes);
-
-    //As the cluster file does not exist assign all the spikes to cluster 1.
-    for(dataType i = 1; i <= nbSpikes; ++ i)
-        (*spikesByCluster)(2,i) = 1;
 
+    if(!startLoadingStage(LOADING_FEATURES,errorInformation))
+        return false;
     if(!loadFeatures(featureFile,errorInformation))
         return false;
+    if(!startLoadingStage(BUILDING_LAYOUT,errorInformation))
+        return false;
 
-    //Fill the first row of spikesByCluster with the row index of the spike,
-    //knowing that for the moment the elements of the table are sorted by spike order.
-    for(dataType i = 1; i <= nbSpikes; ++ i)
-        (*spikesByCluster)(1,i) = i;
+    //As the cluster file does not exist assign all the spikes to cluster 1, in the order of time (<=> position in the fet file).
+    QVector<dataType>& clusterSpikes = (*spikesByCluster)[1];
+    clusterSpikes.resize(static_cast<int>(nbSpikes));
+    for(dataType i = 0; i < nbSpikes; ++ i)
+        clusterSpikes[i] = i + 1;
 
-    clusterInfoMap->insert(1, ClusterInfo(1,nbSpikes));
+    clusterInfoMap->setNbSpikes(1,nbSpikes);
+
+    mutex.lock();
+    publishSnapshot();
+    mutex.unlock();
 
     //Calculate the minimum and maximum for each dimension and store them in
     //dimensionMinima and dimensionMaxima respectively
-    QList<int> modifiedClusters;
-    minMaxDimensionCalculation(modifiedClusters);
+    if(!startLoadingStage(COMPUTING_MIN_MAX,errorInformation))
+        return false;
+    minMaxDimensionCalculation();
+    clusterRangesGroup.wait();
+
+    //Map the spike file once for all the waveform extractions.
+    if(!spikeFile.open(spkFileName)) qDebug()<<"the spike file "<<spkFileName<<" could not be opened";
+
+    startFeatureLoading();
     return true;
 }
 
@@ -478,93 +569,88 @@ bool Data::initialize(QFile& featureFile,long spkFileLength,const QString& spkFi
     return true;
 }
 
-void Data::minMaxDimensionCalculation(QList<int> modifiedClusters){
-    //If an undo or redo has started or the cluster 0 has been changed again, do not do any calculation, it will be done on the new data.
-    if(undoRedoInProcess || clusterZeroJustModified) return;
+void Data::minMaxDimensionCalculation(){
+    //The ranges of the clusters which have not changed are reused, the others are computed by a ClusterRangesTask
+    //which updates dimensionMinima and dimensionMaxima once they are all known.
+    QMutexLocker locker(&rangesMutex);
+    updateClusterRanges();
+    if(pendingClusterRanges.isEmpty()) publishDimensionRanges();
+    else if(!clusterRangesRunning){
+        clusterRangesRunning = true;
+        clusterRangesGroup.start(clusterRangesTask);
+    }
+}
 
-    //The mutex protects spikesByCluster and clusterInfoMap so that only one thread can
-    //access them at the time.
-    ClusterInfoMap clusterInfoMapTemp;
-    ClusterInfoMap::Iterator iterator;
-    mutex.lock();
-    SortableTable spikesByClusterTemp(*spikesByCluster);
+void Data::computePendingClusterRanges(){
+    //The features may be compacted by the GUI thread, they are held for reading during the whole computation.
+    QReadLocker featuresLocker(&featuresLock);
+    QMutexLocker locker(&rangesMutex);
+    while(!pendingClusterRanges.isEmpty()){
+        //The clusters may change while the ranges are computed, so the pending ones are copied with their spikes.
+        QList<ClusterRanges> computedRanges = pendingClusterRanges.values();
+        locker.unlock();
+        for(int i = 0; i < computedRanges.size() && !clusterRangesGroup.isCancelled(); ++i){
+            const QVector<dataType>& clusterSpikes = computedRanges[i].spikes;
+            computeClusterRanges(computedRanges[i],clusterSpikes.constData(),clusterSpikes.size());
+        }
+        locker.relock();
+        if(clusterRangesGroup.isCancelled()) break;
+
+        //Only the ranges of the clusters still pending are kept. The ones computed without all the dimensions
+        //while they have been loaded meanwhile are computed again.
+        featureLoadingMutex.lock();
+        bool allDimensionsLoaded = remainingDimensionsLoaded;
+        featureLoadingMutex.unlock();
+        for(int i = 0; i < computedRanges.size(); ++i){
+            const dataType* spikes = computedRanges[i].spikes.constData();
+            if(!pendingClusterRanges.contains(spikes) || (!computedRanges[i].complete && allDimensionsLoaded)) continue;
+            pendingClusterRanges.remove(spikes);
+            clusterRangesCache.insert(spikes,computedRanges[i]);
+        }
+    }
+    if(!clusterRangesGroup.isCancelled()) publishDimensionRanges();
+    clusterRangesRunning = false;
+}
 
-    for(iterator = clusterInfoMap->begin(); iterator != clusterInfoMap->end(); ++iterator){
-        clusterInfoMapTemp.insert(iterator.key(),iterator.value());
-    }
-    mutex.unlock();
+void Data::publishDimensionRanges(){
+    //The dimensions still being loaded in the background are skipped, the FeatureLoaderThread computes their minimum and maximum.
+    //Once all the dimensions are loaded, the ranges computed before are completed by updateClusterRanges().
+    featureLoadingMutex.lock();
+    bool allDimensionsLoaded = remainingDimensionsLoaded;
+    featureLoadingMutex.unlock();
+    bool init = (dimensionMinima.nbOfRows() != nbDimensions);
 
     Array<dataType> dimensionMaximaTemp(nbDimensions,1);
     Array<dataType> dimensionMinimaTemp(nbDimensions,1);
-    dataType max,min;
-
-    bool init = false;
-    if(clustersGivingMinimum.isEmpty()){
-        init = true;
-        for(int i = 0; i<nbDimensions; ++i){
-            clustersGivingMinimum.append(0);
-            clustersGivingMaximum.append(0);
-        }
+    for(int dimension = 1; dimension < nbDimensions; ++dimension){
+        dimensionMinimaTemp(dimension,1) = features(1,dimension);
+        dimensionMaximaTemp(dimension,1) = features(1,dimension);
     }
 
-    //Calculate the minimum and maximum for each dimension and store them in
-    //dimensionMinima and dimensionMaxima respectively. The cluster 0 is not taken into account.
-    for(int dimension = 1; dimension<nbDimensions; ++dimension){
-        //If an undo or redo has started or the cluster 0 has been changed again, stop the calculation.
-        if(undoRedoInProcess || clusterZeroJustModified) return;
-
-        max = min = features(1,dimension);
-
-        dataType clusterIdMin = 0;
-        dataType clusterIdMax = 0;
-
-        if(!(modifiedClusters.contains(clustersGivingMinimum[dimension - 1]) || modifiedClusters.contains(clustersGivingMaximum[dimension - 1]))
-                && !init && !modifiedClusters.isEmpty() && !modifiedClusters.contains(0)){
-            dimensionMinimaTemp(dimension,1) = dimensionMinima(dimension,1);
-            dimensionMaximaTemp(dimension,1) = dimensionMaxima(dimension,1);
-            continue;
-        }
-
-        //NB: the iterator iterates on the items sorted by their key
-        for(iterator = clusterInfoMapTemp.begin(); iterator != clusterInfoMapTemp.end(); ++iterator){
-            dataType clusterId = iterator.key();
-
-            if(clusterId == 0)
-                continue;
-            dataType firstSpikePosition = iterator.value().firstSpikePosition();
-            dataType nbSpikesOfCluster = iterator.value().nbSpikes();
-            dataType lastPosition =  firstSpikePosition + nbSpikesOfCluster;
-
-            for(dataType i = firstSpikePosition; i < (lastPosition);++i){
-                dataType spikePosition = spikesByClusterTemp(1,i);
-                dataType currentSpike = features(spikePosition,dimension);
-
-                if(currentSpike < min){
-                    min = currentSpike;
-                    clusterIdMin = clusterId;
-                }
-                if(currentSpike > max){
-                    clusterIdMax = clusterId;
-                    max = currentSpike;
-                }
-
-            }
-
-            //If an undo or redo has started or the cluster 0 has been changed again, stop the calculation.
-            if(undoRedoInProcess || clusterZeroJustModified) return;
+    //The minimum and maximum of each dimension are the ones of the ranges of all the clusters, the cluster 0 not being taken into account.
+    QHash<const dataType*,ClusterRanges>::ConstIterator iterator;
+    for(iterator = clusterRangesCache.constBegin(); iterator != clusterRangesCache.constEnd(); ++iterator){
+        const dataType* minima = iterator.value().minima.constData();
+        const dataType* maxima = iterator.value().maxima.constData();
+        for(int dimension = 1; dimension < nbDimensions; ++dimension){
+            if(minima[dimension - 1] < dimensionMinimaTemp(dimension,1)) dimensionMinimaTemp(dimension,1) = minima[dimension - 1];
+            if(maxima[dimension - 1] > dimensionMaximaTemp(dimension,1)) dimensionMaximaTemp(dimension,1) = maxima[dimension - 1];
         }
-        dimensionMinimaTemp(dimension,1) = min;
-        dimensionMaximaTemp(dimension,1) = max;
-        clustersGivingMinimum[dimension - 1] = clusterIdMin;
-        clustersGivingMaximum[dimension - 1] = clusterIdMax;
     }
 
     //The time is done seperatly because the minimum is the first spike and the maximun the last spike
     dimensionMinimaTemp(nbDimensions,1) = features(1,nbDimensions);
     dimensionMaximaTemp(nbDimensions,1) = features(nbSpikes,nbDimensions);
 
-    //Update dimensionMinima and dimensionMaxima
+    //Update dimensionMinima and dimensionMaxima, keeping the values computed meanwhile by the FeatureLoaderThread.
     mutex.lock();
+    if(!allDimensionsLoaded){
+        for(int i = 1; i < nbDimensions;++i){
+            if(initiallyLoadedDimensions[i - 1]) continue;
+            dimensionMinimaTemp(i,1) = init ? 0 : dimensionMinima(i,1);
+            dimensionMaximaTemp(i,1) = init ? 0 : dimensionMaxima(i,1);
+        }
+    }
     dimensionMaxima.setSize(nbDimensions,1);
     dimensionMinima.setSize(nbDimensions,1);
     for(int i = 1; i<=nbDimensions;++i){
@@ -572,125 +658,266 @@ void Data::minMaxDimensionCalculation(QList<int> modifiedClusters){
         dimensionMaxima(i,1) = dimensionMaximaTemp(i,1);
     }
     mutex.unlock();
+}
+
+void Data::computeClusterRanges(ClusterRanges& ranges,const dataType* spikes,dataType nbSpikesOfCluster){
+    featureLoadingMutex.lock();
+    ranges.complete = remainingDimensionsLoaded;
+    featureLoadingMutex.unlock();
+
+    ranges.minima.fill(0,nbDimensions - 1);
+    ranges.maxima.fill(0,nbDimensions - 1);
+    if(nbSpikesOfCluster == 0) return;
+
+    //Each dimension is read as a column, in the order of the spikes, with a loop specific to the width of the column.
+    for(int dimension = 1; dimension < nbDimensions; ++dimension){
+        if(!ranges.complete && !initiallyLoadedDimensions[dimension - 1]) continue;
+        dataType min = features(spikes[0],dimension);
+        dataType max = min;
+        features.columnMinMax(dimension,spikes,nbSpikesOfCluster,min,max);
+        ranges.minima[dimension - 1] = min;
+        ranges.maxima[dimension - 1] = max;
+    }
+}
+
+void Data::combineClusterRanges(const QVector<dataType>& clusterSpikes,const QList<const dataType*>& mergedSpikes){
+    if(clusterSpikes.isEmpty()) return;
+
+    QMutexLocker locker(&rangesMutex);
+    ClusterRanges combinedRanges;
+    combinedRanges.complete = true;
+    bool first = true;
+    for(int i = 0; i < mergedSpikes.size(); ++i){
+        if(!clusterRangesCache.contains(mergedSpikes[i])) return;
+        const ClusterRanges& clusterRanges = clusterRangesCache.constFind(mergedSpikes[i]).value();
+        if(first){
+            combinedRanges.minima = clusterRanges.minima;
+            combinedRanges.maxima = clusterRanges.maxima;
+            first = false;
+        }
+        else{
+            dataType* minima = combinedRanges.minima.data();
+            dataType* maxima = combinedRanges.maxima.data();
+            for(int j = 0; j < nbDimensions - 1; ++j){
+                minima[j] = qMin(minima[j],clusterRanges.minima[j]);
+                maxima[j] = qMax(maxima[j],clusterRanges.maxima[j]);
+            }
+        }
+        combinedRanges.complete = combinedRanges.complete && clusterRanges.complete;
+    }
+    if(first) return;
+
+    combinedRanges.spikes = clusterSpikes;
+    clusterRangesCache.insert(clusterSpikes.constData(),combinedRanges);
+}
+
+void Data::updateClusterRanges(){
+    featureLoadingMutex.lock();
+    bool allDimensionsLoaded = remainingDimensionsLoaded;
+    featureLoadingMutex.unlock();
+
+    //The ranges of the clusters whose spikes have not changed are kept, the others are left to the ClusterRangesTask.
+    QHash<const dataType*,ClusterRanges> currentRanges;
+    QHash<const dataType*,ClusterRanges> missingRanges;
+    SpikesByClusterMap::ConstIterator iterator;
+    for(iterator = spikesByCluster->constBegin(); iterator != spikesByCluster->constEnd(); ++iterator){
+        const QVector<dataType>& clusterSpikes = iterator.value();
+        if(iterator.key() == 0 || clusterSpikes.isEmpty()) continue;
+
+        QHash<const dataType*,ClusterRanges>::ConstIterator cachedRanges = clusterRangesCache.constFind(clusterSpikes.constData());
+        if(cachedRanges != clusterRangesCache.constEnd() && (cachedRanges.value().complete || !allDimensionsLoaded)){
+            currentRanges.insert(clusterSpikes.constData(),cachedRanges.value());
+            continue;
+        }
+        ClusterRanges ranges;
+        ranges.spikes = clusterSpikes;
+        missingRanges.insert(clusterSpikes.constData(),ranges);
+    }
+    clusterRangesCache = currentRanges;
+    pendingClusterRanges = missingRanges;
+}
+
+void Data::dimensionMinMax(int dimension,const SpikesByClusterMap& spikes,dataType& min,dataType& max){
+    //NB: the iterator iterates on the items sorted by their key
+    SpikesByClusterMap::ConstIterator iterator;
+    for(iterator = spikes.constBegin(); iterator != spikes.constEnd(); ++iterator){
+        if(iterator.key() == 0 || iterator.value().isEmpty())
+            continue;
+        features.columnMinMax(dimension,iterator.value().constData(),iterator.value().size(),min,max);
+    }
+}
+
+void Data::startFeatureLoading(){
+    if(initiallyLoadedDimensions.isEmpty() || featureLoaderThread != 0L) return;
+    featureLoaderThread = featureLoader();
+    featureLoaderThread->start();
+}
+
+bool Data::loadRemainingFeatures(){
+    //Parse the dimensions which have not been parsed by loadFeatures.
+    QVector<bool> remainingDimensions(nbDimensions);
+    for(int i = 0; i < nbDimensions; ++i) remainingDimensions[i] = !initiallyLoadedDimensions[i];
+
+    bool parsed = false;
+    QFile featureFile(featureFileName);
+    if(featureFile.open(QIODevice::ReadOnly) && featureFile.seek(featureValuesOffset)){
+        ChunkedTextParser parser(featureFile,true);
+        parser.setColumnsToStore(remainingDimensions);
+        parser.setCancelFlag(&featureLoadingCancelled);
+        parsed = parser.parse(&features[0],nbSpikes * nbDimensions) == nbSpikes * nbDimensions && parser.isValid();
+        featureFile.close();
+    }
+    if(featureLoadingCancelled) return false;
+    if(!parsed) qDebug()<<"the remaining dimensions of "<<featureFileName<<" could not be loaded";
+
+    //Compute the minimum and maximum of the new dimensions on the current clusters.
+    mutex.lock();
+    SpikesByClusterMap spikesByClusterTemp(*spikesByCluster);
+    mutex.unlock();
+
+    features.adviseAccess(FeatureArray::SEQUENTIAL);
+    for(int dimension = 1; dimension < nbDimensions; ++dimension){
+        if(initiallyLoadedDimensions[dimension - 1]) continue;
+        if(featureLoadingCancelled) return false;
+
+        dataType min = features(1,dimension);
+        dataType max = min;
+        dimensionMinMax(dimension,spikesByClusterTemp,min,max);
+
+        mutex.lock();
+        dimensionMinima(dimension,1) = min;
+        dimensionMaxima(dimension,1) = max;
+        mutex.unlock();
+    }
+    features.adviseAccess(FeatureArray::NORMAL);
+
+    //From now on, the dimensions are all available.
+    featureLoadingMutex.lock();
+    remainingDimensionsLoaded = true;
+    featureLoadingCondition.wakeAll();
+    featureLoadingMutex.unlock();
+
+    //The features are read concurrently, so they are not compacted here. The cache is written compacted
+    //and useCompactFeatures(), called from the GUI thread, then replaces the full-width table by it.
+    if(!parsed) return false;
+    if(!featureCacheFileName.isEmpty()){
+        features.adviseAccess(FeatureArray::SEQUENTIAL);
+        if(!features.writeCache(featureCacheFileName,QFileInfo(featureFileName)))
+            qDebug()<<"the feature cache "<<featureCacheFileName<<" could not be written";
+        features.adviseAccess(FeatureArray::NORMAL);
+    }
+    featuresToCompact = true;
+    return true;
+}
+
+bool Data::useCompactFeatures(){
+    if(!featuresToCompact) return true;
+    //The computing threads hold the lock while they read the features, the table is replaced once none of them does.
+    if(!featuresLock.tryLockForWrite()) return false;
 
-    qDebug() << "in minMaxDimensionCalculation end" << endl;
+    //Use the cache if it has been written, as the non lazy loading does in out-of-core mode, otherwise compact the table itself.
+    if(featureCacheFileName.isEmpty() || !features.mapCache(featureCacheFileName,QFileInfo(featureFileName),nbSpikes))
+        features.compact();
+    featuresToCompact = false;
+    featuresLock.unlock();
+
+    //The ranges of the clusters computed while some dimensions were missing are completed now rather than at the next change of the clusters.
+    minMaxDimensionCalculation();
+    return true;
+}
 
+bool Data::isDimensionLoaded(int dimension){
+    if(initiallyLoadedDimensions.isEmpty() || initiallyLoadedDimensions[dimension - 1]) return true;
+    featureLoadingMutex.lock();
+    bool loaded = remainingDimensionsLoaded;
+    featureLoadingMutex.unlock();
+    return loaded;
 }
 
+void Data::waitForDimension(int dimension){
+    if(isDimensionLoaded(dimension)) return;
+    waitForAllDimensions();
+}
+
+void Data::waitForAllDimensions(){
+    featureLoadingMutex.lock();
+    while(!remainingDimensionsLoaded) featureLoadingCondition.wait(&featureLoadingMutex);
+    featureLoadingMutex.unlock();
+}
+
+
+dataType Data::createNewCluster(const PolygonMask& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY, QList <int>& fromClusters,QList <int>& emptyClusters){
+    //Classify at once the spikes of all the clusters which may contain spikes in the region.
+    SpikeSelection selection(region,features.column(dimensionX),features.column(dimensionY));
+    addClustersToSelection(selection,clustersOfOrigin,-1);
+    selection.classify();
 
-dataType Data::createNewCluster(QRegion& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY, QList <int>& fromClusters,QList <int>& emptyClusters){
     //Set the new cluster number to the biggest existing number plus one
-    dataType newClusterId = (*spikesByCluster)(2,nbSpikes) + 1;
+    dataType newClusterId = clusterInfoMap->lastKey() + 1;
     dataType nbSpikesInNewCluster = 0;
 
-    //Create the variables to store the number of spikes and the position of the last spike
-    //for each cluster contributing to the new cluster. This will be used to sort the new cluster.
-    QList<dataType> lastPositions;
-    QList<dataType> nbOfspikes;
+    //Count the spikes of the new cluster to allocate it at once.
+    QList<int>::const_iterator originIterator;
+    for(originIterator = clustersOfOrigin.begin(); originIterator != clustersOfOrigin.end(); ++originIterator)
+        if(clusterInfoMap->contains(*originIterator)) nbSpikesInNewCluster += selection.nbSelected(*originIterator);
+    //The selected spikes of each contributing cluster are gathered one run after the other and then merged in the new cluster.
+    QVector<dataType> selectedSpikes(nbSpikesInNewCluster);
+    QVector<const dataType*> runs;
+    QVector<dataType> runSizes;
+    nbSpikesInNewCluster = 0;
 
-    //The new information about the cluster will be inserted in the table pointed by spikesByClusterTemp
-    SortableTable* spikesByClusterTemp = new SortableTable();
-    spikesByClusterTemp->setSize(nbSpikes);
-
-    //Create a new map which will contain the new information about the position of the clusters
-    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap();
+    //The new state starts as a shallow copy of the current one, only the modified clusters are replaced.
+    SpikesByClusterMap* spikesByClusterTemp = new SpikesByClusterMap(*spikesByCluster);
+    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap(*clusterInfoMap);
 
     //Iteration on the clusters
-    ClusterInfoMap::Iterator iterator;
-    dataType upperInsertionIndex = 1;
-    dataType lowerInsertionIndex = nbSpikes;
-
     //NB: the iterator iterates on the items sorted by their key
-    for(iterator = clusterInfoMap->begin(); iterator != clusterInfoMap->end(); ++iterator){
-        dataType firstSpikePosition = iterator.value().firstSpikePosition();
-        dataType nbSpikesOfCluster = iterator.value().nbSpikes();
+    ClusterInfoMap::ConstIterator iterator;
+    for(iterator = clusterInfoMap->constBegin(); iterator != clusterInfoMap->constEnd(); ++iterator){
         dataType clusterId = iterator.key();
 
         //if clustersOfOrigin does not contains the current cluster, this cluster is let unchanged
-        //and its information is simply copy as is from spikesByCluster to spikesByClusterTemp
-        if(!clustersOfOrigin.contains(static_cast<int>(clusterId))){
-            //copy the 2 rows of spikesByCluster for the given cluster
-            memcpy(&(*spikesByClusterTemp)(1,upperInsertionIndex),
-                   &(*spikesByCluster)(1,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            memcpy(&(*spikesByClusterTemp)(2,upperInsertionIndex),
-                   &(*spikesByCluster)(2,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            //Construct the new clusterInfoMap
-            clusterInfoMapTemp->insert(clusterId,ClusterInfo(upperInsertionIndex,nbSpikesOfCluster,iterator.value().getStructure(),iterator.value().getType(),iterator.value().getId(),iterator.value().getQuality(),iterator.value().getNotes()));
-            upperInsertionIndex += nbSpikesOfCluster;
-        }
+        if(!clustersOfOrigin.contains(static_cast<int>(clusterId))) continue;
+
         //Now deal with the clusters which may contain spikes to add to the new cluster
         //<=> spike in the region.
-        else{
-            //Store the last spike position for the current cluster
-            lastPositions.append(nbSpikesInNewCluster + 1);
-
-            dataType updatedClusterPosition = 0;
-            bool existUntouchSpike = true;
-            dataType newNbSpikesOfCluster = nbSpikesOfCluster;
-            dataType lastPosition =  firstSpikePosition + nbSpikesOfCluster;
-            dataType lastPositionLessOne =  lastPosition -1;
-
-            for(dataType i = firstSpikePosition; i < lastPosition;++i){
-                dataType featuresRowIndex = static_cast<dataType>((*spikesByCluster)(1,i));
-                if(region.contains(
-                            QPoint(static_cast<dataType>(features(featuresRowIndex,dimensionX)),
-                                   static_cast<dataType>(features(featuresRowIndex,dimensionY))))){
-                    //Add the spike to the new cluster <=> add the row index at the end of spikesByCluster at the lowerInsertionIndex
-                    (*spikesByClusterTemp)(1,lowerInsertionIndex) = featuresRowIndex;
-                    --lowerInsertionIndex;
-                    ++nbSpikesInNewCluster;
-                    --newNbSpikesOfCluster;
-                }
-                else{
-                    //Update the position of this cluster
-                    if(existUntouchSpike){
-                        existUntouchSpike = false;
-                        updatedClusterPosition = upperInsertionIndex;
-                    }
-                    //Keep the spike in the current cluster <=> add the row index and the cluster number at the top of spikesByCluster at the upperInsertionIndex
-                    (*spikesByClusterTemp)(1,upperInsertionIndex) = featuresRowIndex;
-                    (*spikesByClusterTemp)(2,upperInsertionIndex) = (*spikesByCluster)(2,i);
-                    ++upperInsertionIndex;
-                }
+        dataType nbSelectedSpikes = selection.nbSelected(clusterId);
+        dataType newNbSpikesOfCluster = iterator.nbSpikes() - nbSelectedSpikes;
+        if(nbSelectedSpikes == 0 && newNbSpikesOfCluster > 0) continue;
 
-                if(i == (lastPositionLessOne)){
-                    if(newNbSpikesOfCluster < nbSpikesOfCluster){
-                        //Store the number of spikes coming from the current cluster
-                        nbOfspikes.append(nbSpikesOfCluster - newNbSpikesOfCluster);
+        if(nbSelectedSpikes > 0){
+            //Add the spikes to the runs to merge
+            dataType* run = selectedSpikes.data() + nbSpikesInNewCluster;
+            selection.copySelected(clusterId,run);
+            runs.append(run);
+            runSizes.append(nbSelectedSpikes);
+            nbSpikesInNewCluster += nbSelectedSpikes;
 
-                        //update fromClusters if at least one spike from that cluster was in the region
-                        fromClusters.append(static_cast<int>(clusterId));
-                    }
-                    //No spike has been move to the new cluster, remove the last entry in lastPositions.
-                    else lastPositions.pop_back();
+            //update fromClusters if at least one spike from that cluster was in the region
+            fromClusters.append(static_cast<int>(clusterId));
+        }
 
-                    //Construct the insertion of the current cluster in the new clusterInfoMap if
-                    // the number of spikes is more than zero
-                    if(newNbSpikesOfCluster >0)clusterInfoMapTemp->insert(clusterId,ClusterInfo(updatedClusterPosition,newNbSpikesOfCluster,iterator.value().getStructure(),iterator.value().getType(),iterator.value().getId(),iterator.value().getQuality(),iterator.value().getNotes()));
-                    else emptyClusters.append(static_cast<int>(clusterId));
-                }
-            }
+        //Keep the other spikes in the current cluster if there are any left
+        if(newNbSpikesOfCluster > 0){
+            QVector<dataType> keptSpikes(newNbSpikesOfCluster);
+            selection.copyKept(clusterId,keptSpikes.data());
+            spikesByClusterTemp->insert(clusterId,keptSpikes);
+            clusterInfoMapTemp->setNbSpikes(clusterId,newNbSpikesOfCluster);
+        }
+        else{
+            spikesByClusterTemp->remove(clusterId);
+            clusterInfoMapTemp->remove(clusterId);
+            emptyClusters.append(static_cast<int>(clusterId));
         }
     }
 
-    //If some spikes have been taken from the cluster 0, the max and min
-    // dimensions have to be recalculated. If minMaxThread is running, clusterZeroJustModified will
-    //inform it that it has to stop (the computation will be done again on the new data).
-    if(fromClusters.contains(0)) clusterZeroJustModified = true;
-
-    //For the new cluster, only the row index has been inserted in spikesByClusterTemp,
-    //now the cluster number is updated at once for all the spikes of the new cluster
-    dataType startInsertion =  lowerInsertionIndex + 1;
-    for(dataType i = 0; i<nbSpikesInNewCluster;++i) (*spikesByClusterTemp)(2,startInsertion + i) = newClusterId;
 
     if(nbSpikesInNewCluster > 0){
-        //Construct the insertion of the new cluster in the new clusterInfoMap
-        clusterInfoMapTemp->insert(newClusterId,ClusterInfo(lowerInsertionIndex + 1,nbSpikesInNewCluster));
-
-        //Sort the spikes of the newly created cluster.
-        sortCluster(clusterInfoMapTemp,spikesByClusterTemp,newClusterId,lastPositions,nbOfspikes,-1);
+        //Merge the spikes of the newly created cluster and insert it in the new state.
+        QVector<dataType> newClusterSpikes(nbSpikesInNewCluster);
+        SpikeMerge::mergeRuns(runs,runSizes,newClusterSpikes.data());
+        spikesByClusterTemp->insert(newClusterId,newClusterSpikes);
+        clusterInfoMapTemp->setNbSpikes(newClusterId,nbSpikesInNewCluster);
 
         //Get the list of clusters before applying the changes, this will be used in the clean
         //of the correlation.
@@ -699,19 +926,6 @@ dataType Data::createNewCluster(QRegion& region, const QList <int>& clustersOfOr
         //Deal with the undo mechanism
         prepareUndo(spikesByClusterTemp,clusterInfoMapTemp);
 
-        //If some spikes have been taken from the cluster 0, the max and min
-        // dimensions have to be recalculated. If minMaxThread is running, the call
-        //will wait until it finishes before starting the thread again.
-        if(fromClusters.contains(0)){
-            //If the minMaxThread has not finish, wait until it is done
-            while(!minMaxThread->wait()){};
-            //Reset the flag to false so the minMaxThread can do the computation
-            clusterZeroJustModified = false;
-            minMaxThread->setModifiedClusters(fromClusters);
-            minMaxThread->start();
-            dimensionChangedUndo.prepend(true);
-        }
-        else dimensionChangedUndo.prepend(false);
 
         //Remove the waveform and correlation data for the clusters which gave the spikes for the new cluster.
         //if there is not a thread working with them,otherwise advice the thread of the change,by updating waveformStatus and correlationsInProcess
@@ -721,7 +935,7 @@ dataType Data::createNewCluster(QRegion& region, const QList <int>& clustersOfOr
             mutex.lock();
             if(waveformStatusMap.contains(*iterator)){
                 if(!waveformStatusMap[*iterator].isInProcess()){
-                    delete waveformDict.take(QString::fromLatin1("%1").arg(*iterator));
+                    delete waveformCache.take(*iterator);
                     waveformStatusMap.remove(*iterator);
                 }
                 else{
@@ -744,173 +958,79 @@ dataType Data::createNewCluster(QRegion& region, const QList <int>& clustersOfOr
     }
     //return 0 if no new cluster have been created
     //safe as cluster 0 (artifact) can never be created that way
-    else return 0;
+    else{
+        delete spikesByClusterTemp;
+        delete clusterInfoMapTemp;
+        return 0;
+    }
 }
 
-QMap<int,int> Data::createNewClusters(QRegion& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY,QList <int>& emptyClusters){
-    QMap<int,int> fromToClusterIds;
-    QMap<int,int> fromToNewClusterIds;
-    ClusterInfoMap clusterInfoMapTemp; //used in the first part of the function
-    int nbNewClusters = 0;
-    int nbMaxNewClusters = clustersOfOrigin.size();
-
-    //Set the new cluster number to the biggest existing number plus nbMaxNewClusters.
-    //The number will be decremented before being used, and the number will be corrected at the end once the
-    //number of really created clusters will be known (the biggest clusterId is store at the bottom of spikesByClusterTemp).
-    dataType newClusterId = (*spikesByCluster)(2,nbSpikes) + nbMaxNewClusters;
+QMap<int,int> Data::createNewClusters(const PolygonMask& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY,QList <int>& emptyClusters){
+    //Classify at once the spikes of all the clusters which may contain spikes in the region.
+    SpikeSelection selection(region,features.column(dimensionX),features.column(dimensionY));
+    addClustersToSelection(selection,clustersOfOrigin,-1);
+    selection.classify();
 
-    //Create the variables to store the number of spikes and the position of the first spike
-    //for each cluster contributing to a new cluster. This will be used to sort the new clusters.
-    QList< QList<dataType> > firstPositions;
-    QList< QList<dataType> > nbOfspikes;
+    QMap<int,int> fromToNewClusterIds;
+    //Spikes of the new clusters, stored by cluster of origin until the number of clusters created is known.
+    QMap<int,QVector<dataType> > newClustersSpikes;
 
-    //The new information about the cluster will be inserted in the table pointed by spikesByClusterTemp
-    SortableTable* spikesByClusterTemp = new SortableTable();
-    spikesByClusterTemp->setSize(nbSpikes);
+    //The new state starts as a shallow copy of the current one, only the modified clusters are replaced.
+    SpikesByClusterMap* spikesByClusterTemp = new SpikesByClusterMap(*spikesByCluster);
+    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap(*clusterInfoMap);
 
     //Iteration on the clusters
-    ClusterInfoMap::Iterator iterator;
-    dataType upperInsertionIndex = 1;
-    dataType lowerInsertionIndex = nbSpikes;
-
     //NB: the iterator iterates on the items sorted by their key
-    for(iterator = clusterInfoMap->begin(); iterator != clusterInfoMap->end(); ++iterator){
-        dataType firstSpikePosition = iterator.value().firstSpikePosition();
-        dataType nbSpikesOfCluster = iterator.value().nbSpikes();
+    ClusterInfoMap::ConstIterator iterator;
+    for(iterator = clusterInfoMap->constBegin(); iterator != clusterInfoMap->constEnd(); ++iterator){
         dataType clusterId = iterator.key();
 
         //if clustersOfOrigin does not contains the current cluster, this cluster is let unchanged
-        //and its information is simply copy as is from spikesByCluster to spikesByClusterTemp
-        if(!clustersOfOrigin.contains(static_cast<int>(clusterId))){
-            //copy the 2 rows of spikesByCluster for the given cluster
-            memcpy(&(*spikesByClusterTemp)(1,upperInsertionIndex),
-                   &(*spikesByCluster)(1,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            memcpy(&(*spikesByClusterTemp)(2,upperInsertionIndex),
-                   &(*spikesByCluster)(2,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            //Construct the new clusterInfoMap
-            clusterInfoMapTemp.insert(clusterId,ClusterInfo(upperInsertionIndex,nbSpikesOfCluster,iterator.value().getStructure(),iterator.value().getType(),iterator.value().getId(),iterator.value().getQuality(),iterator.value().getNotes()));
-            upperInsertionIndex += nbSpikesOfCluster;
-        }
+        if(!clustersOfOrigin.contains(static_cast<int>(clusterId))) continue;
+
         //Now deal with the clusters which may contain spikes to add to a new cluster <=> spike in the region.
         //If a cluster contain spikes in the region, a new cluster is created
+        dataType nbSpikesInNewCluster = selection.nbSelected(clusterId);
+        dataType newNbSpikesOfCluster = iterator.nbSpikes() - nbSpikesInNewCluster;
+        if(nbSpikesInNewCluster == 0 && newNbSpikesOfCluster > 0) continue;
+
+        //Keep the spikes outside the region in the current cluster if there are any left.
+        if(newNbSpikesOfCluster > 0){
+            QVector<dataType> keptSpikes(newNbSpikesOfCluster);
+            selection.copyKept(clusterId,keptSpikes.data());
+            spikesByClusterTemp->insert(clusterId,keptSpikes);
+            clusterInfoMapTemp->setNbSpikes(clusterId,newNbSpikesOfCluster);
+        }
         else{
-            dataType nbSpikesInNewCluster = 0;
-            dataType updatedClusterPosition = 0;
-            bool existUntouchSpike = true;
-            dataType newNbSpikesOfCluster = nbSpikesOfCluster;
-            dataType lastPosition =  firstSpikePosition + nbSpikesOfCluster;
-            dataType lastPositionLessOne =  lastPosition -1;
-
-            //Create the variables to store the number of spikes and the position of the last spike
-            //for the new cluster contributing to the new cluster. This will be used to sort the new cluster.
-            QList<dataType> currentFirstPositions;
-            QList<dataType> currentNbOfspikes;
-
-            //Store the last spike position for the current cluster.
-            currentFirstPositions.append(1);
-
-            for(dataType i = firstSpikePosition; i < lastPosition;++i){
-                dataType featuresRowIndex = (*spikesByCluster)(1,i);
-                if(region.contains(
-                            QPoint(features(featuresRowIndex,dimensionX),
-                                   features(featuresRowIndex,dimensionY)))){
-                    //Add the spike to the new cluster <=> add the row index at the end of spikesByCluster at the lowerInsertionIndex
-                    (*spikesByClusterTemp)(1,lowerInsertionIndex) = featuresRowIndex;
-
-                    --lowerInsertionIndex;
-                    ++nbSpikesInNewCluster;
-                    newNbSpikesOfCluster --;
-                }
-                else{
-                    //Update the position of this cluster
-                    if(existUntouchSpike){
-                        existUntouchSpike = false;
-                        updatedClusterPosition = upperInsertionIndex;
-                    }
-                    //Keep the spike in the current cluster <=> add the row index and the cluster number at the top of spikesByCluster at the upperInsertionIndex
-                    (*spikesByClusterTemp)(1,upperInsertionIndex) = featuresRowIndex;
-                    (*spikesByClusterTemp)(2,upperInsertionIndex) = (*spikesByCluster)(2,i);
-                    ++upperInsertionIndex;
-                }
+            spikesByClusterTemp->remove(clusterId);
+            clusterInfoMapTemp->remove(clusterId);
+            emptyClusters.append(static_cast<int>(clusterId));
+        }
 
-                if(i == (lastPositionLessOne)){
-                    //Construct the insertion of the current cluster in the new clusterInfoMap if
-                    // the number of spikes is more than zero.
-                    //Copy the spikes back to spikesByCluster.
-                    if(newNbSpikesOfCluster > 0){
-                        clusterInfoMapTemp.insert(clusterId,ClusterInfo(updatedClusterPosition,newNbSpikesOfCluster,iterator.value().getStructure(),iterator.value().getType(),iterator.value().getId(),iterator.value().getQuality(),iterator.value().getNotes()));
-                    }
-                    else emptyClusters.append(static_cast<int>(clusterId));
-
-                    //If at least one spike from that cluster was in the region, a new cluster will be created
-                    if(nbSpikesInNewCluster > 0){
-                        //Store the number of spikes of the new cluster.
-                        currentNbOfspikes.append(nbSpikesInNewCluster);
-                        //Store the information to later sort the new cluster.
-                        firstPositions.append(currentFirstPositions);
-                        nbOfspikes.append(currentNbOfspikes);
-
-
-                        ++nbNewClusters;
-                        //update fromToClusterIds
-                        fromToClusterIds.insert(static_cast<int>(clusterId),static_cast<int>(newClusterId));
-                        //Construct the insertion of the newly created cluster with a temporarily clusterId
-                        clusterInfoMapTemp.insert(newClusterId,ClusterInfo(lowerInsertionIndex + 1,nbSpikesInNewCluster));
-                        //decrement the cluster id for the next cluster to be created
-                        --newClusterId;
-                    }
-                }
-            }
+        //If at least one spike from that cluster was in the region, a new cluster will be created
+        if(nbSpikesInNewCluster > 0){
+            QVector<dataType> newClusterSpikes(nbSpikesInNewCluster);
+            selection.copySelected(clusterId,newClusterSpikes.data());
+            newClustersSpikes.insert(static_cast<int>(clusterId),newClusterSpikes);
         }
     }
 
-    //If some spikes have been taken from the cluster 0, the max and min
-    // dimensions have to be recalculated. If minMaxThread is running, clusterZeroJustModified will
-    //inform it that it has to stop (the computation will be done again on the new data).
-    if(fromToClusterIds.contains(0)) clusterZeroJustModified = true;
-
-
-    //Create a new map which will contain the new information about the position of the clusters
-    ClusterInfoMap* clusterInfoMapTemp2 = new ClusterInfoMap(clusterInfoMapTemp);
 
-    //Update the information on the new clusters,renumber them with the good number now that
-    //we know how many clusters have been created.
+    int nbNewClusters = newClustersSpikes.size();
     if(nbNewClusters > 0){
-        int shift =  nbMaxNewClusters - nbNewClusters;
-
-        QList<int> keys = fromToClusterIds.keys();
-
-        //Iteration on the fromToClusterIds
-        for(int i = keys.size() - 1; i >= 0; --i){
-            int oldCluster = keys[i];
-            int clusterToCreate = fromToClusterIds[oldCluster];
-
-            int newClusterId = clusterToCreate - shift;
-            fromToNewClusterIds.insert(oldCluster,newClusterId);
-            ClusterInfo clusterInfo = clusterInfoMapTemp[clusterToCreate];
-            dataType firstSpikePosition = clusterInfo.firstSpikePosition();
-            dataType nbSpikesOfCluster = clusterInfo.nbSpikes();
-
-            clusterInfoMapTemp2->remove(clusterToCreate);
-            clusterInfoMapTemp2->insert(newClusterId,clusterInfo);
-
-            //For the new cluster, only the row index has been inserted in spikesByClusterTemp,
-            //now the cluster number is updated at once for all the spikes of the new cluster
-            for(dataType i = 0; i<nbSpikesOfCluster;++i)
-                (*spikesByClusterTemp)(2,firstSpikePosition + i) = newClusterId;
-        }
-
-
-        //Sort the spikes of the newly created clusters, the information to do so have been store in the 2 lists
-        //firstPositions and nbOfspikes by increasing Id of the cluster of origin.
-        //NB: the iterator iterates on the items sorted by their key, here from fromToNewClusterIds
-        QMap<int,int>::Iterator iterator;
-        int i = 0;
-        for(iterator = fromToNewClusterIds.begin(); iterator != fromToNewClusterIds.end(); ++iterator){
-            sortCluster(clusterInfoMapTemp2,spikesByClusterTemp,iterator.value(),firstPositions[i],nbOfspikes[i],-1);
-            ++i;
+        //The new clusters are numbered from the biggest existing number plus the number of new clusters,
+        //by increasing id of the cluster of origin.
+        //NB: the iterator iterates on the items sorted by their key
+        int newClusterId = static_cast<int>(clusterInfoMap->lastKey()) + nbNewClusters;
+        QMap<int,QVector<dataType> >::ConstIterator newClustersIterator;
+        for(newClustersIterator = newClustersSpikes.constBegin(); newClustersIterator != newClustersSpikes.constEnd(); ++newClustersIterator){
+            //The spikes of the new cluster have been copied in the order of the cluster of origin, they are already sorted.
+            const QVector<dataType>& newClusterSpikes = newClustersIterator.value();
+            dataType nbSpikesInNewCluster = newClusterSpikes.size();
+            spikesByClusterTemp->insert(newClusterId,newClusterSpikes);
+            clusterInfoMapTemp->setNbSpikes(newClusterId,nbSpikesInNewCluster);
+            fromToNewClusterIds.insert(newClustersIterator.key(),newClusterId);
+            --newClusterId;
         }
 
         //Get the list of clusters before applying the changes, this will be used in the clean
@@ -918,21 +1038,8 @@ QMap<int,int> Data::createNewClusters(QRegion& region, const QList <int>& cluste
         QList<dataType> currentClusterList = clusterIds();
 
         //Deal with the undo mechanism.
-        prepareUndo(spikesByClusterTemp,clusterInfoMapTemp2);
-
-        //If some spikes have been taken from the cluster 0, the max and min
-        // dimensions have to be recalculated. If minMaxThread is running, the call
-        //will wait until it finishes before starting the thread again.
-        if(fromToNewClusterIds.contains(0)){
-            //If the minMaxThread has not finish, wait until it is done
-            while(!minMaxThread->wait()){};
-            //Reset the flag to false so the minMaxThread can do the computation
-            clusterZeroJustModified = false;
-            minMaxThread->start();
-            minMaxThread->setModifiedClusters(fromToNewClusterIds.keys());
-            dimensionChangedUndo.prepend(true);
-        }
-        else dimensionChangedUndo.prepend(false);
+        prepareUndo(spikesByClusterTemp,clusterInfoMapTemp);
+
 
         //Remove the waveform and correlation data for the clusters which gave the spikes for the new cluster.
         //if there is not a thread working with them,otherwise advice the thread of the change,by updating waveformStatus and correlationsInProcess
@@ -943,7 +1050,7 @@ QMap<int,int> Data::createNewClusters(QRegion& region, const QList <int>& cluste
             mutex.lock();
             if(waveformStatusMap.contains(clusterId)){
                 if(!waveformStatusMap[clusterId].isInProcess()){
-                    delete waveformDict.take(QString::fromLatin1("%1").arg(clusterId));
+                    delete waveformCache.take(clusterId);
                     waveformStatusMap.remove(clusterId);
                 }
                 else{
@@ -962,6 +1069,10 @@ QMap<int,int> Data::createNewClusters(QRegion& region, const QList <int>& cluste
             }
         }
     }
+    else{
+        delete spikesByClusterTemp;
+        delete clusterInfoMapTemp;
+    }
     return fromToNewClusterIds;
 }
 
@@ -970,271 +1081,124 @@ QMap<int,int> Data::createNewClusters(QRegion& region, const QList <int>& cluste
   The deletion of spikes from a cluster means moving those spikes from a given cluster
   to either the cluster 0 or the cluster one.
   The main algorithm is the following:
-  Create a temporarily spikesByClusterTemp and clusterInfoMapTemp where the new configuration will be store
-  If possible copy the cluster 0 and the destination cluster into the temporarily variables.
-  Loop on all the clusters id in decreasing order, except the cluster 0 and the destination cluster (if it is the cluster 1).
-  If the cluster is not concern (not currently in the view) copy it as it is. Otherwise loop on each of its spike
-  to test if it is in the region, if so copy it a the top of spikesByClusterTemp (where the destination cluster is beeing build)
-  otherwise, copy it at the bottom. Create the entry of the current cluster into clusterInfoMapTemp
-  Create the entry of the new cluster destination into clusterInfoMapTemp
+  Create a temporarily spikesByClusterTemp and clusterInfoMapTemp, shallow copies of the current configuration.
+  Gather the runs of the new destination cluster: the spikes of the cluster 0 in the region if the destination is the cluster 1,
+  the spikes of the destination cluster and then the spikes in the region of all the other clusters in decreasing order.
+  Each cluster which gave spikes is replaced by the spikes outside the region, or removed if none is left.
+  The runs are then merged in the destination cluster, which is replaced in spikesByClusterTemp and clusterInfoMapTemp.
   There are special cases which have to be taken into account:
   Cluster 0 or cluster 1 does not exist.
   Cluster one is the destination and cluster 0 can contain spikes to be deleted.
  */
-void Data::deleteSpikesFromClusters(QRegion& region, const QList <int>& clustersOfOrigin, int destinationCluster, int dimensionX, int dimensionY, QList <int>& fromClusters,QList <int>& emptyClusters){
-    //The new information about the cluster will be inserted in the table pointed by spikesByClusterTemp
-    SortableTable* spikesByClusterTemp = new SortableTable();
-    spikesByClusterTemp->setSize(nbSpikes);
-
-    //Create the variables to store the number of spikes and the position of the last spike
-    //for each cluster contributing to the new cluster and the position of the first spike and the number
-    //of spikes for the current cluster destination (cluster 0 or cluster 1).
-    //This will be used to sort the new cluster.
-    QList<dataType> positions;
-    QList<dataType> nbOfspikes;
-    dataType firstPosition = 0;
-    dataType number = 0;
-
-    //Create a new map which will contain the new information about the position of the clusters
-    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap();
-
-    dataType upperInsertionIndex = 1;
-    dataType lowerInsertionIndex = nbSpikes + 1;
+void Data::deleteSpikesFromClusters(const PolygonMask& region, const QList <int>& clustersOfOrigin, int destinationCluster, int dimensionX, int dimensionY, QList <int>& fromClusters,QList <int>& emptyClusters){
+    //Classify at once the spikes of all the clusters which may contain spikes in the region.
+    SpikeSelection selection(region,features.column(dimensionX),features.column(dimensionY));
+    addClustersToSelection(selection,clustersOfOrigin,destinationCluster);
+    selection.classify();
+
+    //The new state starts as a shallow copy of the current one, only the modified clusters are replaced.
+    SpikesByClusterMap* spikesByClusterTemp = new SpikesByClusterMap(*spikesByCluster);
+    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap(*clusterInfoMap);
+
+    //The clusters are processed in the following order:
+    //the cluster 0 when the destination is the cluster 1, the destination cluster and then all the other clusters in decreasing order.
+    QList<dataType> clusters;
+    if(destinationCluster == 1 && clusterInfoMap->contains(0)) clusters.append(0);
+    if(clusterInfoMap->contains(destinationCluster)) clusters.append(destinationCluster);
+    QList<dataType> otherClusters = clusterInfoMap->keys();
+    for(int i = otherClusters.size() - 1; i >= 0; --i)
+        if(otherClusters[i] != destinationCluster && otherClusters[i] != 0) clusters.append(otherClusters[i]);
+
+    //Count the spikes moved to the destination cluster to gather them at once.
     dataType nbSpikesInNewCluster = 0;
-    dataType nbNewSpikesInNewCluster = 0;
-    dataType lastSpikePositionForCurrentClusterPlus1 = 1;
-    dataType firstSpikePositionForNewCluster = 1;
-
-    //First process the case of cluster zero and one
-    //Zero has to be take care of
-
-    if(destinationCluster == 0){
-        //Copy cluster 0 as it is if exists
-        if(clusterInfoMap->contains(0)){
-            ClusterInfo currentClusterInfo = (*clusterInfoMap)[0];
-            dataType nbSpikesOfCluster = currentClusterInfo.nbSpikes();
-            dataType firstSpikePosition = currentClusterInfo.firstSpikePosition();
-
-            memcpy(&(*spikesByClusterTemp)(1,upperInsertionIndex),
-                   &(*spikesByCluster)(1,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            memcpy(&(*spikesByClusterTemp)(2,upperInsertionIndex),
-                   &(*spikesByCluster)(2,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-
-            //Store the first spike position for the cluster 0
-            firstPosition = 1;
-            //Store the number of spikes coming from the cluster 0
-            number = nbSpikesOfCluster;
-
-            upperInsertionIndex += nbSpikesOfCluster;
-
-            //Initialize the number of spikes for the new cluster one with the information coming
-            //from the current one
-            firstSpikePositionForNewCluster = firstSpikePosition;
-            nbSpikesInNewCluster = nbSpikesOfCluster;
-            lastSpikePositionForCurrentClusterPlus1 = upperInsertionIndex;
-        }
-    }
-    if(destinationCluster == 1){
-        if(clusterInfoMap->contains(0)){
-            ClusterInfo currentClusterInfo = (*clusterInfoMap)[0];
-            dataType nbSpikesOfCluster = currentClusterInfo.nbSpikes();
-            dataType firstSpikePosition = currentClusterInfo.firstSpikePosition();
-
-            //Copy the cluster 0 as it is
-            if(!clustersOfOrigin.contains(0)){
-                memcpy(&(*spikesByClusterTemp)(1,upperInsertionIndex),
-                       &(*spikesByCluster)(1,firstSpikePosition),
-                       nbSpikesOfCluster * sizeof(dataType));
-                memcpy(&(*spikesByClusterTemp)(2,upperInsertionIndex),
-                       &(*spikesByCluster)(2,firstSpikePosition),
-                       nbSpikesOfCluster * sizeof(dataType));
-
-                //Construct the new clusterInfoMap
-                clusterInfoMapTemp->insert(0,ClusterInfo(upperInsertionIndex,nbSpikesOfCluster));
-                upperInsertionIndex += nbSpikesOfCluster;
-                //assign the position of the first spike of cluster 1
-                firstSpikePositionForNewCluster = nbSpikesOfCluster + 1;
-            }
-            else{
-                //copy the points which are not in the region at the top and
-                //copy the points which are in the region at a lower index starting at the number of spikes of the cluster 0
-                dataType newNbSpikesOfCluster = nbSpikesOfCluster;
-                dataType zeroLowerInsertionIndex =  nbSpikesOfCluster;
-                dataType lastPosition =  firstSpikePosition + nbSpikesOfCluster;
-                dataType lastPositionLessOne =  lastPosition -1;
-
-                for(dataType i = firstSpikePosition; i < lastPosition;++i){
-                    dataType featuresRowIndex = (*spikesByCluster)(1,i);
-                    if(region.contains(
-                                QPoint(features(featuresRowIndex,dimensionX),
-                                       features(featuresRowIndex,dimensionY)))){
-                        //Add the spike to the new cluster <=> add the row index at the end of spikesByCluster at the lowerInsertionIndex
-                        (*spikesByClusterTemp)(1,zeroLowerInsertionIndex) = featuresRowIndex;
-                        --zeroLowerInsertionIndex;
-                        ++nbSpikesInNewCluster;
-                        ++nbNewSpikesInNewCluster;
-                        --newNbSpikesOfCluster;
-                    }
-                    else{
-                        //Keep the spike in the current cluster <=> add the row index and the cluster number at the bottom of spikesByCluster at the lowerInsertionIndex
-                        (*spikesByClusterTemp)(1,upperInsertionIndex) = featuresRowIndex;
-                        (*spikesByClusterTemp)(2,upperInsertionIndex) = (*spikesByCluster)(2,i);
-                        ++upperInsertionIndex;
-                    }
-
-                    if(i == (lastPositionLessOne)){
-                        if(newNbSpikesOfCluster < nbSpikesOfCluster){
-                            //Store the last spike position for the cluster 0
-                            positions.append(nbSpikesOfCluster - newNbSpikesOfCluster);
-                            //Store the number of spikes coming from the cluster 0
-                            nbOfspikes.append(nbSpikesOfCluster - newNbSpikesOfCluster);
-
-                            //update fromClusters if at least one spike from cluster 0 was in the region
-                            fromClusters.append(0);
-                        }
-                        //Construct the insertion of the current cluster in the new clusterInfoMap if
-                        // the number of spikes is more than zero
-                        if(newNbSpikesOfCluster >0)clusterInfoMapTemp->insert(0,ClusterInfo(1,newNbSpikesOfCluster));
-                        else emptyClusters.append(0);
-                    }
-                }
-                //For the new cluster, only the row index has been inserted in spikesByClusterTemp,
-                //now the cluster number is updated at once for all the spikes of the new cluster coming from cluster 0
-                for(dataType i = 0; i<nbNewSpikesInNewCluster;++i) (*spikesByClusterTemp)(2,upperInsertionIndex + i) = destinationCluster;
-                firstSpikePositionForNewCluster =  upperInsertionIndex;//when the last spike has been tested upperInsertionIndex =  zeroLowerInsertionIndex+1
-                lastSpikePositionForCurrentClusterPlus1 = upperInsertionIndex = firstSpikePositionForNewCluster + nbSpikesInNewCluster;
-                //reset nbNewSpikesInNewCluster
-                nbNewSpikesInNewCluster = 0;
-            }//else
-        } //end of exists cluster 0
-
-        if(clusterInfoMap->contains(1)){
-            ClusterInfo currentClusterInfo = (*clusterInfoMap)[1];
-            dataType nbSpikesOfCluster = currentClusterInfo.nbSpikes();
-            dataType firstSpikePosition = currentClusterInfo.firstSpikePosition();
-
-            memcpy(&(*spikesByClusterTemp)(1,upperInsertionIndex),
-                   &(*spikesByCluster)(1,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            memcpy(&(*spikesByClusterTemp)(2,upperInsertionIndex),
-                   &(*spikesByCluster)(2,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
+    dataType nbMovedSpikes = 0;
+    for(int i = 0; i < clusters.size(); ++i){
+        dataType clusterId = clusters[i];
+        if(clusterId == destinationCluster) nbSpikesInNewCluster += clusterInfoMap->nbSpikes(clusterId);
+        else if(clustersOfOrigin.contains(static_cast<int>(clusterId))) nbMovedSpikes += selection.nbSelected(clusterId);
+    }
+    nbSpikesInNewCluster += nbMovedSpikes;
 
-            //Store the first spike position for the cluster 1
-            firstPosition = nbSpikesInNewCluster + 1;
-            //Store the number of spikes coming from the cluster 1
-            number = nbSpikesOfCluster;
+    //The spikes of the destination cluster are a run of their own, the moved spikes are gathered one run after the other.
+    QVector<dataType> movedSpikes(nbMovedSpikes);
+    QVector<const dataType*> runs;
+    QVector<dataType> runSizes;
+    nbMovedSpikes = 0;
 
-            upperInsertionIndex += nbSpikesOfCluster;
+    for(int i = 0; i < clusters.size(); ++i){
+        dataType clusterId = clusters[i];
 
-            //Initialize the number of spikes and the starting position for the new cluster one with the information coming
-            //from the current one.
-            nbSpikesInNewCluster += nbSpikesOfCluster;
-            lastSpikePositionForCurrentClusterPlus1 = upperInsertionIndex;
+        //The spikes of the destination cluster are read as they are
+        if(clusterId == destinationCluster){
+            const QVector<dataType>& destinationSpikes = spikesByCluster->constFind(clusterId).value();
+            runs.append(destinationSpikes.constData());
+            runSizes.append(destinationSpikes.size());
+            continue;
         }
-    }
 
-    //process all the other clusters
-
-    //Iteration on the clusters in decreasing order
-    QList<dataType> clusters = clusterInfoMap->keys();
-    qSort(clusters);
-    int nbClusters = clusters.size();
+        //if clustersOfOrigin does not contains the current cluster, this cluster is let unchanged
+        if(!clustersOfOrigin.contains(static_cast<int>(clusterId))) continue;
 
-    for(int i = nbClusters - 1; i >=0 ; --i){
-        dataType clusterId = clusters[i];
+        //Now deal with the clusters which may contain spikes to add to the new cluster
+        //<=> spike in the region.
+        dataType nbSelectedSpikes = selection.nbSelected(clusterId);
+        dataType newNbSpikesOfCluster = clusterInfoMap->nbSpikes(clusterId) - nbSelectedSpikes;
+        if(nbSelectedSpikes == 0 && newNbSpikesOfCluster > 0) continue;
 
-        if(clusterId == destinationCluster || clusterId == 0) continue;
+        if(nbSelectedSpikes > 0){
+            //Add the spikes to the runs to merge
+            dataType* run = movedSpikes.data() + nbMovedSpikes;
+            selection.copySelected(clusterId,run);
+            runs.append(run);
+            runSizes.append(nbSelectedSpikes);
+            nbMovedSpikes += nbSelectedSpikes;
 
-        dataType firstSpikePosition = (*clusterInfoMap)[clusterId].firstSpikePosition();
-        dataType nbSpikesOfCluster = (*clusterInfoMap)[clusterId].nbSpikes();
-        //The user information of the different clusters.
-        QString structure = (*clusterInfoMap)[clusterId].getStructure();
-        QString	type = (*clusterInfoMap)[clusterId].getType();
-        QString	iD = (*clusterInfoMap)[clusterId].getId();
-        QString	quality = (*clusterInfoMap)[clusterId].getQuality();
-        QString	notes = (*clusterInfoMap)[clusterId].getNotes();
 
+            //update fromClusters if at least one spike from that cluster was in the region
+            fromClusters.append(static_cast<int>(clusterId));
+        }
 
-        //if clustersOfOrigin does not contains the current cluster, this cluster is let unchanged
-        //and its information is simply copy as is from spikesByCluster to spikesByClusterTemp
-        if(!clustersOfOrigin.contains(static_cast<int>(clusterId))){
-            lowerInsertionIndex -= nbSpikesOfCluster;
-            //copy the 2 rows of spikesByCluster for the given cluster
-            memcpy(&(*spikesByClusterTemp)(1,lowerInsertionIndex),
-                   &(*spikesByCluster)(1,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            memcpy(&(*spikesByClusterTemp)(2,lowerInsertionIndex),
-                   &(*spikesByCluster)(2,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            //Construct the new clusterInfoMap
-            clusterInfoMapTemp->insert(clusterId,ClusterInfo(lowerInsertionIndex,nbSpikesOfCluster,structure,type,iD,quality,notes));
+        //Keep the other spikes in the current cluster if there are any left
+        if(newNbSpikesOfCluster > 0){
+            QVector<dataType> keptSpikes(newNbSpikesOfCluster);
+            selection.copyKept(clusterId,keptSpikes.data());
+            spikesByClusterTemp->insert(clusterId,keptSpikes);
+            clusterInfoMapTemp->setNbSpikes(clusterId,newNbSpikesOfCluster);
         }
-        //Now deal with the clusters which may contain spikes to add to the new cluster
-        //<=> spike in the region. Look up the spikes staring from the last one.
         else{
-            dataType newNbSpikesOfCluster = nbSpikesOfCluster;
-            dataType lastPosition =  firstSpikePosition - 1;
-
-            for(dataType i = firstSpikePosition + nbSpikesOfCluster - 1; i > lastPosition;--i){
-                dataType featuresRowIndex = (*spikesByCluster)(1,i);
-                if(region.contains(
-                            QPoint(features(featuresRowIndex,dimensionX),
-                                   features(featuresRowIndex,dimensionY)))){
-                    //Add the spike to the new cluster <=> add the row index at the end of spikesByCluster at the lowerInsertionIndex
-                    (*spikesByClusterTemp)(1,upperInsertionIndex) = featuresRowIndex;
-                    ++upperInsertionIndex;
-                    ++nbSpikesInNewCluster;
-                    ++nbNewSpikesInNewCluster;
-                    --newNbSpikesOfCluster;
-                }
-                else{
-                    //Keep the spike in the current cluster <=> add the row index and the cluster number at the bottom of spikesByCluster at the lowerInsertionIndex
-                    --lowerInsertionIndex;
-                    (*spikesByClusterTemp)(1,lowerInsertionIndex) = featuresRowIndex;
-                    (*spikesByClusterTemp)(2,lowerInsertionIndex) = (*spikesByCluster)(2,i);
-                }
-
-                if(i == (firstSpikePosition)){
-                    if(newNbSpikesOfCluster < nbSpikesOfCluster){
-                        //Store the last spike position for the current cluster
-                        positions.append(nbSpikesInNewCluster);
-                        //Store the number of spikes coming from the current cluster
-                        nbOfspikes.append(nbSpikesOfCluster - newNbSpikesOfCluster);
-
-                        //If the destination cluster is cluster 0,the max and min dimensions have to
-                        //be recalculated. If minMaxThread is running, clusterZeroJustModified will
-                        //inform it that it has to stop (the computation will be done again on the new data).
-                        if(destinationCluster == 0) clusterZeroJustModified = true;
-
-                        //update fromClusters if at least one spike from that cluster was in the region
-                        fromClusters.append(static_cast<int>(clusterId));
-                    }
-                    //Construct the insertion of the current cluster in the new clusterInfoMap if
-                    // the number of spikes is more than zero
-                    if(newNbSpikesOfCluster >0)clusterInfoMapTemp->insert(clusterId,ClusterInfo(lowerInsertionIndex,newNbSpikesOfCluster,structure,type,iD,quality,notes));
-                    else emptyClusters.append(static_cast<int>(clusterId));
-                }
-            }
+            spikesByClusterTemp->remove(clusterId);
+            clusterInfoMapTemp->remove(clusterId);
+            emptyClusters.append(static_cast<int>(clusterId));
         }
     }
 
-    //For the new cluster, only the row index has been inserted in spikesByClusterTemp,
-    //now the cluster number is updated at once for all the spikes of the new cluster
-    for(dataType i = 0; i<nbNewSpikesInNewCluster;++i) (*spikesByClusterTemp)(2,lastSpikePositionForCurrentClusterPlus1 + i) = destinationCluster;
-
     if(nbSpikesInNewCluster > 0){
         if(clustersOfOrigin.contains(destinationCluster)){
             //update fromClusters for the cluster destination
             fromClusters.append(destinationCluster);
         }
-        //Construct the insertion of the new cluster in the new clusterInfoMap
-        clusterInfoMapTemp->insert(destinationCluster,ClusterInfo(firstSpikePositionForNewCluster,nbSpikesInNewCluster));
-
-        //Sort the spikes of the newly created cluster.
-        sortCluster(clusterInfoMapTemp,spikesByClusterTemp,destinationCluster,positions,nbOfspikes,firstPosition,number);
+        //Construct the new destination cluster, the spikes are merged only if some have been moved.
+        clusterInfoMapTemp->setNbSpikes(destinationCluster,nbSpikesInNewCluster);
+        if(nbMovedSpikes > 0){
+            QVector<dataType> newClusterSpikes(nbSpikesInNewCluster);
+            SpikeMerge::mergeRuns(runs,runSizes,newClusterSpikes.data());
+            spikesByClusterTemp->insert(destinationCluster,newClusterSpikes);
+
+            //The ranges of the destination cluster are the union of its previous ones and the ones of the moved spikes.
+            const QVector<dataType> destinationSpikes = spikesByCluster->value(destinationCluster);
+            if(destinationCluster != 0 && !destinationSpikes.isEmpty()){
+                ClusterRanges movedRanges;
+                movedRanges.spikes = movedSpikes;
+                computeClusterRanges(movedRanges,movedSpikes.constData(),nbMovedSpikes);
+                rangesMutex.lock();
+                clusterRangesCache.insert(movedSpikes.constData(),movedRanges);
+                rangesMutex.unlock();
+                QList<const dataType*> mergedSpikes;
+                mergedSpikes.append(destinationSpikes.constData());
+                mergedSpikes.append(movedSpikes.constData());
+                combineClusterRanges(newClusterSpikes,mergedSpikes);
+            }
+        }
 
         //Get the list of clusters before applying the changes, this will be used in the clean
         //of the correlation.
@@ -1243,19 +1207,6 @@ void Data::deleteSpikesFromClusters(QRegion& region, const QList <int>& clusters
         //Deal with the undo mechanism
         prepareUndo(spikesByClusterTemp,clusterInfoMapTemp);
 
-        //If the spikes have been sent to the cluster 0, the max and min
-        // dimensions have to be recalculated. If minMaxThread is running, the call
-        //will wait until it finishes before starting the thread again.
-        if(destinationCluster == 0){
-            //If the minMaxThread has not finish, wait until it is done
-            while(!minMaxThread->wait()){};
-            //Reset the flag to false so the minMaxThread can do the computation
-            clusterZeroJustModified = false;
-            minMaxThread->setModifiedClusters(fromClusters);
-            minMaxThread->start();
-            dimensionChangedUndo.prepend(true);
-        }
-        else dimensionChangedUndo.prepend(false);
 
         //Remove the waveform and correlation data for the clusters which gave the spikes for the new cluster.
         //if there is not a thread working with them, otherwise advice the thread of the change,by updating waveformStatus and correlationsInProcess
@@ -1265,7 +1216,7 @@ void Data::deleteSpikesFromClusters(QRegion& region, const QList <int>& clusters
             mutex.lock();
             if(waveformStatusMap.contains(*iterator)){
                 if(!waveformStatusMap[*iterator].isInProcess()){
-                    delete waveformDict.take(QString::fromLatin1("%1").arg(*iterator));
+                    delete waveformCache.take(*iterator);
                     waveformStatusMap.remove(*iterator);
                 }
                 else{
@@ -1284,76 +1235,20 @@ void Data::deleteSpikesFromClusters(QRegion& region, const QList <int>& clusters
             }
         }
     }
+    else{
+        delete spikesByClusterTemp;
+        delete clusterInfoMapTemp;
+    }
 }
 
 void Data::moveClustersToArtefact(QList <int>& clustersToDelete){
-    //If clustersToDelete is not empty, the cluster 0 will be modified and the max and min dimensions
-    //have to be recalculated. If minMaxThread is running, clusterZeroJustModified will
-    //inform it that it has to stop (the computation will be done again on the new data).
-    if(clustersToDelete.size() != 0) clusterZeroJustModified = true;
-
-    //The new information about the cluster will be inserted in the table pointed by spikesByClusterTemp
-    SortableTable* spikesByClusterTemp = new SortableTable();
-    spikesByClusterTemp->setSize(nbSpikes);
-
-    //Create a new map which will contain the new information about the position of the clusters
-    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap();
 
-    //Create the variables to store the number of spikes and the position of the first spike
-    //for each cluster contributing to the new cluster. This will be used to sort the new cluster.
-    QList<dataType> positions;
-    QList<dataType> nbOfspikes;
-
-    dataType upperInsertionIndex = 1;
-
-    //If the cluster 0 exits copy the the 2 rows of spikesByCluster
-    dataType nbSpikesInNewClusterZero;
-    dataType nbSpikesInCurrentClusterZero;
-    dataType lastSpikePositionForCurrentClusterZeroPlus1;
-
-    if(clusterInfoMap->contains(0)){
-        ClusterInfo currentClusterInfo = (*clusterInfoMap)[0];
-        dataType nbSpikesOfCluster = currentClusterInfo.nbSpikes();
-        dataType firstSpikePosition = currentClusterInfo.firstSpikePosition();
-
-        memcpy(&(*spikesByClusterTemp)(1,upperInsertionIndex),
-               &(*spikesByCluster)(1,firstSpikePosition),
-               nbSpikesOfCluster * sizeof(dataType));
-        memcpy(&(*spikesByClusterTemp)(2,upperInsertionIndex),
-               &(*spikesByCluster)(2,firstSpikePosition),
-               nbSpikesOfCluster * sizeof(dataType));
-
-        upperInsertionIndex += nbSpikesOfCluster;
-
-        //Initialize the number of spikes for the new cluster 0 with the information coming
-        //from the current one if it exists
-        nbSpikesInNewClusterZero = nbSpikesInCurrentClusterZero = nbSpikesOfCluster;
-        lastSpikePositionForCurrentClusterZeroPlus1 = upperInsertionIndex;
-
-        //Store the first spike position for the original cluster 0
-        positions.append(1);
-        //Store the number of spikes coming from the original cluster 0v
-        nbOfspikes.append(nbSpikesOfCluster);
-    }
-    //cluster 0 does not exist
-    else{
-        nbSpikesInNewClusterZero = nbSpikesInCurrentClusterZero = 0;
-        lastSpikePositionForCurrentClusterZeroPlus1 = upperInsertionIndex;
-    }
+    //The new state starts as a shallow copy of the current one, only the modified clusters are replaced.
+    SpikesByClusterMap* spikesByClusterTemp = new SpikesByClusterMap(*spikesByCluster);
+    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap(*clusterInfoMap);
 
     //Move the clusters contain in clustersToDelete to cluster 0 and leave the others as they are
-    moveClusters(clustersToDelete,spikesByClusterTemp,clusterInfoMapTemp,upperInsertionIndex,nbSpikesInNewClusterZero,0,positions,nbOfspikes);
-
-    //For the new cluster 0, only the row index has been inserted in spikesByClusterTemp,
-    //now the cluster number is updated at once for all the new spikes of the new cluster 0
-    dataType nbNewSpikesInClusterZero = nbSpikesInNewClusterZero - nbSpikesInCurrentClusterZero;
-    for(dataType i = 0; i<nbNewSpikesInClusterZero;++i) (*spikesByClusterTemp)(2,lastSpikePositionForCurrentClusterZeroPlus1 + i) = 0;
-
-    //Construct the entry for cluster 0 in clusterInfoMap
-    clusterInfoMapTemp->insert(0,ClusterInfo(1,nbSpikesInNewClusterZero));
-
-    //Sort the spikes of the newly created cluster.
-    sortCluster(clusterInfoMapTemp,spikesByClusterTemp,0,positions,nbOfspikes,1,true);
+    moveClusters(clustersToDelete,spikesByClusterTemp,clusterInfoMapTemp,0);
 
     //Get the list of clusters before applying the changes, this will be used in the clean
     //of the correlation.
@@ -1362,14 +1257,6 @@ void Data::moveClustersToArtefact(QList <int>& clustersToDelete){
     //Deal with the undo mechanism
     prepareUndo(spikesByClusterTemp,clusterInfoMapTemp);
 
-    //The max and min dimensions have to be recalculated.
-    //If the minMaxThread has not finish, wait until it is done
-    while(!minMaxThread->wait()){qDebug()<<"wait for minMaxThread to finish";};
-    //Reset the flag to false so the minMaxThread can do the computation
-    clusterZeroJustModified = false;
-    minMaxThread->setModifiedClusters(clustersToDelete);
-    minMaxThread->start();
-    dimensionChangedUndo.prepend(true);
 
     //Remove the waveform and correlation data for the clusters which gave the spikes for the new cluster 0.
     //if there is not a thread working with them, otherwise advice the thread of the change,by updating waveformStatus and correlationsInProcess
@@ -1379,7 +1266,7 @@ void Data::moveClustersToArtefact(QList <int>& clustersToDelete){
         mutex.lock();
         if(waveformStatusMap.contains(*iterator)){
             if(!waveformStatusMap[*iterator].isInProcess()){
-                delete waveformDict.take(QString::fromLatin1("%1").arg(*iterator));
+                delete waveformCache.take(*iterator);
                 waveformStatusMap.remove(*iterator);
             }
             else{
@@ -1404,7 +1291,7 @@ void Data::moveClustersToArtefact(QList <int>& clustersToDelete){
     if(!clustersToDelete.empty()){
         mutex.lock();
         if(!waveformStatusMap[0].isInProcess()){
-            delete waveformDict.take("0");
+            delete waveformCache.take(0);
             waveformStatusMap.remove(0);
         }
         else{
@@ -1425,93 +1312,13 @@ void Data::moveClustersToArtefact(QList <int>& clustersToDelete){
 
 
 void Data::moveClustersToNoise(QList<int>& clustersToDelete){
-    //If clustersToDelete contains the cluster 0, the max and min dimensions
-    //have to be recalculated. If minMaxThread is running, clusterZeroJustModified will
-    //inform it that it has to stop (the computation will be done again on the new data).
-    if(clustersToDelete.contains(0)) clusterZeroJustModified = true;
-
-    //The new information about the cluster will be inserted in the table pointed by spikesByClusterTemp
-    SortableTable* spikesByClusterTemp = new SortableTable();
-    spikesByClusterTemp->setSize(nbSpikes);
-
-    //Create a new map which will contain the new information about the position of the clusters
-    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap();
-
-    //Create the variables to store the number of spikes and the position of the first spike
-    //for each cluster contributing to the new cluster. This will be used to sort the new cluster.
-    QList<dataType> positions;
-    QList<dataType> nbOfspikes;
-
-    dataType upperInsertionIndex = 1;
-
-    //If the cluster 0 exists and is not a cluster to delete, copy the 2 rows of spikesByCluster.
-    // If cluster 1 exists copy the the 2 rows of spikesByCluster
-    int i, max;
-    if(clusterInfoMap->contains(0) && !clustersToDelete.contains(0)) i = 0;
-    else i = 1;
-    if(clusterInfoMap->contains(1)) max = 2;
-    else max = 1;
-    dataType nbSpikesOfCluster = 0;
-    dataType firstSpikePosition;
-    for(;i<max;++i){
-        ClusterInfo currentClusterInfo = (*clusterInfoMap)[i];
-        nbSpikesOfCluster = currentClusterInfo.nbSpikes();
-        firstSpikePosition = currentClusterInfo.firstSpikePosition();
-
-        memcpy(&(*spikesByClusterTemp)(1,upperInsertionIndex),
-               &(*spikesByCluster)(1,firstSpikePosition),
-               nbSpikesOfCluster * sizeof(dataType));
-        memcpy(&(*spikesByClusterTemp)(2,upperInsertionIndex),
-               &(*spikesByCluster)(2,firstSpikePosition),
-               nbSpikesOfCluster * sizeof(dataType));
-
-        //Construct the new clusterInfoMap, the entry for cluster 1 will be updated later
-        clusterInfoMapTemp->insert(i,ClusterInfo(upperInsertionIndex,nbSpikesOfCluster));
-
-        upperInsertionIndex += nbSpikesOfCluster;
-
-        //Store the information on the spikes of the original cluster 1
-        if(i == 1){
-            //Store the first spike position for the the original cluster 1
-            positions.append(1);
-            //Store the number of spikes coming from the original cluster 1
-            nbOfspikes.append(nbSpikesOfCluster);
-        }
-    }
-
-    //Initialize the number of spikes for the new cluster one with the information coming
-    //from the current one if it exists
-    dataType nbSpikesInNewClusterOne;
-    dataType nbSpikesInCurrentClusterOne;
-    dataType lastSpikePositionForCurrentClusterOnePlus1;
-    if(max == 2){
-        nbSpikesInNewClusterOne = nbSpikesInCurrentClusterOne = nbSpikesOfCluster; //nbSpikesOfCluster currently contents the info for cluster 1
-        lastSpikePositionForCurrentClusterOnePlus1 = upperInsertionIndex; //upperInsertionIndex currently contents the info for cluster 1
-    }
-    //max == 1 <=> cluster 1 does not exist
-    else{
-        nbSpikesInNewClusterOne = nbSpikesInCurrentClusterOne = 0;
-        lastSpikePositionForCurrentClusterOnePlus1 = upperInsertionIndex;
 
-        //Construct the new clusterInfoMap, the entry for cluster 1 will be updated later
-        clusterInfoMapTemp->insert(1,ClusterInfo(upperInsertionIndex,nbSpikesInNewClusterOne));
-    }
+    //The new state starts as a shallow copy of the current one, only the modified clusters are replaced.
+    SpikesByClusterMap* spikesByClusterTemp = new SpikesByClusterMap(*spikesByCluster);
+    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap(*clusterInfoMap);
 
     //Move the clusters contain in clustersToDelete to cluster 1 and leave the others as they are
-    moveClusters(clustersToDelete,spikesByClusterTemp,clusterInfoMapTemp,upperInsertionIndex,nbSpikesInNewClusterOne,1,positions,nbOfspikes);
-
-    //For the new cluster 1, only the row index has been inserted in spikesByClusterTemp,
-    //now the cluster number is updated at once for all the new spikes of the new cluster 1
-    dataType nbNewSpikesInClusterOne = nbSpikesInNewClusterOne - nbSpikesInCurrentClusterOne;
-    for(dataType i = 0; i<nbNewSpikesInClusterOne;++i) (*spikesByClusterTemp)(2,lastSpikePositionForCurrentClusterOnePlus1 + i) = 1;
-
-    //Update the new clusterInfoMap for the cluster 1
-    ClusterInfo clusterOneInfo = (*clusterInfoMapTemp)[1];
-    clusterOneInfo.setNbSpikes(nbSpikesInNewClusterOne);
-    clusterInfoMapTemp->insert(1,clusterOneInfo);
-
-    //Sort the spikes of the newly created cluster.
-    sortCluster(clusterInfoMapTemp,spikesByClusterTemp,1,positions,nbOfspikes,1,true);
+    moveClusters(clustersToDelete,spikesByClusterTemp,clusterInfoMapTemp,1);
 
     //Get the list of clusters before applying the changes, this will be used in the clean
     //of the correlation.
@@ -1520,18 +1327,6 @@ void Data::moveClustersToNoise(QList<int>& clustersToDelete){
     //Deal with the undo mechanism
     prepareUndo(spikesByClusterTemp,clusterInfoMapTemp);
 
-    //The max and min dimensions have to be recalculated.
-    //If the minMaxThread has not finish, wait until it is done
-    if(clustersToDelete.contains(0)){
-        while(!minMaxThread->wait()){qDebug()<<"wait for minMaxThread to finish"; };
-        //Reset the flag to false so the minMaxThread can do the computation
-        clusterZeroJustModified = false;
-        QList<int> modifiedClusters;
-        minMaxThread->setModifiedClusters(modifiedClusters);
-        minMaxThread->start();
-        dimensionChangedUndo.prepend(true);
-    }
-    else dimensionChangedUndo.prepend(false);
 
 
     //Remove the waveform and correlation data for the clusters which gave the spikes for the new cluster 1.
@@ -1542,7 +1337,7 @@ void Data::moveClustersToNoise(QList<int>& clustersToDelete){
         mutex.lock();
         if(waveformStatusMap.contains(*iterator)){
             if(!waveformStatusMap[*iterator].isInProcess()){
-                delete waveformDict.take(QString::fromLatin1("%1").arg(*iterator));
+                delete waveformCache.take(*iterator);
                 waveformStatusMap.remove(*iterator);
             }
             else{
@@ -1567,7 +1362,7 @@ void Data::moveClustersToNoise(QList<int>& clustersToDelete){
     if(!clustersToDelete.empty()){
         mutex.lock();
         if(!waveformStatusMap[1].isInProcess()){
-            delete waveformDict.take("1");
+            delete waveformCache.take(1);
             waveformStatusMap.remove(1);
         }
         else{
@@ -1587,20 +1382,11 @@ void Data::moveClustersToNoise(QList<int>& clustersToDelete){
 }
 
 dataType Data::groupClusters(QList<int>& clustersToGroup){
-    //If the clusters to group contain the cluster 0, the max and min
-    // dimensions have to be recalculated. If minMaxThread is running, clusterZeroJustModified will
-    //inform it that it has to stop (the computation will be done again on the new data).
-    if(clustersToGroup.contains(0)) clusterZeroJustModified = true;
 
     //Set the new cluster number to the biggest existing number plus one
-    dataType newClusterId = (*spikesByCluster)(2,nbSpikes) + 1;
+    dataType newClusterId = clusterInfoMap->lastKey() + 1;
     dataType nbSpikesInNewCluster = 0;
 
-    //Create the variables to store the number of spikes and the position of the first spike
-    //for each cluster contributing to the new cluster. This will be used to sort the new cluster.
-    QList<dataType> positions;
-    QList<dataType> nbOfspikes;
-
     //The user information of the different clusters to be grouped will be concatenated.
     QString newStructure;
     QString	newType;
@@ -1608,86 +1394,69 @@ dataType Data::groupClusters(QList<int>& clustersToGroup){
     QString	newQuality;
     QString	newNotes;
 
-    //The new information about the cluster will be inserted in the table pointed by spikesByClusterTemp
-    SortableTable* spikesByClusterTemp = new SortableTable();
-    spikesByClusterTemp->setSize(nbSpikes);
-
-    //Create a new map which will contain the new information about the position of the clusters
-    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap();
-
-    dataType upperInsertionIndex = 1;
-    dataType lowerInsertionIndex = nbSpikes + 1;
+    //The new state starts as a shallow copy of the current one, only the modified clusters are replaced.
+    SpikesByClusterMap* spikesByClusterTemp = new SpikesByClusterMap(*spikesByCluster);
+    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap(*clusterInfoMap);
 
-    //Iteration on the clusters
-    ClusterInfoMap::Iterator iterator;
+    //Iteration on the clusters to find the ones to group
+    ClusterInfoMap::ConstIterator iterator;
+    QList<dataType> groupedClusters;
 
     //Variable used to determined
     bool first = true;
 
     //NB: the iterator iterates on the items sorted by their key
-    for(iterator = clusterInfoMap->begin(); iterator != clusterInfoMap->end(); ++iterator) {
-        dataType firstSpikePosition = iterator.value().firstSpikePosition();
-        dataType nbSpikesOfCluster = iterator.value().nbSpikes();
+    for(iterator = clusterInfoMap->constBegin(); iterator != clusterInfoMap->constEnd(); ++iterator) {
         dataType clusterId = iterator.key();
 
         //if clustersToGroup does not contains the current cluster, this cluster is let unchanged
-        //and its information is simply copy as is from spikesByCluster to spikesByClusterTemp
-        if(!clustersToGroup.contains(static_cast<int>(clusterId))){
-            //copy the 2 rows of spikesByCluster for the given cluster
-            memcpy(&(*spikesByClusterTemp)(1,upperInsertionIndex),
-                   &(*spikesByCluster)(1,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            memcpy(&(*spikesByClusterTemp)(2,upperInsertionIndex),
-                   &(*spikesByCluster)(2,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-
-            //Construct the new clusterInfoMap
-            clusterInfoMapTemp->insert(clusterId,ClusterInfo(upperInsertionIndex,nbSpikesOfCluster,iterator.value().getStructure(),iterator.value().getType(),iterator.value().getId(),iterator.value().getQuality(),iterator.value().getNotes()));
-            upperInsertionIndex += nbSpikesOfCluster;
-        }
-        //Now deal with the clusters which are to be grouped and need to be added to the new cluster
+        if(!clustersToGroup.contains(static_cast<int>(clusterId))) continue;
+
+        groupedClusters.append(clusterId);
+        nbSpikesInNewCluster += iterator.nbSpikes();
+
+        //Take care of the user information about the current cluster
+        ClusterInfo clusterInformation = clusterInfoMap->clusterInformation(clusterId);
+        if(first){
+            newStructure += clusterInformation.getStructure();
+            newType += clusterInformation.getType();
+            newID += clusterInformation.getId();
+            newQuality += clusterInformation.getQuality();
+            newNotes += clusterInformation.getNotes();
+
+            first = false;
+        }
         else{
-            memcpy(&(*spikesByClusterTemp)(1,lowerInsertionIndex - nbSpikesOfCluster),
-                   &(*spikesByCluster)(1,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-
-            nbSpikesInNewCluster += nbSpikesOfCluster;
-            lowerInsertionIndex -= nbSpikesOfCluster;
-
-            //Store the first spike position for the current cluster
-            positions.append(nbSpikesInNewCluster);
-            //Store the number of spikes coming from the current cluster
-            nbOfspikes.append(nbSpikesOfCluster);
-
-            //Take care of the user information about the current cluster
-            if(first){
-                newStructure += iterator.value().getStructure();
-                newType += iterator.value().getType();
-                newID += iterator.value().getId();
-                newQuality += iterator.value().getQuality();
-                newNotes += iterator.value().getNotes();
-
-                first = false;
-            }
-            else{
-                newStructure += "--" + iterator.value().getStructure();
-                newType += "--" + iterator.value().getType();
-                newID += "--" + iterator.value().getId();
-                newQuality += "--" + iterator.value().getQuality();
-                newNotes += "--" + iterator.value().getNotes();
-            }
+            newStructure += "--" + clusterInformation.getStructure();
+            newType += "--" + clusterInformation.getType();
+            newID += "--" + clusterInformation.getId();
+            newQuality += "--" + clusterInformation.getQuality();
+            newNotes += "--" + clusterInformation.getNotes();
         }
     }
 
-    //For the new cluster, only the row index has been inserted in spikesByClusterTemp,
-    //now the cluster number is updated at once for all the spikes of the new cluster
-    for(dataType i = 0; i<nbSpikesInNewCluster;++i) (*spikesByClusterTemp)(2,lowerInsertionIndex + i) = newClusterId;
+    //The spikes of each cluster to group are a run to merge in the new cluster, the clusters are removed from the new state.
+    QVector<const dataType*> runs;
+    QVector<dataType> runSizes;
+    QList<const dataType*> mergedSpikes;
+    for(int i = 0; i < groupedClusters.size(); ++i){
+        dataType clusterId = groupedClusters[i];
+        const QVector<dataType>& clusterSpikes = spikesByCluster->constFind(clusterId).value();
+        runs.append(clusterSpikes.constData());
+        runSizes.append(clusterSpikes.size());
+        if(!clusterSpikes.isEmpty()) mergedSpikes.append(clusterSpikes.constData());
 
-    //Construct the insertion of the new cluster in the new clusterInfoMap
-    clusterInfoMapTemp->insert(newClusterId,ClusterInfo(lowerInsertionIndex,nbSpikesInNewCluster,newStructure,newType,newID,newQuality,newNotes));
+        spikesByClusterTemp->remove(clusterId);
+        clusterInfoMapTemp->remove(clusterId);
+    }
 
-    //Sort the spikes of the newly created cluster.
-    sortCluster(clusterInfoMapTemp,spikesByClusterTemp,newClusterId,positions,nbOfspikes,1);
+    //Merge the spikes of the newly created cluster and insert it in the new state.
+    QVector<dataType> newClusterSpikes(nbSpikesInNewCluster);
+    SpikeMerge::mergeRuns(runs,runSizes,newClusterSpikes.data());
+    spikesByClusterTemp->insert(newClusterId,newClusterSpikes);
+    clusterInfoMapTemp->setNbSpikes(newClusterId,nbSpikesInNewCluster);
+    clusterInfoMapTemp->setClusterInformation(newClusterId,ClusterInfo(newStructure,newType,newID,newQuality,newNotes));
+    combineClusterRanges(newClusterSpikes,mergedSpikes);
 
     //Get the list of clusters before applying the grouping, this will be used in the clean
     //of the correlation.
@@ -1696,18 +1465,6 @@ dataType Data::groupClusters(QList<int>& clustersToGroup){
     //Deal with the undo mechanism
     prepareUndo(spikesByClusterTemp,clusterInfoMapTemp);
 
-    //If the clusters to group contain the cluster 0, the max and min
-    // dimensions have to be recalculated.
-    if(clustersToGroup.contains(0)){
-        //If the minMaxThread has not finish, wait until it is done
-        while(!minMaxThread->wait()){};
-        //Reset the flag to false so the minMaxThread can do the computation
-        clusterZeroJustModified = false;
-        minMaxThread->setModifiedClusters(clustersToGroup);
-        minMaxThread->start();
-        dimensionChangedUndo.prepend(true);
-    }
-    else dimensionChangedUndo.prepend(false);
 
     //Remove the waveform and correlation data for the clusters which gave the spikes for the new cluster.
     //if there is not a thread working with them, otherwise advice the thread of the change,by updating waveformStatus and correlationsInProcess
@@ -1718,7 +1475,7 @@ dataType Data::groupClusters(QList<int>& clustersToGroup){
         mutex.lock();
         if(waveformStatusMap.contains(*clustersToGroupIterator)){
             if(!waveformStatusMap[*clustersToGroupIterator].isInProcess()){
-                delete waveformDict.take(QString::fromLatin1("%1").arg(*clustersToGroupIterator));
+                delete waveformCache.take(*clustersToGroupIterator);
                 waveformStatusMap.remove(*clustersToGroupIterator);
             }
             else{
@@ -1742,130 +1499,307 @@ dataType Data::groupClusters(QList<int>& clustersToGroup){
 }
 
 
-void Data::prepareUndo(SortableTable* spikesByClusterTemp,ClusterInfoMap* clusterInfoMapTemp){
-    //Store the current spikesByCluster in the undo list and make the temporary becomes the current one.
-    spikesByClusterUndoList.prepend(spikesByCluster);
-    //Store the current map in the undo list and make the temporary become the current one.
-    clusterInfoMapUndoList.prepend(clusterInfoMap);
+void Data::prepareUndo(SpikesByClusterMap* spikesByClusterTemp,ClusterInfoMap* clusterInfoMapTemp,const QMap<int,int>& clusterIdsOldNew){
+    //Store the difference with the current spikesByCluster and map in the undo list and make the temporary ones become the current ones.
+    //The delta takes the ownership of the current map, the current spikesByCluster is not needed anymore.
+    undoList.prepend(createDelta(spikesByClusterTemp,clusterInfoMapTemp,clusterIdsOldNew));
 
+    SpikesByClusterMap* previousSpikesByCluster = spikesByCluster;
     mutex.lock();
     clusterInfoMap = clusterInfoMapTemp;
     spikesByCluster = spikesByClusterTemp;
+    publishSnapshot();
     mutex.unlock();
+    delete previousSpikesByCluster;
 
-    //if the number of undo has been reach remove the last element in the undo list (first inserted)
-    int currentSpikesByClusterNbUndo = spikesByClusterUndoList.count();
-    if(currentSpikesByClusterNbUndo > nbUndo)
-        delete spikesByClusterUndoList.takeAt(currentSpikesByClusterNbUndo - 1);
+    //Only the ranges of the clusters which have changed are computed, so the minimum and maximum of the dimensions are kept up to date at each change.
+    minMaxDimensionCalculation();
 
     //if the number of undo has been reach remove the last element in the undo list (first inserted)
-    int currentClusterInfoNbUndo = clusterInfoMapUndoList.count();
-    if(currentClusterInfoNbUndo > nbUndo)
-        delete clusterInfoMapUndoList.takeAt(currentClusterInfoNbUndo - 1);
+    int currentNbUndo = undoList.count();
+    if(currentNbUndo > nbUndo)
+        delete undoList.takeAt(currentNbUndo - 1);
+
+    //Clear the redoList
+    qDeleteAll(redoList);
+    redoList.clear();
+}
+
+Data::ClusteringDelta* Data::createDelta(SpikesByClusterMap* spikesByClusterTemp,ClusterInfoMap* clusterInfoMapTemp,const QMap<int,int>& clusterIdsOldNew){
+    ClusteringDelta* delta = new ClusteringDelta();
+    delta->clusterInfoMap = clusterInfoMap;
+    delta->currentIds = clusterIdsOldNew;
+
+    //Id in the current distribution of each cluster of the new one.
+    QMap<dataType,dataType> oldIds;
+    QMap<int,int>::const_iterator renumbered;
+    for(renumbered = clusterIdsOldNew.constBegin(); renumbered != clusterIdsOldNew.constEnd(); ++renumbered)
+        oldIds.insert(static_cast<dataType>(renumbered.value()),static_cast<dataType>(renumbered.key()));
+
+    //Marks the spikes of a cluster while looking for the spikes of the other version of the cluster which are not in it.
+    QBitArray marks(static_cast<int>(nbSpikes + 1));
+
+    //The clusters of the current distribution (the one restored by the delta) and the ones of the new distribution
+    //which do not exist in the current one.
+    QList<dataType> clusters = clusterInfoMap->keys();
+    ClusterInfoMap::ConstIterator iterator;
+    for(iterator = clusterInfoMapTemp->constBegin(); iterator != clusterInfoMapTemp->constEnd(); ++iterator){
+        dataType oldId = oldIds.value(iterator.key(),iterator.key());
+        if(!clusterInfoMap->contains(oldId)) clusters.append(iterator.key());
+    }
+
+    for(int i = 0; i < clusters.size(); ++i){
+        dataType clusterId = clusters[i];
+        dataType currentId = clusterId;
+        if(clusterInfoMap->contains(clusterId))
+            currentId = static_cast<dataType>(clusterIdsOldNew.value(static_cast<int>(clusterId),static_cast<int>(clusterId)));
+        const QVector<dataType> oldVector = spikesByCluster->value(clusterId);
+        const QVector<dataType> newVector = spikesByClusterTemp->value(currentId);
+
+        //Unchanged cluster, the comparison is immediate if the spikes are still shared.
+        if(oldVector == newVector) continue;
+
+        const dataType* oldSpikes = oldVector.constData();
+        dataType nbOldSpikes = oldVector.size();
+        const dataType* newSpikes = newVector.constData();
+        dataType nbNewSpikes = newVector.size();
+
+        //The delta is applied to the new distribution: the spikes removed are the ones of the new cluster which are not in the old one
+        //and the spikes added the ones of the old cluster which are not in the new one. Each of them takes a position and a spike,
+        //so as soon as they are not fewer than half the old spikes, the old vector, shared with the current distribution, is kept instead.
+        ClusteringDelta::ClusterChange change;
+        bool smaller = true;
+        for(dataType j = 0; j < nbOldSpikes; ++j) marks.setBit(static_cast<int>(oldSpikes[j]));
+        for(dataType j = 0; j < nbNewSpikes; ++j){
+            if(!marks.testBit(static_cast<int>(newSpikes[j]))){
+                if(2 * (change.removedPositions.size() + 1) >= nbOldSpikes){
+                    smaller = false;
+                    break;
+                }
+                change.removedPositions.append(j);
+                change.removedSpikes.append(newSpikes[j]);
+            }
+        }
+        for(dataType j = 0; j < nbOldSpikes; ++j) marks.clearBit(static_cast<int>(oldSpikes[j]));
+
+        //The spikes common to both versions have to be in the same order, otherwise the old vector is kept.
+        bool sameOrder = true;
+        if(smaller){
+            for(dataType j = 0; j < nbNewSpikes; ++j) marks.setBit(static_cast<int>(newSpikes[j]));
+            dataType newIndex = 0;
+            int removedIndex = 0;
+            for(dataType j = 0; j < nbOldSpikes && sameOrder; ++j){
+                if(!marks.testBit(static_cast<int>(oldSpikes[j]))){
+                    if(2 * (change.removedPositions.size() + change.addedPositions.size() + 1) >= nbOldSpikes){
+                        smaller = false;
+                        break;
+                    }
+                    change.addedPositions.append(j);
+                    change.addedSpikes.append(oldSpikes[j]);
+                }
+                else{
+                    while(removedIndex < change.removedPositions.size() && change.removedPositions[removedIndex] == newIndex){
+                        ++removedIndex;
+                        ++newIndex;
+                    }
+                    if(newSpikes[newIndex++] != oldSpikes[j]) sameOrder = false;
+                }
+            }
+            for(dataType j = 0; j < nbNewSpikes; ++j) marks.clearBit(static_cast<int>(newSpikes[j]));
+        }
+
+        if(!smaller || !sameOrder){
+            change = ClusteringDelta::ClusterChange();
+            change.replaced = true;
+            change.spikes = oldVector;
+        }
+        //The ranges of the cluster are kept with the delta so they are not computed again when it is applied.
+        if(!oldVector.isEmpty()){
+            rangesMutex.lock();
+            QHash<const dataType*,ClusterRanges>::ConstIterator cachedRanges = clusterRangesCache.constFind(oldSpikes);
+            if(cachedRanges != clusterRangesCache.constEnd()){
+                change.ranges.minima = cachedRanges.value().minima;
+                change.ranges.maxima = cachedRanges.value().maxima;
+                change.ranges.complete = cachedRanges.value().complete;
+            }
+            rangesMutex.unlock();
+        }
+        delta->changes.insert(clusterId,change);
+    }
+
+    return delta;
+}
+
+void Data::applyDelta(ClusteringDelta* delta){
+    SpikesByClusterMap* spikesByClusterTemp = new SpikesByClusterMap();
+    ClusterInfoMap* clusterInfoMapTemp = delta->clusterInfoMap;
+    rangesMutex.lock();
+
+    //Rebuild each cluster of the other state, sharing its spikes with the current state if it has not been modified.
+    ClusterInfoMap::ConstIterator iterator;
+    for(iterator = clusterInfoMapTemp->constBegin(); iterator != clusterInfoMapTemp->constEnd(); ++iterator){
+        dataType clusterId = iterator.key();
+        dataType currentId = static_cast<dataType>(delta->currentIds.value(static_cast<int>(clusterId),static_cast<int>(clusterId)));
+        const QVector<dataType> currentVector = spikesByCluster->value(currentId);
+
+        if(!delta->changes.contains(clusterId)) spikesByClusterTemp->insert(clusterId,currentVector);
+        else if(delta->changes[clusterId].replaced) spikesByClusterTemp->insert(clusterId,delta->changes[clusterId].spikes);
+        else{
+            dataType nbSpikesOfCluster = iterator.nbSpikes();
+            QVector<dataType> clusterSpikes(static_cast<int>(nbSpikesOfCluster));
+            dataType* spikes = clusterSpikes.data();
+            const dataType* currentSpikes = currentVector.constData();
+            const ClusteringDelta::ClusterChange& change = delta->changes[clusterId];
+            dataType currentIndex = 0;
+            int removedIndex = 0;
+            int addedIndex = 0;
+            for(dataType i = 0; i < nbSpikesOfCluster; ++i){
+                if(addedIndex < change.addedPositions.size() && change.addedPositions[addedIndex] == i){
+                    spikes[i] = change.addedSpikes[addedIndex];
+                    ++addedIndex;
+                }
+                else{
+                    while(removedIndex < change.removedPositions.size() && change.removedPositions[removedIndex] == currentIndex){
+                        ++removedIndex;
+                        ++currentIndex;
+                    }
+                    spikes[i] = currentSpikes[currentIndex++];
+                }
+            }
+            spikesByClusterTemp->insert(clusterId,clusterSpikes);
+        }
+
+        //The ranges kept with the delta become the ones of the rebuilt cluster.
+        if(delta->changes.contains(clusterId) && !delta->changes[clusterId].ranges.minima.isEmpty()){
+            const QVector<dataType> clusterSpikes = spikesByClusterTemp->value(clusterId);
+            if(!clusterSpikes.isEmpty()){
+                ClusterRanges ranges = delta->changes[clusterId].ranges;
+                ranges.spikes = clusterSpikes;
+                clusterRangesCache.insert(clusterSpikes.constData(),ranges);
+            }
+        }
+    }
+
+    //Turn the delta in the one getting back the current state.
+    QMap<int,int> otherIds;
+    QMap<int,int>::const_iterator renumbered;
+    for(renumbered = delta->currentIds.constBegin(); renumbered != delta->currentIds.constEnd(); ++renumbered)
+        otherIds.insert(renumbered.value(),renumbered.key());
+    QMap<dataType,ClusteringDelta::ClusterChange> changes;
+    QMap<dataType,ClusteringDelta::ClusterChange>::const_iterator changeIterator;
+    for(changeIterator = delta->changes.constBegin(); changeIterator != delta->changes.constEnd(); ++changeIterator){
+        dataType clusterId = changeIterator.key();
+        if(clusterInfoMapTemp->contains(clusterId))
+            clusterId = static_cast<dataType>(delta->currentIds.value(static_cast<int>(clusterId),static_cast<int>(clusterId)));
+        ClusteringDelta::ClusterChange& change = changes[clusterId];
+        const QVector<dataType> currentVector = spikesByCluster->value(clusterId);
+        QHash<const dataType*,ClusterRanges>::ConstIterator cachedRanges = clusterRangesCache.constFind(currentVector.constData());
+        if(!currentVector.isEmpty() && cachedRanges != clusterRangesCache.constEnd()){
+            change.ranges.minima = cachedRanges.value().minima;
+            change.ranges.maxima = cachedRanges.value().maxima;
+            change.ranges.complete = cachedRanges.value().complete;
+        }
+        //The spikes left by a replaced cluster are the ones of its current version, which become shared with the delta.
+        if(changeIterator.value().replaced){
+            change.replaced = true;
+            change.spikes = currentVector;
+            continue;
+        }
+        change.removedPositions = changeIterator.value().addedPositions;
+        change.removedSpikes = changeIterator.value().addedSpikes;
+        change.addedPositions = changeIterator.value().removedPositions;
+        change.addedSpikes = changeIterator.value().removedSpikes;
+    }
+    delta->changes = changes;
+    delta->currentIds = otherIds;
+    delta->clusterInfoMap = clusterInfoMap;
+    rangesMutex.unlock();
+
+    SpikesByClusterMap* previousSpikesByCluster = spikesByCluster;
+    mutex.lock();
+    clusterInfoMap = clusterInfoMapTemp;
+    spikesByCluster = spikesByClusterTemp;
+    publishSnapshot();
+    mutex.unlock();
+    delete previousSpikesByCluster;
 
-    //Clear the redoLists
-    qDeleteAll(spikesByClusterRedoList);
-    spikesByClusterRedoList.clear();
-    qDeleteAll(clusterInfoMapRedoList);
-    clusterInfoMapRedoList.clear();
+    //Only the ranges of the clusters which have changed are computed, so the minimum and maximum of the dimensions are kept up to date at each change.
+    minMaxDimensionCalculation();
 }
 
 void Data::nbUndoChangedCleaning(int newNbUndo){
     //if the new number of possible undo is smaller than the current one,
     // clean the undo/redo related variables.
     if(newNbUndo < nbUndo){
-        int currentNbUndo = spikesByClusterUndoList.count();
+        int currentNbUndo = undoList.count();
         //if the current number of undo is bigger than the new number of undo,
-        // remove the last elements in the undo lists (first ones inserted).
+        // remove the last elements in the undo list (first ones inserted).
         if(currentNbUndo > newNbUndo){
             while(currentNbUndo > newNbUndo){
-                delete spikesByClusterUndoList.takeAt(currentNbUndo - 1);
-                delete clusterInfoMapUndoList.takeAt(currentNbUndo - 1);
-                currentNbUndo = spikesByClusterUndoList.count();
+                delete undoList.takeAt(currentNbUndo - 1);
+                currentNbUndo = undoList.count();
             }
-            //Clear the redoLists
-            qDeleteAll(spikesByClusterRedoList);
-            spikesByClusterRedoList.clear();
-            qDeleteAll(clusterInfoMapRedoList);
-            clusterInfoMapRedoList.clear();
+            //Clear the redoList
+            qDeleteAll(redoList);
+            redoList.clear();
         }
         //currentNbUndo < newNbUndo, check the redo list.
         else{
             //number of undo and redo must be <= new number of undo. Remove redo elements if need it.
-            int currentNbRedo = spikesByClusterRedoList.count();
+            int currentNbRedo = redoList.count();
             if((currentNbRedo + currentNbUndo) > newNbUndo){
                 while((currentNbRedo + currentNbUndo) > newNbUndo){
-                    delete clusterInfoMapRedoList.takeAt(currentNbRedo - 1);
-                    delete spikesByClusterRedoList.takeAt(currentNbRedo - 1);
-                    currentNbRedo = spikesByClusterRedoList.count();
+                    delete redoList.takeAt(currentNbRedo - 1);
+                    currentNbRedo = redoList.count();
                 }
             }
         }
     }
 }
 
-void Data::moveClusters(QList<int>& clustersToDelete,SortableTable* spikesByClusterTemp,ClusterInfoMap* clusterInfoMapTemp,long upperInsertionIndex,long& nbSpikesInNewCluster,int destinationId,QList<long>& positions,QList<long>& nbOfspikes){
-
-    //For all the clusters to delete, copy the first row of spikesByCluster into spikesByClusterTemp
-    //right after the data coming from the current cluster destination (0 or 1)
-    QList<int>::iterator clustersToDeleteIterator;
-    for(clustersToDeleteIterator = clustersToDelete.begin(); clustersToDeleteIterator != clustersToDelete.end(); ++clustersToDeleteIterator ){
+void Data::moveClusters(QList<int>& clustersToDelete,SpikesByClusterMap* spikesByClusterTemp,ClusterInfoMap* clusterInfoMapTemp,int destinationId){
+    //The spikes of the current cluster destination (0 or 1) and of each cluster to delete are the runs to merge
+    //in the new destination cluster.
+    const QVector<dataType> destinationSpikes = spikesByCluster->value(destinationId);
+    QVector<const dataType*> runs;
+    QVector<dataType> runSizes;
+    QList<const dataType*> mergedSpikes;
+    runs.append(destinationSpikes.constData());
+    runSizes.append(destinationSpikes.size());
+    if(!destinationSpikes.isEmpty()) mergedSpikes.append(destinationSpikes.constData());
+    dataType nbSpikesInNewCluster = destinationSpikes.size();
+
+    //Add the spikes of each cluster to delete and remove it from the new state.
+    QList<int>::const_iterator clustersToDeleteIterator;
+    for(clustersToDeleteIterator = clustersToDelete.constBegin(); clustersToDeleteIterator != clustersToDelete.constEnd(); ++clustersToDeleteIterator){
         dataType clusterId = static_cast<dataType>(*clustersToDeleteIterator);
-        if(clusterId == destinationId) continue;
-        ClusterInfo currentClusterInfo = (*clusterInfoMap)[clusterId];
-        dataType firstSpikePosition = currentClusterInfo.firstSpikePosition();
-        dataType nbSpikesOfCluster = currentClusterInfo.nbSpikes();
-
-        memcpy(&(*spikesByClusterTemp)(1,upperInsertionIndex),
-               &(*spikesByCluster)(1,firstSpikePosition),
-               nbSpikesOfCluster * sizeof(dataType));
-
-        //Store the first spike position for the current cluster
-        positions.append(nbSpikesInNewCluster + 1);
-        //Store the number of spikes coming from the current cluster
-        nbOfspikes.append(nbSpikesOfCluster);
-
-        upperInsertionIndex += nbSpikesOfCluster;
-        nbSpikesInNewCluster += nbSpikesOfCluster;
-    }
-
-    //Copy the 2 rows for all the other clusters
-    //Iteration on the clusters starting with the cluster following cluster 1
-    ClusterInfoMap::Iterator iterator;
-
-    //NB: the iterator iterates on the items sorted by their key
-    for(iterator = clusterInfoMap->begin(); iterator != clusterInfoMap->end(); ++iterator){
-        dataType clusterId = iterator.key();
-        if(clusterId <= destinationId) continue;
-        if(!clustersToDelete.contains(static_cast<int>(clusterId))){
-            dataType firstSpikePosition = iterator.value().firstSpikePosition();
-            dataType nbSpikesOfCluster = iterator.value().nbSpikes();
-
-            memcpy(&(*spikesByClusterTemp)(1,upperInsertionIndex),
-                   &(*spikesByCluster)(1,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            memcpy(&(*spikesByClusterTemp)(2,upperInsertionIndex),
-                   &(*spikesByCluster)(2,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-
-            //Construct the new clusterInfoMap
-            clusterInfoMapTemp->insert(clusterId,ClusterInfo(upperInsertionIndex,nbSpikesOfCluster,iterator.value().getStructure(),iterator.value().getType(),iterator.value().getId(),iterator.value().getQuality(),iterator.value().getNotes()));
-            upperInsertionIndex += nbSpikesOfCluster;
-        }
-    }
+        if(clusterId == destinationId || !spikesByCluster->contains(clusterId)) continue;
+        const QVector<dataType>& clusterSpikes = spikesByCluster->constFind(clusterId).value();
+        runs.append(clusterSpikes.constData());
+        runSizes.append(clusterSpikes.size());
+        if(!clusterSpikes.isEmpty()) mergedSpikes.append(clusterSpikes.constData());
+        nbSpikesInNewCluster += clusterSpikes.size();
+
+        spikesByClusterTemp->remove(clusterId);
+        clusterInfoMapTemp->remove(clusterId);
+    }
+
+    //Merge the spikes of the new destination cluster and insert it in the new state, even if it is empty.
+    QVector<dataType> newClusterSpikes(nbSpikesInNewCluster);
+    SpikeMerge::mergeRuns(runs,runSizes,newClusterSpikes.data());
+    spikesByClusterTemp->insert(destinationId,newClusterSpikes);
+    if(destinationId != 0) combineClusterRanges(newClusterSpikes,mergedSpikes);
+    clusterInfoMapTemp->setNbSpikes(destinationId,nbSpikesInNewCluster);
 }
 
 void Data::undo(QList<int>& addedClusters,QList<int>& updatedClusters){
-    //Inform that an undo is in process
-    undoRedoInProcess = true;
-
     qDebug()<<"in Data::undo 1";
 
     //Get the list of clusters before applying the changes, this will be used in the clean
     //of the correlation.
     QList<dataType> currentClusterList = clusterIds();
 
-    //If addedClusters or updatedClusters contain any cluster, remove the corresponding entry in waveformDict and correlationDict
+    //If addedClusters or updatedClusters contain any cluster, remove the corresponding entry in waveformCache and correlationDict
     //(the data will have to be uploaded again) if there is not a thread working with it,
     //otherwise advice the thread of the change,by updating waveformStatus and correlationsInProcess
     // and the thread will remove it.
@@ -1877,7 +1811,7 @@ void Data::undo(QList<int>& addedClusters,QList<int>& updatedClusters){
             mutex.lock();
             if(waveformStatusMap.contains(*clustersToRemoveIterator)){
                 if(!waveformStatusMap[*clustersToRemoveIterator].isInProcess()){
-                    delete waveformDict.take(QString::fromLatin1("%1").arg(*clustersToRemoveIterator));
+                    delete waveformCache.take(*clustersToRemoveIterator);
                     waveformStatusMap.remove(*clustersToRemoveIterator);
                 }
                 else{
@@ -1909,7 +1843,7 @@ void Data::undo(QList<int>& addedClusters,QList<int>& updatedClusters){
             mutex.lock();
             if(waveformStatusMap.contains(*clustersToRemoveIterator)){
                 if(!waveformStatusMap[*clustersToRemoveIterator].isInProcess()){
-                    delete waveformDict.take(QString::fromLatin1("%1").arg(*clustersToRemoveIterator));
+                    delete waveformCache.take(*clustersToRemoveIterator);
                     waveformStatusMap.remove(*clustersToRemoveIterator);
                 }
                 else{
@@ -1946,7 +1880,7 @@ void Data::undo(QList<int>& addedClusters,QList<int>& updatedClusters){
             mutex.lock();
             if(waveformStatusMap.contains(static_cast<int>(*iterator))){
                 if(!waveformStatusMap[static_cast<int>(*iterator)].isInProcess()){
-                    delete waveformDict.take(QString::fromLatin1("%1").arg(*iterator));
+                    delete waveformCache.take(static_cast<int>(*iterator));
                     waveformStatusMap.remove(static_cast<int>(*iterator));
                 }
                 else{
@@ -1966,58 +1900,25 @@ void Data::undo(QList<int>& addedClusters,QList<int>& updatedClusters){
         }
     }
 
-    //If clusterInfoMapUndoList is not empty, make the current clusterInfoMap become the first element
-    //of the clusterInfoMapRedoList and the first element of the clusterInfoMapUndoList become the current clusterInfoMap.
-    //Do the same with the spikesByCluster
-    if(!clusterInfoMapUndoList.isEmpty()){
-
-        clusterInfoMapRedoList.prepend(clusterInfoMap);
-        ClusterInfoMap* clusterInfoMapTemp = clusterInfoMapUndoList.takeAt(0);
-        spikesByClusterRedoList.prepend(spikesByCluster);
-        SortableTable* spikesByClusterTemp = spikesByClusterUndoList.takeAt(0);
-
-        mutex.lock();
-        clusterInfoMap =  clusterInfoMapTemp;
-
-        qDebug()<<"in Data::undo 2, clusterInfoMap updated";
-
-        spikesByCluster =  spikesByClusterTemp;
-
-        mutex.unlock();
-
-        qDebug()<<"in Data::undo 3, spikesByCluster updated";
-
-        //If the last action implied a changed of the dimension, change the dimension again
-        if(!dimensionChangedUndo.isEmpty() && dimensionChangedUndo.at(0) == true){
-
+    //If undoList is not empty, apply its first element to get back the previous clusterInfoMap and spikesByCluster,
+    //the delta becomes the one getting back the current state and is moved to the redoList.
+    if(!undoList.isEmpty()){
+        ClusteringDelta* delta = undoList.takeAt(0);
+        applyDelta(delta);
+        redoList.prepend(delta);
 
-            qDebug()<<"in Data::undo dimensionChangedUndo[0] == true";
-
-
-            //If the minMaxThread has not finish, wait until it is done
-            while(!minMaxThread->wait()){};
-
-            //Reset the flag to false so the minMaxThread can do the computation
-            undoRedoInProcess = false;
-            QList<int> modifiedClusters;
-            minMaxThread->setModifiedClusters(modifiedClusters);
-            minMaxThread->start();
-            dimensionChangedRedo.prepend(true);
-        }
+        qDebug()<<"in Data::undo 2, clusterInfoMap and spikesByCluster updated";
     }
     qDebug()<<"in Data::undo end";
 }
 
 
 void Data::redo(QList<int>& addedClusters,QList<int>& updatedClusters,QList<int>& deletedClusters){
-    //Inform that a redo is in process
-    undoRedoInProcess = true;
-
     //Get the list of clusters before applying the changes, this will be used in the clean
     //of the correlation.
     QList<dataType> currentClusterList = clusterIds();
 
-    //If addedClusters or updatedClusters contain any cluster, remove the corresponding entry in waveformDict and correlationDict
+    //If addedClusters or updatedClusters contain any cluster, remove the corresponding entry in waveformCache and correlationDict
     //(the data will have to be uploaded again).
     if(!addedClusters.isEmpty() ){
         QList<int>::iterator clustersToRemoveIterator;
@@ -2025,7 +1926,7 @@ void Data::redo(QList<int>& addedClusters,QList<int>& updatedClusters,QList<int>
             mutex.lock();
             if(waveformStatusMap.contains(*clustersToRemoveIterator)){
                 if(!waveformStatusMap[*clustersToRemoveIterator].isInProcess()){
-                    delete waveformDict.take(QString::fromLatin1("%1").arg(*clustersToRemoveIterator));
+                    delete waveformCache.take(*clustersToRemoveIterator);
                     waveformStatusMap.remove(*clustersToRemoveIterator);
                 }
                 else{
@@ -2051,7 +1952,7 @@ void Data::redo(QList<int>& addedClusters,QList<int>& updatedClusters,QList<int>
             mutex.lock();
             if(waveformStatusMap.contains(*clustersToRemoveIterator)){
                 if(!waveformStatusMap[*clustersToRemoveIterator].isInProcess()){
-                    delete waveformDict.take(QString::fromLatin1("%1").arg(*clustersToRemoveIterator));
+                    delete waveformCache.take(*clustersToRemoveIterator);
                     waveformStatusMap.remove(*clustersToRemoveIterator);
                 }
                 else{
@@ -2077,7 +1978,7 @@ void Data::redo(QList<int>& addedClusters,QList<int>& updatedClusters,QList<int>
             mutex.lock();
             if(waveformStatusMap.contains(*clustersToRemoveIterator)){
                 if(!waveformStatusMap[*clustersToRemoveIterator].isInProcess()){
-                    delete waveformDict.take(QString::fromLatin1("%1").arg(*clustersToRemoveIterator));
+                    delete waveformCache.take(*clustersToRemoveIterator);
                     waveformStatusMap.remove(*clustersToRemoveIterator);
                 }
                 else{
@@ -2111,7 +2012,7 @@ void Data::redo(QList<int>& addedClusters,QList<int>& updatedClusters,QList<int>
             mutex.lock();
             if(waveformStatusMap.contains(static_cast<int>(*iterator))){
                 if(!waveformStatusMap[static_cast<int>(*iterator)].isInProcess()){
-                    delete waveformDict.take(QString::fromLatin1("%1").arg(*iterator));
+                    delete waveformCache.take(static_cast<int>(*iterator));
                     waveformStatusMap.remove(static_cast<int>(*iterator));
                 }
                 else{
@@ -2131,101 +2032,46 @@ void Data::redo(QList<int>& addedClusters,QList<int>& updatedClusters,QList<int>
         }
     }
 
-    //If clusterInfoMapRedoList is not empty, make the current clusterInfoMap become the first element
-    //of the clusterInfoMapUndoList and the first element of the clusterInfoMapRedoList become the current clusterInfoMap.
-    //Do the same with the spikesByCluster
-    if(!clusterInfoMapRedoList.isEmpty()){
-        clusterInfoMapUndoList.prepend(clusterInfoMap);
-        ClusterInfoMap* clusterInfoMapTemp = clusterInfoMapRedoList.takeAt(0);
-        spikesByClusterUndoList.prepend(spikesByCluster);
-        SortableTable* spikesByClusterTemp = spikesByClusterRedoList.takeAt(0);
-
-        mutex.lock();
-        clusterInfoMap =  clusterInfoMapTemp;
-        spikesByCluster =  spikesByClusterTemp;
-        mutex.unlock();
-
-        //If the last redo implied a changed of the dimension, change the dimension again
-        if(!dimensionChangedRedo.isEmpty() && dimensionChangedRedo.at(0) == true){
-            //If the minMaxThread has not finish, wait until it is done
-            while(!minMaxThread->wait()){};
-
-            //Reset the flag to false so the minMaxThread can do the computation
-            undoRedoInProcess = false;
-            QList<int> modifiedClusters;
-            minMaxThread->setModifiedClusters(modifiedClusters);
-            minMaxThread->start();
-            dimensionChangedUndo.prepend(true);
-        }
+    //If redoList is not empty, apply its first element to get back the next clusterInfoMap and spikesByCluster,
+    //the delta becomes the one getting back the current state and is moved to the undoList.
+    if(!redoList.isEmpty()){
+        ClusteringDelta* delta = redoList.takeAt(0);
+        applyDelta(delta);
+        undoList.prepend(delta);
     }
 }
 
 void Data::renumber(QMap<int,int>& clusterIdsOldNew,QMap<int,int>& clusterIdsNewOld){
-    //The new information about the cluster will be inserted in the table pointed by spikesByClusterTemp
-    SortableTable* spikesByClusterTemp = new SortableTable();
-    spikesByClusterTemp->setSize(nbSpikes);
-
-    //Create a new map which will contain the new information about the position of the clusters
+    //The new state shares the spikes of every cluster with the current one, only the keys change.
+    SpikesByClusterMap* spikesByClusterTemp = new SpikesByClusterMap();
     ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap();
 
-    //process the clusters 0 and 1 separately as, if they exist, they are never renumber.
-    for(int i = 0; i < 2; ++i){
-        if(clusterInfoMap->contains(i)){
-            ClusterInfo currentClusterInfo = (*clusterInfoMap)[i];
-            dataType nbSpikesOfCluster = currentClusterInfo.nbSpikes();
-            dataType firstSpikePosition = currentClusterInfo.firstSpikePosition();
-
-            //copy the 2 rows of spikesByCluster for the given cluster
-            memcpy(&(*spikesByClusterTemp)(1,firstSpikePosition),
-                   &(*spikesByCluster)(1,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            memcpy(&(*spikesByClusterTemp)(2,firstSpikePosition),
-                   &(*spikesByCluster)(2,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-
-            //Construct the new clusterInfoMap
-            clusterInfoMapTemp->insert(i,ClusterInfo(firstSpikePosition,nbSpikesOfCluster));
-            clusterIdsOldNew.insert(i,i);
-            clusterIdsNewOld.insert(i,i);
-        }
-    }
-
     //Iteration on the clusters
-    ClusterInfoMap::Iterator iterator;
+    ClusterInfoMap::ConstIterator iterator;
     int clusterNumber = 2;
 
     //NB: the iterator iterates on the items sorted by their key
-    for(iterator = clusterInfoMap->begin(); iterator != clusterInfoMap->end(); ++iterator) {
-        dataType firstSpikePosition = iterator.value().firstSpikePosition();
-        dataType nbSpikesOfCluster = iterator.value().nbSpikes();
+    for(iterator = clusterInfoMap->constBegin(); iterator != clusterInfoMap->constEnd(); ++iterator) {
         dataType clusterId = iterator.key();
-
-        //The clusters 0 and 1 have been processed separately before
-        if(clusterId == 0 || clusterId == 1) continue;
-
-        //Insert into spikesByClusterTemp and clusterInfoMapTemp with the new number
-
-        //copy the first row of spikesByCluster for the given cluster
-        memcpy(&(*spikesByClusterTemp)(1,firstSpikePosition),
-               &(*spikesByCluster)(1,firstSpikePosition),
-               nbSpikesOfCluster * sizeof(dataType));
-
-        if(clusterId == clusterNumber){
-            //copy the second row as it is
-            memcpy(&(*spikesByClusterTemp)(2,firstSpikePosition),
-                   &(*spikesByCluster)(2,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
+        const QVector<dataType> clusterSpikes = spikesByCluster->value(clusterId);
+
+        //The clusters 0 and 1, if they exist, are never renumber.
+        if(clusterId == 0 || clusterId == 1){
+            spikesByClusterTemp->insert(clusterId,clusterSpikes);
+            clusterInfoMapTemp->setNbSpikes(clusterId,iterator.nbSpikes());
+            clusterInfoMapTemp->setClusterInformation(clusterId,clusterInfoMap->clusterInformation(clusterId));
+            clusterIdsOldNew.insert(static_cast<int>(clusterId),static_cast<int>(clusterId));
+            clusterIdsNewOld.insert(static_cast<int>(clusterId),static_cast<int>(clusterId));
+            continue;
         }
-        //renumber
-        else{
-            //Insert the new cluster id in the second row.
-            for(long i = 0; i<nbSpikesOfCluster;++i) (*spikesByClusterTemp)(2,firstSpikePosition + i) = clusterNumber;
-            //If waveformDict or correlationDict contain that cluster, change the key for it.
+
+        if(clusterId != clusterNumber){
+            //If waveformCache or correlationDict contain that cluster, change the key for it.
             mutex.lock();
             if(waveformStatusMap.contains(static_cast<int>(clusterId))){
                 if(!waveformStatusMap[static_cast<int>(clusterId)].isInProcess()){
-                    Waveforms* waveforms = waveformDict.take(QString::fromLatin1("%1").arg(clusterId));
-                    waveformDict.insert(QString::fromLatin1("%1").arg(clusterNumber),waveforms);
+                    Waveforms* waveforms = waveformCache.take(static_cast<int>(clusterId));
+                    waveformCache.insert(clusterNumber,waveforms);
                     WaveformStatus waveformStatus = waveformStatusMap[static_cast<int>(clusterId)];
                     waveformStatusMap.insert(clusterNumber,waveformStatus);
                     waveformStatusMap.remove(static_cast<int>(clusterId));
@@ -2239,8 +2085,10 @@ void Data::renumber(QMap<int,int>& clusterIdsOldNew,QMap<int,int>& clusterIdsNew
             }
             mutex.unlock();
         }
-        //Construct the new clusterInfoMap
-        clusterInfoMapTemp->insert(clusterNumber,ClusterInfo(firstSpikePosition,nbSpikesOfCluster,iterator.value().getStructure(),iterator.value().getType(),iterator.value().getId(),iterator.value().getQuality(),iterator.value().getNotes()));
+        //Insert into spikesByClusterTemp and clusterInfoMapTemp with the new number
+        spikesByClusterTemp->insert(clusterNumber,clusterSpikes);
+        clusterInfoMapTemp->setNbSpikes(clusterNumber,iterator.nbSpikes());
+        clusterInfoMapTemp->setClusterInformation(clusterNumber,clusterInfoMap->clusterInformation(clusterId));
         clusterIdsOldNew.insert(static_cast<int>(clusterId),clusterNumber);
         clusterIdsNewOld.insert(clusterNumber,static_cast<int>(clusterId));
 
@@ -2252,7 +2100,7 @@ void Data::renumber(QMap<int,int>& clusterIdsOldNew,QMap<int,int>& clusterIdsNew
     renumberCorrelation(clusterIdsOldNew);
 
     //Deal with the undo mechanism
-    prepareUndo(spikesByClusterTemp,clusterInfoMapTemp);
+    prepareUndo(spikesByClusterTemp,clusterInfoMapTemp,clusterIdsOldNew);
 }
 
 bool Data::saveClusters(FILE* clusterFile){
@@ -2260,97 +2108,41 @@ bool Data::saveClusters(FILE* clusterFile){
 
     int writeStatus = 0;
 
-    //Sort spikesByCluster by spikes order
+    //The clusters are read in the last published version, which does not change while the file is written.
+    const ClusteringSnapshot clusters = snapshot();
+    const SpikesByClusterMap& spikesByClusterTemp = clusters.spikesByCluster();
 
-    //The mutex protects spikesByCluster and clusterInfoMap so that only one thread can
-    //access them at the time.
-    ClusterInfoMap clusterInfoMapTemp;
-    ClusterInfoMap::Iterator it;
-    mutex.lock();
-    SortableTable spikesByClusterTemp(*spikesByCluster);
-
-    bool overLimit = false;
-    for(it = clusterInfoMap->begin(); it != clusterInfoMap->end(); ++it){
-        clusterInfoMapTemp.insert(it.key(),it.value());
-        if(it.value().nbSpikes() > 250000) overLimit = true;
-    }
-    mutex.unlock();
-
-    int nbClusters = clusterInfoMapTemp.count();
+    int nbClusters = spikesByClusterTemp.count();
 
     //first line of the file contains the number of clusters
     writeStatus = fprintf(clusterFile, "%i\n",nbClusters);
 
-    //first method
-    if(nbClusters > 12 && !overLimit){
-        spikesByClusterTemp.sort(1);
-
-        //Store all the clusterIds in spikes order
-        for(long i = 1; i <= nbSpikes ; ++i)
-            writeStatus = fprintf(clusterFile, "%i\n",static_cast<int>((spikesByClusterTemp)(2,i)));
+    //Scatter the cluster id of each spike at its position in the feature file
+    QVector<dataType> clusterIdsOfSpikes(nbSpikes);
+    dataType* clusterIdsData = clusterIdsOfSpikes.data();
+    SpikesByClusterMap::ConstIterator iterator;
+    for(iterator = spikesByClusterTemp.constBegin(); iterator != spikesByClusterTemp.constEnd(); ++iterator){
+        const dataType* clusterSpikes = iterator.value().constData();
+        dataType nbSpikesOfCluster = iterator.value().size();
+        for(dataType i = 0; i < nbSpikesOfCluster; ++i) clusterIdsData[clusterSpikes[i] - 1] = iterator.key();
     }
-    //second method
-    else if (nbClusters > 1){
-        QList<dataType> clusterList = clusterInfoMapTemp.keys();
-        QList<dataType>::iterator iterator;
 
-        SortableTable final = SortableTable();
-        final.setSize(nbSpikes,false);
-        dataType position = 1;
-        dataType cluster = spikesByClusterTemp(2,position);
-        dataType value = spikesByClusterTemp(1,position);
-
-        while(true){
-            for(iterator = clusterList.begin(); iterator != clusterList.end(); ++iterator){
-                dataType current = spikesByClusterTemp(1,clusterInfoMapTemp[*iterator].firstSpikePosition());
-                if(current < value){
-                    value = current;
-                    cluster = *iterator;
-                }
-            }
-            final(1,position) = cluster;
-            position ++;
-            dataType firstSpikePosition = clusterInfoMapTemp[cluster].firstSpikePosition() + 1;
-            clusterInfoMapTemp[cluster].setFirstSpikePosition(firstSpikePosition);
-            dataType nbSpikesOfCluster = clusterInfoMapTemp[cluster].nbSpikes() - 1;
-            clusterInfoMapTemp[cluster].setNbSpikes(nbSpikesOfCluster);
-            if(nbSpikesOfCluster == 0){
-                nbClusters --;
-                clusterList.removeAll(cluster);
-                clusterInfoMapTemp.remove(cluster);
-            }
-            if(nbClusters == 0) break;
-            cluster = clusterList[0];
-            value = spikesByClusterTemp(1,clusterInfoMapTemp[cluster].firstSpikePosition());
-        }
+    //Store all the clusterIds in spikes order
+    for(long i = 0; i < nbSpikes ; ++i)
+        writeStatus = fprintf(clusterFile, "%i\n",static_cast<int>(clusterIdsData[i]));
 
-        //Store all the clusterIds in spikes order
-        for(long i = 1; i <= nbSpikes ; ++i)
-            writeStatus = fprintf(clusterFile, "%i\n",static_cast<int>((final)(1,i)));
-    }//nbClusters>1
-    //third method
-    else{
-        //Store all the clusterIds in spikes order
-        for(long i = 1; i <= nbSpikes ; ++i)
-            writeStatus = fprintf(clusterFile, "%i\n",static_cast<int>((spikesByClusterTemp)(2,i)));
-    }
     qDebug() << "save clu file: "<<Timer() << endl;
     if(writeStatus > 0) return 1;
     else return 0;
 }
 
-bool Data::spikePositions(int clusterId,SortableTable& subsetTable){
+bool Data::spikePositions(int clusterId,QVector<dataType>& spikes){
 
     if(!clusterInfoMap->contains(static_cast<dataType>(clusterId))) return false;
 
-    //Lock the mutex to protect the changes as a whole
+    //Lock the mutex to protect the changes as a whole. The spikes are shared with spikesByCluster, not copied.
     mutex.lock();
-
-    ClusterInfo clusterInfo  = (*clusterInfoMap)[clusterId];
-    dataType firstSpikePosition = clusterInfo.firstSpikePosition();
-    dataType nbSpikesOfCluster = clusterInfo.nbSpikes();
-
-    spikesByCluster->subset(subsetTable,1,firstSpikePosition,firstSpikePosition + nbSpikesOfCluster - 1);
+    spikes = spikesByCluster->value(clusterId);
     mutex.unlock();
 
     return true;
@@ -2365,93 +2157,82 @@ Data::Status Data::getSampleWaveformPoints(int clusterId,dataType nbSpkToDisplay
 
     //Take a sample of the spikes (displayNbSpikes) evenly distributed on all the recording.
 
-    QString clusterIdString = QString::fromLatin1("%1").arg(clusterId);
-    SortableTable positionOfSpikes = SortableTable();
+    QVector<dataType> positionOfSpikes;
     Waveforms* waveforms;
     dataType nbSpikesOfCluster = 0;
 
     //Does this cluster has already been processed?
-    if(waveformStatusMap.contains(clusterId)){
-        Status status = waveformStatusMap[clusterId].sampleStatus();
-        if(status == IN_PROCESS)return IN_PROCESS;
-        waveforms = waveformDict[clusterIdString];
+    //The status is checked and updated with the mutex locked as the GUI thread may discard the waveforms which are not in process.
+    mutex.lock();
+    QMap<int,WaveformStatus>::Iterator statusIterator = waveformStatusMap.find(clusterId);
+    if(statusIterator != waveformStatusMap.end()){
+        Status status = statusIterator.value().sampleStatus();
+        if(status == IN_PROCESS){
+            mutex.unlock();
+            return IN_PROCESS;
+        }
+        waveforms = waveformCache.value(clusterId);
         //status == READY with the same number of spikes to present
-        if((waveforms->nbOfSpikesAsked() == nbSpkToDisplay) && (status == READY))return READY;
+        if((waveforms->nbOfSpikesAsked() == nbSpkToDisplay) && (status == READY)){
+            waveformCache.addHit();
+            mutex.unlock();
+            return READY;
+        }
         //status == READY with a different number of spikes to present, recollect the data
-        mutex.lock();
-        waveformStatusMap[clusterId].setSampleStatus(IN_PROCESS);
+        waveformCache.addMiss();
+        statusIterator.value().setSampleStatus(IN_PROCESS);
         mutex.unlock();
         //Check if there not a mean calculation in process, is so wait until it finishes before doing anything
-        while(waveformStatusMap[clusterId].sampleMeanStatus() == IN_PROCESS);
+        waitForWaveforms(clusterId,SAMPLE,true,0L);
         //check if the cluster has not been removed while the mean function was running
         //if so the entry in waveformStatusMap for that cluster will have been removed  in the mean function
-        if(!waveformStatusMap.contains(clusterId)) return NOT_AVAILABLE;
         mutex.lock();
-        waveformStatusMap[clusterId].setSampleMeanStatus(NOT_AVAILABLE);
-        mutex.unlock();
-
-        //Check again that the cluster has not been removed or modified and get the spikes positions in a one row SortableTable.
-        if(!spikePositions(clusterId,positionOfSpikes) || waveformStatusMap[clusterId].isClusterModified()){
-            mutex.lock();
-            waveformStatusMap[clusterId].setClusterModified(false);
-            delete waveformDict.take(clusterIdString); //not already done by the function which modified the data as the thread is running.
-            waveformStatusMap.remove(clusterId);
+        statusIterator = waveformStatusMap.find(clusterId);
+        if(statusIterator == waveformStatusMap.end()){
             mutex.unlock();
             return NOT_AVAILABLE;
         }
+        statusIterator.value().setSampleMeanStatus(NOT_AVAILABLE);
+        mutex.unlock();
+
+        //Check again that the cluster has not been removed or modified and get the spikes positions.
+        if(!spikePositions(clusterId,positionOfSpikes) || waveformsOutdated(clusterId)) return discardWaveforms(clusterId);
         waveforms->setNbOfSpikesAsked(nbSpkToDisplay);
         //Get the spikes information
-        nbSpikesOfCluster = positionOfSpikes.nbOfColumns();
+        nbSpikesOfCluster = positionOfSpikes.size();
         waveforms->setSize(nbSpikesOfCluster,SAMPLE);
     }
     else{
-        mutex.lock();
-        waveformStatusMap.insert(clusterId,WaveformStatus(IN_PROCESS));
-        mutex.unlock();
         if(isTwoBytesRecording) waveforms = new WaveformData<short>(*this);
         else waveforms = new WaveformData<long>(*this);
+        waveformCache.addMiss();
+        waveformCache.insert(clusterId,waveforms);
+        waveformStatusMap.insert(clusterId,WaveformStatus(IN_PROCESS));
+        mutex.unlock();
 
-        //Check that the cluster has not been removed or modified and get the spikes positions in a one row SortableTable.
-        if(!spikePositions(clusterId,positionOfSpikes) || waveformStatusMap[clusterId].isClusterModified()){
-            mutex.lock();
-            waveformStatusMap[clusterId].setClusterModified(false);
-            delete waveformDict.take(clusterIdString); //not already done by the function which modified the data as the thread is running.
-            waveformStatusMap.remove(clusterId);
-            mutex.unlock();
-            return NOT_AVAILABLE;
-        }
+        //Check that the cluster has not been removed or modified and get the spikes positions.
+        if(!spikePositions(clusterId,positionOfSpikes) || waveformsOutdated(clusterId)) return discardWaveforms(clusterId);
 
         waveforms->setNbOfSpikesAsked(nbSpkToDisplay);
         //Get the spikes information
-        nbSpikesOfCluster = positionOfSpikes.nbOfColumns();
+        nbSpikesOfCluster = positionOfSpikes.size();
 
         waveforms->setSize(nbSpikesOfCluster,SAMPLE);
-        waveformDict.insert(clusterIdString,waveforms);
-    }
-
-    FILE* spikeFile = fopen(spkFileName.toLatin1(),"r");
-    if(spikeFile == NULL){
-        // OPEN_ERROR;  ///The openning pb has to be taken into account
     }
 
     //read and store the data
     waveforms->read(positionOfSpikes,nbSpikesOfCluster,spikeFile,nbSpkToDisplay);
-    fclose(spikeFile);
 
     //If the cluster has been suppress or modified after the thread calling this function has been launched
     //return this information that the data are not available and remove the collected data.
-    if(!clusterInfoMap->contains(static_cast<dataType>(clusterId)) || waveformStatusMap[clusterId].isClusterModified()){
-        mutex.lock();
-        waveformStatusMap[clusterId].setClusterModified(false);
-        delete waveformDict.take(clusterIdString);  //not already done by the function which modified the data as the thread is running.
-        waveformStatusMap.remove(clusterId);
-        mutex.unlock();
-        return NOT_AVAILABLE;
-    }
+    if(!clusterInfoMap->contains(static_cast<dataType>(clusterId)) || waveformsOutdated(clusterId)) return discardWaveforms(clusterId);
     else{
         //Store the information in waveformStatusMap
         mutex.lock();
-        waveformStatusMap[clusterId].setSampleStatus(READY);
+        waveformCache.updateMemoryUsage(clusterId);
+        statusIterator = waveformStatusMap.find(clusterId);
+        if(statusIterator != waveformStatusMap.end()) statusIterator.value().setSampleStatus(READY);
+        computationFinished.wakeAll();
         mutex.unlock();
         return READY;
     }
@@ -2463,8 +2244,7 @@ Data::Status Data::getTimeFrameWaveformPoints(int clusterId,dataType start,dataT
     if(!clusterInfoMap->contains(static_cast<dataType>(clusterId)))return NOT_AVAILABLE;
 
     //Take all the spikes in a given time frame
-    QString clusterIdString = QString::fromLatin1("%1").arg(clusterId);
-    SortableTable positionOfSpikes = SortableTable();
+    QVector<dataType> positionOfSpikes;
     dataType nbSpikesOfCluster = 0;
     dataType startInRecordingUnits = start * static_cast<dataType>(1000000.0 / samplingInterval);
     dataType endInRecordingUnits =  end * static_cast<dataType>(1000000.0 / samplingInterval);
@@ -2472,40 +2252,46 @@ Data::Status Data::getTimeFrameWaveformPoints(int clusterId,dataType start,dataT
     Waveforms* waveforms;
 
     //Does this cluster has already been processed?
-    if(waveformStatusMap.contains(clusterId)){
-        Status status = waveformStatusMap[clusterId].timeFrameStatus();
-        if(status == IN_PROCESS)return IN_PROCESS;
-        waveforms = waveformDict[clusterIdString];
+    mutex.lock();
+    QMap<int,WaveformStatus>::Iterator statusIterator = waveformStatusMap.find(clusterId);
+    if(statusIterator != waveformStatusMap.end()){
+        Status status = statusIterator.value().timeFrameStatus();
+        if(status == IN_PROCESS){
+            mutex.unlock();
+            return IN_PROCESS;
+        }
+        waveforms = waveformCache.value(clusterId);
         dataType timeEndIndex = waveforms->indexOfTimeEnd();
         dataType timeStart = waveforms->startTime();
         dataType timeEnd = waveforms->endTime();
 
         //status == READY with the time frame
-        if(timeStart == start && timeEnd == end && status == READY) return READY;
-        mutex.lock();
-        waveformStatusMap[clusterId].setTimeFrameStatus(IN_PROCESS);
+        if(timeStart == start && timeEnd == end && status == READY){
+            waveformCache.addHit();
+            mutex.unlock();
+            return READY;
+        }
+        waveformCache.addMiss();
+        statusIterator.value().setTimeFrameStatus(IN_PROCESS);
         mutex.unlock();
         //Check if there not a mean calculation in process, is so wait until it finishes before doing anything
-        while(waveformStatusMap[clusterId].timeFrameMeanStatus() == IN_PROCESS);
+        waitForWaveforms(clusterId,TIME_FRAME,true,0L);
         //check if the cluster has not been removed while the mean function was running
         //if so the entry in waveformStatusMap for that cluster will have been removed  in the mean function
-        if(!waveformStatusMap.contains(clusterId)) return NOT_AVAILABLE;
         mutex.lock();
-        waveformStatusMap[clusterId].setTimeFrameMeanStatus(NOT_AVAILABLE);
-        mutex.unlock();
-
-        //Check again that the cluster has not been removed or modifed and get the spikes positions in a one row SortableTable.
-        if(!spikePositions(clusterId,positionOfSpikes) || waveformStatusMap[clusterId].isClusterModified()){
-            mutex.lock();
-            waveformStatusMap[clusterId].setClusterModified(false);
-            delete waveformDict.take(clusterIdString); //not already done by the function which modified the data as the thread is running.
-            waveformStatusMap.remove(clusterId);
+        statusIterator = waveformStatusMap.find(clusterId);
+        if(statusIterator == waveformStatusMap.end()){
             mutex.unlock();
             return NOT_AVAILABLE;
         }
+        statusIterator.value().setTimeFrameMeanStatus(NOT_AVAILABLE);
+        mutex.unlock();
+
+        //Check again that the cluster has not been removed or modifed and get the spikes positions.
+        if(!spikePositions(clusterId,positionOfSpikes) || waveformsOutdated(clusterId)) return discardWaveforms(clusterId);
 
         //Get the spikes information
-        nbSpikesOfCluster = positionOfSpikes.nbOfColumns();
+        nbSpikesOfCluster = positionOfSpikes.size();
         waveforms->setSize(nbSpikesOfCluster,TIME_FRAME);
         //status == READY with a different time frame, recollect the data
         //Start from the last position where the spikes have been taken
@@ -2513,60 +2299,43 @@ Data::Status Data::getTimeFrameWaveformPoints(int clusterId,dataType start,dataT
         if(start == timeEnd) currentSpikeIndex =  timeEndIndex;
     }
     else{
-        mutex.lock();
-        waveformStatusMap.insert(clusterId,WaveformStatus(NOT_AVAILABLE,IN_PROCESS));
-        mutex.unlock();
         if(isTwoBytesRecording) waveforms = new WaveformData<short>(*this);
         else waveforms = new WaveformData<long>(*this);
+        waveformCache.addMiss();
+        waveformCache.insert(clusterId,waveforms);
+        waveformStatusMap.insert(clusterId,WaveformStatus(NOT_AVAILABLE,IN_PROCESS));
+        mutex.unlock();
 
-        //Check that the cluster has not been removed or modified and get the spikes positions in a one row SortableTable.
-        if(!spikePositions(clusterId,positionOfSpikes) || waveformStatusMap[clusterId].isClusterModified()){
-            mutex.lock();
-            waveformStatusMap[clusterId].setClusterModified(false);
-            delete waveformDict.take(clusterIdString); //not already done by the function which modified the data as the thread is running.
-            waveformStatusMap.remove(clusterId);
-            mutex.unlock();
-            return NOT_AVAILABLE;
-        }
+        //Check that the cluster has not been removed or modified and get the spikes positions.
+        if(!spikePositions(clusterId,positionOfSpikes) || waveformsOutdated(clusterId)) return discardWaveforms(clusterId);
         //Get the spikes information
-        nbSpikesOfCluster = positionOfSpikes.nbOfColumns();
+        nbSpikesOfCluster = positionOfSpikes.size();
 
         waveforms->setSize(nbSpikesOfCluster,TIME_FRAME);
-        waveformDict.insert(clusterIdString,waveforms);
     }
 
+    //The spike times are read in the features.
+    QReadLocker featuresLocker(&featuresLock);
+
     //Look for the starting position if not already known
     if(currentSpikeIndex == 0){
         dataType max = nbSpikesOfCluster + 1;
         dataType currentPositionInFeatures = 0;
         dataType currentTime = 0;
         for(currentSpikeIndex = 1; currentSpikeIndex < max; ++currentSpikeIndex){
-            currentPositionInFeatures = positionOfSpikes(1,currentSpikeIndex);
+            currentPositionInFeatures = positionOfSpikes[currentSpikeIndex - 1];
             currentTime = features(currentPositionInFeatures,nbDimensions);
             if(currentTime >= startInRecordingUnits) break;
         }
     }
 
-    FILE* spikeFile = fopen(spkFileName.toLatin1(),"r");
-    if(spikeFile == NULL){
-        // OPEN_ERROR;  ///The openning pb has to be taken into account
-    }
-
     //read and store the data
     waveforms->read(positionOfSpikes,nbSpikesOfCluster,spikeFile,currentSpikeIndex,endInRecordingUnits);
-
-    fclose(spikeFile);
+    featuresLocker.unlock();
 
     //If the cluster has been suppress or modified after the thread calling this function has been launched
     //return this information that the data are not available and remove the collected data.
-    if(!clusterInfoMap->contains(static_cast<dataType>(clusterId)) || waveformStatusMap[clusterId].isClusterModified()){
-        mutex.lock();
-        waveformStatusMap[clusterId].setClusterModified(false);
-        delete waveformDict.take(clusterIdString); //if not already done by the function which modified the data
-        waveformStatusMap.remove(clusterId);
-        mutex.unlock();
-        return NOT_AVAILABLE;
-    }
+    if(!clusterInfoMap->contains(static_cast<dataType>(clusterId)) || waveformsOutdated(clusterId)) return discardWaveforms(clusterId);
     else{
         //Store the information in waveforms and waveformStatusMap
         waveforms->setStartTime(start);
@@ -2575,7 +2344,10 @@ Data::Status Data::getTimeFrameWaveformPoints(int clusterId,dataType start,dataT
 
         //Store the information in waveformStatusMap
         mutex.lock();
-        waveformStatusMap[clusterId].setTimeFrameStatus(READY);
+        waveformCache.updateMemoryUsage(clusterId);
+        statusIterator = waveformStatusMap.find(clusterId);
+        if(statusIterator != waveformStatusMap.end()) statusIterator.value().setTimeFrameStatus(READY);
+        computationFinished.wakeAll();
         mutex.unlock();
         return READY;
     }
@@ -2587,6 +2359,7 @@ void Data::WaveformData<T>::setSize(dataType size,WaveformMode waveformMode){
     if(mode == SAMPLE){
         if(sampleSpikesTable) delete []sampleSpikesTable;
         sampleSpikesTable = new T[size * nbPtsBySpike];
+        sampleTableSize = size * nbPtsBySpike;
         if(sampleMeanTable){
             delete []sampleMeanTable;
             sampleMeanTable = 0L;
@@ -2598,6 +2371,7 @@ void Data::WaveformData<T>::setSize(dataType size,WaveformMode waveformMode){
     else{
         if(timeFrameSpikesTable) delete[]timeFrameSpikesTable;
         timeFrameSpikesTable = new T[size * nbPtsBySpike];
+        timeFrameTableSize = size * nbPtsBySpike;
         if(timeFrameMeanTable){
             delete []timeFrameMeanTable;
             timeFrameMeanTable = 0L;
@@ -2610,28 +2384,30 @@ void Data::WaveformData<T>::setSize(dataType size,WaveformMode waveformMode){
 
 
 template <class T>
-void Data::WaveformData<T>::read(SortableTable& positionOfSpikes,dataType nbSpikesOfCluster,FILE* spikeFile,dataType nbSpkToDisplay){
+void Data::WaveformData<T>::read(const QVector<dataType>& positionOfSpikes,dataType nbSpikesOfCluster,const SpikeFile& spikeFile,dataType nbSpkToDisplay){
+    //The spikes are gathered and read in batches.
+    QVector<SpikeFile::Record> records;
+
     //Show nbSpkToDisplay spikes or all the spikes if nbSpikesOfCluster < nbSpkToDisplay
     if(nbSpikesOfCluster < nbSpkToDisplay){
         dataType max = nbSpikesOfCluster +1;
         dataType position = 0;
+        records.reserve(nbSpikesOfCluster);
         for(dataType i = 1; i < max; ++i){
-            //go to the spike position
-            dataType currentSpikePosition = (positionOfSpikes(1,i) - 1) * nbPtsBySpike ;
-            fseeko64(spikeFile,currentSpikePosition * sizeof(T),SEEK_SET);
+            //position of the spike in the spike file
+            dataType currentSpikePosition = (positionOfSpikes[i - 1] - 1) * nbPtsBySpike ;
             // copy the spikes into spikePoints.
-            fread(&(sampleSpikesTable[position]),sizeof(T),nbPtsBySpike,spikeFile);
+            records.append(SpikeFile::Record(currentSpikePosition * sizeof(T),&(sampleSpikesTable[position])));
             position += nbPtsBySpike;
             ++nbSampleSpikes;
         }
     }
     //If there is only one spike to show, take the first one
     else if(nbSpkToDisplay == 1){
-        //go to the spike position
-        dataType currentSpikePosition = (positionOfSpikes(1,1) - 1) * nbPtsBySpike ;
-        fseeko64(spikeFile,currentSpikePosition * sizeof(T),SEEK_SET);
+        //position of the spike in the spike file
+        dataType currentSpikePosition = (positionOfSpikes[0] - 1) * nbPtsBySpike ;
         // copy the spikes into spikePoints.
-        fread(&(sampleSpikesTable[0]),sizeof(T),nbPtsBySpike,spikeFile);
+        spikeFile.read(currentSpikePosition * sizeof(T),&(sampleSpikesTable[0]),nbPtsBySpike * sizeof(T));
         nbSampleSpikes = 1;
     }
     else{
@@ -2640,41 +2416,43 @@ void Data::WaveformData<T>::read(SortableTable& positionOfSpikes,dataType nbSpik
         dataType max = nbSpkToDisplay +1;
         float floatSpkIndice = 1;
         dataType spkIndice;
+        records.reserve(nbSpkToDisplay);
         for(float i = 1; i < max; ++i){
             spkIndice = static_cast<dataType>(floatSpkIndice + 0.5);
-            //go to the spike position
-            dataType currentSpikePosition = (positionOfSpikes(1,spkIndice) - 1) * nbPtsBySpike ;
-            fseeko64(spikeFile,currentSpikePosition * sizeof(T),SEEK_SET);
+            //position of the spike in the spike file
+            dataType currentSpikePosition = (positionOfSpikes[spkIndice - 1] - 1) * nbPtsBySpike ;
             // copy the spikes into spikePoints.
-            fread(&(sampleSpikesTable[position]),sizeof(T),nbPtsBySpike,spikeFile);
+            records.append(SpikeFile::Record(currentSpikePosition * sizeof(T),&(sampleSpikesTable[position])));
             position += nbPtsBySpike;
             ++nbSampleSpikes;
             floatSpkIndice += factor;
         }
     }
+    spikeFile.read(records,nbPtsBySpike * sizeof(T));
 }
 
 template <class T>
-void Data::WaveformData<T>::read(SortableTable& positionOfSpikes,dataType nbSpikesOfCluster,FILE* spikeFile,dataType& currentSpikeIndex,dataType end){
+void Data::WaveformData<T>::read(const QVector<dataType>& positionOfSpikes,dataType nbSpikesOfCluster,const SpikeFile& spikeFile,dataType& currentSpikeIndex,dataType end){
     dataType max = nbSpikesOfCluster +1;
     dataType position = 0;
     dataType startPositionInSpk;
+    //The spikes are gathered and read in batches.
+    QVector<SpikeFile::Record> records;
 
     for(; currentSpikeIndex < max; ++currentSpikeIndex){
-        dataType currentPositionInFeatures = positionOfSpikes(1,currentSpikeIndex);
+        dataType currentPositionInFeatures = positionOfSpikes[currentSpikeIndex - 1];
         dataType currentTime = data.features(currentPositionInFeatures,data.nbDimensions);
 
         if(currentTime >= end) break;
         //positionOfSpikes and features take indices starting at 1, so currentPositionInFeatures
         //is already correct regarding the presence of an additional first line (nb of features) in the fet file.
         startPositionInSpk = (currentPositionInFeatures - 1) * nbPtsBySpike * sizeof(T);
-        //go to the spike position
-        fseeko64(spikeFile,startPositionInSpk,SEEK_SET);
         // copy the spikes into timeFrameSpikesTable.
-        fread(&(timeFrameSpikesTable[position]),sizeof(T),nbPtsBySpike,spikeFile);
+        records.append(SpikeFile::Record(startPositionInSpk,&(timeFrameSpikesTable[position])));
         position += nbPtsBySpike;
         ++nbTimeFrameSpikes;
     }
+    spikeFile.read(records,nbPtsBySpike * sizeof(T));
 }
 
 template <class T>
@@ -2730,50 +2508,43 @@ void Data::WaveformData<T>::calculateMean(WaveformMode waveformMode){
 Data::Status Data::calculateSampleMean(int clusterId,dataType nbSpkToDisplay){
     //Calculate the mean and the standard deviation for
     //a sample of the spikes (displayNbSpikes) evenly distributed on all the recording.
-    QString clusterIdString = QString::fromLatin1("%1").arg(clusterId);
     Waveforms* waveforms;
 
     //Does this cluster already processed?
-    if(waveformStatusMap.contains(clusterId)){
-        mutex.lock();
-        Status status = waveformStatusMap[clusterId].sampleMeanStatus();
-        waveforms = waveformDict[clusterIdString];
-        mutex.unlock();
+    //Same as for the waveforms, the mean is only computed on waveforms marked in process.
+    QMutexLocker locker(&mutex);
+    QMap<int,WaveformStatus>::Iterator statusIterator = waveformStatusMap.find(clusterId);
+    if(statusIterator != waveformStatusMap.end()){
+        Status status = statusIterator.value().sampleMeanStatus();
+        waveforms = waveformCache.value(clusterId);
         if(status == IN_PROCESS)return IN_PROCESS;
         else if(waveforms->nbOfSpikesAsked() != nbSpkToDisplay) return NOT_AVAILABLE;
         //status == READY with the same number of spikes to present
         else if((waveforms->nbOfSpikesAsked() == nbSpkToDisplay) && (status == READY))return READY;
         else{
-            if(waveformStatusMap[clusterId].sampleStatus() != READY) return NOT_AVAILABLE;
+            if(statusIterator.value().sampleStatus() != READY) return NOT_AVAILABLE;
             if(waveforms->nbOfSpikes(SAMPLE) == 0){
-                mutex.lock();
-                waveformStatusMap[clusterId].setSampleMeanStatus(NOT_AVAILABLE);
-                mutex.unlock();
+                statusIterator.value().setSampleMeanStatus(NOT_AVAILABLE);
                 return READY;
             }
-            mutex.lock();
-            waveformStatusMap[clusterId].setSampleMeanStatus(IN_PROCESS);
-            mutex.unlock();
+            statusIterator.value().setSampleMeanStatus(IN_PROCESS);
         }
     }
     else return NOT_AVAILABLE;
+    locker.unlock();
 
     //calculate the mean and the standard deviation and store the data
     waveforms->calculateMean(SAMPLE);
     //If the cluster has been suppress or modified after the thread calling this function has been launched
     //return this information that the data are not available.
-    if(!clusterInfoMap->contains(static_cast<dataType>(clusterId)) || waveformStatusMap[clusterId].isClusterModified()){
-        mutex.lock();
-        waveformStatusMap[clusterId].setClusterModified(false);
-        delete waveformDict.take(clusterIdString);  //if not already done by the function which modified the data
-        waveformStatusMap.remove(clusterId);;
-        mutex.unlock();
-        return NOT_AVAILABLE;
-    }
+    if(!clusterInfoMap->contains(static_cast<dataType>(clusterId)) || waveformsOutdated(clusterId)) return discardWaveforms(clusterId);
     else{
         //Store the information in waveformStatusMap
         mutex.lock();
-        waveformStatusMap[clusterId].setSampleMeanStatus(READY);
+        waveformCache.updateMemoryUsage(clusterId);
+        statusIterator = waveformStatusMap.find(clusterId);
+        if(statusIterator != waveformStatusMap.end()) statusIterator.value().setSampleMeanStatus(READY);
+        computationFinished.wakeAll();
         mutex.unlock();
         return READY;
     }
@@ -2784,34 +2555,30 @@ Data::Status Data::calculateTimeFrameMean(int clusterId,dataType start,dataType
     //Calculate the mean and the standard deviation for
     //a sample of the spikes (displayNbSpikes) evenly distributed on all the recording.
 
-    QString clusterIdString = QString::fromLatin1("%1").arg(clusterId);
     Waveforms* waveforms;
 
     //Does this cluster already processed?
-    if(waveformStatusMap.contains(clusterId)){
-        mutex.lock();
-        Status status = waveformStatusMap[clusterId].timeFrameMeanStatus();
-        waveforms = waveformDict[clusterIdString];
-        mutex.unlock();
+    QMutexLocker locker(&mutex);
+    QMap<int,WaveformStatus>::Iterator statusIterator = waveformStatusMap.find(clusterId);
+    if(statusIterator != waveformStatusMap.end()){
+        Status status = statusIterator.value().timeFrameMeanStatus();
+        waveforms = waveformCache.value(clusterId);
         dataType timeStart = waveforms->startTime();
         dataType timeEnd = waveforms->endTime();
 
         if(status == IN_PROCESS)return IN_PROCESS;
         else if(timeStart == start && timeEnd == end && status == READY) return READY;
         else{
-            if(waveformStatusMap[clusterId].timeFrameStatus() != READY) return NOT_AVAILABLE;
+            if(statusIterator.value().timeFrameStatus() != READY) return NOT_AVAILABLE;
             if(waveforms->nbOfSpikes(TIME_FRAME) == 0){
-                mutex.lock();
-                waveformStatusMap[clusterId].setTimeFrameMeanStatus(NOT_AVAILABLE);
-                mutex.unlock();
+                statusIterator.value().setTimeFrameMeanStatus(NOT_AVAILABLE);
                 return READY;
             }
-            mutex.lock();
-            waveformStatusMap[clusterId].setTimeFrameMeanStatus(IN_PROCESS);
-            mutex.unlock();
+            statusIterator.value().setTimeFrameMeanStatus(IN_PROCESS);
         }
     }
     else return NOT_AVAILABLE;
+    locker.unlock();
 
 
     //calculate the mean and the standard deviation and store the data
@@ -2819,177 +2586,101 @@ Data::Status Data::calculateTimeFrameMean(int clusterId,dataType start,dataType
 
     //If the cluster has been suppress or modifed after the thread calling this function has been launched
     //return this information that the data are not available.
-    if(!clusterInfoMap->contains(static_cast<dataType>(clusterId)) || waveformStatusMap[clusterId].isClusterModified()){
-        mutex.lock();
-        waveformStatusMap[clusterId].setClusterModified(false);
-        delete waveformDict.take(clusterIdString);  //if not already done by the function which modified the data
-        waveformStatusMap.remove(clusterId);
-        mutex.unlock();
-        return NOT_AVAILABLE;
-    }
+    if(!clusterInfoMap->contains(static_cast<dataType>(clusterId)) || waveformsOutdated(clusterId)) return discardWaveforms(clusterId);
     else{
         //Store the information in waveformStatusMap
         mutex.lock();
-        waveformStatusMap[clusterId].setTimeFrameMeanStatus(READY);
+        waveformCache.updateMemoryUsage(clusterId);
+        statusIterator = waveformStatusMap.find(clusterId);
+        if(statusIterator != waveformStatusMap.end()) statusIterator.value().setTimeFrameMeanStatus(READY);
+        computationFinished.wakeAll();
         mutex.unlock();
         return READY;
     }
 }
 
+bool Data::waveformsOutdated(int clusterId){
+    QMutexLocker locker(&mutex);
+    QMap<int,WaveformStatus>::ConstIterator iterator = waveformStatusMap.constFind(clusterId);
+    return iterator == waveformStatusMap.constEnd() || iterator.value().isClusterModified();
+}
 
-void Data::sortCluster(ClusterInfoMap* clusterInfoMapTemp,SortableTable* spikesByClusterTemp, dataType clusterId,QList<dataType> positions,
-                       QList<dataType> nbOfspikes,int step,bool fromTop){
-    uint nbClusters = static_cast<uint>(positions.size());
-    uint indice = 0;
-
-    ClusterInfo clusterInfo  = (*clusterInfoMapTemp)[clusterId];
-    dataType nbSpikesOfCluster = clusterInfo.nbSpikes();
-    dataType firstSpikePosition = clusterInfo.firstSpikePosition();
+Data::Status Data::discardWaveforms(int clusterId){
+    QMutexLocker locker(&mutex);
+    //Not already done by the function which modified the data as the computation was in process.
+    delete waveformCache.take(clusterId);
+    waveformStatusMap.remove(clusterId);
+    computationFinished.wakeAll();
+    return NOT_AVAILABLE;
+}
 
-    //Update positions to set the last spikes position correctly if need it.
-    //The positions were counted from the last spike of the new cluster, now
-    //they will be counted from the first spike of the new cluster.
-    if(!fromTop){
-        for(dataType i = 0; i < static_cast<dataType>(nbClusters); ++i){
-            positions[i] = nbSpikesOfCluster - positions[i] + 1;
-        }
+void Data::waitForWaveforms(int clusterId,WaveformMode mode,bool mean,const volatile bool* cancelFlag){
+    mutex.lock();
+    while(cancelFlag == 0L || !*cancelFlag){
+        QMap<int,WaveformStatus>::ConstIterator iterator = waveformStatusMap.constFind(clusterId);
+        //The entry is removed if the computation has been abandoned.
+        if(iterator == waveformStatusMap.constEnd()) break;
+        Status status;
+        if(mode == SAMPLE) status = mean ? iterator.value().sampleMeanStatus() : iterator.value().sampleStatus();
+        else status = mean ? iterator.value().timeFrameMeanStatus() : iterator.value().timeFrameStatus();
+        if(status != IN_PROCESS) break;
+        //The thread doing the computation wakes up the waiting threads when it is done, the timeout only bounds the wait.
+        computationFinished.wait(&mutex,kCOMPUTATION_WAIT);
     }
+    mutex.unlock();
+}
 
-    SortableTable data = SortableTable();
-    //Get the spike positions in a one row SortableTable.
-    spikesByClusterTemp->subset(data,1,firstSpikePosition,firstSpikePosition + nbSpikesOfCluster - 1);
+void Data::wakeUpWaitingThreads(){
+    mutex.lock();
+    computationFinished.wakeAll();
+    mutex.unlock();
+}
 
-    SortableTable final = SortableTable();
-    final.setSize(nbSpikesOfCluster,false);
-    dataType position = 1;
-    dataType value = data(1,positions[0]);
+void Data::setWaveformCacheBudget(qint64 nbBytes){
+    mutex.lock();
+    waveformCache.setBudget(nbBytes);
+    mutex.unlock();
+}
 
-    //If step == -1, the spikes for each cluster are sorted from the first one to the last one
-    //by decreasing order. They will be read from last one to the first one.
-    //If step == 1, the spikes for each cluster are sorted from the first one to the last one
-    //by increasing order. They will be read from first one to the last one.
-    while(true){
-        for(uint i = 1; i < nbClusters; ++i){
-            dataType current = data(1,positions[i]);
-            if(current < value){
-                value = current;
-                indice = i;
-            }
-        }
-        final(1,position) = value;
-        position ++;
-        positions[indice] += step;
-        nbOfspikes[indice] --;
-        if(nbOfspikes[indice] == 0){
-            nbClusters --;
-            positions.removeOne(positions.at(indice));
-            nbOfspikes.removeOne(nbOfspikes.at(indice));
-        }
-        if(nbClusters == 0) break;
-        indice = 0;
-        value = data(1,positions[0]);
-    }
-
-    //Copy the sorted data to spikesByClusterTemp
-    memcpy(&(*spikesByClusterTemp)(1,firstSpikePosition),
-           &final(1,1),
-           nbSpikesOfCluster * sizeof(dataType));
-}
-
-void Data::sortCluster(ClusterInfoMap* clusterInfoMapTemp,SortableTable* spikesByClusterTemp,dataType clusterId,QList<dataType> lastPositions,QList<dataType> nbOfspikes,dataType firstPosition,dataType number){
-    //Initialize the variables concerning the previous data of clusterId (which is 0 or 1).
-    dataType originalFirstPosition = firstPosition;
-    dataType originalNb = number;
-    uint nbClusters = static_cast<uint>(lastPositions.size());
-    uint indice = 0;
-
-    ClusterInfo clusterInfo  = (*clusterInfoMapTemp)[clusterId];
-    dataType nbSpikesOfCluster = clusterInfo.nbSpikes();
-    dataType firstSpikePosition = clusterInfo.firstSpikePosition();
-
-    SortableTable data = SortableTable();
-    //Get the spikes positions in a one row SortableTable.
-    spikesByClusterTemp->subset(data,1,firstSpikePosition,firstSpikePosition + nbSpikesOfCluster - 1);
-
-    SortableTable final = SortableTable();
-    final.setSize(nbSpikesOfCluster,false);
-    dataType position = 1;
-    dataType value = data(1,lastPositions[0]);
-
-    //The spikes for each cluster are sorted from the last one to the first one
-    //by increasing order.
-    if(originalNb > 0){
-        while(true){
-            for(uint i = 1; i < nbClusters; ++i){
-                dataType current = data(1,lastPositions[i]);
-                if(current < value){
-                    value = current;
-                    indice = i;
-                }
-            }
-            //work on the original spikes of the new cluster (which is either cluster 0 or cluster 1).
-            dataType current = data(1,originalFirstPosition);
-            if(current < value){
-                final(1,position) = current;
-                position ++;
-                originalNb --;
-                if(originalNb == 0)break;
-                originalFirstPosition ++;
-            }
-            else{
-                final(1,position) = value;
-                position ++;
-                lastPositions[indice]--;
-                nbOfspikes[indice] --;
-                if(nbOfspikes[indice] == 0){
-                    nbClusters --;
-                    lastPositions.removeOne(lastPositions.at(indice));
-                    nbOfspikes.removeOne(nbOfspikes.at(indice));
-                }
-                //Copy all the reminding original spikes of the new cluster.
-                if(nbClusters == 0){
-                    memcpy(&(final(1,position)),
-                           &(data(1,originalFirstPosition)),
-                           originalNb * sizeof(dataType));
-                    break;
-                }
-                indice = 0;
-                value = data(1,lastPositions[0]);
-            }
-        }
-    }
-    //All the original spikes have been sort, now deal with the reminding ones coming
-    //from the other clusters.
-    if(originalNb == 0 && nbClusters != 0){
-        indice = 0;
-        value = data(1,lastPositions[0]);
-        while(true){
-            for(uint i = 1; i < nbClusters; ++i){
-                dataType current = data(1,lastPositions[i]);
-                if(current < value){
-                    value = current;
-                    indice = i;
-                }
-            }
-            final(1,position) = value;
-            position ++;
-            lastPositions[indice]--;
-            nbOfspikes[indice] --;
-            if(nbOfspikes[indice] == 0){
-                nbClusters --;
-                lastPositions.removeOne(lastPositions.at(indice));
-                nbOfspikes.removeOne(nbOfspikes.at(indice));
-            }
-            if(nbClusters == 0) break;
-            indice = 0;
-            value = data(1,lastPositions[0]);
-        }
+qint64 Data::waveformCacheHits(){
+    QMutexLocker locker(&mutex);
+    return waveformCache.nbHits();
+}
+
+qint64 Data::waveformCacheMisses(){
+    QMutexLocker locker(&mutex);
+    return waveformCache.nbMisses();
+}
+
+qint64 Data::waveformCacheMemoryUsage(){
+    QMutexLocker locker(&mutex);
+    return waveformCache.memoryUsage();
+}
+
+void Data::evictWaveforms(const QList<int>& shownClusters){
+    QMutexLocker locker(&mutex);
+    if(waveformCache.memoryUsage() <= waveformCache.budget()) return;
+
+    QList<int> clusters = waveformCache.clustersByUse();
+    for(int i = 0; i < clusters.count() && waveformCache.memoryUsage() > waveformCache.budget(); ++i){
+        int currentClusterId = clusters[i];
+        if(shownClusters.contains(currentClusterId)) continue;
+        //The waveforms used by a computation are removed by the thread doing it if needed.
+        QMap<int,WaveformStatus>::ConstIterator iterator = waveformStatusMap.constFind(currentClusterId);
+        if(iterator != waveformStatusMap.constEnd() && iterator.value().isInProcess()) continue;
+        delete waveformCache.take(currentClusterId);
+        waveformStatusMap.remove(currentClusterId);
     }
+}
+
 
-    //Copy the sorted data to spikesByClusterTemp
-    memcpy(&(*spikesByClusterTemp)(1,firstSpikePosition),
-           &final(1,1),
-           nbSpikesOfCluster * sizeof(dataType));
+void Data::addClustersToSelection(SpikeSelection& selection,const QList<int>& clustersOfOrigin,int excludedCluster){
+    for(int i = 0; i < clustersOfOrigin.size(); ++i){
+        dataType clusterId = static_cast<dataType>(clustersOfOrigin[i]);
+        if(clustersOfOrigin[i] == excludedCluster || !spikesByCluster->contains(clusterId)) continue;
+        const QVector<dataType>& clusterSpikes = spikesByCluster->constFind(clusterId).value();
+        selection.addCluster(clusterId,clusterSpikes.constData(),clusterSpikes.size());
+    }
 }
 
 Data::Status Data::getCorrelograms(Pair& pair,int binSize,int timeWindow,double binSizeInRU,float timeWindowInRU,int halfBins){
@@ -3077,17 +2768,17 @@ Data::Status Data::getCorrelograms(Pair& pair,int binSize,int timeWindow,double
         //skip this pair.
         bool clusterNotAvailable = false;
         bool autoCorrelogram = false;
-        SortableTable spikesOfCluster1 = SortableTable();
-        SortableTable spikesOfCluster2 =  SortableTable();
+        QVector<dataType> spikesOfCluster1;
+        QVector<dataType> spikesOfCluster2;
 
         if(cluster1 == cluster2) autoCorrelogram = true;
 
-        //Get the spikes positions for the cluster1 in a one row SortableTable.
+        //Get the spikes positions for the cluster1.
         if(!spikePositions(cluster1,spikesOfCluster1)){
             cleanCorrelation(static_cast<dataType>(cluster1),clusterIds(),true);
             clusterNotAvailable = true;
         }
-        //Get the spikes positions for the cluster2 in a one row SortableTable.
+        //Get the spikes positions for the cluster2.
         if(!autoCorrelogram && (!spikePositions(cluster2,spikesOfCluster2))){
             cleanCorrelation(static_cast<dataType>(cluster2),clusterIds(),true);
             clusterNotAvailable = true;
@@ -3098,6 +2789,7 @@ Data::Status Data::getCorrelograms(Pair& pair,int binSize,int timeWindow,double
             correlationsInProcess.removeProcess(static_cast<dataType>(cluster2));
             delete correlationDict.take(pair.toString()); //if the clusters do not exist anymore they would not have been
             //removed in cleanCorrelation
+            computationFinished.wakeAll();
             mutex.unlock();
             return NOT_AVAILABLE;
         }
@@ -3107,6 +2799,7 @@ Data::Status Data::getCorrelograms(Pair& pair,int binSize,int timeWindow,double
             mutex.lock();
             correlationsInProcess.removeProcess(static_cast<dataType>(cluster1));
             delete correlationDict.take(pair.toString());
+            computationFinished.wakeAll();
             mutex.unlock();
 
             clusterNotAvailable = true;
@@ -3115,6 +2808,7 @@ Data::Status Data::getCorrelograms(Pair& pair,int binSize,int timeWindow,double
             mutex.lock();
             correlationsInProcess.removeProcess(static_cast<dataType>(cluster2));
             delete correlationDict.take(pair.toString());
+            computationFinished.wakeAll();
             mutex.unlock();
 
             clusterNotAvailable = true;
@@ -3122,9 +2816,11 @@ Data::Status Data::getCorrelograms(Pair& pair,int binSize,int timeWindow,double
         if(clusterNotAvailable) return NOT_AVAILABLE;
 
 
-        //Compute the correlogram.
+        //Compute the correlogram, the spike times being read in the features.
+        featuresLock.lockForRead();
         if(!autoCorrelogram) correlation->calculateCorrelation(spikesOfCluster1,spikesOfCluster2,binSizeInRU,timeWindowInRU,halfBins,autoCorrelogram);
         else correlation->calculateCorrelation(spikesOfCluster1,spikesOfCluster1,binSizeInRU,timeWindowInRU,halfBins,autoCorrelogram);
+        featuresLock.unlock();
 
         //If cluster1 or cluster2 have been suppress or modifed after the thread calling this function has been launched
         //skip this pair.
@@ -3142,6 +2838,7 @@ Data::Status Data::getCorrelograms(Pair& pair,int binSize,int timeWindow,double
             correlationsInProcess.removeProcess(static_cast<dataType>(cluster2));
             delete correlationDict.take(pair.toString()); //if the clusters do not exist anymore they would not have been
             //removed in cleanCorrelation
+            computationFinished.wakeAll();
             mutex.unlock();
             return NOT_AVAILABLE;
         }
@@ -3150,6 +2847,7 @@ Data::Status Data::getCorrelograms(Pair& pair,int binSize,int timeWindow,double
             mutex.lock();
             correlationsInProcess.removeProcess(static_cast<dataType>(cluster1));
             delete correlationDict.take(pair.toString());
+            computationFinished.wakeAll();
             mutex.unlock();
             clusterNotAvailable = true;
         }
@@ -3157,6 +2855,7 @@ Data::Status Data::getCorrelograms(Pair& pair,int binSize,int timeWindow,double
             mutex.lock();
             correlationsInProcess.removeProcess(static_cast<dataType>(cluster2));
             delete correlationDict.take(pair.toString());
+            computationFinished.wakeAll();
             mutex.unlock();
             clusterNotAvailable = true;
         }
@@ -3166,6 +2865,7 @@ Data::Status Data::getCorrelograms(Pair& pair,int binSize,int timeWindow,double
 
             //Update the status
             correlation->setStatus(READY);
+            computationFinished.wakeAll();
 
             //Update the correlation status of the cluster1 and cluster2.
             correlationsInProcess.removeProcess(static_cast<dataType>(cluster1));
@@ -3177,9 +2877,23 @@ Data::Status Data::getCorrelograms(Pair& pair,int binSize,int timeWindow,double
     return READY;
 }
 
-void Data::Correlation::calculateCorrelation(SortableTable& spikesOfCluster1,SortableTable& spikesOfCluster2,double binSizeInRU,double timeWindowInRU,int halfBins,bool autoCorrelogram){
-    dataType cluster1NbSpikesPlusOne = spikesOfCluster1.nbOfColumns() + 1;
-    dataType cluster2NbSpikes = spikesOfCluster2.nbOfColumns();
+void Data::waitForCorrelograms(const Pair& pair,int binSize,int timeWindow,const volatile bool* cancelFlag){
+    QString pairKey = pair.toString();
+    QString parametersKey = Pair(binSize,timeWindow).toString();
+    mutex.lock();
+    while(cancelFlag == 0L || !*cancelFlag){
+        QHash<QString, Correlation*>* dict = correlationDict.value(pairKey);
+        Correlation* correlation = (dict != 0L) ? dict->value(parametersKey) : 0L;
+        if(correlation == 0L || correlation->getStatus(binSize,timeWindow) != IN_PROCESS) break;
+        //The thread doing the computation wakes up the waiting threads when it is done, the timeout only bounds the wait.
+        computationFinished.wait(&mutex,kCOMPUTATION_WAIT);
+    }
+    mutex.unlock();
+}
+
+void Data::Correlation::calculateCorrelation(const QVector<dataType>& spikesOfCluster1,const QVector<dataType>& spikesOfCluster2,double binSizeInRU,double timeWindowInRU,int halfBins,bool autoCorrelogram){
+    dataType cluster1NbSpikesPlusOne = spikesOfCluster1.size() + 1;
+    dataType cluster2NbSpikes = spikesOfCluster2.size();
     dataType cluster2NbSpikesPlusOne = cluster2NbSpikes + 1;
     dataType spikeOfCluster2 = 1;
     double timeOfCluster1;
@@ -3386,8 +3100,8 @@ void Data::renumberCorrelation(QMap<int,int>& clusterIdsOldNew){
     mutex.unlock();
 }
 
-long Data::findSpikePosition(double time,SortableTable& spikesOfCluster){
-    dataType clusterNbSpikes = spikesOfCluster.nbOfColumns();
+long Data::findSpikePosition(double time,const QVector<dataType>& spikesOfCluster){
+    dataType clusterNbSpikes = spikesOfCluster.size();
     double currentTime = spikeTime(spikesOfCluster,clusterNbSpikes);
     if(currentTime == time) return clusterNbSpikes;
 
@@ -3443,42 +3157,42 @@ long Data::findSpikePosition(double time,SortableTable& spikesOfCluster){
     return i;
 }
 
-void Data::duplicate(SortableTable* & spikesOfClusterTemp,ClusterInfoMap* & clusterInfoMapTemp){
-    //The mutex protect spikesByCluster and clusterInfoMap so that only one thread can
-    //access them at the time.
+Data::ClusteringSnapshot Data::snapshot(){
     mutex.lock();
-    spikesOfClusterTemp = new SortableTable(*spikesByCluster);
-    clusterInfoMapTemp = new ClusterInfoMap(*clusterInfoMap);
+    ClusteringSnapshot clusters = currentSnapshot;
     mutex.unlock();
+    return clusters;
+}
+
+void Data::publishSnapshot(){
+    //The maps of the snapshot share their data with the current ones, which detach from it when they are modified.
+    currentSnapshot = ClusteringSnapshot(*spikesByCluster,*clusterInfoMap,currentSnapshot.version() + 1);
 }
 
 void Data::createFeatureFile(QList<int>& clustersToRecluster,QFile& fetFile){
     dataType reclusteringNbSpikes = 0;
     //Loop on the selected clusters to calculate the total number of spikes
     QList<int>::iterator iterator;
-    for(iterator = clustersToRecluster.begin(); iterator != clustersToRecluster.end(); ++iterator ){
-        ClusterInfo clusterInfo = (*clusterInfoMap)[static_cast<dataType>(*iterator)];
-        reclusteringNbSpikes += clusterInfo.nbSpikes();
-    }
+    for(iterator = clustersToRecluster.begin(); iterator != clustersToRecluster.end(); ++iterator )
+        reclusteringNbSpikes += spikesByCluster->value(static_cast<dataType>(*iterator)).size();
     reclusteringSpikesByCluster.setSize(reclusteringNbSpikes);//erase any previous data.
 
     //Loop on the selected clusters
     dataType upperInsertionIndex = 1;
     for(iterator = clustersToRecluster.begin(); iterator != clustersToRecluster.end(); ++iterator ){
-        ClusterInfo clusterInfo = (*clusterInfoMap)[static_cast<dataType>(*iterator)];
-        dataType firstSpikePosition = clusterInfo.firstSpikePosition();
-        dataType nbSpikesOfCluster = clusterInfo.nbSpikes();
-        //copy the 2 rows of spikesByCluster for the given cluster
-        memcpy(&(reclusteringSpikesByCluster)(1,upperInsertionIndex),
-               &(*spikesByCluster)(1,firstSpikePosition),
-               nbSpikesOfCluster * sizeof(dataType));
-        memcpy(&(reclusteringSpikesByCluster)(2,upperInsertionIndex),
-               &(*spikesByCluster)(2,firstSpikePosition),
-               nbSpikesOfCluster * sizeof(dataType));
+        dataType clusterId = static_cast<dataType>(*iterator);
+        const QVector<dataType> clusterSpikes = spikesByCluster->value(clusterId);
+        dataType nbSpikesOfCluster = clusterSpikes.size();
+        //copy the spikes of the given cluster and its id
+        if(nbSpikesOfCluster > 0)
+            memcpy(&(reclusteringSpikesByCluster)(1,upperInsertionIndex),clusterSpikes.constData(),nbSpikesOfCluster * sizeof(dataType));
+        for(dataType i = 0; i < nbSpikesOfCluster; ++i) reclusteringSpikesByCluster(2,upperInsertionIndex + i) = clusterId;
         upperInsertionIndex += nbSpikesOfCluster;
     }
 
-    //Write all the features to file
+    //Write all the features to file, once they have all been loaded.
+    waitForAllDimensions();
+    features.adviseAccess(FeatureArray::SEQUENTIAL);
     QTextStream fetStream(&fetFile);
     fetStream <<nbDimensions<< endl;
     //loop on all the spikes
@@ -3488,43 +3202,20 @@ void Data::createFeatureFile(QList<int>& clustersToRecluster,QFile& fetFile){
         for(int j = 1; j < nbDimensions;++j) fetStream << features(featuresRowIndex,j)<<" ";
         fetStream << features(featuresRowIndex,nbDimensions)<<endl;
     }
+    features.adviseAccess(FeatureArray::NORMAL);
 }
 
 bool Data::integrateReclusteredClusters(QList<int>& clustersToRecluster,QList<int>& reclusteredClusterList, QFile& clusterFile){
     //Replace the cluster ids in reclusteringSpikesByCluster by the new ones.
     if(!loadReclusteredClusters(clusterFile)) return 0;
 
-    //The new information about the cluster will be inserted in the table pointed by spikesByClusterTemp
-    SortableTable* spikesByClusterTemp = new SortableTable();
-    spikesByClusterTemp->setSize(nbSpikes);
-
-    //Create a new map which will contain the new information about the position of the clusters
-    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap();
-
-    //Iteration on the clusters to copy the unchanged clusters.
-    ClusterInfoMap::Iterator infoMapIterator;
-    dataType upperInsertionIndex = 1;
-
-    //NB: the iterator iterates on the items sorted by their key
-    for(infoMapIterator = clusterInfoMap->begin(); infoMapIterator != clusterInfoMap->end(); ++infoMapIterator){
-        dataType firstSpikePosition = infoMapIterator.value().firstSpikePosition();
-        dataType nbSpikesOfCluster = infoMapIterator.value().nbSpikes();
-        dataType clusterId = infoMapIterator.key();
-
-        //if clustersToRecluster does not contains the current cluster, this cluster is let unchanged
-        //and its information is simply copy as is from spikesByCluster to spikesByClusterTemp
-        if(!clustersToRecluster.contains(static_cast<int>(clusterId))){
-            //copy the 2 rows of spikesByCluster for the given cluster
-            memcpy(&(*spikesByClusterTemp)(1,upperInsertionIndex),
-                   &(*spikesByCluster)(1,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            memcpy(&(*spikesByClusterTemp)(2,upperInsertionIndex),
-                   &(*spikesByCluster)(2,firstSpikePosition),
-                   nbSpikesOfCluster * sizeof(dataType));
-            //Construct the new clusterInfoMap
-            clusterInfoMapTemp->insert(clusterId,ClusterInfo(upperInsertionIndex,nbSpikesOfCluster));
-            upperInsertionIndex += nbSpikesOfCluster;
-        }
+    //The new state starts as a shallow copy of the current one, without the reclustered clusters.
+    SpikesByClusterMap* spikesByClusterTemp = new SpikesByClusterMap(*spikesByCluster);
+    ClusterInfoMap* clusterInfoMapTemp = new ClusterInfoMap(*clusterInfoMap);
+    QList<int>::iterator iterator;
+    for(iterator = clustersToRecluster.begin(); iterator != clustersToRecluster.end(); ++iterator){
+        spikesByClusterTemp->remove(static_cast<dataType>(*iterator));
+        clusterInfoMapTemp->remove(static_cast<dataType>(*iterator));
     }
 
     //Sort by time the spikes of the reclustered clusters.
@@ -3540,28 +3231,22 @@ bool Data::integrateReclusteredClusters(QList<int>& clustersToRecluster,QList<in
         clusters[clusterId]++;
     }
 
-    //Initialize positions, for each clusterId the value is set to the position of the first spike.
-    //The clusters will sorted by clusterId in spikesByClusterTemp. Initialize clusterInfoMapTemp.
-    QMap<dataType,dataType> positions;
+    //Allocate the new clusters and initialize clusterInfoMapTemp.
+    QMap<dataType,QVector<dataType> > reclusteredSpikes;
     QMap<dataType,dataType>::Iterator clusterIterator;
-    int index = upperInsertionIndex;//The first new cluster will start after all the clusters which were not reclustered.
     for(clusterIterator = clusters.begin(); clusterIterator != clusters.end(); ++clusterIterator){
         dataType clusterId = clusterIterator.key();
         reclusteredClusterList.append(static_cast<int>(clusterId));
-        positions[clusterId] =  index;
-        clusterInfoMapTemp->insert(clusterId,ClusterInfo(index,clusterIterator.value()));
-        index += clusterIterator.value();
+        reclusteredSpikes[clusterId].reserve(clusterIterator.value());
+        clusterInfoMapTemp->setNbSpikes(clusterId,clusterIterator.value());
     }
 
-    //Fill spikesByClusterTemp with the data of the reclustered clusters sorted by cluster and by time (<=> position in the fet file)
-    for(dataType i = 1; i < max; ++i){
-        dataType clusterId = reclusteringSpikesByCluster(2,i);
-        dataType position = positions[clusterId];
-        dataType positionInFet = reclusteringSpikesByCluster(1,i);
-        (*spikesByClusterTemp)(1,position) = positionInFet;
-        (*spikesByClusterTemp)(2,position) = clusterId;
-        positions[clusterId] ++;
-    }
+    //Fill the new clusters with the spikes sorted by time (<=> position in the fet file)
+    for(dataType i = 1; i < max; ++i)
+        reclusteredSpikes[reclusteringSpikesByCluster(2,i)].append(reclusteringSpikesByCluster(1,i));
+    QMap<dataType,QVector<dataType> >::ConstIterator reclusteredIterator;
+    for(reclusteredIterator = reclusteredSpikes.constBegin(); reclusteredIterator != reclusteredSpikes.constEnd(); ++reclusteredIterator)
+        spikesByClusterTemp->insert(reclusteredIterator.key(),reclusteredIterator.value());
 
     //clear reclusteringSpikesByCluster
     reclusteringSpikesByCluster.setSize(0,true);
@@ -3573,29 +3258,15 @@ bool Data::integrateReclusteredClusters(QList<int>& clustersToRecluster,QList<in
     //Deal with the undo mechanism
     prepareUndo(spikesByClusterTemp,clusterInfoMapTemp);
 
-    //If the cluster 0 have been recluster (very unlikely), the max and min
-    // dimensions have to be recalculated. If minMaxThread is running, the call
-    //will wait until it finishes before starting the thread again.
-    if(clustersToRecluster.contains(0)){
-        //If the minMaxThread has not finish, wait until it is done
-        while(!minMaxThread->wait()){};
-        //Reset the flag to false so the minMaxThread can do the computation
-        clusterZeroJustModified = false;
-        minMaxThread->setModifiedClusters(clustersToRecluster);
-        minMaxThread->start();
-        dimensionChangedUndo.prepend(true);
-    }
-    else dimensionChangedUndo.prepend(false);
 
     //Remove the waveform and correlation data for the reclustered clusters.
     //If there is not a thread working with them,otherwise advice the thread of the change,by updating waveformStatus and correlationsInProcess
     // and the thread will remove it.
-    QList<int>::iterator iterator;
     for(iterator = clustersToRecluster.begin(); iterator != clustersToRecluster.end(); ++iterator){
         mutex.lock();
         if(waveformStatusMap.contains(*iterator)){
             if(!waveformStatusMap[*iterator].isInProcess()){
-                delete waveformDict.take(QString::fromLatin1("%1").arg(*iterator));
+                delete waveformCache.take(*iterator);
                 waveformStatusMap.remove(*iterator);
             }
             else{
@@ -3621,7 +3292,7 @@ bool Data::integrateReclusteredClusters(QList<int>& clustersToRecluster,QList<in
 bool Data::loadReclusteredClusters(QFile &clusterFile){
     bool firstLine = true;
 
-    dataType highestClusterId = (*spikesByCluster)(2,nbSpikes);
+    dataType highestClusterId = clusterInfoMap->lastKey();
     dataType k = 1;
     while (!clusterFile.atEnd()) {
         QByteArray line = clusterFile.readLine();
@@ -3650,15 +3321,16 @@ bool Data::loadReclusteredClusters(QFile &clusterFile){
 
 void Data::getClusterUserInformation (int pGroup,QMap<int,ClusterUserInformation>& clusterUserInformationMap)const{
     //Iteration on the clusters
-    ClusterInfoMap::Iterator iterator;
+    ClusterInfoMap::ConstIterator iterator;
 
     //NB: the iterator iterates on the items sorted by their key
-    for(iterator = clusterInfoMap->begin(); iterator != clusterInfoMap->end(); ++iterator) {
+    for(iterator = clusterInfoMap->constBegin(); iterator != clusterInfoMap->constEnd(); ++iterator) {
         int clusterId = static_cast<int>(iterator.key());
 
         if(clusterId == 0 || clusterId == 1) continue;
 
-        ClusterUserInformation currentClusterUserInformation = ClusterUserInformation(pGroup,clusterId,iterator.value().getStructure(),iterator.value().getType(),iterator.value().getId(),iterator.value().getQuality(),iterator.value().getNotes());
+        ClusterInfo clusterInformation = clusterInfoMap->clusterInformation(clusterId);
+        ClusterUserInformation currentClusterUserInformation = ClusterUserInformation(pGroup,clusterId,clusterInformation.getStructure(),clusterInformation.getType(),clusterInformation.getId(),clusterInformation.getQuality(),clusterInformation.getNotes());
 
         clusterUserInformationMap.insert(clusterId,currentClusterUserInformation);
     }
@@ -21,17 +21,25 @@
 //Include files of the application
 #include "array.h"
 #include "sortabletable.h"
+#include "featurearray.h"
+#include "spikefile.h"
+#include "polygonmask.h"
+#include "spikeselection.h"
 #include "pair.h"
 #include "types.h"
 #include "clusteruserinformation.h"
+#include "taskpool.h"
 
 //Include files for QT
 #include <QList>
 #include <QHash>
-#include <qregion.h>
+#include <QVector>
+#include <QSharedData>
 #include <qmap.h>
 #include <qfile.h>
 #include <qmutex.h>
+#include <QReadWriteLock>
+#include <qwaitcondition.h>
 #include <qthread.h>
 
 
@@ -41,7 +49,7 @@
 using namespace std;
 
 // forward declaration
-class MinMaxThread;
+class FeatureLoaderThread;
 class WaveformThread;
 class CorrelationThread;
 
@@ -57,7 +65,7 @@ class Data {
 
 
 public:
-    friend class MinMaxThread;
+    friend class FeatureLoaderThread;
     friend class WaveformThread;
     friend class CorrelationThread;
     friend class AutoSaveThread;
@@ -157,11 +165,11 @@ public:
     bool initialize(QFile& featureFile,QFile& clusterFile, long spkFileLength, const QString &spkFileName, QFile& parFile, int electrodeGroupID, QString& errorInformation);
 
     /**Calculate the minimum and maximum for each dimension and store them in
-  *dimensionMinima and dimensionMaxima respectively.
-  * @param modifiedClusters list of the clusters which have been modified implying
-  * the modification of the cluster 0 this the recalculation of the minima and maxima.
+  *dimensionMinima and dimensionMaxima respectively. The ranges of the clusters which
+  *have changed since the last call are computed in the background, the others are reused.
+  *dimensionMinima and dimensionMaxima are updated once the ranges of all the clusters are known.
   */
-    void minMaxDimensionCalculation(QList<int> modifiedClusters);
+    void minMaxDimensionCalculation();
 
     /**
   * Creates a new cluster out of existing ones.
@@ -177,7 +185,7 @@ public:
   * @return the number of the newly created cluster or 0 if no cluster have been created (no spikes selected).
   * This is safe as cluster 0 (artifact) can never be created that way.
   */
-    dataType createNewCluster(QRegion& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY, QList <int>& fromClusters,QList <int>& emptyClusters);
+    dataType createNewCluster(const PolygonMask& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY, QList <int>& fromClusters,QList <int>& emptyClusters);
 
     /**
   * Creates a new clusters out of existing ones. If the polygon of selection contains x clusters
@@ -192,7 +200,7 @@ public:
   * @return a map where the keys are ids of the clusters which really contained spikes in the region
   * and the values are the ids of the newly created clusters.
   */
-    QMap<int,int> createNewClusters(QRegion& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY,QList <int>& emptyClusters);
+    QMap<int,int> createNewClusters(const PolygonMask& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY,QList <int>& emptyClusters);
 
     /**
   * Removes spikes from some clusters and assign them to the cluster @p destinationCluster
@@ -208,7 +216,7 @@ public:
   * @param emptyClusters an empty list used as a return value, which will be filled
   * with the cluster numbers which became empty because all their spikes were put in the new one.
   */
-    void deleteSpikesFromClusters(QRegion& region, const QList <int>& clustersOfOrigin, int destinationCluster, int dimensionX, int dimensionY, QList <int>& fromClusters,QList <int>& emptyClusters);
+    void deleteSpikesFromClusters(const PolygonMask& region, const QList <int>& clustersOfOrigin, int destinationCluster, int dimensionX, int dimensionY, QList <int>& fromClusters,QList <int>& emptyClusters);
 
     /**
   * Deletes the clusters contained in @p clustersToDelete. The correponding spikes are assign to cluster 1 (the noise)
@@ -291,7 +299,7 @@ public:
     * coordinate system into consideration, the ordinate coordinate is the opposite of the raw data.
     */
         QPoint operator()(dataType dimensionX, dataType dimensionY) const{
-            dataType featuresRowIndex = (*data.spikesByCluster)(1,index);
+            dataType featuresRowIndex = spikes[index];
             return QPoint(data.features(featuresRowIndex,dimensionX),
                           - data.features(featuresRowIndex,dimensionY));
         }
@@ -301,26 +309,25 @@ public:
     * @return the value of the feature.
     */
         dataType operator()(dataType dimension) const{
-            return data.features((*data.spikesByCluster)(1,index),dimension);
+            return data.features(spikes[index],dimension);
         }
         /**Increments the iterator.*/
         void next(){index++;}
         /**Check if there is more spikes*/
-        bool hasNext(){return (lastIndex >= index);}
+        bool hasNext(){return (index < spikes.size());}
 
     private:
-        Iterator(dataType clusterId, const Data& d):data(d),clusterId(clusterId){
-            ClusterInfo clusterInfo = (*data.clusterInfoMap)[clusterId];
-            index = clusterInfo.firstSpikePosition();
-            lastIndex = index + clusterInfo.nbSpikes() - 1;
+        Iterator(dataType clusterId, const Data& d):data(d),clusterId(clusterId),index(0){
+            spikes = data.spikesByCluster->value(clusterId);
         }
         /**Returns true if the iterator has reach the last spike for the cluster on which it iterates,
       * false otherwise.
       */
         const Data& data;
         dataType clusterId;
-        dataType index;
-        dataType lastIndex;
+        /**Spikes of the cluster, shared with the distribution current at the creation of the iterator.*/
+        QVector<dataType> spikes;
+        int index;
     };
 
     /** Returns the list of cluster Ids.*/
@@ -380,12 +387,13 @@ public:
   * and then the data are coded on 4 bytes).*/
     bool isRecordingTwoBytes(){return isTwoBytesRecording;}
 
-    /**Gets a onr row SortableTable with the spike positions for the cluster @p clusterId.
+    /**Gets the spike positions for the cluster @p clusterId, sorted by time.
+  * The returned vector shares its data with the current distribution of the spikes, no copy is made.
   * @param clusterId d of the cluster for which the spike position are search.
-  * @param subsetTable the array where the result of the search will be store.
+  * @param spikes the vector where the result of the search will be store.
   * @return true if the cluster exist and the data have been retreive, false otherwise.
   */
-    bool spikePositions(int clusterId,SortableTable& subsetTable);
+    bool spikePositions(int clusterId,QVector<dataType>& spikes);
 
     /**Returns the number of points corresponding to a spike. This equals to:
   * nbChannels * nbSamplesInWaveform
@@ -396,16 +404,96 @@ public:
   * @param clusterId id of the cluster for which the number of spikes is requested.
   * @return the number of spikes of the cluster @p clusterId.
   */
-    dataType nbOfSpikes(dataType clusterId){
-        ClusterInfo currentClusterInfo = (*clusterInfoMap)[clusterId];
-        return currentClusterInfo.nbSpikes();
-    }
+    dataType nbOfSpikes(dataType clusterId){return clusterInfoMap->nbSpikes(clusterId);}
 
     /**Returns the total number of spikes.
   * @return the total number of spikes.
   */
     dataType totalNbOfSpikes() const{return nbSpikes;}
 
+    /**Sets the name of the binary feature cache to use when loading the features.
+  * If the cache is valid for the feature file, it is mapped in memory instead of parsing the
+  * feature file, otherwise the feature file is parsed and the cache is (re)written.
+  * An empty name disables the cache.
+  * @param cacheFileName name of the binary feature cache file.
+  */
+    void setFeatureCacheFileName(const QString& cacheFileName){featureCacheFileName = cacheFileName;}
+
+    /**Sets the storage order of the features, spike by spike or dimension by dimension.
+  * Storing the dimensions contiguously speeds up the projections and the statistics computed on a few dimensions.
+  * @param layout storage order of the features.
+  */
+    void setFeatureLayout(FeatureArray::Layout layout){features.setLayout(layout);}
+
+    /**Sets the out-of-core mode for the features: the features are held in memory-mapped files
+  * (next to the feature cache) paged by the system instead of the memory. To be called before initialize().
+  * @param outOfCore true to use the out-of-core mode, false to keep the features in memory.
+  */
+    void setFeaturesOutOfCore(bool outOfCore){featuresOutOfCore = outOfCore;}
+
+    /**Advises the system on the way the features are going to be accessed, this only
+  * matters when the features are memory-mapped.
+  * @param pattern expected access pattern.
+  */
+    void adviseFeatureAccess(FeatureArray::AccessPattern pattern) const{features.adviseAccess(pattern);}
+
+    /**Sets the number of dimensions loaded by initialize(), in addition to the time. The other dimensions
+  * are loaded in the background once the document is open. To be called before initialize().
+  * @param nbDimensions number of dimensions to load before opening the document, 0 to load them all.
+  */
+    void setLazyFeatureDimensions(int nbDimensions){lazyFeatureDimensions = nbDimensions;}
+
+    /**Returns true if the values and the minimum and maximum of the dimension @p dimension are available.
+  * @param dimension dimension to check, starting at 1.
+  */
+    bool isDimensionLoaded(int dimension);
+
+    /**Waits until the values and the minimum and maximum of the dimension @p dimension are available.
+  * This returns immediately unless the dimension is still being loaded in the background, in which case it waits
+  * until all the remaining dimensions are loaded.
+  * @param dimension dimension to wait for, starting at 1.
+  */
+    void waitForDimension(int dimension);
+
+    /**Waits until all the dimensions are available.*/
+    void waitForAllDimensions();
+
+    /**Sets the object to which the FeatureLoaderThread posts an event once all the dimensions have been loaded in the background.
+  * On this event, useCompactFeatures() has to be called from the GUI thread.
+  * @param receiver object receiving the event, 0 if none.
+  */
+    void setFeatureLoadingReceiver(QObject* receiver){featureLoadingReceiver = receiver;}
+
+    /**Once all the dimensions have been loaded in the background, replaces the full-width table used while loading
+  * by the compacted binary cache written at the end of the loading, or compacts it if the cache could not be written.
+  * The ranges of the clusters computed without all the dimensions are then computed again in the background.
+  * Does nothing if the dimensions have not been loaded in the background or the table has already been replaced.
+  * To be called in the GUI thread.
+  * @return false if a computing thread is reading the features, the call has then to be made again later.
+  */
+    bool useCompactFeatures();
+
+    /**Stages of the loading done by initialize(), in the order in which they are done.*/
+    enum LoadingStage{LOADING_PARAMETERS=0,LOADING_CLUSTERS=1,LOADING_FEATURES=2,BUILDING_LAYOUT=3,COMPUTING_MIN_MAX=4,NB_LOADING_STAGES=5};
+
+    /**
+  * Interface of the objects following the loading done by initialize(), which can also cancel it.
+  * The methods are called from the thread calling initialize().
+  */
+    class LoadingMonitor{
+    public:
+        virtual ~LoadingMonitor(){}
+        /**Called at the beginning of each stage of the loading.*/
+        virtual void loadingStageStarted(LoadingStage stage) = 0;
+        /**Returns the flag which is set to true to cancel the loading.*/
+        virtual const volatile bool* cancelFlag() const = 0;
+    };
+
+    /**Sets the object following the loading done by initialize().
+  * @param monitor the object to notify, 0 if none.
+  */
+    void setLoadingMonitor(LoadingMonitor* monitor){loadingMonitor = monitor;}
+
     /**
   * String indicating in scale mode the user is using (raw, scale by the maximum,
   * scale by the shoulder) in the correlationView.
@@ -434,15 +522,11 @@ public:
     void setUserClusterInformation(int clusterId, QString structure,
                                           QString	type,QString ID, QString	quality, QString notes){
         if((*clusterInfoMap).contains(static_cast<dataType>(clusterId))){
-            ClusterInfo currentClusterInfo = (*clusterInfoMap)[static_cast<dataType>(clusterId)];
-
-            currentClusterInfo.setStructure(structure);
-            currentClusterInfo.setType(type);
-            currentClusterInfo.setId(ID);
-            currentClusterInfo.setQuality(quality);
-            currentClusterInfo.setNotes(notes);
-
-            clusterInfoMap->insert(static_cast<dataType>(clusterId),currentClusterInfo);
+            ClusterInfo currentClusterInfo(structure,type,ID,quality,notes);
+            mutex.lock();
+            clusterInfoMap->setClusterInformation(static_cast<dataType>(clusterId),currentClusterInfo);
+            publishSnapshot();
+            mutex.unlock();
         }
     }
 
@@ -458,7 +542,7 @@ public:
     void getUserClusterInformation(int clusterId,QList<QString>& clusterInformation){
 
         if((*clusterInfoMap).contains(static_cast<dataType>(clusterId))){
-            ClusterInfo currentClusterInfo = (*clusterInfoMap)[static_cast<dataType>(clusterId)];
+            ClusterInfo currentClusterInfo = clusterInfoMap->clusterInformation(static_cast<dataType>(clusterId));
 
             clusterInformation.append(currentClusterInfo.getStructure());
             clusterInformation.append(currentClusterInfo.getType());
@@ -517,14 +601,82 @@ public:
     /**Returns the list of channels of the current electrode.*/
     QList<int>& getCurrentChannels(){return currentChannels;}
 
-private:
-
     /**
   * String indicating what is the status of the processing of the waveform information.
   */
     enum Status{NOT_AVAILABLE=1,IN_PROCESS=2,READY=3};
 
-    MinMaxThread* minMaxThread;
+    /**
+  * Gets the waveform points for cluster @p clusterId in the sample mode.
+  * Take a sample of the spikes evenly distributed on all the recording.
+  * @param clusterId id of the cluster to get waveform information for.
+  * @param nbSpkToDisplay number of spikes to display.
+  * @return the status, READY if the data have already been collected or the current collection is finish,
+  * and IN_PROCESS if an other thread is already treating @p clusterId.
+  */
+    Status getSampleWaveformPoints(int clusterId,dataType nbSpkToDisplay);
+
+    /**
+  * Gets the waveform points for cluster @p clusterId in time frame mode.
+  * Take all the spikes in a given time frame.
+  * @param clusterId id of the cluster to get waveform information for.
+  * @param start starting time in second
+  * @param end ending time in second.
+  * @return the status, READY if the data have already been collected or the current collection is finish,
+  * and IN_PROCESS if an other thread is already treating that cluster.
+  */
+    Status getTimeFrameWaveformPoints(int clusterId,dataType start,dataType end);
+
+    /**
+  * Calculates the mean and the standard deviation for cluster @p clusterId in the sample mode.
+  * In that mode, the spikes used are a sample of the spikes evenly distributed on all the recording.
+  * @param clusterId id of the cluster to calculate the data for.
+  * @param nbSpkToDisplay number of spikes diplayed.
+  * @return the status, READY if the data have already been calculated or the current calculation is finish,
+  * IN_PROCESS if an other thread is already treating that cluster and NOT_AVAILABLE
+  * if the spikes have not been collected yet.
+  */
+    Status calculateSampleMean(int clusterId,dataType nbSpkToDisplay);
+
+    /**
+  * Calculates the mean and the standard deviation for cluster @p clusterId in the time frame mode.
+  * In that mode, all the spikes in a given time frame are selected.
+  * @param clusterId id of the cluster to calculate the data for.
+  * @param start starting time in second
+  * @param end ending time in second.
+  * @return the status, READY if the data have already been calculated or the current calculation is finish,
+  * IN_PROCESS if an other thread is already treating that cluster and NOT_AVAILABLE
+  * if the spikes have not been collected yet.
+  */
+    Status calculateTimeFrameMean(int clusterId,dataType start,dataType end);
+
+    /**Sets the memory the waveforms of the clusters can use. Above it, the waveforms of the least recently
+  * used clusters are discarded, except the ones in process. They are collected again if asked for.
+  * @param nbBytes memory budget in bytes.
+  */
+    void setWaveformCacheBudget(qint64 nbBytes);
+
+    /**Returns the number of requests for waveforms served by the waveforms already collected.*/
+    qint64 waveformCacheHits();
+
+    /**Returns the number of requests for waveforms for which the waveforms had to be collected.*/
+    qint64 waveformCacheMisses();
+
+    /**Returns the number of bytes used by the waveforms currently stored.*/
+    qint64 waveformCacheMemoryUsage();
+
+    /**
+  * Discards the waveforms of the least recently used clusters until the memory used by the waveforms is within the budget.
+  * The waveforms of the clusters in @p shownClusters and the ones used by a computation are kept.
+  * To be called in the GUI thread when no WaveformIterator exists, typically before drawing the waveforms.
+  * @param shownClusters clusters presented in a view, whose waveforms have to stay available.
+  */
+    void evictWaveforms(const QList<int>& shownClusters);
+
+private:
+
+    /**Thread loading the dimensions which have not been loaded by initialize(), 0 if there are none.*/
+    FeatureLoaderThread* featureLoaderThread;
 
     int nbChannels;
     int nbSamplesInWaveform;
@@ -549,6 +701,34 @@ private:
     int nbTotalElectrodes;
     int nbBits;
     QString spkFileName;
+    /**Read-only mapping of the spike file, shared by the waveform extractions.*/
+    SpikeFile spikeFile;
+    /**Name of the binary cache of the feature file, empty if no cache is used.*/
+    QString featureCacheFileName;
+    /**True if the features are held in memory-mapped files rather than in memory.*/
+    bool featuresOutOfCore;
+    /**Number of dimensions loaded by initialize(), in addition to the time, 0 if they are all loaded.*/
+    int lazyFeatureDimensions;
+    /**Offset of the first value in the feature file, used to parse the remaining dimensions.*/
+    qint64 featureValuesOffset;
+    /**Name of the feature file, used to parse the remaining dimensions.*/
+    QString featureFileName;
+    /**For each dimension, true if it has been loaded by initialize(). Empty if all the dimensions have been loaded.*/
+    QVector<bool> initiallyLoadedDimensions;
+    /**True once the remaining dimensions and their minimum and maximum are available.*/
+    bool remainingDimensionsLoaded;
+    /**Set to stop the loading of the remaining dimensions.*/
+    volatile bool featureLoadingCancelled;
+    /**Object following the loading done by initialize(), 0 if none.*/
+    LoadingMonitor* loadingMonitor;
+    /**Protects remainingDimensionsLoaded.*/
+    QMutex featureLoadingMutex;
+    /**Wakes up the threads waiting for the remaining dimensions.*/
+    QWaitCondition featureLoadingCondition;
+    /**Object to which the end of the loading of the remaining dimensions is posted, 0 if none.*/
+    QObject* featureLoadingReceiver;
+    /**True once the remaining dimensions have been loaded and until useCompactFeatures() has compacted the features.*/
+    bool featuresToCompact;
     int voltageRange;
     int amplification;
     int initialOffset;
@@ -576,31 +756,35 @@ private:
   * the max of the to previous data
   * the width of the spike
   * the time of the spike
+  * Each dimension is stored on the narrowest integer width holding its values,
+  * the values are read through features(row,dimension).
   */
 
-    Array<dataType> features;
-    /**
-  * A two line array which contains sorted by cluster numbers and then by time:
-  * the row index of the spike in features
-  * the id of the cluster
+    FeatureArray features;
+
+    /**Held for reading by the computations reading the features outside the GUI thread (waveforms in time frame mode,
+  * correlograms, error matrix and ranges of the clusters), and for writing by useCompactFeatures() when it replaces the table.
   */
-    SortableTable* spikesByCluster;
+    QReadWriteLock featuresLock;
 
-    /**Represents a list of clusterInfoMap
-  * use to enable undo action.
+    /**Spikes of each cluster.
+  * key: cluster number
+  * value: the row index in features of the spikes of the cluster, sorted by time (<=> row index).
   */
-    QList<SortableTable*> spikesByClusterUndoList;
+    typedef QMap<dataType,QVector<dataType> > SpikesByClusterMap;
 
-    /**Represents a list of clusterInfoMap
-  * use to enable redo action.
+    /**
+  * Contains the spikes of each cluster. The vectors are implicitly shared, so a copy of the map
+  * only references the spikes: a modification of the clusters copies the map and only allocates
+  * the vectors of the clusters it changes, the other ones staying shared with the previous map.
   */
-    QList<SortableTable*> spikesByClusterRedoList;
+    SpikesByClusterMap* spikesByCluster;
+
+    /**Cluster id of each spike, in the order of the cluster file. Only used while loading the clusters.*/
+    QVector<dataType> spikeClusterIds;
 
     /**
-  * Represents information on a cluster:
-  * the index of the first spike of a given cluster number in spikesByCluster
-  * the number of spikes of the cluster
-  * and optionnally information added by the user:
+  * Represents the information added by the user on a cluster:
   * the structure where the cluster is located
   * the type of the unit
   * the isolation distance
@@ -612,13 +796,7 @@ private:
     public:
         ClusterInfo(const QString& pStructure = QString(), const QString& pType = QString(),const QString& pID = QString(),const QString& pQuality = QString(),const QString& pNotes = QString())
             :structure(pStructure),type(pType),ID(pID),quality(pQuality),notes(pNotes){}
-        ClusterInfo(dataType position, dataType nb,QString pStructure = QString(),QString pType = QString(),QString pID = QString(),QString pQuality = QString(),QString pNotes =QString())
-            :position(position),spikeNb(nb),structure(pStructure),type(pType),ID(pID),quality(pQuality),notes(pNotes){}
         ~ClusterInfo(){}
-         dataType firstSpikePosition() const {return position;}
-         dataType nbSpikes() const {return spikeNb;}
-         void setNbSpikes(dataType nbSpikes){spikeNb = nbSpikes;}
-         void setFirstSpikePosition(dataType position){this->position = position;}
 
          QString getStructure() const { return structure; }
          QString getType() const { return type; }
@@ -632,10 +810,10 @@ private:
          void setQuality(const QString& pQuality) { quality = pQuality; }
          void setNotes(const QString& pNotes) { notes = pNotes; }
 
-    private:
-        dataType position;
-        dataType spikeNb;
+         /**Returns true if the user has not given any information.*/
+         bool isEmpty() const {return structure.isEmpty() && type.isEmpty() && ID.isEmpty() && quality.isEmpty() && notes.isEmpty();}
 
+    private:
         QString		structure;
         QString		type;
         /**Isolation Distance*/
@@ -644,44 +822,283 @@ private:
         QString		notes;
     } ;
 
-    typedef QMap<dataType,ClusterInfo> ClusterInfoMap;
-
-    /**Contains ClusterInfo
-  * key: cluster number
-  * value: a ClusterInfo (which gives:
-  * the index of the first spike in spikesByCluster and the number of spikes for a given cluster)
+    /**
+  * Represents the existing clusters: the number of spikes of each cluster, in an array indexed
+  * by the cluster id, and in a separate table the information added by the user on some of them.
+  * The lookups of the number of spikes neither walk a tree nor copy strings, and as both tables are
+  * implicitly shared, a copy only costs a reference count until it is modified, and then a flat copy of the array.
+  * The array only covers the ids in proportion with the number of clusters, the few clusters with larger ids
+  * are kept in a map.
   */
+    class ClusterInfoMap {
+
+    public:
+        /**Iterates on the existing clusters by increasing id, those of the array then those of the map.*/
+        class ConstIterator {
+        public:
+            ConstIterator():spikeNbs(0L),size(0),position(0){}
+            dataType key() const {return position < size ? position : sparse.key();}
+            dataType nbSpikes() const {return position < size ? spikeNbs[position] : sparse.value();}
+            ConstIterator& operator++(){
+                if(position < size){
+                    do ++position; while(position < size && spikeNbs[position] < 0);
+                }
+                else ++sparse;
+                return *this;
+            }
+            bool operator==(const ConstIterator& other) const {return position == other.position && sparse == other.sparse;}
+            bool operator!=(const ConstIterator& other) const {return !(*this == other);}
+
+        private:
+            friend class ClusterInfoMap;
+            ConstIterator(const dataType* spikeNbs,dataType size,dataType position,QMap<dataType,dataType>::const_iterator sparse)
+                :spikeNbs(spikeNbs),size(size),position(position),sparse(sparse){}
+            const dataType* spikeNbs;
+            dataType size;
+            dataType position;
+            QMap<dataType,dataType>::const_iterator sparse;
+        };
+
+        ClusterInfoMap():nbClusters(0){}
+
+        /**Returns true if the cluster @p clusterId exists.*/
+        bool contains(dataType clusterId) const{
+            if(clusterId >= 0 && clusterId < spikeNbs.size()) return spikeNbs[clusterId] >= 0;
+            return sparseSpikeNbs.contains(clusterId);
+        }
+
+        /**Returns the number of spikes of the cluster @p clusterId, 0 if it does not exist.*/
+        dataType nbSpikes(dataType clusterId) const{
+            if(clusterId >= 0 && clusterId < spikeNbs.size()) return spikeNbs[clusterId] < 0 ? 0 : spikeNbs[clusterId];
+            return sparseSpikeNbs.value(clusterId,0);
+        }
+
+        /**Sets the number of spikes of the cluster @p clusterId, adding the cluster if it does not exist yet.*/
+        void setNbSpikes(dataType clusterId,dataType nbSpikes){
+            if(clusterId >= spikeNbs.size() && clusterId >= 0 && clusterId < maxDenseSize()){
+                //Extend the array up to the cluster, taking over the clusters of the map it now covers.
+                dataType size = spikeNbs.size();
+                spikeNbs.resize(static_cast<int>(clusterId) + 1);
+                for(dataType i = size; i <= clusterId; ++i) spikeNbs[i] = -1;
+                while(!sparseSpikeNbs.isEmpty() && sparseSpikeNbs.constBegin().key() <= clusterId){
+                    QMap<dataType,dataType>::iterator first = sparseSpikeNbs.begin();
+                    spikeNbs[first.key()] = first.value();
+                    sparseSpikeNbs.erase(first);
+                }
+            }
+            if(clusterId >= 0 && clusterId < spikeNbs.size()){
+                if(spikeNbs[clusterId] < 0) ++nbClusters;
+                spikeNbs[clusterId] = nbSpikes;
+            }
+            else{
+                if(!sparseSpikeNbs.contains(clusterId)) ++nbClusters;
+                sparseSpikeNbs.insert(clusterId,nbSpikes);
+            }
+        }
+
+        /**Removes the cluster @p clusterId and the information added by the user on it.*/
+        void remove(dataType clusterId){
+            if(!contains(clusterId)) return;
+            --nbClusters;
+            userInformation.remove(clusterId);
+            if(clusterId >= spikeNbs.size()){
+                sparseSpikeNbs.remove(clusterId);
+                return;
+            }
+            spikeNbs[clusterId] = -1;
+            //The array ends with the last existing cluster it covers.
+            dataType size = spikeNbs.size();
+            while(size > 0 && spikeNbs[size - 1] < 0) --size;
+            spikeNbs.resize(static_cast<int>(size));
+        }
+
+        /**Returns the number of clusters.*/
+        int count() const {return nbClusters;}
+
+        /**Returns the biggest cluster id.*/
+        dataType lastKey() const {return sparseSpikeNbs.isEmpty() ? spikeNbs.size() - 1 : sparseSpikeNbs.lastKey();}
+
+        /**Returns the list of the cluster ids, sorted.*/
+        QList<dataType> keys() const{
+            QList<dataType> clusterIds;
+            for(ConstIterator iterator = constBegin(); iterator != constEnd(); ++iterator) clusterIds.append(iterator.key());
+            return clusterIds;
+        }
+
+        ConstIterator constBegin() const{
+            dataType position = 0;
+            while(position < spikeNbs.size() && spikeNbs[position] < 0) ++position;
+            return ConstIterator(spikeNbs.constData(),spikeNbs.size(),position,sparseSpikeNbs.constBegin());
+        }
+        ConstIterator constEnd() const {return ConstIterator(spikeNbs.constData(),spikeNbs.size(),spikeNbs.size(),sparseSpikeNbs.constEnd());}
+
+        /**Returns the information added by the user on the cluster @p clusterId, empty if there is none.*/
+        ClusterInfo clusterInformation(dataType clusterId) const {return userInformation.value(clusterId);}
+
+        /**Sets the information added by the user on the existing cluster @p clusterId.*/
+        void setClusterInformation(dataType clusterId,const ClusterInfo& information){
+            if(!contains(clusterId)) return;
+            if(information.isEmpty()) userInformation.remove(clusterId);
+            else userInformation.insert(clusterId,information);
+        }
+
+    private:
+        /**Size up to which the array can grow, in proportion with the number of clusters.*/
+        dataType maxDenseSize() const {return qMax(static_cast<dataType>(1024),static_cast<dataType>(4) * (nbClusters + 1));}
+
+        /**Number of spikes of each cluster, indexed by the cluster id, -1 for the ids which are not used.*/
+        QVector<dataType> spikeNbs;
+        /**Number of spikes of the clusters whose id is beyond the array.*/
+        QMap<dataType,dataType> sparseSpikeNbs;
+        int nbClusters;
+        /**Information added by the user, only for the clusters which have some.*/
+        QMap<dataType,ClusterInfo> userInformation;
+    };
+
+    /**Contains the number of spikes and the user information of each cluster.*/
     ClusterInfoMap* clusterInfoMap;
 
-    /**Represents a list of clusterInfoMap
+    /**
+  * Read-only version of the distribution of the spikes among the clusters, for the threads reading it in the background.
+  * Each change of the clusters publishes a new version, the ones held by the readers staying unchanged, so a reader
+  * gets a consistent view without any copy and does not need to lock anything while it works on it.
+  * Copying a snapshot only increments a reference count.
+  */
+    class ClusteringSnapshot {
+
+    public:
+        ClusteringSnapshot():state(new State()){}
+
+        /**Returns the spikes of each cluster.*/
+        const SpikesByClusterMap& spikesByCluster() const {return state->spikesByCluster;}
+        /**Returns the number of spikes and the user information of each cluster.*/
+        const ClusterInfoMap& clusterInfoMap() const {return state->clusterInfoMap;}
+        /**Returns the number of the version, which increases with each change of the clusters.*/
+        long version() const {return state->version;}
+
+    private:
+        friend class Data;
+
+        class State : public QSharedData {
+        public:
+            State():version(0){}
+            State(const SpikesByClusterMap& spikes,const ClusterInfoMap& clusters,long version)
+                :spikesByCluster(spikes),clusterInfoMap(clusters),version(version){}
+            SpikesByClusterMap spikesByCluster;
+            ClusterInfoMap clusterInfoMap;
+            long version;
+        };
+
+        ClusteringSnapshot(const SpikesByClusterMap& spikes,const ClusterInfoMap& clusters,long version)
+            :state(new State(spikes,clusters,version)){}
+
+        /**Only accessed through const methods, the state is never detached.*/
+        QSharedDataPointer<State> state;
+    };
+
+    /**Last published version of the distribution of the spikes among the clusters, protected by the mutex.*/
+    ClusteringSnapshot currentSnapshot;
+
+    /**Minimum and maximum of each dimension but the time over the spikes of a cluster.*/
+    class ClusterRanges {
+
+    public:
+        ClusterRanges():complete(false){}
+
+        /**Spikes of the cluster, which keeps them alive as long as the ranges are cached.*/
+        QVector<dataType> spikes;
+        /**Minimum and maximum of each dimension, dimension 1 being at index 0.*/
+        QVector<dataType> minima;
+        QVector<dataType> maxima;
+        /**True if all the dimensions were loaded when the ranges were computed.*/
+        bool complete;
+    };
+
+    /**
+  * Difference between the current distribution of the spikes among the clusters and another one
+  * (the previous one for an undo, the next one for a redo). A modified cluster is stored either as the spikes which
+  * changed of cluster, with their position in the cluster, or as the spikes of the cluster in the other state,
+  * which are shared with that state and so are not copied. The smaller of the two is kept.
+  */
+    class ClusteringDelta {
+
+    public:
+        /**Spikes removed from and added to a cluster, positions starting at 0 in the cluster.*/
+        class ClusterChange {
+        public:
+            ClusterChange():replaced(false){}
+
+            /**True if the cluster of the other state is given by spikes, false if it is given by the positions below.*/
+            bool replaced;
+            /**Spikes of the cluster in the other state, shared with it.*/
+            QVector<dataType> spikes;
+            /**Positions, in increasing order, in the current cluster of the spikes which are not in the other state.*/
+            QVector<dataType> removedPositions;
+            QVector<dataType> removedSpikes;
+            /**Positions, in increasing order, in the cluster of the other state of the spikes which are not in the current one.*/
+            QVector<dataType> addedPositions;
+            QVector<dataType> addedSpikes;
+            /**Ranges of the cluster in the other state, without its spikes. Empty if they were not known when the delta was created.*/
+            ClusterRanges ranges;
+        };
+
+        ClusteringDelta():clusterInfoMap(0L){}
+        ~ClusteringDelta(){delete clusterInfoMap;}
+
+        /**Information on the clusters of the other state.*/
+        ClusterInfoMap* clusterInfoMap;
+        /**Current id of the clusters renumbered between the two states, given by their id in the other state.*/
+        QMap<int,int> currentIds;
+        /**Changes of the modified clusters, given by their id in the other state, or their current id if they do not exist in it.*/
+        QMap<dataType,ClusterChange> changes;
+    };
+
+    /**Represents a list of ClusteringDelta
   * use to enable undo action.
   */
-    QList<ClusterInfoMap*> clusterInfoMapUndoList;
+    QList<ClusteringDelta*> undoList;
 
-    /**Represents a list of clusterInfoMap
+    /**Represents a list of ClusteringDelta
   * use to enable redo action.
   */
-    QList<ClusterInfoMap*> clusterInfoMapRedoList;
+    QList<ClusteringDelta*> redoList;
 
     /**List of the maximum of each dimension*/
     Array<dataType> dimensionMaxima;
     /**List of the minimum of each dimension*/
     Array<dataType> dimensionMinima;
 
-    /**List of the clusters giving the maximum of each dimension (sorted by dimension)*/
-    QList<int> clustersGivingMaximum;
+    /**Ranges of the clusters of the current state but the cluster 0, used to compute dimensionMinima and dimensionMaxima.
+  * The ranges are identified by the spikes they were computed from, so they follow the clusters through the
+  * renumbering, the undo and the redo, and only the clusters whose spikes have changed are computed again.
+  * Protected by rangesMutex.
+  * key: first spike of the cluster's vector
+  * value: the ClusterRanges of the cluster
+  */
+    QHash<const dataType*,ClusterRanges> clusterRangesCache;
+
+    /**Clusters of the current state whose ranges are not known yet, they are computed by a ClusterRangesTask.
+  * Protected by rangesMutex.
+  * key: first spike of the cluster's vector
+  * value: a ClusterRanges holding only the spikes of the cluster
+  */
+    QHash<const dataType*,ClusterRanges> pendingClusterRanges;
 
-    /**List of the clusters giving the minimum of each dimension (sorted by dimension)*/
-    QList<int> clustersGivingMinimum;
+    /**Protects clusterRangesCache, pendingClusterRanges and clusterRangesRunning.*/
+    QMutex rangesMutex;
 
-    /**QT object providing access serialization between threads*/
-    QMutex mutex;
+    /**True while a ClusterRangesTask is computing the pending ranges.*/
+    bool clusterRangesRunning;
+
+    class ClusterRangesTask;
+    friend class ClusterRangesTask;
 
-    /**List containing the the dimension change status of each action of the undo list*/
-    QList<bool> dimensionChangedUndo;
+    /**Task computing the pending ranges, run in clusterRangesGroup.*/
+    ClusterRangesTask* clusterRangesTask;
+    TaskPool::Group clusterRangesGroup;
 
-    /**List containing the the dimension change status of each action of the redo list*/
-    QList<bool> dimensionChangedRedo;
+    /**QT object providing access serialization between threads*/
+    QMutex mutex;
 
     /**True is the data where recording using a 12 or 16 bits recording system which
   * gives data coded on 2 bytes, false otherwise (the recording is then assume to be 32 bits
@@ -756,9 +1173,11 @@ private:
         virtual dataType getTimeFrameMean(dataType index) const  = 0;
         virtual dataType getSampleStDeviation(dataType index) const  = 0;
         virtual dataType getTimeFrameStDeviation(dataType index) const  = 0;
-        virtual void read(SortableTable& positionOfSpikes,dataType nbSpikesOfCluster,FILE* spikeFile,dataType nbSpkToDisplay) = 0;
-        virtual void read(SortableTable& positionOfSpikes,dataType nbSpikesOfCluster,FILE* spikeFile,dataType& currentSpikeIndex,dataType end) = 0;
+        virtual void read(const QVector<dataType>& positionOfSpikes,dataType nbSpikesOfCluster,const SpikeFile& spikeFile,dataType nbSpkToDisplay) = 0;
+        virtual void read(const QVector<dataType>& positionOfSpikes,dataType nbSpikesOfCluster,const SpikeFile& spikeFile,dataType& currentSpikeIndex,dataType end) = 0;
         virtual void calculateMean(WaveformMode waveformMode) = 0;
+        /**Returns the number of bytes used by the spikes, the means and the standard deviations stored.*/
+        virtual qint64 memoryUsage() const = 0;
 
     protected:
         Waveforms(Data& d,dataType nbSampleSpikes = 0,dataType nbTimeFrameSpikes = 0,dataType index = 0,dataType startTime = 0,dataType endTime = 0):data(d){
@@ -803,6 +1222,8 @@ private:
             timeFrameMeanTable = 0L;
             sampleStDeviationTable = 0L;
             timeFrameStDeviationTable = 0L;
+            sampleTableSize = 0;
+            timeFrameTableSize = 0;
         }
         ~WaveformData(){
             if(sampleSpikesTable != 0L) delete []sampleSpikesTable;
@@ -832,9 +1253,17 @@ private:
         dataType getTimeFrameStDeviation(dataType index) const {
             return static_cast<dataType>(timeFrameStDeviationTable[index]);
         }
-        void read(SortableTable& positionOfSpikes,dataType currentSpikeIndex,FILE* spikeFile,dataType nbSpkToDisplay);
-        void read(SortableTable& positionOfSpikes,dataType nbSpikesOfCluster,FILE* spikeFile,dataType& currentSpikeIndex,dataType end);
+        void read(const QVector<dataType>& positionOfSpikes,dataType currentSpikeIndex,const SpikeFile& spikeFile,dataType nbSpkToDisplay);
+        void read(const QVector<dataType>& positionOfSpikes,dataType nbSpikesOfCluster,const SpikeFile& spikeFile,dataType& currentSpikeIndex,dataType end);
         void calculateMean(WaveformMode waveformMode = SAMPLE);
+        qint64 memoryUsage() const {
+            qint64 nbValues = sampleTableSize + timeFrameTableSize;
+            //A mean table always comes with its standard deviation table.
+            qint64 nbStatisticValues = 2 * data.nbSamplesInWaveform * data.nbChannels;
+            if(sampleMeanTable != 0L) nbValues += nbStatisticValues;
+            if(timeFrameMeanTable != 0L) nbValues += nbStatisticValues;
+            return nbValues * static_cast<qint64>(sizeof(T));
+        }
     private:
         T* sampleSpikesTable;
         T* timeFrameSpikesTable;
@@ -842,6 +1271,10 @@ private:
         T* timeFrameMeanTable;
         T* sampleStDeviationTable;
         T* timeFrameStDeviationTable;
+        /**Number of values allocated in sampleSpikesTable.*/
+        dataType sampleTableSize;
+        /**Number of values allocated in timeFrameSpikesTable.*/
+        dataType timeFrameTableSize;
     } ;
 
 
@@ -851,17 +1284,121 @@ private:
   */
     QMap<int,WaveformStatus> waveformStatusMap;
 
+    /**Wakes up, with the mutex, the threads waiting for waveforms or correlograms computed by another thread.*/
+    QWaitCondition computationFinished;
+
     /**
-  * Dictionary containing the waveform data by cluster. Only the clusters
-  * for which data have been asked are present in this dictionary.
+  * Stores the waveform data by cluster, with the memory they use and their order of use.
+  * Only the clusters for which data have been asked and which have not been discarded since are present.
+  * It is accessed with the mutex locked.
   */
-    QHash<QString, Waveforms*> waveformDict;
+    class WaveformCache{
+    public:
+        WaveformCache():memoryBudget(kDEFAULT_BUDGET),memoryUsed(0),lastUse(0),hits(0),misses(0){}
+        ~WaveformCache(){clear();}
+
+        /**Memory budget used until setBudget is called, in bytes.*/
+        static const qint64 kDEFAULT_BUDGET;
+
+        bool contains(int clusterId) const {return entries.contains(clusterId);}
+
+        /**Returns the waveforms of the cluster @p clusterId, or 0L if there are none, and marks them as the most recently used.*/
+        Waveforms* value(int clusterId){
+            QHash<int,Entry>::iterator iterator = entries.find(clusterId);
+            if(iterator == entries.end()) return 0L;
+            use(clusterId,iterator.value());
+            return iterator.value().waveforms;
+        }
+
+        /**Stores @p waveforms as the ones of the cluster @p clusterId, the cache takes their ownership.*/
+        void insert(int clusterId,Waveforms* waveforms){
+            delete take(clusterId);
+            if(waveforms == 0L) return;
+            Entry entry;
+            entry.waveforms = waveforms;
+            entry.size = waveforms->memoryUsage();
+            entry.lastUse = 0;
+            use(clusterId,entry);
+            memoryUsed += entry.size;
+            entries.insert(clusterId,entry);
+        }
+
+        /**Removes and returns the waveforms of the cluster @p clusterId, or 0L if there are none. The caller has to delete them.*/
+        Waveforms* take(int clusterId){
+            QHash<int,Entry>::iterator iterator = entries.find(clusterId);
+            if(iterator == entries.end()) return 0L;
+            Waveforms* waveforms = iterator.value().waveforms;
+            memoryUsed -= iterator.value().size;
+            useOrder.remove(iterator.value().lastUse);
+            entries.erase(iterator);
+            return waveforms;
+        }
+
+        /**Updates the memory used by the waveforms of the cluster @p clusterId, to be called once they have been collected or their mean computed.*/
+        void updateMemoryUsage(int clusterId){
+            QHash<int,Entry>::iterator iterator = entries.find(clusterId);
+            if(iterator == entries.end()) return;
+            memoryUsed -= iterator.value().size;
+            iterator.value().size = iterator.value().waveforms->memoryUsage();
+            memoryUsed += iterator.value().size;
+        }
+
+        /**Deletes all the waveforms.*/
+        void clear(){
+            QHash<int,Entry>::iterator iterator;
+            for(iterator = entries.begin(); iterator != entries.end(); ++iterator) delete iterator.value().waveforms;
+            entries.clear();
+            useOrder.clear();
+            memoryUsed = 0;
+        }
+
+        /**Returns the clusters having waveforms, from the least to the most recently used.*/
+        QList<int> clustersByUse() const {return useOrder.values();}
+
+        /**Returns the number of bytes used by the waveforms stored.*/
+        qint64 memoryUsage() const {return memoryUsed;}
+        /**Returns the number of bytes above which the least recently used waveforms are discarded.*/
+        qint64 budget() const {return memoryBudget;}
+        void setBudget(qint64 nbBytes){memoryBudget = nbBytes;}
+
+        /**Counts a request served by the waveforms already collected.*/
+        void addHit(){++hits;}
+        /**Counts a request for which the waveforms had to be collected.*/
+        void addMiss(){++misses;}
+        qint64 nbHits() const {return hits;}
+        qint64 nbMisses() const {return misses;}
 
-    /**Boolean use to inform the MinMaxThread that an undo or a redo is in process and that it has to stop.*/
-    bool undoRedoInProcess;
+    private:
+        WaveformCache(const WaveformCache&);
+        WaveformCache& operator=(const WaveformCache&);
+
+        struct Entry{
+            Waveforms* waveforms;
+            /**Number of bytes used by the waveforms when last updated.*/
+            qint64 size;
+            /**Position of the entry in useOrder.*/
+            qint64 lastUse;
+        };
+
+        /**Marks @p entry as the most recently used.*/
+        void use(int clusterId,Entry& entry){
+            if(entry.lastUse != 0) useOrder.remove(entry.lastUse);
+            entry.lastUse = ++lastUse;
+            useOrder.insert(entry.lastUse,clusterId);
+        }
 
-    /**Boolean use to inform the MinMaxThread that the cluster 0 has changed and that it has to stop.*/
-    bool clusterZeroJustModified;
+        QHash<int,Entry> entries;
+        /**Clusters by order of use, the key is the use counter at the last use of the cluster.*/
+        QMap<qint64,int> useOrder;
+        qint64 memoryBudget;
+        qint64 memoryUsed;
+        qint64 lastUse;
+        qint64 hits;
+        qint64 misses;
+    };
+
+    /**Waveform data by cluster.*/
+    WaveformCache waveformCache;
 
     /**
   * This class stores the information to know which cluster has
@@ -952,7 +1489,7 @@ private:
         void setMaximum(uint m){max = m;}
         float getShoulder() const {return asymptote;}
         void setShoulder(float s){asymptote = s;}
-        void calculateCorrelation(SortableTable& spikesOfCluster1,SortableTable& spikesOfCluster2,double binSizeInRU,double timeWindowInRU,int halfBins,bool autoCorrelogram);
+        void calculateCorrelation(const QVector<dataType>& spikesOfCluster1,const QVector<dataType>& spikesOfCluster2,double binSizeInRU,double timeWindowInRU,int halfBins,bool autoCorrelogram);
         int getNbBins(){return nbBins;}
         void setNbBins(int nb){nbBins = nb;}
         uint getValue(int index){return values[index];}
@@ -987,72 +1524,106 @@ private:
 
     //Methods
     /**
-  * Fills the undo lists (spikesByClusterUndoList,clusterInfoMapUndoList) to prepare for a futur undo.
-  * @param spikesByClusterTemp the newly created spikesByCluster array
+  * Fills the undo list (undoList) to prepare for a futur undo, spikesByClusterTemp and clusterInfoMapTemp becoming the current ones.
+  * @param spikesByClusterTemp the newly created spikesByCluster map
   * @param clusterInfoMapTemp the newly created ClusterInfoMap map
+  * @param clusterIdsOldNew map given the new id of the clusters which have been renumbered, if any.
+  */
+    void prepareUndo(SpikesByClusterMap* spikesByClusterTemp,ClusterInfoMap* clusterInfoMapTemp,const QMap<int,int>& clusterIdsOldNew = QMap<int,int>());
+
+    /**
+  * Computes the difference between a new distribution of the spikes among the clusters and the current one.
+  * @param spikesByClusterTemp the new spikesByCluster map.
+  * @param clusterInfoMapTemp the new ClusterInfoMap map.
+  * @param clusterIdsOldNew map given the new id of the clusters which have been renumbered, if any.
+  * @return the delta to apply to the new distribution to get back the current one, it takes the ownership of the current clusterInfoMap.
+  */
+    ClusteringDelta* createDelta(SpikesByClusterMap* spikesByClusterTemp,ClusterInfoMap* clusterInfoMapTemp,const QMap<int,int>& clusterIdsOldNew);
+
+    /**
+  * Applies @p delta to the current distribution of the spikes among the clusters, rebuilding spikesByCluster and clusterInfoMap.
+  * @param delta the delta to apply, it is changed in the delta to apply to get back the current distribution.
   */
-    void prepareUndo(SortableTable* spikesByClusterTemp,ClusterInfoMap* clusterInfoMapTemp);
+    void applyDelta(ClusteringDelta* delta);
 
     /**
   * Moves the clusters contained in @p clustersToDelete to a the cluster @p destinationId. The correponding spikes are assign to cluster @p destinationId
   * @param clustersToDelete a list of the cluster numbers (in ascending order) identifying the clusters to delete.
   * @param spikesByClusterTemp the new spikesByCluster which will contain the new distribution of the spikes among the clusters
   * @param clusterInfoMapTemp the new clusterInfoMap which will contain the information on the new clusters
-  * @param upperInsertionIndex the starting position in spikesByCluster where to insert the spikes which are moved
-  * @param nbSpikesInNewCluster the current number of spikes in the new cluster
   * @param destinationId the cluster id of destination (0 for artifact or 1for noise)
-  * @param positions list containing, for each cluster to delete,
-  * the position of its first spike in the new cluster's spikes (starting from the first spike of the new cluster).
-  * @param nbOfspikes list containing, for each cluster to delete, its number of spikes.
   */
-    void moveClusters(QList<int>& clustersToDelete,SortableTable* spikesByClusterTemp,ClusterInfoMap* clusterInfoMapTemp,long upperInsertionIndex,long& nbSpikesInNewCluster,int destinationId,QList<long>& positions,QList<long>& nbOfspikes);
+    void moveClusters(QList<int>& clustersToDelete,SpikesByClusterMap* spikesByClusterTemp,ClusterInfoMap* clusterInfoMapTemp,int destinationId);
 
-    /**Creates a new thread to calculate the min and max of the dimensions when the cluster 0 is modified.*/
-    MinMaxThread* minMaxCalculator();
+    /**Calculates the minimum and maximum of the dimension @p dimension, the cluster 0 not being taken into account.
+  * @param dimension dimension for which to do the calculation.
+  * @param spikes spikes of each cluster, as in spikesByCluster.
+  * @param min minimum of the dimension, which has to be initialized by the caller.
+  * @param max maximum of the dimension, which has to be initialized by the caller.
+  */
+    void dimensionMinMax(int dimension,const SpikesByClusterMap& spikes,dataType& min,dataType& max);
 
-    /**
-  * Gets the waveform points for cluster @p clusterId in the sample mode.
-  * Take a sample of the spikes evenly distributed on all the recording.
-  * @param clusterId id of the cluster to get waveform information for.
-  * @param nbSpkToDisplay number of spikes to display.
-  * @return the status, READY if the data have already been collected or the current collection is finish,
-  * and IN_PROCESS if an other thread is already treating @p clusterId.
+    /**Computes the ranges of the loaded dimensions over the spikes @p spikes.
+  * @param ranges the ranges to fill.
+  * @param spikes the row indices of the spikes.
+  * @param nbSpikesOfCluster the number of spikes.
   */
-    Status getSampleWaveformPoints(int clusterId,dataType nbSpkToDisplay);
+    void computeClusterRanges(ClusterRanges& ranges,const dataType* spikes,dataType nbSpikesOfCluster);
 
-    /**
-  * Gets the waveform points for cluster @p clusterId in time frame mode.
-  * Take all the spikes in a given time frame.
-  * @param clusterId id of the cluster to get waveform information for.
-  * @param start starting time in second
-  * @param end ending time in second.
-  * @return the status, READY if the data have already been collected or the current collection is finish,
-  * and IN_PROCESS if an other thread is already treating that cluster.
+    /**Caches the ranges of the cluster whose spikes are @p clusterSpikes as the union of the ranges of @p mergedSpikes, when they are all cached.
+  * This is used when clusters are merged, the ranges of the merged cluster are then not computed again.
+  * @param clusterSpikes the spikes of the merged cluster.
+  * @param mergedSpikes the first spike of the vector of each non-empty cluster merged.
   */
-    Status getTimeFrameWaveformPoints(int clusterId,dataType start,dataType end);
+    void combineClusterRanges(const QVector<dataType>& clusterSpikes,const QList<const dataType*>& mergedSpikes);
 
-    /**
-  * Calculates the mean and the standard deviation for cluster @p clusterId in the sample mode.
-  * In that mode, the spikes used are a sample of the spikes evenly distributed on all the recording.
-  * @param clusterId id of the cluster to calculate the data for.
-  * @param nbSpkToDisplay number of spikes diplayed.
-  * @return the status, READY if the data have already been calculated or the current calculation is finish,
-  * IN_PROCESS if an other thread is already treating that cluster and NOT_AVAILABLE
-  * if the spikes have not been collected yet.
+    /**Updates clusterRangesCache for the current state: the clusters whose ranges are not known are put in
+  * pendingClusterRanges, the ranges of the clusters which do not exist anymore are removed. rangesMutex has to be locked.
   */
-    Status calculateSampleMean(int clusterId,dataType nbSpkToDisplay);
+    void updateClusterRanges();
+
+    /**Computes the ranges of the pending clusters until there are none left, then updates dimensionMinima and dimensionMaxima.
+  * Called by the ClusterRangesTask.
+  */
+    void computePendingClusterRanges();
+
+    /**Updates dimensionMinima and dimensionMaxima from the ranges of clusterRangesCache. rangesMutex has to be locked.*/
+    void publishDimensionRanges();
+
+    /**Creates a new thread to load the dimensions which have not been loaded by initialize().*/
+    FeatureLoaderThread* featureLoader();
+
+    /**Parses the dimensions which have not been loaded by initialize(), computes their minimum and maximum
+  * and writes the binary feature cache. Called by the FeatureLoaderThread.
+  * @return true if the dimensions have been loaded and the features are to be compacted by useCompactFeatures().
+  */
+    bool loadRemainingFeatures();
+
+    /**Starts the loading of the remaining dimensions if initialize() has only loaded some of them.*/
+    void startFeatureLoading();
+
+    /**Notifies the loading monitor, if any, of the beginning of @p stage.
+  * @param stage the stage which begins.
+  * @param errorInformation set if the loading has been cancelled.
+  * @return false if the loading has been cancelled, true otherwise.
+  */
+    bool startLoadingStage(LoadingStage stage,QString& errorInformation);
+
+    /**Returns true if the loading monitor, if any, has cancelled the loading.*/
+    bool isLoadingCancelled() const{return loadingMonitor != 0L && *loadingMonitor->cancelFlag();}
 
     /**
-  * Calculates the mean and the standard deviation for cluster @p clusterId in the time frame mode.
-  * In that mode, all the spikes in a given time frame are selected.
-  * @param clusterId id of the cluster to calculate the data for.
-  * @param start starting time in second
-  * @param end ending time in second.
-  * @return the status, READY if the data have already been calculated or the current calculation is finish,
-  * IN_PROCESS if an other thread is already treating that cluster and NOT_AVAILABLE
-  * if the spikes have not been collected yet.
+  * Waits until the waveforms of the cluster @p clusterId, or their mean and standard deviation,
+  * are not being computed by another thread anymore. Returns immediately if they are not in process.
+  * @param clusterId id of the cluster.
+  * @param mode SAMPLE or TIME_FRAME.
+  * @param mean true to wait for the mean and standard deviation, false to wait for the waveforms.
+  * @param cancelFlag flag set to stop waiting, wakeUpWaitingThreads() has to be called once it is set.
   */
-    Status calculateTimeFrameMean(int clusterId,dataType start,dataType end);
+    void waitForWaveforms(int clusterId,WaveformMode mode,bool mean,const volatile bool* cancelFlag);
+
+    /**Wakes up the threads waiting for waveforms or correlograms so they check their cancel flag.*/
+    void wakeUpWaitingThreads();
 
     /**
   * Remove all the correlations link to the cluster @p clusterId. This mean remove the
@@ -1071,48 +1642,21 @@ private:
     void renumberCorrelation(QMap<int,int>& clusterIdsOldNew);
 
     /**Returns the time corresponding to a spike.
-  * @param spikesOfCluster one row SortableTable corresponding to the position of the cluser's spikes in
-  * features sorted by position.
-  * @param spike position.
+  * @param spikesOfCluster the position of the cluser's spikes in features sorted by position.
+  * @param spike position, starting at 1.
   */
-    double spikeTime(SortableTable& spikesOfCluster,dataType spike){
-        dataType currentPositionInFeatures = spikesOfCluster(1,spike);
+    double spikeTime(const QVector<dataType>& spikesOfCluster,dataType spike){
+        dataType currentPositionInFeatures = spikesOfCluster[spike - 1];
         return static_cast<double>(features(currentPositionInFeatures,nbDimensions));
     }
 
-    /**Sorts by time the spikes of a newly created cluster created from other clusters, knowing
-  * that the spikes from the other clusters are already sorted.
-  * @param clusterInfoMapTemp the new clusterInfoMap which will contain the information on the new clusters.
-  * @param spikesByClusterTemp the new spikesByCluster which will contain the new distribution of the spikes among the clusters.
-  * @param clusterId the id of the cluster to sort.
-  * @param positions list containing, for each contributing cluster,
-  * the position of either its last spike (if @p fromTop is false) or its first spike (if @p fromTop is true)
-  * in the new cluster's spikes.
-  * @param nbOfspikes list containing, for each contributing cluster, its number of spikes.
-  * @param step equals -1 if the contributing clusters are sorted from the bigger to the smaller
-  * and equals 1 if the contributing clusters are sorted from the smaller to the bigger.
-  * @param fromTop true if the position is given starting from the first spike of the new cluster, false if
-  * it is given starting from the last spike of the new cluster. The default is false.
-  */
-    void sortCluster(ClusterInfoMap* clusterInfoMapTemp,SortableTable* spikesByClusterTemp,dataType clusterId,QList<dataType> positions,QList<dataType> nbOfspikes,int step,bool fromTop = false);
-
-    /**
-  * Sorts by time the spikes of a newly created cluster created from other clusters.
-  * The function is an overload of the previous one for the cases where the cluster to sort is
-  * either the cluster 0 or the cluster 1. In that case the spikes coming from those clusters
-  * are sorted from the smaller time to the bigger whereas the other clusters still
-  * sorted from the bigger to the smaller.
-  * @param clusterInfoMapTemp the new clusterInfoMap which will contain the information on the new clusters.
-  * @param spikesByClusterTemp the new spikesByCluster which will contain the new distribution of the spikes among the clusters.
-  * @param clusterId the id of the cluster to sort.
-  * @param lastPositions list containing, for each contributing cluster,
-  * the position of its last spike in the new cluster's spikes (starting from the last spike
-  * of the new cluster).
-  * @param nbOfspikes list containing, for each contributing cluster, tits number of spikes.e
-  * @param firstPosition position of the first spike of the cluster 0 or 1.
-  * @param number number of spikes of either the cluster 0 or 1.
-  */
-    void sortCluster(ClusterInfoMap* clusterInfoMapTemp,SortableTable* spikesByClusterTemp,dataType clusterId,QList<dataType> lastPositions,QList<dataType> nbOfspikes,dataType firstPosition,dataType number);
+    /**Adds to @p selection the existing clusters of @p clustersOfOrigin, except @p excludedCluster,
+  * which may contain spikes in the selection area.
+  * @param selection the selection classifying the spikes.
+  * @param clustersOfOrigin a list of the cluster numbers identifying the clusters which may contain spikes in the region.
+  * @param excludedCluster a cluster not to add, -1 to add all of them.
+  */
+    void addClustersToSelection(SpikeSelection& selection,const QList<int>& clustersOfOrigin,int excludedCluster);
 
 
     /**
@@ -1120,15 +1664,29 @@ private:
   * @param time the time look up.
   * @param spikesOfCluster array of sorted spikes in which to look up.
   */
-    long findSpikePosition(double time,SortableTable& spikesOfCluster);
+    long findSpikePosition(double time,const QVector<dataType>& spikesOfCluster);
 
     /**
-  * Makes a copy of the internal variables, spikesOfCluster and clusterInfoMap, used to store
-  * insformation about the clusters.
-  * @param spikesOfClusterTemp pointer on a SortableTable which will point on a copy of the internal variable spikesOfCluster.
-  * @param clusterInfoMapTemp pointer on a ClusterInfoMap which will point on a copy of the internal variable clusterInfoMap.
+  * Returns the last published version of the clusters, which stays unchanged while the caller holds it.
+  * The mutex is only locked for the time of the copy of the handle.
+  */
+    ClusteringSnapshot snapshot();
+
+    /**Publishes the current spikesByCluster and clusterInfoMap as a new version of the clusters.
+  * To be called with the mutex locked after each change of the clusters.
   */
-    void duplicate(SortableTable* & spikesOfClusterTemp,ClusterInfoMap* & clusterInfoMapTemp);
+    void publishSnapshot();
+
+    /**Returns true if the cluster @p clusterId, whose waveforms are in process, has been modified or
+  * its waveforms discarded since the computation started. Locks the mutex.
+  */
+    bool waveformsOutdated(int clusterId);
+
+    /**Discards the waveforms in process of the cluster @p clusterId and wakes up the threads waiting for them.
+  * Locks the mutex.
+  * @return NOT_AVAILABLE, the status to return to the caller.
+  */
+    Status discardWaveforms(int clusterId);
 
 public:
 
@@ -1184,12 +1742,12 @@ public:
   * @return the sampleWaveformIterator on the spikes of the given cluster.
   */
     SampleWaveformIterator* sampleWaveformIterator(dataType clusterId,dataType nbSampleSpikes){
-        QString clusterIdString = QString::fromLatin1("%1").arg(clusterId);
         int clusterIdInt = static_cast<int>(clusterId);
         SampleWaveformIterator* waveformIterator;
 
+        QMutexLocker locker(&mutex);
         if(waveformStatusMap.contains(clusterIdInt)){
-            Waveforms* waveforms = waveformDict[clusterIdString];
+            Waveforms* waveforms = waveformCache.value(clusterIdInt);
             waveformIterator = new SampleWaveformIterator(waveforms);
             if(waveformStatusMap[clusterIdInt].sampleMeanStatus() == READY)
                 waveformIterator->setMeanAvailable(true);
@@ -1262,12 +1820,12 @@ public:
   * @return the TimeFrameWaveformIterator on the spikes of the given cluster.
   */
     TimeFrameWaveformIterator* timeFrameWaveformIterator(dataType clusterId,dataType startTime,dataType endTime){
-        QString clusterIdString = QString::fromLatin1("%1").arg(clusterId);
         int clusterIdInt = static_cast<int>(clusterId);
         TimeFrameWaveformIterator* waveformIterator;
 
+        QMutexLocker locker(&mutex);
         if(waveformStatusMap.contains(clusterIdInt)){
-            Waveforms* waveforms = waveformDict[clusterIdString];
+            Waveforms* waveforms = waveformCache.value(clusterIdInt);
             waveformIterator = new TimeFrameWaveformIterator(waveforms);
             if(waveformStatusMap[clusterIdInt].timeFrameMeanStatus() == READY) waveformIterator->setMeanAvailable(true);
             if(waveformStatusMap[clusterIdInt].timeFrameStatus() == READY){
@@ -1340,6 +1898,16 @@ public:
   */
     Status getCorrelograms(Pair& pair,int binSize,int timeWindow,double binSizeInRU,float timeWindowInRU,int halfBins);
 
+    /**
+  * Waits until the correlogram of @p pair for the given parameters is not being computed by another thread anymore.
+  * Returns immediately if it is not in process.
+  * @param pair pair of clusters.
+  * @param binSize size of the bins given in miliseconds.
+  * @param timeWindow time frame use to compute the correlograms, given in miliseconds.
+  * @param cancelFlag flag set to stop waiting, wakeUpWaitingThreads() has to be called once it is set.
+  */
+    void waitForCorrelograms(const Pair& pair,int binSize,int timeWindow,const volatile bool* cancelFlag);
+
     class CorrelogramIterator;
     friend class CorrelogramIterator;
 
@@ -21,7 +21,7 @@
 #include <qapplication.h>
 
 void ErrorMatrixThread::run(){
-    if(!haveToStopProcessing) probabilities =
+    if(!isCancelled()) probabilities =
             assistant.computeMeanProbabilities(data,clusterList,computedClusterList,ignoreClusterIndex);
 
     //Send an event to the ErrorMatrixView to let it know that the computation is finish.
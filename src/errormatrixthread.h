@@ -23,22 +23,20 @@
 #include "data.h"
 #include "array.h"
 #include "groupingassistant.h"
+#include "taskpool.h"
 
 //include files for QT
-#include <qthread.h>
-
-
 #include <QEvent>
 #include <QList>
 
-/**Thread used to compute the Error Matrix. Each element in the matrix
+/**Task used to compute the Error Matrix, it runs on the TaskPool. Each element in the matrix
   * indicates how likely it is that the two clusters corresponding to the row and column
   * of the element contain spikes from the same neuron.
   *@author Lynn Hazan
   * @since klusters 1.1
   */
 
-class ErrorMatrixThread : public QThread  {
+class ErrorMatrixThread : public TaskPool::Task  {
 public:
 
     //Only the method computeMatrix of ErrorMatrixView has access to the private part of ErrorMatrixThread,
@@ -53,7 +51,7 @@ public:
 
     /**Asks the thread to stop his work as soon as possible.*/
     void stopProcessing(){
-        haveToStopProcessing = true;
+        cancel();
         assistant.stopComputing();
     }
 
@@ -89,8 +87,8 @@ protected:
 
 private:
 
-    ErrorMatrixThread(ErrorMatrixView& view,Data& d):errorMatrixView(view),data(d),haveToStopProcessing(false){
-        start();
+    ErrorMatrixThread(ErrorMatrixView& view,Data& d):errorMatrixView(view),data(d){
+        start(view.taskPriority());
     }
 
     ErrorMatrixView& errorMatrixView;
@@ -99,8 +97,6 @@ private:
     QList<int> clusterList;
     QList<int> computedClusterList;
     QList<int> ignoreClusterIndex;
-    /**True if the thread has to stop processing, false otherwise.*/
-    bool haveToStopProcessing;
     GroupingAssistant assistant;
 
 };
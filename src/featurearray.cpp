@@ -0,0 +1,378 @@
+/***************************************************************************
+                          featurearray.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "featurearray.h"
+
+//Qt include files
+#include <qdatetime.h>
+#include <QMap>
+#include <QDebug>
+
+//C include files
+#include <cstring>
+#if defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+const char FeatureArray::kMAGIC[8] = {'K','L','U','F','E','T','C','\0'};
+const qint32 FeatureArray::kVERSION = 3;
+
+/**Computes the minimum and maximum of the values of type T found at @p origin + (row - 1) * @p step for each row of @p rows.*/
+template <class T>
+static void minMaxOfRows(const uchar* origin,qint64 step,const dataType* rows,dataType nbOfRows,dataType& min,dataType& max){
+    dataType localMin = min;
+    dataType localMax = max;
+    for(dataType i = 0; i < nbOfRows; ++i){
+        dataType value = *reinterpret_cast<const T*>(origin + (rows[i] - 1) * step);
+        localMin = qMin(localMin,value);
+        localMax = qMax(localMax,value);
+    }
+    min = localMin;
+    max = localMax;
+}
+
+FeatureArray::FeatureArray():nbRows(0),nbColumns(0),totalSize(0),currentLayout(ROW_MAJOR),preferredLayout(ROW_MAJOR),
+    values(0L),buffer(0L),bufferFile(0L),cacheMapped(false){
+}
+
+FeatureArray::~FeatureArray(){
+    clear();
+}
+
+uchar* FeatureArray::allocate(qint64 size,const QString& suffix,QFile*& file) const{
+    file = 0L;
+    if(!backingFileName.isEmpty() && size > 0){
+        //The pages of a file extended by resize read as zeros.
+        file = new QFile(backingFileName + suffix);
+        if(file->open(QIODevice::ReadWrite | QIODevice::Truncate) && file->resize(size)){
+            uchar* data = file->map(0,size);
+            if(data != 0L) return data;
+        }
+        qDebug()<<"the backing file "<<file->fileName()<<" could not be created, the features are kept in memory";
+        file->close();
+        file->remove();
+        delete file;
+        file = 0L;
+    }
+
+    uchar* data = new uchar[size];
+    memset(data,0,size);
+    return data;
+}
+
+void FeatureArray::release(uchar* buffer,QFile*& file,bool removeFile){
+    if(file != 0L){
+        file->unmap(buffer);
+        file->close();
+        if(removeFile) file->remove();
+        delete file;
+        file = 0L;
+    }
+    else delete []buffer;
+}
+
+void FeatureArray::adviseAccess(AccessPattern pattern) const{
+#if defined(Q_OS_UNIX)
+    if(bufferFile == 0L) return;
+    int advice = POSIX_MADV_NORMAL;
+    if(pattern == SEQUENTIAL) advice = POSIX_MADV_SEQUENTIAL;
+    else if(pattern == RANDOM) advice = POSIX_MADV_RANDOM;
+    //The mapping starts on a page boundary.
+    posix_madvise(buffer,(values - buffer) + totalSize,advice);
+#else
+    Q_UNUSED(pattern);
+#endif
+}
+
+void FeatureArray::clear(){
+    release(buffer,bufferFile,!cacheMapped);
+    buffer = 0L;
+    cacheMapped = false;
+    values = 0L;
+    nbRows = 0;
+    nbColumns = 0;
+    totalSize = 0;
+    currentLayout = ROW_MAJOR;
+    columnOffsets.clear();
+    columnSteps.clear();
+    columnWidths.clear();
+}
+
+void FeatureArray::computeLayout(Layout layout){
+    currentLayout = layout;
+    columnOffsets.fill(0,nbColumns);
+    columnSteps.fill(0,nbColumns);
+
+    if(layout == COLUMN_MAJOR){
+        //Each column is contiguous, the widest columns first.
+        qint64 offset = 0;
+        for(int width = 8; width >= 1; width /= 2){
+            for(int i = 0; i < nbColumns; ++i){
+                if(columnWidths[i] != width) continue;
+                columnOffsets[i] = offset;
+                columnSteps[i] = width;
+                offset += static_cast<qint64>(nbRows) * width;
+            }
+        }
+        totalSize = offset;
+        return;
+    }
+
+    int offset = 0;
+    for(int width = 8; width >= 1; width /= 2){
+        for(int i = 0; i < nbColumns; ++i){
+            if(columnWidths[i] != width) continue;
+            columnOffsets[i] = offset;
+            offset += width;
+        }
+    }
+    //Keep the rows aligned on the widest column.
+    int alignment = 1;
+    for(int i = 0; i < nbColumns; ++i) alignment = qMax(alignment,columnWidths[i]);
+    qint64 rowStride = ((offset + alignment - 1) / alignment) * alignment;
+    columnSteps.fill(rowStride,nbColumns);
+    totalSize = static_cast<qint64>(nbRows) * rowStride;
+}
+
+void FeatureArray::setSize(dataType nbOfRows,int nbOfColumns){
+    clear();
+    nbRows = nbOfRows;
+    nbColumns = nbOfColumns;
+    columnWidths.fill(sizeof(dataType),nbColumns);
+    //All the columns have the same width, computeLayout keeps them in order.
+    computeLayout(ROW_MAJOR);
+    buffer = allocate(dataSize(),".wide",bufferFile);
+    values = buffer;
+}
+
+QVector<int> FeatureArray::narrowestWidths() const{
+    //Choose the narrowest width for each column from its range of values, the time keeps the full width.
+    QVector<int> widths(nbColumns);
+    for(int column = 1; column <= nbColumns; ++column){
+        if(column == nbColumns || nbRows == 0){
+            widths[column - 1] = sizeof(dataType);
+            continue;
+        }
+        dataType min = (*this)(1,column);
+        dataType max = min;
+        for(dataType row = 2; row <= nbRows; ++row){
+            dataType value = (*this)(row,column);
+            if(value < min) min = value;
+            else if(value > max) max = value;
+        }
+        if(min >= -128 && max <= 127) widths[column - 1] = 1;
+        else if(min >= -32768 && max <= 32767) widths[column - 1] = 2;
+        else if(min >= -2147483647L - 1 && max <= 2147483647L) widths[column - 1] = 4;
+        else widths[column - 1] = 8;
+    }
+    return widths;
+}
+
+void FeatureArray::compact(){
+    if(values == 0L || isMapped()) return;
+
+    QVector<int> widths = narrowestWidths();
+    if(widths == columnWidths && preferredLayout == currentLayout) return;
+
+    //Repack the values with the new widths and layout, the full width values are stored row by row.
+    const dataType* wideValues = reinterpret_cast<const dataType*>(values);
+    columnWidths = widths;
+    computeLayout(preferredLayout);
+    QFile* compactFile;
+    uchar* compactValues = allocate(dataSize(),".compact",compactFile);
+    for(dataType row = 0; row < nbRows; ++row){
+        const dataType* source = wideValues + row * nbColumns;
+        for(int i = 0; i < nbColumns; ++i)
+            write(compactValues + columnOffsets[i] + row * columnSteps[i],columnWidths[i],source[i]);
+    }
+    release(buffer,bufferFile,true);
+    buffer = compactValues;
+    bufferFile = compactFile;
+    values = buffer;
+}
+
+bool FeatureArray::mapCache(const QString& cacheFileName,const QFileInfo& featureFileInfo,dataType nbOfRows){
+    QFile* file = new QFile(cacheFileName);
+    if(!file->exists() || !file->open(QIODevice::ReadOnly)){
+        delete file;
+        return false;
+    }
+
+    CacheHeader header;
+    bool valid = file->read(reinterpret_cast<char*>(&header),sizeof(CacheHeader)) == static_cast<qint64>(sizeof(CacheHeader)) &&
+            memcmp(header.magic,kMAGIC,sizeof(kMAGIC)) == 0 &&
+            header.version == kVERSION &&
+            header.valueSize == static_cast<qint32>(sizeof(dataType)) &&
+            header.nbRows == nbOfRows && header.nbColumns > 0 &&
+            header.featureFileSize == featureFileInfo.size() &&
+            header.featureFileModified == featureFileInfo.lastModified().toMSecsSinceEpoch() &&
+            header.layout == preferredLayout;
+
+    //Read the column widths and check that the size of the file matches the layout they give.
+    QVector<int> widths;
+    QByteArray widthsBlock;
+    if(valid){
+        widthsBlock = file->read(widthsBlockSize(header.nbColumns));
+        valid = widthsBlock.size() == widthsBlockSize(header.nbColumns);
+        for(int i = 0; valid && i < header.nbColumns; ++i){
+            int width = widthsBlock.at(i);
+            valid = (width == 1 || width == 2 || width == 4 || width == 8) && width <= static_cast<int>(sizeof(dataType));
+            widths.append(width);
+        }
+    }
+    FeatureArray cacheLayout;
+    if(valid){
+        cacheLayout.nbRows = header.nbRows;
+        cacheLayout.nbColumns = static_cast<int>(header.nbColumns);
+        cacheLayout.columnWidths = widths;
+        cacheLayout.computeLayout(preferredLayout);
+        valid = file->size() == static_cast<qint64>(sizeof(CacheHeader)) + widthsBlockSize(header.nbColumns) + cacheLayout.dataSize();
+    }
+    if(!valid){
+        qDebug()<<"the feature cache "<<cacheFileName<<" is out of date or invalid, it will not be used";
+        file->close();
+        delete file;
+        return false;
+    }
+
+    uchar* data = file->map(0,file->size());
+    if(data == 0L){
+        file->close();
+        delete file;
+        return false;
+    }
+
+    clear();
+    bufferFile = file;
+    buffer = data;
+    cacheMapped = true;
+    nbRows = cacheLayout.nbRows;
+    nbColumns = cacheLayout.nbColumns;
+    columnWidths = cacheLayout.columnWidths;
+    columnOffsets = cacheLayout.columnOffsets;
+    columnSteps = cacheLayout.columnSteps;
+    totalSize = cacheLayout.totalSize;
+    currentLayout = cacheLayout.currentLayout;
+    values = buffer + sizeof(CacheHeader) + widthsBlockSize(nbColumns);
+    return true;
+}
+
+bool FeatureArray::writeValues(QFile& file,const FeatureArray& target) const{
+    //The values are converted by blocks of rows, in the order of the target layout.
+    const dataType kBLOCK_ROWS = 65536;
+    QByteArray block;
+    if(target.currentLayout == ROW_MAJOR){
+        qint64 rowStride = target.nbColumns > 0 ? target.columnSteps[0] : 0;
+        for(dataType first = 1; first <= nbRows; first += kBLOCK_ROWS){
+            dataType last = qMin(first + kBLOCK_ROWS - 1,nbRows);
+            block.fill('\0',static_cast<int>((last - first + 1) * rowStride));
+            uchar* data = reinterpret_cast<uchar*>(block.data());
+            for(dataType row = first; row <= last; ++row)
+                for(int i = 0; i < nbColumns; ++i)
+                    write(data + (row - first) * rowStride + target.columnOffsets[i],target.columnWidths[i],(*this)(row,i + 1));
+            if(file.write(block) != block.size()) return false;
+        }
+        return true;
+    }
+
+    //Dimension by dimension, the columns are written in the order of their offsets.
+    QMap<qint64,int> columnsByOffset;
+    for(int i = 0; i < nbColumns; ++i) columnsByOffset.insert(target.columnOffsets[i],i);
+    QMap<qint64,int>::const_iterator iterator;
+    for(iterator = columnsByOffset.constBegin(); iterator != columnsByOffset.constEnd(); ++iterator){
+        int i = iterator.value();
+        int width = target.columnWidths[i];
+        Column source = column(i + 1);
+        for(dataType first = 1; first <= nbRows; first += kBLOCK_ROWS){
+            dataType last = qMin(first + kBLOCK_ROWS - 1,nbRows);
+            block.resize(static_cast<int>((last - first + 1) * width));
+            uchar* data = reinterpret_cast<uchar*>(block.data());
+            for(dataType row = first; row <= last; ++row)
+                write(data + (row - first) * width,width,source[row]);
+            if(file.write(block) != block.size()) return false;
+        }
+    }
+    return true;
+}
+
+bool FeatureArray::writeCache(const QString& cacheFileName,const QFileInfo& featureFileInfo) const{
+    if(values == 0L) return false;
+
+    //A table which has not been compacted is written with the widths and the layout compact() would use.
+    FeatureArray target;
+    target.nbRows = nbRows;
+    target.nbColumns = nbColumns;
+    target.columnWidths = columnWidths;
+    if(columnWidths.count(sizeof(dataType)) == nbColumns) target.columnWidths = narrowestWidths();
+    target.computeLayout(preferredLayout);
+
+    CacheHeader header;
+    memset(&header,0,sizeof(CacheHeader));
+    memcpy(header.magic,kMAGIC,sizeof(kMAGIC));
+    header.version = kVERSION;
+    header.valueSize = sizeof(dataType);
+    header.nbRows = nbRows;
+    header.nbColumns = nbColumns;
+    header.featureFileSize = featureFileInfo.size();
+    header.featureFileModified = featureFileInfo.lastModified().toMSecsSinceEpoch();
+    header.layout = target.currentLayout;
+
+    QByteArray widthsBlock(widthsBlockSize(nbColumns),'\0');
+    for(int i = 0; i < nbColumns; ++i) widthsBlock[i] = static_cast<char>(target.columnWidths[i]);
+
+    QString tmpFileName = cacheFileName + ".tmp";
+    QFile file(tmpFileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    bool status = file.write(reinterpret_cast<const char*>(&header),sizeof(CacheHeader)) == static_cast<qint64>(sizeof(CacheHeader)) &&
+            file.write(widthsBlock) == widthsBlock.size() &&
+            (target.columnWidths == columnWidths && target.currentLayout == currentLayout ?
+                 file.write(reinterpret_cast<const char*>(values),dataSize()) == dataSize() : writeValues(file,target));
+    file.close();
+
+    if(!status){
+        QFile::remove(tmpFileName);
+        return false;
+    }
+
+    QFile::remove(cacheFileName);
+    if(!QFile::rename(tmpFileName,cacheFileName)){
+        QFile::remove(tmpFileName);
+        return false;
+    }
+    return true;
+}
+
+void FeatureArray::columnMinMax(int column,const dataType* rows,dataType nbOfRows,dataType& min,dataType& max) const{
+    const uchar* origin = values + columnOffsets[column - 1];
+    qint64 step = columnSteps[column - 1];
+    switch(columnWidths[column - 1]){
+    case 1:
+        minMaxOfRows<qint8>(origin,step,rows,nbOfRows,min,max);
+        break;
+    case 2:
+        minMaxOfRows<qint16>(origin,step,rows,nbOfRows,min,max);
+        break;
+    case 4:
+        minMaxOfRows<qint32>(origin,step,rows,nbOfRows,min,max);
+        break;
+    default:
+        minMaxOfRows<qint64>(origin,step,rows,nbOfRows,min,max);
+    }
+}
@@ -0,0 +1,286 @@
+/***************************************************************************
+                          featurearray.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef FEATUREARRAY_H
+#define FEATUREARRAY_H
+
+//Include files of the application
+#include "types.h"
+
+//Include files for QT
+#include <QString>
+#include <QVector>
+#include <qfile.h>
+#include <qfileinfo.h>
+
+/**
+* This class stores the features of all the spikes (one row per spike, one column per dimension,
+* the last column being the time). As Array, the indices start at 1.
+* The table is filled with full width values (see setSize() and operator[]) and then compacted (see compact()):
+* each dimension is stored on the narrowest integer width (1, 2, 4 or 8 bytes) able to hold its range of values,
+* the time being always kept on 8 bytes. All the reads go through operator() or through a Column.
+* The compacted values are stored either row by row (default) or dimension by dimension (see setLayout()),
+* the later keeping the values of a dimension contiguous for the loops working on a few dimensions at a time
+* (projections, minimum and maximum, covariances).
+* The values are either held in memory or read directly from a memory-mapped binary cache
+* file (see writeCache() and mapCache()) which avoids parsing the text feature file again.
+* In out-of-core mode (see setBackingFile()) the tables built while loading are also memory-mapped files,
+* so the features are paged in and out by the system and can be larger than the physical memory.
+*/
+class FeatureArray{
+
+public:
+    /**Storage order of the compacted values.*/
+    enum Layout{ROW_MAJOR=0,COLUMN_MAJOR=1};
+
+    /**Expected access pattern to the values, used to advise the system on the paging of a memory-mapped table.*/
+    enum AccessPattern{NORMAL=0,SEQUENTIAL=1,RANDOM=2};
+
+    /**
+  * Gives access to the values of one dimension, whatever the layout.
+  */
+    class Column{
+        friend class FeatureArray;
+    public:
+        Column():origin(0L),step(0),width(0){}
+        /**Returns the value at @p row (starting at 1).*/
+        inline dataType operator[](dataType row) const{return FeatureArray::read(origin + (row - 1) * step,width);}
+    private:
+        const uchar* origin;
+        qint64 step;
+        int width;
+    };
+
+    FeatureArray();
+    ~FeatureArray();
+
+    /**Allocates a table of @p nbOfRows by @p nbOfColumns in memory, filled with zeros.
+  * All the columns have the width of dataType until compact() is called.
+  * Any previously mapped cache file is released.
+  * @param nbOfRows number of rows (spikes).
+  * @param nbOfColumns number of columns (dimensions).
+  */
+    void setSize(dataType nbOfRows,int nbOfColumns);
+
+    /**Sets the base name of the files used to hold the tables built by setSize() and compact()
+  * instead of the memory (out-of-core mode). An empty name, the default, keeps the tables in memory.
+  * If a file cannot be created, the table is allocated in memory.
+  * @param fileName base name of the backing files, the files are removed once they are not used anymore.
+  */
+    void setBackingFile(const QString& fileName){backingFileName = fileName;}
+
+    /**Advises the system on the way the values are going to be accessed. This is only
+  * used for a memory-mapped table (cache file or out-of-core mode), and on Unix systems.
+  * @param pattern expected access pattern.
+  */
+    void adviseAccess(AccessPattern pattern) const;
+
+    /**Sets the layout used by compact() and required from a cache file by mapCache().
+  * @param layout storage order of the compacted values.
+  */
+    void setLayout(Layout layout){preferredLayout = layout;}
+
+    /**Returns the current storage order of the values.*/
+    inline Layout layout() const{return currentLayout;}
+
+    /**Stores each column on the narrowest integer width able to hold the values of the column,
+  * the last column (time) keeping the width of dataType, using the layout given by setLayout().
+  */
+    void compact();
+
+    /**Returns the number of rows (spikes).*/
+    inline dataType nbOfRows() const{return nbRows;}
+
+    /**Returns the number of columns (dimensions).*/
+    inline int nbOfColumns() const{return nbColumns;}
+
+    /**Returns the width in bytes used to store the values of @p column (starting at 1).*/
+    inline int columnWidth(int column) const{return columnWidths[column - 1];}
+
+    /**Returns the number of bytes used to store the values.*/
+    inline qint64 dataSize() const{return totalSize;}
+
+    /**Returns the value at @p row and @p column (indices starting at 1).*/
+    inline dataType operator()(dataType row,int column) const{
+        return read(values + columnOffsets[column - 1] + (row - 1) * columnSteps[column - 1],columnWidths[column - 1]);
+    }
+
+    /**Returns the offset in bytes of the value at @p row and @p column (indices starting at 1) from the first value.*/
+    inline qint64 valueOffset(dataType row,int column) const{
+        return columnOffsets[column - 1] + (row - 1) * columnSteps[column - 1];
+    }
+
+    /**Returns the accessor to the values of @p column (starting at 1).*/
+    inline Column column(int column) const{
+        Column accessor;
+        accessor.origin = values + columnOffsets[column - 1];
+        accessor.step = columnSteps[column - 1];
+        accessor.width = columnWidths[column - 1];
+        return accessor;
+    }
+
+    /**Computes the minimum and maximum of @p column (starting at 1) over the rows @p rows (starting at 1).
+  * The width of the column is resolved once, each width having its own loop.
+  * @param column the column.
+  * @param rows the rows to take into account.
+  * @param nbOfRows the number of rows, at least 1.
+  * @param min minimum of the values, which has to be initialized by the caller.
+  * @param max maximum of the values, which has to be initialized by the caller.
+  */
+    void columnMinMax(int column,const dataType* rows,dataType nbOfRows,dataType& min,dataType& max) const;
+
+    /**Returns the value stored on @p width bytes at @p value.*/
+    static inline dataType read(const uchar* value,int width){
+        switch(width){
+        case 1:
+            return *reinterpret_cast<const qint8*>(value);
+        case 2:
+            return *reinterpret_cast<const qint16*>(value);
+        case 4:
+            return *reinterpret_cast<const qint32*>(value);
+        default:
+            return static_cast<dataType>(*reinterpret_cast<const qint64*>(value));
+        }
+    }
+
+    /**Returns a reference to the value at the flat index @p index (starting at 0, row by row).
+  * Only valid between setSize() and compact(), a compacted or mapped table is read-only.
+  */
+    inline dataType& operator[](dataType index){return reinterpret_cast<dataType*>(values)[index];}
+
+    /**Returns true if the data come from a memory-mapped cache file.*/
+    inline bool isMapped() const{return cacheMapped;}
+
+    /**Maps the binary cache file @p cacheFileName into memory if it is valid for the
+  * feature file described by @p featureFileInfo, that is if the size and the last modification
+  * date recorded in the cache match the ones of the feature file.
+  * @param cacheFileName name of the binary cache file.
+  * @param featureFileInfo information on the text feature file.
+  * @param nbOfRows the expected number of rows (spikes).
+  * @return true if the cache has been mapped, false otherwise (the content of the table is then unchanged).
+  */
+    bool mapCache(const QString& cacheFileName,const QFileInfo& featureFileInfo,dataType nbOfRows);
+
+    /**Writes the content of the table in the binary cache file @p cacheFileName,
+  * tagged with the size and last modification date of the feature file described by @p featureFileInfo.
+  * A table which has not been compacted is written as compact() would store it, without being modified.
+  * The file is first written under a temporary name and then renamed so a partial cache is never used.
+  * @param cacheFileName name of the binary cache file.
+  * @param featureFileInfo information on the text feature file.
+  * @return true if the cache has been written, false otherwise.
+  */
+    bool writeCache(const QString& cacheFileName,const QFileInfo& featureFileInfo) const;
+
+    /**Returns the name of the binary cache file associated with the feature file @p featureFileName.*/
+    static QString cacheFileName(const QString& featureFileName){return featureFileName + ".kcache";}
+
+private:
+
+    /**Header of the binary cache file, followed by the width of each column (padded to a multiple of 8 bytes)
+  * and by the values stored in the layout recorded in the header.
+  */
+    struct CacheHeader{
+        char magic[8];
+        qint32 version;
+        qint32 valueSize;
+        qint64 nbRows;
+        qint64 nbColumns;
+        qint64 featureFileSize;
+        qint64 featureFileModified;
+        qint32 layout;
+        qint32 reserved;
+    };
+
+    static const char kMAGIC[8];
+    static const qint32 kVERSION;
+
+    //Not implemented, the table can be large and may own a mapping.
+    FeatureArray(const FeatureArray&);
+    FeatureArray& operator=(const FeatureArray&);
+
+    void clear();
+
+    /**Allocates @p size bytes filled with zeros, in memory or in the memory-mapped
+  * backing file whose name ends with @p suffix in out-of-core mode.
+  * @param file set to the backing file, 0 if the buffer is in memory.
+  */
+    uchar* allocate(qint64 size,const QString& suffix,QFile*& file) const;
+
+    /**Releases a buffer obtained by allocate() or by mapping the cache file.
+  * @param removeFile true if the file has to be removed (backing file).
+  */
+    static void release(uchar* buffer,QFile*& file,bool removeFile);
+
+    /**Computes the offset and the step of each column from the column widths for the given @p layout.
+  * The columns are laid out by decreasing width so that every value is aligned on its width.
+  */
+    void computeLayout(Layout layout);
+
+    /**Returns the narrowest width able to hold the values of each column, the last column (time) keeping the width of dataType.*/
+    QVector<int> narrowestWidths() const;
+
+    /**Stores @p value on @p width bytes at @p destination.*/
+    static inline void write(uchar* destination,int width,dataType value){
+        switch(width){
+        case 1:
+            *reinterpret_cast<qint8*>(destination) = static_cast<qint8>(value);
+            break;
+        case 2:
+            *reinterpret_cast<qint16*>(destination) = static_cast<qint16>(value);
+            break;
+        case 4:
+            *reinterpret_cast<qint32*>(destination) = static_cast<qint32>(value);
+            break;
+        default:
+            *reinterpret_cast<qint64*>(destination) = static_cast<qint64>(value);
+            break;
+        }
+    }
+
+    /**Writes to @p file the values of the table laid out as in @p target, which has the same number of rows and columns.*/
+    bool writeValues(QFile& file,const FeatureArray& target) const;
+
+    /**Size of the column widths block following the header in the cache file.*/
+    static qint64 widthsBlockSize(qint64 nbOfColumns){return ((nbOfColumns + 7) / 8) * 8;}
+
+    dataType nbRows;
+    int nbColumns;
+    /**Number of bytes used by the values.*/
+    qint64 totalSize;
+    /**Offset in bytes of the first value of each column.*/
+    QVector<qint64> columnOffsets;
+    /**Number of bytes between two consecutive values of each column.*/
+    QVector<qint64> columnSteps;
+    /**Width in bytes of each column.*/
+    QVector<int> columnWidths;
+    Layout currentLayout;
+    Layout preferredLayout;
+    /**First value, inside buffer.*/
+    uchar* values;
+    /**Memory allocated for the values or mapping of bufferFile.*/
+    uchar* buffer;
+    /**File mapped at buffer (cache or backing file), 0 if the values are in memory.
+  * The file is kept open as long as its mapping is used.
+  */
+    QFile* bufferFile;
+    /**True if bufferFile is the read-only cache file, false if it is a backing file.*/
+    bool cacheMapped;
+    /**Base name of the backing files in out-of-core mode, empty otherwise.*/
+    QString backingFileName;
+};
+
+#endif
@@ -1,9 +1,9 @@
 /***************************************************************************
-                          minmaxthread.h  -  description
+                          featureloaderthread.cpp  -  description
                              -------------------
-    begin                : Wed Oct 22 2003
-    copyright            : (C) 2003 by Lynn Hazan
-    email                : lynn.hazan@myrealbox.com
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
  ***************************************************************************/
 
 /***************************************************************************
@@ -16,16 +16,14 @@
  ***************************************************************************/
 
 //include files for the application
-#include "minmaxthread.h"
+#include "featureloaderthread.h"
 
+//include files for QT
+#include <qapplication.h>
 
-void MinMaxThread::run()
+void FeatureLoaderThread::run()
 {
-    data.minMaxDimensionCalculation(modifiedClusters);
+    //Ask the GUI thread to replace the full-width features by their compacted version.
+    if(data.loadRemainingFeatures() && data.featureLoadingReceiver != 0L)
+        QApplication::postEvent(data.featureLoadingReceiver,featuresLoadedEvent());
 }
-
-void MinMaxThread::setModifiedClusters(const QList<int>& clusters)
-{
-    modifiedClusters = clusters;
-}
-
@@ -0,0 +1,72 @@
+/***************************************************************************
+                          featureloaderthread.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef FEATURELOADERTHREAD_H
+#define FEATURELOADERTHREAD_H
+
+//include files for the application
+#include "data.h"
+
+//include files for QT
+#include <qthread.h>
+#include <QEvent>
+
+/**Thread used to load in the background the dimensions (features) which have not been
+ * loaded when the document was opened.
+ * The thread calls the data object which will do the work. Once the dimensions are loaded, a FeaturesLoadedEvent
+ * is posted to the receiver set by Data::setFeatureLoadingReceiver(), which then calls Data::useCompactFeatures().
+ */
+
+class FeatureLoaderThread : public QThread  {
+public:
+    //Only the method featureLoader of Data has access to the private part of FeatureLoaderThread,
+    //the constructor of FeatureLoaderThread being private, only this method can create a new FeatureLoaderThread
+    friend FeatureLoaderThread* Data::featureLoader();
+
+    ~FeatureLoaderThread(){}
+
+    void run();
+
+    class FeaturesLoadedEvent;
+    friend class FeaturesLoadedEvent;
+
+    FeaturesLoadedEvent* featuresLoadedEvent(){
+        return new FeaturesLoadedEvent();
+    }
+
+    /**
+  * Internal class use to inform the receiver set on the data object that all the dimensions have been loaded.
+  */
+    class FeaturesLoadedEvent : public QEvent{
+        //Only the method featuresLoadedEvent of FeatureLoaderThread has access to the private part of FeaturesLoadedEvent,
+        //the constructor of FeaturesLoadedEvent being private, only this method can create a new FeaturesLoadedEvent
+        friend FeaturesLoadedEvent* FeatureLoaderThread::featuresLoadedEvent();
+
+    public:
+        ~FeaturesLoadedEvent(){}
+
+    private:
+        FeaturesLoadedEvent():QEvent(QEvent::Type(QEvent::User + 800)){}
+    };
+
+private:
+    Data& data;
+    FeatureLoaderThread(Data& d):data(d){}
+};
+
+
+#endif
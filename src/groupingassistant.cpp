@@ -20,6 +20,7 @@
 //Include files for QT
 #include <qmap.h>
 #include <QList>
+#include <QVector>
 
 //include files for c/c++ libraires.
 #include <math.h>
@@ -27,7 +28,7 @@
 
 
 GroupingAssistant::GroupingAssistant()
-    :existCluster1(false),initIndex(1),haveToStopComputing(false)
+    :spikesByCluster(0L),existCluster1(false),initIndex(1),haveToStopComputing(false)
 {
 }
 
@@ -50,16 +51,16 @@ Array<double>* GroupingAssistant::computeMeanProbabilities(Data& clusteringData,
     //Compute "Error matrix" = mean probabilies that spike of cluster c1 actually belongs to c2.
     int nbClusters = clusterList.size();
 
-    Data::ClusterInfoMap::Iterator iterator;
+    Data::ClusterInfoMap::ConstIterator iterator;
     int clusterIndex = initIndex;
-    for(iterator = clusterInfoMap->begin(); iterator != clusterInfoMap->end(); ++iterator){
+    for(iterator = clusterInfoMap.constBegin(); iterator != clusterInfoMap.constEnd(); ++iterator){
 
         if(haveToStopComputing)
             break; //We do not care about what is return as it will not be used.
 
-        dataType firstSpikePosition = iterator.value().firstSpikePosition();
-        dataType nbSpikesOfCluster = iterator.value().nbSpikes();
-        dataType lastPosition =  firstSpikePosition + nbSpikesOfCluster;
+        const dataType* clusterSpikes = spikesByCluster->constFind(iterator.key()).value().constData();
+        dataType nbSpikesOfCluster = iterator.nbSpikes();
+        dataType lastPosition = nbSpikesOfCluster;
 
         //Check if the current cluster has been ignored
         if(ignoreClusterIndex.contains(clusterIndex) != 0){
@@ -76,8 +77,8 @@ Array<double>* GroupingAssistant::computeMeanProbabilities(Data& clusteringData,
 
             //Accumulate sums for mean calculation
             double sum = 0;
-            for(dataType i = firstSpikePosition; i < lastPosition;++i){
-                dataType featuresRowIndex = (*spikesByCluster)(1,i);
+            for(dataType i = 0; i < lastPosition;++i){
+                dataType featuresRowIndex = clusterSpikes[i];
 
                 sum += (*probabilities)(featuresRowIndex,clusterIndex2);
             }
@@ -91,8 +92,10 @@ Array<double>* GroupingAssistant::computeMeanProbabilities(Data& clusteringData,
         (*errorMatrix)(clusterIndex,clusterIndex) = 0;
     }
 
-    delete spikesByCluster;
-    delete clusterInfoMap;
+    //Release the version of the clusters used for the computation.
+    spikesByCluster = 0L;
+    clusterInfoMap = Data::ClusterInfoMap();
+    clusters = Data::ClusteringSnapshot();
     delete probabilities;
 
     return errorMatrix;
@@ -107,17 +110,22 @@ Array<double>* GroupingAssistant::computeProbabilities(Data& clusteringData,QLis
     //Only the PCs dimensions are taken into account.
     int nbDimensions = clusteringData.totalNbOfPCAs();
 
-    spikesByCluster;
-    clusterInfoMap;
-    //Obtain a copy of the internal variables of data storing the information the clusters.
-    //A copy is needed because the clusters can changed while the calculation is in process.
-    clusteringData.duplicate(spikesByCluster,clusterInfoMap);
+    //The PCs may still be loading in the background.
+    for(int i = 1; i <= nbDimensions;++i) clusteringData.waitForDimension(i);
+
+    //The features are not replaced by their compacted version while the calculation reads them.
+    QReadLocker featuresLocker(&clusteringData.featuresLock);
+
+    //Work on the last published version of the clusters, which does not change while the calculation is in process.
+    clusters = clusteringData.snapshot();
+    spikesByCluster = &clusters.spikesByCluster();
+    clusterInfoMap = clusters.clusterInfoMap();
 
     //Cluster 0 is not compute.
-    if(clusterInfoMap->contains(0))
-        clusterInfoMap->remove(0);
+    if(clusterInfoMap.contains(0))
+        clusterInfoMap.remove(0);
 
-    int nbClusters = clusterInfoMap->count();
+    int nbClusters = clusterInfoMap.count();
 
     if(haveToStopComputing) return new Array<double>(0,0);//We do not care about what is return as it will not be used.
 
@@ -131,15 +139,15 @@ Array<double>* GroupingAssistant::computeProbabilities(Data& clusteringData,QLis
 
     double piTerm = static_cast<double>(log(2 * M_PI)) * nbDimensions / 2;
 
-    Data::ClusterInfoMap::Iterator iterator;
+    Data::ClusterInfoMap::ConstIterator iterator;
     int clusterIndex = 1;
     int cluster1Index = 1;
 
     //NB: the iterator iterates on the items sorted by their key (clusterId)
-    for(iterator = clusterInfoMap->begin(); iterator != clusterInfoMap->end(); ++iterator){
+    for(iterator = clusterInfoMap.constBegin(); iterator != clusterInfoMap.constEnd(); ++iterator){
         if(haveToStopComputing) return probabilities;//We do not care about what is return as it will not be used.
 
-        dataType nbSpikesOfCluster = iterator.value().nbSpikes();
+        dataType nbSpikesOfCluster = iterator.nbSpikes();
         dataType clusterId = iterator.key();
 
         //Check if the cluster1 exists
@@ -181,19 +189,23 @@ Array<double>* GroupingAssistant::computeProbabilities(Data& clusteringData,QLis
         double weight = static_cast<double>(log(static_cast<double>(static_cast<double>(nbSpikesOfCluster)/static_cast<double>(nbSpikes))));
         double logTerm = logRootDet - weight + piTerm;
 
+        //Accessors to the PCA dimensions, whatever the storage order of the features.
+        QVector<FeatureArray::Column> columns(nbDimensions + 1);
+        for(int i = 1; i <= nbDimensions;++i) columns[i] = clusteringData.features.column(i);
+
         Array<double> dataMinusMean;
         dataMinusMean.setSize(1,nbDimensions);
         Array<double> root;
         root.setSize(1,nbDimensions);
         root.fillWithZeros();
 
-        Data::ClusterInfoMap::Iterator iterator2;
+        Data::ClusterInfoMap::ConstIterator iterator2;
         int clusterIndex2 = 1;
-        for(iterator2 = clusterInfoMap->begin(); iterator2 != clusterInfoMap->end(); ++iterator2){
+        for(iterator2 = clusterInfoMap.constBegin(); iterator2 != clusterInfoMap.constEnd(); ++iterator2){
             if(haveToStopComputing) return probabilities;//We do not care about what is return as it will not be used.
 
-            dataType firstSpikePosition = iterator2.value().firstSpikePosition();
-            dataType lastPosition =  firstSpikePosition + iterator2.value().nbSpikes();
+            const dataType* clusterSpikes = spikesByCluster->constFind(iterator2.key()).value().constData();
+            dataType lastPosition = iterator2.nbSpikes();
 
             //Check if the current cluster has been ignore
             if(ignoreClusterIndex.contains(clusterIndex2) != 0){
@@ -201,13 +213,13 @@ Array<double>* GroupingAssistant::computeProbabilities(Data& clusteringData,QLis
                 continue;
             }
 
-            for(dataType i = firstSpikePosition; i < lastPosition;++i){
-                dataType featuresRowIndex = (*spikesByCluster)(1,i);
+            for(dataType i = 0; i < lastPosition;++i){
+                dataType featuresRowIndex = clusterSpikes[i];
 
                 double sum = 0;
                 //Calculate data minus cluster mean.
                 for(int i = 1; i <= nbDimensions;++i){
-                    sum = clusteringData.features(featuresRowIndex,i)
+                    sum = columns[i][featuresRowIndex]
                             - means(clusterIndex,i);
 
                     //Calculate root vector - by choleskyDecomposition*root = dataMinusMean.
@@ -248,11 +260,11 @@ Array<double>* GroupingAssistant::computeProbabilities(Data& clusteringData,QLis
     }
 
     clusterIndex = initIndex;
-    for(iterator = clusterInfoMap->begin(); iterator != clusterInfoMap->end(); ++iterator){
+    for(iterator = clusterInfoMap.constBegin(); iterator != clusterInfoMap.constEnd(); ++iterator){
         if(haveToStopComputing) return probabilities;//We do not care about what is return as it will not be used.
 
-        dataType firstSpikePosition = iterator.value().firstSpikePosition();
-        dataType lastPosition =  firstSpikePosition + iterator.value().nbSpikes();
+        const dataType* clusterSpikes = spikesByCluster->constFind(iterator.key()).value().constData();
+        dataType lastPosition = iterator.nbSpikes();
 
         //Check if the current cluster has been ignore
         if(ignoreClusterIndex.contains(clusterIndex) != 0){
@@ -260,8 +272,8 @@ Array<double>* GroupingAssistant::computeProbabilities(Data& clusteringData,QLis
             continue;
         }
 
-        for(dataType i = firstSpikePosition; i < lastPosition;++i){
-            dataType featuresRowIndex = (*spikesByCluster)(1,i);
+        for(dataType i = 0; i < lastPosition;++i){
+            dataType featuresRowIndex = clusterSpikes[i];
 
             double sum = 0;
             for(int clusterIndex2 = initIndex; clusterIndex2 <= nbClusters; ++clusterIndex2)
@@ -315,16 +327,20 @@ void GroupingAssistant::meanCovarianceComputation(int nbClusters,int nbDimension
     covariances.setSize(nbClusters,nbDimensions * nbDimensions);
     covariances.fillWithZeros();
 
-    Data::ClusterInfoMap::Iterator iterator;
+    //Accessors to the PCA dimensions, whatever the storage order of the features.
+    QVector<FeatureArray::Column> columns(nbDimensions + 1);
+    for(int j = 1;j <= nbDimensions;++j) columns[j] = clusteringData.features.column(j);
+
+    Data::ClusterInfoMap::ConstIterator iterator;
 
     int clusterIndex = 1;
     //NB: the iterator iterates on the items sorted by their key
-    for(iterator = clusterInfoMap->begin(); iterator != clusterInfoMap->end(); ++iterator){
+    for(iterator = clusterInfoMap.constBegin(); iterator != clusterInfoMap.constEnd(); ++iterator){
         if(haveToStopComputing) return;//We do not care about the result as it will not be used.
 
-        dataType firstSpikePosition = iterator.value().firstSpikePosition();
-        dataType nbSpikesOfCluster = iterator.value().nbSpikes();
-        dataType lastPosition =  firstSpikePosition + nbSpikesOfCluster;
+        const dataType* clusterSpikes = spikesByCluster->constFind(iterator.key()).value().constData();
+        dataType nbSpikesOfCluster = iterator.nbSpikes();
+        dataType lastPosition = nbSpikesOfCluster;
 
         //Check if a cluster as to be ignore <=> not enough spikes.
         bool ignore = false;
@@ -336,12 +352,13 @@ void GroupingAssistant::meanCovarianceComputation(int nbClusters,int nbDimension
         if(!ignore && !haveToStopComputing){
             //Calculate the means.
 
-            //Accumulate sums for mean caculation
-            for(dataType i = firstSpikePosition; i < lastPosition;++i){
-                dataType featuresRowIndex = (*spikesByCluster)(1,i);
-                for(int j = 1;j <= nbDimensions;++j){
-                    means(clusterIndex,j) += static_cast<double>(clusteringData.features(featuresRowIndex,j));
-                }
+            //Accumulate sums for mean caculation, one dimension at a time.
+            for(int j = 1;j <= nbDimensions;++j){
+                const FeatureArray::Column& values = columns[j];
+                double sum = 0;
+                for(dataType i = 0; i < lastPosition;++i)
+                    sum += static_cast<double>(values[clusterSpikes[i]]);
+                means(clusterIndex,j) = sum;
             }
 
             //Normalize
@@ -350,12 +367,12 @@ void GroupingAssistant::meanCovarianceComputation(int nbClusters,int nbDimension
             }
 
             //Calculate the covariances.
-            for(dataType i = firstSpikePosition; i < lastPosition;++i){
-                dataType featuresRowIndex = (*spikesByCluster)(1,i);
+            for(dataType i = 0; i < lastPosition;++i){
+                dataType featuresRowIndex = clusterSpikes[i];
 
                 //Calculate distance from mean
                 for(int j = 1;j <= nbDimensions;++j){
-                    dataMinusMean(1,j) = (static_cast<double>(clusteringData.features(featuresRowIndex,j))
+                    dataMinusMean(1,j) = (static_cast<double>(columns[j][featuresRowIndex])
                                           - means(clusterIndex,j));
                 }
 
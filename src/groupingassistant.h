@@ -68,19 +68,17 @@ private:
     /**Array containing the means of the clusters computed.*/
     Array<double> means;
 
+    /**Version of the clusters on which the computation is done, it does not change during the computation.*/
+    Data::ClusteringSnapshot clusters;
+
     /**
-  * Copy of the @ref Data::spikesByCluster, a two line array which contains sorted by cluster numbers:
-  * the row index of the spike in features array.
-  * the id of the cluster.
+  * Spikes of the clusters of the snapshot, which contains for each cluster number
+  * the row indices of its spikes in features array, sorted by time.
   */
-    SortableTable* spikesByCluster;
+    const Data::SpikesByClusterMap* spikesByCluster;
 
-    /**Copy of the @ref Data::clusterInfoMap, contains ClusterInfo(s)
-  * key: cluster number
-  * value: a ClusterInfo (which gives:
-  * the index of the first spike in spikesByCluster and the number of spikes for a given cluster).
-  */
-    Data::ClusterInfoMap* clusterInfoMap;
+    /**Number of spikes and user information of the clusters of the snapshot, cluster 0 excepted.*/
+    Data::ClusterInfoMap clusterInfoMap;
 
     /**True if the cluster 1 is among the clusters to compute, false otherwise.*/
     bool existCluster1;
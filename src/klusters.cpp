@@ -20,6 +20,7 @@
 #include "klustersdoc.h"
 #include "clusterPalette.h"
 #include "savethread.h"
+#include "openthread.h"
 #include "prefdialog.h"
 #include "configuration.h"  // class Configuration
 #include "processwidget.h"
@@ -61,6 +62,7 @@
 #include <QFileDialog>
 #include <QTime>
 #include <QSettings>
+#include <QProgressDialog>
 
 extern int nbUndo;
 
@@ -130,6 +132,10 @@ KlustersApp::KlustersApp()
     //create the thread which will be used to save the cluster file
     saveThread = new SaveThread(this);
 
+    //create the thread which will be used to load the documents
+    openThread = new OpenThread(this);
+    openProgressDialog = 0L;
+
 
     //Prepare the spineboxes and line edit
     initSelectionBoxes();
@@ -147,6 +153,9 @@ KlustersApp::KlustersApp()
 KlustersApp::~KlustersApp()
 {
     //Clear the memory by deleting all the pointers
+    openThread->cancel();
+    while(!openThread->wait()){};
+    delete openThread;
     delete doc;
     delete saveThread;
     delete processWidget;
@@ -1076,6 +1085,12 @@ void KlustersApp::openDocumentFile(const QString& url)
         return;
 
     }
+    //A document is being loaded, only one document at the time is allowed.
+    if(openProgressDialog != 0L){
+        mFileOpenRecent->addRecentFile(url); //hack, unselect the item
+        return;
+    }
+
     slotStatusMsg(tr("Ready."));
     QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
     
@@ -1087,121 +1102,28 @@ void KlustersApp::openDocumentFile(const QString& url)
 
         mFileOpenRecent->addRecentFile(url);
 
-        // Open the file (that will also initialize the doc)
-        QString errorInformation;
-        int returnStatus = doc->openDocument(url,errorInformation);
-        if(returnStatus == KlustersDoc::INCORRECT_FILE)
-        {
-            QApplication::restoreOverrideCursor();
-            QMessageBox::critical (this, tr("Error!"), tr("The selected file is invalid, it has to be of the form baseName.clu.n or baseName.fet.n or baseName.par.n"));
-            QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-            //close the document
-            doc->closeDocument();
-
-            resetState();
-            QApplication::restoreOverrideCursor();
-            slotStatusMsg(tr("Ready."));
-            return;
-        } else if(returnStatus == KlustersDoc::DOWNLOAD_ERROR)
-        {
-            QApplication::restoreOverrideCursor();
-            QMessageBox::critical (this,tr("Error!"),tr("Could not get the cluster file (base.clu.n)") );
-            QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-            //close the document
-            doc->closeDocument();
-            resetState();
-            QApplication::restoreOverrideCursor();
-            slotStatusMsg(tr("Ready."));
-            return;
-        } else if(returnStatus == KlustersDoc::SPK_DOWNLOAD_ERROR)
-        {
-            QApplication::restoreOverrideCursor();
-            QMessageBox::critical (this,tr("Error!"),tr("Could not get the spike file (base.spk.n)"));
-            QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-            //close the document
-            doc->closeDocument();
-            resetState();
-            QApplication::restoreOverrideCursor();
-            slotStatusMsg(tr("Ready."));
-            return;
-        } else if(returnStatus == KlustersDoc::FET_DOWNLOAD_ERROR)
-        {
-            QApplication::restoreOverrideCursor();
-            QMessageBox::critical (this,tr("Error!"),tr("Could not get the feature file (base.fet.n)"));
-            QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-            //close the document
-            doc->closeDocument();
-            resetState();
-            QApplication::restoreOverrideCursor();
-            slotStatusMsg(tr("Ready."));
-            return;
-        } else if(returnStatus == KlustersDoc::PAR_DOWNLOAD_ERROR)
-        {
-            QApplication::restoreOverrideCursor();
-            QMessageBox::critical (this,tr("Error!"),tr("Could not get the general parameter file (base.par)"));
-            QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-            //close the document
-            doc->closeDocument();
-            resetState();
-            QApplication::restoreOverrideCursor();
-            slotStatusMsg(tr("Ready."));
-            return;
-        } else if(returnStatus == KlustersDoc::PARX_DOWNLOAD_ERROR)
-        {
-            QApplication::restoreOverrideCursor();
-            QMessageBox::critical (this,tr("Error!"), tr("Could not get the specific parameter file (base.par.n)") );
-            QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-            //close the document
-            doc->closeDocument();
-            resetState();
-            QApplication::restoreOverrideCursor();
-            slotStatusMsg(tr("Ready."));
-            return;
-        } else if(returnStatus == KlustersDoc::PARXML_DOWNLOAD_ERROR)
-        {
-            QApplication::restoreOverrideCursor();
-            QMessageBox::critical (this,tr("Error!"),tr("Could not get the parameter file (base.xml)"));
-            QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-            //close the document
-            doc->closeDocument();
-            resetState();
-            QApplication::restoreOverrideCursor();
-            slotStatusMsg(tr("Ready."));
-            return;
-        } else if(returnStatus == KlustersDoc::OPEN_ERROR)
-        {
-            QApplication::restoreOverrideCursor();
-            QMessageBox::critical (this,tr("Error!"),tr("Could not open the files") );
-            QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-            //close the document
-            doc->closeDocument();
-            resetState();
-            QApplication::restoreOverrideCursor();
-            slotStatusMsg(tr("Ready."));
-            return;
-        } else if(returnStatus == KlustersDoc::INCORRECT_CONTENT)
-        {
-            QApplication::restoreOverrideCursor();
-            QMessageBox::critical (this,tr("Error!"),errorInformation);
-            QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-            //close the document
-            doc->closeDocument();
-            resetState();
-            QApplication::restoreOverrideCursor();
-            slotStatusMsg(tr("Ready."));
+        // Check the files of the document, the data are then loaded by the openThread.
+        int returnStatus = doc->openDocument(url);
+        if(returnStatus != KlustersDoc::OK){
+            openDocumentFailed(returnStatus,QString());
             return;
         }
 
-        setWindowTitle(doc->documentName());
-        initDisplay();
-
-        //A traceView is possible only if the variables it needs are available (provided in the new parameter file) and
-        //the .dat file exists.
-        if(doc->areTraceDataAvailable() && doc->isTraceViewVariablesAvailable()) {
-            slotStateChanged("traceDisplayState");
-        }
-
+        //The application stays responsive during the loading, which can be cancelled from the progress dialog.
+        //The display is created once the data are loaded (see customEvent).
         QApplication::restoreOverrideCursor();
+        openProgressDialog = new QProgressDialog(tr("Loading the parameters..."),tr("Cancel"),0,Data::NB_LOADING_STAGES,this);
+        openProgressDialog->setWindowTitle(tr("Opening file..."));
+        openProgressDialog->setWindowModality(Qt::WindowModal);
+        openProgressDialog->setAutoClose(false);
+        openProgressDialog->setAutoReset(false);
+        openProgressDialog->setMinimumDuration(0);
+        connect(openProgressDialog,SIGNAL(canceled()),this,SLOT(slotCancelOpen()));
+        openProgressDialog->show();
+
+        slotStatusMsg(tr("Loading file..."));
+        openThread->load(doc);
+        return;
     }
     // check, if this document is already open. If yes, do not do anything
     else{
@@ -1243,6 +1165,54 @@ void KlustersApp::openDocumentFile(const QString& url)
     slotStatusMsg(tr("Ready."));
 }
 
+void KlustersApp::openDocumentFailed(int status,const QString& errorInformation){
+    QApplication::restoreOverrideCursor();
+    switch(status){
+    case KlustersDoc::INCORRECT_FILE:
+        QMessageBox::critical (this, tr("Error!"), tr("The selected file is invalid, it has to be of the form baseName.clu.n or baseName.fet.n or baseName.par.n"));
+        break;
+    case KlustersDoc::DOWNLOAD_ERROR:
+        QMessageBox::critical (this,tr("Error!"),tr("Could not get the cluster file (base.clu.n)") );
+        break;
+    case KlustersDoc::SPK_DOWNLOAD_ERROR:
+        QMessageBox::critical (this,tr("Error!"),tr("Could not get the spike file (base.spk.n)"));
+        break;
+    case KlustersDoc::FET_DOWNLOAD_ERROR:
+        QMessageBox::critical (this,tr("Error!"),tr("Could not get the feature file (base.fet.n)"));
+        break;
+    case KlustersDoc::PAR_DOWNLOAD_ERROR:
+        QMessageBox::critical (this,tr("Error!"),tr("Could not get the general parameter file (base.par)"));
+        break;
+    case KlustersDoc::PARX_DOWNLOAD_ERROR:
+        QMessageBox::critical (this,tr("Error!"), tr("Could not get the specific parameter file (base.par.n)") );
+        break;
+    case KlustersDoc::PARXML_DOWNLOAD_ERROR:
+        QMessageBox::critical (this,tr("Error!"),tr("Could not get the parameter file (base.xml)"));
+        break;
+    case KlustersDoc::OPEN_ERROR:
+        QMessageBox::critical (this,tr("Error!"),tr("Could not open the files") );
+        break;
+    case KlustersDoc::INCORRECT_CONTENT:
+        QMessageBox::critical (this,tr("Error!"),errorInformation);
+        break;
+    //The loading has been cancelled by the user, there is nothing to report.
+    case KlustersDoc::CANCELLED:
+    default:
+        break;
+    }
+    QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+    //close the document
+    doc->closeDocument();
+    resetState();
+    QApplication::restoreOverrideCursor();
+    slotStatusMsg(tr("Ready."));
+}
+
+void KlustersApp::slotCancelOpen(){
+    slotStatusMsg(tr("Cancelling..."));
+    openThread->cancel();
+}
+
 void KlustersApp::importDocumentFile(const QString& url)
 {
     slotStatusMsg(tr("Importing file..."));
@@ -1298,6 +1268,14 @@ bool KlustersApp::queryClose()
     //implement to ask the user to save if necessary before closing
     if(doc == 0) return true;
     else{
+        //If a document is being loaded, stop the loading, the document is then closed as usual.
+        if(openProgressDialog != 0L){
+            openThread->cancel();
+            while(!openThread->wait()){};
+            delete openProgressDialog;
+            openProgressDialog = 0L;
+        }
+
         if(doc->canCloseView()){
             //Set a waiting cursor in case there is some delay to the ending of the running threads.
             QApplication::restoreOverrideCursor();
@@ -1331,12 +1309,67 @@ bool KlustersApp::queryExit()
     QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
     //If the saveThread has not finish, wait until id done
     while(!saveThread->wait()){qDebug()<<"in queryExit";};
+    //Stop the loading of a document, if any
+    openThread->cancel();
+    while(!openThread->wait()){};
     QApplication::restoreOverrideCursor();
 
     return true;
 }
 
 void KlustersApp::customEvent (QEvent* event){
+    //Event sent by the OpenThread at the beginning of each stage of the loading.
+    if(event->type() == QEvent::User + 110){
+        OpenThread::OpenProgressEvent* progressEvent = (OpenThread::OpenProgressEvent*) event;
+        if(openProgressDialog != 0L && !openThread->isCancelled()){
+            switch(progressEvent->loadingStage()){
+            case Data::LOADING_PARAMETERS:
+                openProgressDialog->setLabelText(tr("Loading the parameters..."));
+                break;
+            case Data::LOADING_CLUSTERS:
+                openProgressDialog->setLabelText(tr("Loading the clusters..."));
+                break;
+            case Data::LOADING_FEATURES:
+                openProgressDialog->setLabelText(tr("Loading the features..."));
+                break;
+            case Data::BUILDING_LAYOUT:
+                openProgressDialog->setLabelText(tr("Sorting the spikes by cluster..."));
+                break;
+            default:
+                openProgressDialog->setLabelText(tr("Computing the range of the features..."));
+                break;
+            }
+            openProgressDialog->setValue(progressEvent->loadingStage());
+        }
+    }
+    //Event sent by the OpenThread once the loading is done.
+    if(event->type() == QEvent::User + 120){
+        OpenThread::OpenDoneEvent* doneEvent = (OpenThread::OpenDoneEvent*) event;
+        //The document has already been closed if the application has been closed during the loading.
+        if(openProgressDialog == 0L) return;
+        while(!openThread->wait()){};
+        delete openProgressDialog;
+        openProgressDialog = 0L;
+
+        if(doneEvent->status() != KlustersDoc::OK){
+            openDocumentFailed(doneEvent->status(),doneEvent->errorInformation());
+            return;
+        }
+
+        QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+        doc->documentLoaded();
+        setWindowTitle(doc->documentName());
+        initDisplay();
+
+        //A traceView is possible only if the variables it needs are available (provided in the new parameter file) and
+        //the .dat file exists.
+        if(doc->areTraceDataAvailable() && doc->isTraceViewVariablesAvailable()) {
+            slotStateChanged("traceDisplayState");
+        }
+
+        QApplication::restoreOverrideCursor();
+        slotStatusMsg(tr("Ready."));
+    }
     //Event sent by the SaveThread
     if(event->type() == QEvent::User + 100){
         slotStatusMsg(tr("Save file done."));
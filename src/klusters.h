@@ -48,6 +48,8 @@
 class KlustersDoc;
 class ClusterPalette;
 class SaveThread;
+class OpenThread;
+class QProgressDialog;
 class PrefDialog;
 class ProcessWidget;
 class QRecentFileAction;
@@ -169,6 +171,8 @@ private Q_SLOTS:
     void slotFileImport();
     /** Opens a file from the recent files menu */
     void slotFileOpenRecent(const QString& url);
+    /** Cancels the loading of the document being opened.*/
+    void slotCancelOpen();
     /** Save the document */
     void slotFileSave();
     /** Renumbers the cluster and save the document.*/
@@ -462,6 +466,12 @@ private:
     /**Resets the state of the application to a none document open state.*/
     void resetState();
 
+    /**Informs the user that the document could not be opened and closes it.
+    * @param status the KlustersDoc::OpenSaveCreateReturnMessage giving the open status.
+    * @param errorInformation detail about the error for an incorrect content.
+    */
+    void openDocumentFailed(int status,const QString& errorInformation);
+
     /**Updates the acess to the undo/redo mechanism*/
     void updateUndoRedoDisplay();
 
@@ -584,6 +594,12 @@ private:
     */
     SaveThread* saveThread;
 
+    /**Thread used to load the data of a document, so the application stays responsive during the loading.*/
+    OpenThread* openThread;
+
+    /**Dialog showing the progress of the loading of a document, 0 if no document is being loaded.*/
+    QProgressDialog* openProgressDialog;
+
     /**Amount of time used when looking for the spikes when the presentation mode is time frame.
     * This amount is in second and the default is 30.
     */
@@ -42,6 +42,7 @@
 #include "types.h"
 #include "autosavethread.h"
 #include "parameterxmlmodifier.h"
+#include "configuration.h"
 
 //C, C++ include files
 //#define _LARGEFILE_SOURCE already defined in /usr/include/features.h
@@ -53,6 +54,9 @@
 
 extern int nbUndo;
 
+/**Delay, in miliseconds, before trying again to compact the features while a computation is reading them.*/
+static const int kCOMPACT_FEATURES_RETRY = 500;
+
 KlustersDoc::KlustersDoc(QWidget* parent,ClusterPalette& clusterPalette,bool autoSave,int savingInterval)
     : clusterColorListUndoList(),clusterColorListRedoList(),modified(false),docUrl(),parent(parent),clusterPalette(clusterPalette),
     addedClustersUndoList(),addedClustersRedoList(),modifiedClustersUndoList(),modifiedClustersRedoList()
@@ -65,6 +69,7 @@ KlustersDoc::KlustersDoc(QWidget* parent,ClusterPalette& clusterPalette,bool aut
     deletedClusters = 0L;
     endAutoSaving = false;
     autoSaveThread = 0L;
+    isXmlParExist = false;
 }
 
 KlustersDoc::~KlustersDoc(){
@@ -110,6 +115,18 @@ bool KlustersDoc::isLastView() {
     return ((int) viewList->count() == 1);
 }
 
+QList<int> KlustersDoc::clustersInWaveformViews() const{
+    QList<int> clusters;
+    for(int i =0; i<viewList->count();++i){
+        KlustersView *view = viewList->at(i);
+        if(!view->containsWaveformView()) continue;
+        const QList<int>& shownClusters = view->clusters();
+        for(int j = 0; j < shownClusters.count(); ++j)
+            if(!clusters.contains(shownClusters[j])) clusters.append(shownClusters[j]);
+    }
+    return clusters;
+}
+
 
 void KlustersDoc::updateAllViews(KlustersView *sender){
     for(int i =0; i<viewList->count();++i)
@@ -179,6 +196,9 @@ void KlustersDoc::closeDocument(){
     //Remove the temp files if any
     tmpCluFile.clear();
     tmpSpikeFile.clear();
+    fetFileUrl.clear();
+    parXFileUrl.clear();
+    parFileUrl.clear();
 
     //Variables link to TraceView
     if(channelColorList != 0L){
@@ -209,10 +229,11 @@ bool KlustersDoc::importDocument(const QString &url, const char *format ){
     return  returnValue;
 }
 
-int KlustersDoc::openDocument(const QString &url,QString& errorInformation, const char *format ){
+int KlustersDoc::openDocument(const QString &url, const char *format ){
     //1 - Get the base name of the file
-    //2 - load the config information: read the different files, initialize clusteringData (loadConfigFromNewFormat())
-    //3 - load the spikes, clusters, time and PCA information (loadDataFromNewFormat())
+    //2 - Check the presence of the different files and ask the user what to do in case of ambiguity
+    //3 - The config information and the spikes, clusters, time and PCA information are loaded by loadDocument(),
+    //which can be called from another thread.
 
     //Initialize the members specific to a document
     clusteringData = new Data();
@@ -247,56 +268,37 @@ int KlustersDoc::openDocument(const QString &url,QString& errorInformation, cons
     cluFileSaveUrl = urlFileInfo.absolutePath() + QDir::separator() + "." + urlFileInfo.fileName() + ".autosave";
 
 
-    QString fetFileUrl = urlFileInfo.absolutePath() + QDir::separator() + baseName +".fet."+ electrodeGroupID;
+    fetFileUrl = urlFileInfo.absolutePath() + QDir::separator() + baseName +".fet."+ electrodeGroupID;
+    //The features are read from a binary cache (baseName.fet.x.kcache) when it is up to date with the fet file.
+    clusteringData->setFeatureCacheFileName(FeatureArray::cacheFileName(fetFileUrl));
+    clusteringData->setFeatureLayout(configuration().isFeaturesByDimension() ? FeatureArray::COLUMN_MAJOR : FeatureArray::ROW_MAJOR);
+    clusteringData->setFeaturesOutOfCore(configuration().isFeaturesOutOfCore());
+    clusteringData->setLazyFeatureDimensions(configuration().getLazyFeatureDimensions());
+    clusteringData->setFeatureLoadingReceiver(this);
+    clusteringData->setWaveformCacheBudget(static_cast<qint64>(configuration().getWaveformCacheSize()) * 1024 * 1024);
     //Parameter files
     QString xmlParFileUrl = urlFileInfo.absolutePath() + QDir::separator() + baseName +".xml";
     xmlParameterFile = xmlParFileUrl;
 
 
 
-    QString parXFileUrl = urlFileInfo.absolutePath() + QDir::separator() + baseName +".par."+ electrodeGroupID;
+    parXFileUrl = urlFileInfo.absolutePath() + QDir::separator() + baseName +".par."+ electrodeGroupID;
 
 
-    QString parFileUrl = urlFileInfo.absolutePath() + QDir::separator() + baseName +".par";
+    parFileUrl = urlFileInfo.absolutePath() + QDir::separator() + baseName +".par";
 
 
     //Download the spike and fet files in temp files if necessary
     if(!QFile(spkFileUrl).exists())
         return SPK_DOWNLOAD_ERROR;
-    QString tmpSpikeFile = spkFileUrl;
-
+    tmpSpikeFile = spkFileUrl;
 
-    QFile fetFile(fetFileUrl);
-    if(!fetFile.exists())
+    if(!QFile(fetFileUrl).exists())
         return FET_DOWNLOAD_ERROR;
-    //Open the the spike and fet files. Only the fet file will be loaded the spike file
-    // will be used on the fly when waveforms will need to be drawn.
-    //The biggest files are open in a C FILE to enable a quick access, the others (parameter files) are open in a QFile
-    if(!fetFile.open(QIODevice::ReadOnly)){
-        return OPEN_ERROR;
-    }
-
-    //The length of the spike file is used to determine the number of spikes.
-    QFile spikeFile(tmpSpikeFile);
-
-    if(!spikeFile.open(QIODevice::ReadOnly)){
-        fetFile.close();
-        return OPEN_ERROR;
-    }
-    long spkFileLength = spikeFile.size();
-    spikeFile.close();
 
-    bool isXmlParExist = false;
-    QString tmpXmlParFile;
-    QString tmpParXFile;
-    QString tmpParFile;
     QFileInfo xmlParFileInfo(xmlParFileUrl);
-    QFile xmlParFile;
-    QFile parXFile;
-    QFile parFile;
-    if(xmlParFileInfo.exists()){
-        tmpXmlParFile = xmlParFileUrl;
-        isXmlParExist = true;
+    isXmlParExist = xmlParFileInfo.exists();
+    if(isXmlParExist){
         //Check if the generic parameter file also exist, if so, warn the user that the xml format parameter file will be used.
         QFileInfo parFileInfo(parFileUrl);
         if(parFileInfo.exists()){
@@ -304,35 +306,12 @@ int KlustersDoc::openDocument(const QString &url,QString& errorInformation, cons
             QMessageBox::information(0, tr("Warning!"), tr("Two parameter files were found, %1 and %2. The parameter file %3 will be used.").arg(xmlParFileUrl).arg(parFileUrl).arg(xmlParFileUrl));
             QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
         }
-        xmlParFile.setFileName(tmpXmlParFile);
-        if(!xmlParFile.open(QIODevice::ReadOnly)){
-            fetFile.close();
-            return OPEN_ERROR;
-        }
     }
     else{
-        if(!QFile(parXFileUrl).exists()) {
-            fetFile.close();
+        if(!QFile(parXFileUrl).exists())
             return PARX_DOWNLOAD_ERROR;
-        }
-        tmpParXFile = parXFileUrl;
-        parXFile.setFileName(tmpParXFile);
-        if(!parXFile.open(QIODevice::ReadOnly)){
-            fetFile.close();
-            return OPEN_ERROR;
-        }
-        if(!QFile(parFileUrl).exists()) {
-            fetFile.close();
-            parXFile.close();
+        if(!QFile(parFileUrl).exists())
             return PAR_DOWNLOAD_ERROR;
-        }
-        tmpParFile = parFileUrl;
-        parFile.setFileName(tmpParFile);
-        if(!parFile.open(QIODevice::ReadOnly)){
-            fetFile.close();
-            parXFile.close();
-            return OPEN_ERROR;
-        }
     }
 
     //If a crashRecoveryFile exits, check if it is newer than the clu file, if so
@@ -365,11 +344,60 @@ int KlustersDoc::openDocument(const QString &url,QString& errorInformation, cons
             QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
         }
     }
+    tmpCluFile = cluFileUrl;
+
+    return OK;
+}
+
+int KlustersDoc::loadDocument(QString& errorInformation,Data::LoadingMonitor* monitor){
+    //Open the the spike and fet files. Only the fet file will be loaded the spike file
+    // will be used on the fly when waveforms will need to be drawn.
+    QFile fetFile(fetFileUrl);
+    if(!fetFile.open(QIODevice::ReadOnly)){
+        return OPEN_ERROR;
+    }
+
+    //The length of the spike file is used to determine the number of spikes.
+    QFile spikeFile(tmpSpikeFile);
+
+    if(!spikeFile.open(QIODevice::ReadOnly)){
+        fetFile.close();
+        return OPEN_ERROR;
+    }
+    long spkFileLength = spikeFile.size();
+    spikeFile.close();
+
+    QFile xmlParFile;
+    QFile parXFile;
+    QFile parFile;
+    if(isXmlParExist){
+        xmlParFile.setFileName(xmlParameterFile);
+        if(!xmlParFile.open(QIODevice::ReadOnly)){
+            fetFile.close();
+            return OPEN_ERROR;
+        }
+    }
+    else{
+        parXFile.setFileName(parXFileUrl);
+        if(!parXFile.open(QIODevice::ReadOnly)){
+            fetFile.close();
+            return OPEN_ERROR;
+        }
+        parFile.setFileName(parFileUrl);
+        if(!parFile.open(QIODevice::ReadOnly)){
+            fetFile.close();
+            parXFile.close();
+            return OPEN_ERROR;
+        }
+    }
+
+    //The loading can be followed and cancelled by the monitor.
+    clusteringData->setLoadingMonitor(monitor);
+    bool cancelled = false;
 
     //Treat the cluster file separately as it can be empty
-    QFile cluFile(cluFileUrl);
+    QFile cluFile(tmpCluFile);
     if(cluFile.exists()){
-        tmpCluFile = cluFileUrl;
         if(!cluFile.open(QIODevice::ReadOnly)) {
             if(isXmlParExist){
                 xmlParFile.close();
@@ -379,17 +407,20 @@ int KlustersDoc::openDocument(const QString &url,QString& errorInformation, cons
                 parFile.close();
             }
             fetFile.close();
+            clusteringData->setLoadingMonitor(0L);
             return OPEN_ERROR;
         }
 
         //Initialize the data
         if(isXmlParExist){
             if(!clusteringData->initialize(fetFile,cluFile,spkFileLength,tmpSpikeFile,xmlParFile,electrodeGroupID.toInt(),errorInformation)){
+                cancelled = monitor != 0L && *monitor->cancelFlag();
+                clusteringData->setLoadingMonitor(0L);
                 //close the files
                 xmlParFile.close();
                 fetFile.close();
                 cluFile.close();
-                return INCORRECT_CONTENT;
+                return cancelled ? CANCELLED : INCORRECT_CONTENT;
             }
             xmlParFile.close();
             fetFile.close();
@@ -397,12 +428,14 @@ int KlustersDoc::openDocument(const QString &url,QString& errorInformation, cons
         }
         else{
             if(!clusteringData->initialize(fetFile,cluFile,spkFileLength,tmpSpikeFile,parXFile,parFile,errorInformation)){
+                cancelled = monitor != 0L && *monitor->cancelFlag();
+                clusteringData->setLoadingMonitor(0L);
                 //close the files
                 parXFile.close();
                 parFile.close();
                 fetFile.close();
                 cluFile.close();
-                return INCORRECT_CONTENT;
+                return cancelled ? CANCELLED : INCORRECT_CONTENT;
             }
             parXFile.close();
             parFile.close();
@@ -412,27 +445,29 @@ int KlustersDoc::openDocument(const QString &url,QString& errorInformation, cons
     }//end //the cluster file exists
     //the cluster file does not exist
     else{
-        tmpCluFile =  cluFileUrl;
-
         //Initialize the data
         if(isXmlParExist){
             if(!clusteringData->initialize(fetFile,spkFileLength,tmpSpikeFile,xmlParFile,electrodeGroupID.toInt(),errorInformation)){
+                cancelled = monitor != 0L && *monitor->cancelFlag();
+                clusteringData->setLoadingMonitor(0L);
                 //close the files
                 xmlParFile.close();
                 fetFile.close();
-                return INCORRECT_CONTENT;
+                return cancelled ? CANCELLED : INCORRECT_CONTENT;
             }
             xmlParFile.close();
             fetFile.close();
         }
         else{
             if(!clusteringData->initialize(fetFile,spkFileLength,tmpSpikeFile,parXFile,parFile,errorInformation)){
+                cancelled = monitor != 0L && *monitor->cancelFlag();
+                clusteringData->setLoadingMonitor(0L);
                 //close the files
                 parXFile.close();
                 parFile.close();
                 fetFile.close();
 
-                return INCORRECT_CONTENT;
+                return cancelled ? CANCELLED : INCORRECT_CONTENT;
             }
             //close the files
             parXFile.close();
@@ -440,7 +475,12 @@ int KlustersDoc::openDocument(const QString &url,QString& errorInformation, cons
             fetFile.close();
         }
     }//end the cluster file does not exist
+    clusteringData->setLoadingMonitor(0L);
+
+    return OK;
+}
 
+void KlustersDoc::documentLoaded(){
     //Constructs the clusterColorList
     QList<dataType> clusterList = clusteringData->clusterIds();
     QList<dataType>::iterator it;
@@ -459,10 +499,8 @@ int KlustersDoc::openDocument(const QString &url,QString& errorInformation, cons
         qDebug()<<"autoSave = true in openDoc";
         endAutoSaving = false;
         autoSaveThread = new AutoSaveThread(*clusteringData,this,cluFileSaveUrl);
-        autoSaveThread->start();
+        autoSaveThread->start(TaskPool::PREFETCH);
     }
-
-    return OK;
 }
 
 void KlustersDoc::updateAutoSavingInterval(int interval){
@@ -471,7 +509,7 @@ void KlustersDoc::updateAutoSavingInterval(int interval){
     if(!autoSave){
         autoSave = true;
         autoSaveThread = new AutoSaveThread(*clusteringData,this,cluFileSaveUrl);
-        autoSaveThread->start();
+        autoSaveThread->start(TaskPool::PREFETCH);
     }
 }
 
@@ -498,10 +536,19 @@ bool KlustersDoc::stopAutoSaving(bool currentDocument){
 }
 
 void KlustersDoc::launchAutoSave(){
-    if(!endAutoSaving)autoSaveThread->start();
+    if(!endAutoSaving)autoSaveThread->start(TaskPool::PREFETCH);
+}
+
+void KlustersDoc::useCompactFeatures(){
+    //If a computation is reading the features, try again later.
+    if(clusteringData != 0L && !clusteringData->useCompactFeatures())
+        QTimer::singleShot(kCOMPACT_FEATURES_RETRY,this,SLOT(useCompactFeatures()));
 }
 
 void KlustersDoc::customEvent(QEvent *event){
+    //All the dimensions have been loaded in the background, the features can be compacted.
+    if(event->type() == QEvent::User + 800) useCompactFeatures();
+
     //The autoSaveThread has finish, it can be delete.
     if(event->type() == QEvent::User + 500){
         if(endAutoSaving){
@@ -1002,16 +1049,16 @@ void KlustersDoc::deleteClusters(QList<int> clustersToDelete,KlustersView& activ
     }
 }
 
-void KlustersDoc::deleteArtifact(QRegion& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY){
+void KlustersDoc::deleteArtifact(const PolygonMask& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY){
     deleteSpikesFromClusters(0,region,clustersOfOrigin,dimensionX,dimensionY);
 }
 
 
-void KlustersDoc::deleteNoise(QRegion& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY){
+void KlustersDoc::deleteNoise(const PolygonMask& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY){
     deleteSpikesFromClusters(1,region,clustersOfOrigin,dimensionX,dimensionY);
 }
 
-void KlustersDoc::deleteSpikesFromClusters(int destination, QRegion& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY){
+void KlustersDoc::deleteSpikesFromClusters(int destination, const PolygonMask& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY){
     //list which will contain the clusters really having spikes in the region of selection.
     QList <int> fromClusters;
     //list which will contain the clusters which became empty because all their spikes were in the region of selection.
@@ -1095,7 +1142,7 @@ void KlustersDoc::deleteSpikesFromClusters(int destination, QRegion& region,cons
 }
 
 
-void KlustersDoc::createNewCluster(QRegion& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY){
+void KlustersDoc::createNewCluster(const PolygonMask& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY){
     //list which will contain the clusters really having spikes in the region of selection.
     QList <int> fromClusters;
     //list which will contain the clusters which became empty because all their spikes were in the region of selection.
@@ -1161,7 +1208,7 @@ void KlustersDoc::createNewCluster(QRegion& region, const QList <int>& clustersO
     }
 }
 
-void KlustersDoc::createNewClusters(QRegion& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY){
+void KlustersDoc::createNewClusters(const PolygonMask& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY){
     //list which will contain the clusters really having spikes in the region of selection.
     QList <int> fromClusters;
     //list which will contain the clusters which became empty because all their spikes were in the region of selection.
@@ -68,7 +68,8 @@ public:
     /**Information retun after a call to openFile/saveDocument/createFeatureFile*/
     enum OpenSaveCreateReturnMessage {OK=0,OPEN_ERROR=1,DOWNLOAD_ERROR=3,INCORRECT_FILE=4,SAVE_ERROR=5,
                                       UPLOAD_ERROR=6,INCORRECT_CONTENT=7,CREATION_ERROR=8,SPK_DOWNLOAD_ERROR=9,FET_DOWNLOAD_ERROR=10,
-                                      PAR_DOWNLOAD_ERROR=11,PARX_DOWNLOAD_ERROR=12,PARXML_DOWNLOAD_ERROR=13,NOT_WRITABLE=14,PARSE_ERROR=15};
+                                      PAR_DOWNLOAD_ERROR=11,PARX_DOWNLOAD_ERROR=12,PARXML_DOWNLOAD_ERROR=13,NOT_WRITABLE=14,PARSE_ERROR=15,
+                                      CANCELLED=16};
     
     /** Constructs a document.
     * @param parent the parent QWidget.
@@ -90,6 +91,9 @@ public:
     
     /**Returns true, if the requested view is the last view of the document. */
     bool isLastView();
+
+    /**Returns the clusters shown in the views containing a WaveformView, their waveforms have to stay available.*/
+    QList<int> clustersInWaveformViews() const;
     
     /** This method gets called when the user is about to close the last view. If the document is
     * modified, the user gets asked if he wants to save the document.
@@ -99,10 +103,22 @@ public:
     void setModified(bool m = true){ modified=m; }
     /** Returns if the document is modified or not. Use this to determine if your document needs saving by the user on closing.*/
     bool isModified(){ return modified; }
-    /** Opens the document by filename and format.
+    /** Opens the document by filename and format: checks the files of the document, the data being loaded by loadDocument().
+    * As the user may be asked which files to use, this has to be called from the main thread.
     * @return an OpenSaveCreateReturnMessage enum giving the open status.
     */
-    int openDocument(const QString &url,QString& errorInformation, const char* format=0);
+    int openDocument(const QString &url, const char* format=0);
+
+    /** Loads the data of the document opened by openDocument(). This can be called from another thread,
+    * documentLoaded() has then to be called from the main thread once the loading is done.
+    * @param errorInformation string which, in case of an error, will contain detail about it.
+    * @param monitor object following and possibly cancelling the loading, 0 if none.
+    * @return an OpenSaveCreateReturnMessage enum giving the load status, CANCELLED if the monitor has cancelled the loading.
+    */
+    int loadDocument(QString& errorInformation,Data::LoadingMonitor* monitor = 0L);
+
+    /** Finishes the opening of the document once loadDocument() has succeeded.*/
+    void documentLoaded();
     /**Opens a document using different format, than the one defined for the application, by filename and format.
     * Not Yet implemented.
     */
@@ -206,7 +222,7 @@ public:
     * @param dimensionX the dimension used as absciss to display the clusters.
     * @param dimensionY the dimension used as ordinate to display the clusters.
     */
-    void deleteNoise(QRegion& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY);
+    void deleteNoise(const PolygonMask& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY);
 
     /**
     * Removes spikes from some clusters and assign them to the cluster 0, the cluster for the artefact.
@@ -216,7 +232,7 @@ public:
     * @param dimensionX the dimension used as absciss to display the clusters.
     * @param dimensionY the dimension used as ordinate to display the clusters.
     */
-    void deleteArtifact(QRegion& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY);
+    void deleteArtifact(const PolygonMask& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY);
 
     /**
     * Creates a new cluster out of existing ones.
@@ -227,7 +243,7 @@ public:
     * @param dimensionY the dimension used as ordinate to display the clusters.
     * @return the number of the newly created cluster.
     */
-    void createNewCluster(QRegion& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY);
+    void createNewCluster(const PolygonMask& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY);
 
     /**
     * Creates a new clusters out of existing ones. If the polygon of selection contains x clusters
@@ -239,7 +255,7 @@ public:
     * @param dimensionY the dimension used as ordinate to display the clusters.
     * @return a list of the numbers of the newly created clusters.
     */
-    void createNewClusters(QRegion& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY);
+    void createNewClusters(const PolygonMask& region, const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY);
 
     /**Returns the number of dimensions of the data.*/
     int nbDimensions(){return clusteringData->nbOfDimensions();}
@@ -490,6 +506,9 @@ public Q_SLOTS:
     /**Launchs an autoSave by starting the autoSaveThread.*/
     void launchAutoSave();
 
+    /**Replaces the features by their compacted version once the dimensions loaded in the background are all available.*/
+    void useCompactFeatures();
+
 private:
 
     /**
@@ -502,7 +521,7 @@ private:
     * @param dimensionX the dimension used as absciss to display the clusters.
     * @param dimensionY the dimension used as ordinate to display the clusters.
     */
-    void deleteSpikesFromClusters(int destination, QRegion& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY);
+    void deleteSpikesFromClusters(int destination, const PolygonMask& region,const QList <int>& clustersOfOrigin, int dimensionX, int dimensionY);
 
     /**
     * Fills the undo list (clusterColorListUndoList) and clear the redo list
@@ -636,6 +655,18 @@ private:
 
     /**Temporary file corresponding to the spike file.*/
     QString tmpSpikeFile;
+
+    /**The path to the feature file.*/
+    QString fetFileUrl;
+
+    /**The path to the specific parameter file (used if there is no xml parameter file).*/
+    QString parXFileUrl;
+
+    /**The path to the general parameter file (used if there is no xml parameter file).*/
+    QString parFileUrl;
+
+    /**True if the xml parameter file exists, the old parameter files being used otherwise.*/
+    bool isXmlParExist;
     
     /**The list of the views currently connected to the document. */
     QList<KlustersView*>* viewList;
@@ -0,0 +1,42 @@
+/***************************************************************************
+                          openthread.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+//include files for the application
+#include "openthread.h"
+
+//QT include files
+#include <qapplication.h>
+
+
+
+void OpenThread::load(KlustersDoc* doc){
+    this->doc = doc;
+    cancelled = false;
+    start();
+}
+
+void OpenThread::run(){
+    QString errorInformation;
+    int status = doc->loadDocument(errorInformation,this);
+
+    //Send an event to the application to create the display, or to report the error.
+    QApplication::postEvent(parent,openDoneEvent(status,errorInformation));
+}
+
+void OpenThread::loadingStageStarted(Data::LoadingStage stage){
+    QApplication::postEvent(parent,openProgressEvent(stage));
+}
@@ -0,0 +1,129 @@
+/***************************************************************************
+                          openthread.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef OPENTHREAD_H
+#define OPENTHREAD_H
+
+//include files for the application
+#include "klustersdoc.h"
+#include "klusters.h"
+#include "data.h"
+
+//include files for QT
+#include <qthread.h>
+
+
+#include <QEvent>
+#include <QString>
+
+
+/**Thread used to load the data of a document once its files have been checked by KlustersDoc::openDocument().
+ * The thread calls the document which will do the work, the progress of each stage of the loading and
+ * its end are sent to the application as events.
+ */
+
+class OpenThread : public QThread, public Data::LoadingMonitor{
+
+public:
+
+    explicit OpenThread(KlustersApp* parent):doc(0L),parent(parent),cancelled(false){}
+    ~OpenThread(){}
+
+
+    virtual void run();
+
+    /**
+  * Begins the execution of the thread which will load the data of the document.
+  * @param doc document opened by KlustersDoc::openDocument().
+  */
+    void load(KlustersDoc* doc);
+
+    /**Asks the loading to stop as soon as possible, the end of the loading is still sent as an event.*/
+    void cancel(){cancelled = true;}
+
+    /**Returns true if the loading has been cancelled.*/
+    bool isCancelled() const{return cancelled;}
+
+    void loadingStageStarted(Data::LoadingStage stage);
+
+    const volatile bool* cancelFlag() const{return &cancelled;}
+
+    class OpenProgressEvent;
+    friend class OpenProgressEvent;
+
+    OpenProgressEvent* openProgressEvent(Data::LoadingStage stage){
+        return new OpenProgressEvent(stage);
+    }
+
+    class OpenDoneEvent;
+    friend class OpenDoneEvent;
+
+    OpenDoneEvent* openDoneEvent(int status,const QString& errorInformation){
+        return new OpenDoneEvent(status,errorInformation);
+    }
+
+    /**
+  * Internal class use to send information to the application object (KlustersApp) concerning
+  * the stage of the loading which has started.
+  *
+  */
+    class OpenProgressEvent : public QEvent{
+        //Only the method openProgressEvent of OpenThread has access to the private part of OpenProgressEvent,
+        //the constructor of OpenProgressEvent being private, only this method can create a new OpenProgressEvent
+        friend OpenProgressEvent* OpenThread::openProgressEvent(Data::LoadingStage stage);
+
+    public:
+        Data::LoadingStage loadingStage() const {return stage;}
+        ~OpenProgressEvent(){}
+
+    private:
+        OpenProgressEvent(Data::LoadingStage stage):QEvent(QEvent::Type(QEvent::User + 110)),stage(stage){}
+
+        Data::LoadingStage stage;
+    };
+
+    /**
+  * Internal class use to send information to the application object (KlustersApp) concerning
+  * the end of the loading.
+  *
+  */
+    class OpenDoneEvent : public QEvent{
+        //Only the method openDoneEvent of OpenThread has access to the private part of OpenDoneEvent,
+        //the constructor of OpenDoneEvent being private, only this method can create a new OpenDoneEvent
+        friend OpenDoneEvent* OpenThread::openDoneEvent(int status,const QString& errorInformation);
+
+    public:
+        /**Returns the KlustersDoc::OpenSaveCreateReturnMessage giving the load status.*/
+        int status() const {return loadStatus;}
+        QString errorInformation() const {return information;}
+        ~OpenDoneEvent(){}
+
+    private:
+        OpenDoneEvent(int status,const QString& errorInformation):QEvent(QEvent::Type(QEvent::User + 120)),
+            loadStatus(status),information(errorInformation){}
+
+        int loadStatus;
+        QString information;
+    };
+
+private:
+    KlustersDoc* doc;
+    KlustersApp* parent;
+    volatile bool cancelled;
+};
+
+#endif
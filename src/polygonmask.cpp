@@ -0,0 +1,100 @@
+/***************************************************************************
+                          polygonmask.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "polygonmask.h"
+
+//Qt include files
+#include <QRect>
+#include <QtAlgorithms>
+
+//C include files
+#include <math.h>
+
+const dataType PolygonMask::kMAX_ROWS = 1 << 22;
+
+PolygonMask::PolygonMask(const QPolygon& selectionPolygon):polygon(selectionPolygon),transposed(false),left(0),right(-1),top(0),bottom(-1),empty(true){
+    int nbPoints = polygon.size();
+    if(nbPoints < 3) return;
+
+    //Rasterize along the smaller extent: a polygon taller than wide is stored with its axes swapped.
+    QRect boundingRect = polygon.boundingRect();
+    if(boundingRect.height() > boundingRect.width()){
+        transposed = true;
+        for(int i = 0; i < nbPoints; ++i){
+            QPoint& point = polygon[i];
+            point = QPoint(point.y(),point.x());
+        }
+        boundingRect = QRect(boundingRect.top(),boundingRect.left(),boundingRect.height(),boundingRect.width());
+    }
+    left = boundingRect.left();
+    right = boundingRect.right();
+    top = boundingRect.top();
+    bottom = boundingRect.bottom();
+    dataType nbRows = bottom - top + 1;
+    if(nbRows > kMAX_ROWS){
+        empty = false;
+        return;
+    }
+
+    //Crossings of the edges with each row. An edge covers the rows [lower y,upper y) so that a vertex
+    //shared by two edges is only counted once, and the horizontal edges are ignored.
+    QVector<int> nbCrossings(nbRows + 1,0);
+    for(int i = 0; i < nbPoints; ++i){
+        const QPoint& p1 = polygon.at(i);
+        const QPoint& p2 = polygon.at((i + 1) % nbPoints);
+        if(p1.y() == p2.y()) continue;
+        int start = qMin(p1.y(),p2.y()) - top;
+        int end = qMax(p1.y(),p2.y()) - top;
+        for(int row = start; row < end; ++row) nbCrossings[row + 1]++;
+    }
+    for(int row = 0; row < nbRows; ++row) nbCrossings[row + 1] += nbCrossings[row];
+
+    QVector<double> crossings(nbCrossings[nbRows]);
+    QVector<int> positions(nbCrossings);
+    for(int i = 0; i < nbPoints; ++i){
+        QPoint p1 = polygon.at(i);
+        QPoint p2 = polygon.at((i + 1) % nbPoints);
+        if(p1.y() == p2.y()) continue;
+        if(p1.y() > p2.y()) qSwap(p1,p2);
+        double slope = static_cast<double>(p2.x() - p1.x()) / static_cast<double>(p2.y() - p1.y());
+        for(int y = p1.y(); y < p2.y(); ++y)
+            crossings[positions[y - top]++] = p1.x() + slope * (y - p1.y());
+    }
+
+    //Pair the sorted crossings of each row into intervals of integer abscissae [ceil(x1),ceil(x2)).
+    rowStarts.resize(nbRows + 1);
+    bounds.reserve(crossings.size());
+    for(int row = 0; row < nbRows; ++row){
+        rowStarts[row] = bounds.size();
+        double* rowBegin = crossings.data() + nbCrossings[row];
+        double* rowEnd = crossings.data() + nbCrossings[row + 1];
+        qSort(rowBegin,rowEnd);
+        for(double* crossing = rowBegin; crossing + 1 < rowEnd; crossing += 2){
+            dataType start = static_cast<dataType>(ceil(crossing[0]));
+            dataType end = static_cast<dataType>(ceil(crossing[1]));
+            if(start >= end) continue;
+            //Merge with the previous interval when they touch.
+            if(bounds.size() > rowStarts[row] && bounds.last() >= start) bounds.last() = qMax(bounds.last(),end);
+            else{
+                bounds.append(start);
+                bounds.append(end);
+            }
+        }
+    }
+    rowStarts[nbRows] = bounds.size();
+    empty = bounds.isEmpty();
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+                          polygonmask.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef POLYGONMASK_H
+#define POLYGONMASK_H
+
+//Include files of the application
+#include "types.h"
+
+//Include files for QT
+#include <QPolygon>
+#include <QVector>
+#include <QtAlgorithms>
+
+/**
+* This class gives the points, in feature coordinates, included in a selection polygon.
+* The polygon is rasterized once over its bounding box: for each ordinate the abscissa intervals
+* inside the polygon (odd-even rule) are stored, sorted, one row after the other. Testing a point is then
+* a bounds check followed by a lookup in the few intervals of its row, whatever the number of vertices.
+* A polygon taller than wide is transposed first, so that the rows follow its smaller extent.
+* If the polygon is too large in both directions for the rows to be stored, the points are tested directly against the polygon.
+*/
+class PolygonMask{
+
+public:
+    /**Rasterizes @p selectionPolygon, its points being given in feature coordinates.*/
+    explicit PolygonMask(const QPolygon& selectionPolygon);
+    ~PolygonMask(){}
+
+    /**Returns true if no point can be included in the mask.*/
+    bool isEmpty() const{return empty;}
+
+    /**Returns true if the point (@p x,@p y) is inside the polygon.*/
+    inline bool contains(dataType x,dataType y) const{
+        if(transposed) qSwap(x,y);
+        if(x < left || x > right || y < top || y > bottom) return false;
+        if(rowStarts.isEmpty()) return polygon.containsPoint(QPoint(static_cast<int>(x),static_cast<int>(y)),Qt::OddEvenFill);
+        int row = static_cast<int>(y - top);
+        const dataType* bound = bounds.constData() + rowStarts[row];
+        const dataType* end = bounds.constData() + rowStarts[row + 1];
+        //The intervals [start,end) are sorted and disjoint.
+        for(; bound != end; bound += 2){
+            if(x < bound[0]) return false;
+            if(x < bound[1]) return true;
+        }
+        return false;
+    }
+
+private:
+    /**Maximum number of rows stored, larger polygons are tested vertex by vertex.*/
+    static const dataType kMAX_ROWS;
+
+    /**The polygon, transposed if it is taller than wide.*/
+    QPolygon polygon;
+    /**True if the abscissae and ordinates are swapped in polygon and in the rows.*/
+    bool transposed;
+    dataType left;
+    dataType right;
+    dataType top;
+    dataType bottom;
+    bool empty;
+    /**Index in bounds of the first interval of each row, plus the end of the last row.*/
+    QVector<int> rowStarts;
+    /**Start and end (excluded) of each interval.*/
+    QVector<dataType> bounds;
+};
+
+#endif
@@ -16,12 +16,79 @@
  ***************************************************************************/
 
 #include "sortabletable.h"
+#include "taskpool.h"
+
+//Qt include files
+#include <QRunnable>
+#include <QVector>
 
 //C include files
 #include <cstring>
 
 
-const dataType SortableTable::kSMALL_ENOUGH = 15;
+const dataType SortableTable::kSMALL_ENOUGH = 16;
+const dataType SortableTable::kRADIX_THRESHOLD = 16384;
+const dataType SortableTable::kPARALLEL_THRESHOLD = 1048576;
+
+/**Number of bits of the digits of the radix sort.*/
+static const int kRADIX_BITS = 11;
+static const dataType kRADIX_SIZE = 1 << kRADIX_BITS;
+
+static inline void swapColumns(dataType* keys,dataType* values,dataType i,dataType j){
+    dataType key = keys[i];
+    keys[i] = keys[j];
+    keys[j] = key;
+    if(values != 0L){
+        dataType value = values[i];
+        values[i] = values[j];
+        values[j] = value;
+    }
+}
+
+/**Task of a pass of the radix sort on a range of the values. The task first counts the values of each digit
+  * in its range, the counts are then replaced by the position of the first value of each digit in the destination
+  * and the task scatters its values there, keeping their order.
+  */
+class RadixTask : public QRunnable{
+public:
+    RadixTask(dataType begin,dataType end,dataType min)
+        :begin(begin),end(end),min(min),shift(0),counting(true),keys(0L),values(0L),keysDestination(0L),valuesDestination(0L),offsets(kRADIX_SIZE){
+        setAutoDelete(false);
+    }
+
+    void run(){
+        dataType* offsetData = offsets.data();
+        if(counting){
+            offsets.fill(0);
+            for(dataType i = begin; i < end; ++i) offsetData[digit(keys[i])]++;
+        }
+        else if(values != 0L){
+            for(dataType i = begin; i < end; ++i){
+                dataType position = offsetData[digit(keys[i])]++;
+                keysDestination[position] = keys[i];
+                valuesDestination[position] = values[i];
+            }
+        }
+        else{
+            for(dataType i = begin; i < end; ++i) keysDestination[offsetData[digit(keys[i])]++] = keys[i];
+        }
+    }
+
+    inline dataType digit(dataType key) const{
+        return static_cast<dataType>(((static_cast<unsigned long>(key) - static_cast<unsigned long>(min)) >> shift) & (kRADIX_SIZE - 1));
+    }
+
+    dataType begin;
+    dataType end;
+    dataType min;
+    int shift;
+    bool counting;
+    const dataType* keys;
+    const dataType* values;
+    dataType* keysDestination;
+    dataType* valuesDestination;
+    QVector<dataType> offsets;
+};
 
 SortableTable::SortableTable(const SortableTable& currentSortableTable):
     Array<dataType>(currentSortableTable.nbRows,currentSortableTable.nbColumns){
@@ -38,100 +105,188 @@ void SortableTable::subset(SortableTable& subsetTable, dataType row,dataType sta
     memcpy(&(subsetTable.array[(row - 1)*nbColumns]),&array[(row - 1)*nbColumns + (startColumn - 1)],((endColumn - startColumn) + 1) * sizeof(dataType));
 }                      
 
-void SortableTable::SelectionSort(dataType rowToSort,dataType secondRow, dataType left, dataType right){
-    for(dataType i = left; i < right; i++) {
-        dataType min = i;
-        for(dataType j=i+1; j <= right; j++)
-            if((*this)(rowToSort,j) < (*this)(rowToSort,min)) min = j;
-        dataType temp = (*this)(rowToSort,min);
-        dataType temp2 = (*this)(secondRow,min);
-        (*this)(rowToSort,min) = (*this)(rowToSort,i);
-        (*this)(secondRow,min) = (*this)(secondRow,i);
-        (*this)(rowToSort,i) = temp;
-        (*this)(secondRow,i) = temp2;
-    }
-}
-
-dataType SortableTable::Partition(dataType rowToSort,dataType secondRow, dataType left, dataType right){
-    dataType val = (*this)(rowToSort,left);
-    dataType lm = left-1;
-    dataType rm = right+1;
-    for(;;) {
-        do
-            rm--;
-        while ((*this)(rowToSort,rm) > val);
+void SortableTable::sortRow(dataType* keys,dataType* values,dataType nbValues){
+    if(nbValues < 2) return;
 
-        do
-            lm++;
-        while( (*this)(rowToSort,lm) < val);
-
-        if(lm < rm) {
-            dataType tempr = (*this)(rowToSort,rm);
-            dataType tempr2 = (*this)(secondRow,rm);
-            (*this)(rowToSort,rm) = (*this)(rowToSort,lm);
-            (*this)(secondRow,rm) = (*this)(secondRow,lm);
-            (*this)(rowToSort,lm) = tempr;
-            (*this)(secondRow,lm) = tempr2;
+    //Tables already sorted, or sorted in reverse order, are common: they are detected in one pass.
+    dataType nbAscending = 1;
+    while(nbAscending < nbValues && keys[nbAscending - 1] <= keys[nbAscending]) nbAscending++;
+    if(nbAscending == nbValues) return;
+    if(nbAscending == 1){
+        dataType nbDescending = 1;
+        while(nbDescending < nbValues && keys[nbDescending - 1] > keys[nbDescending]) nbDescending++;
+        if(nbDescending == nbValues){
+            for(dataType i = 0,j = nbValues - 1; i < j; ++i,--j) swapColumns(keys,values,i,j);
+            return;
         }
-        else
-            return rm;
     }
-}
 
-void SortableTable::Quicksort(dataType rowToSort,dataType secondRow, dataType left, dataType right){
-    if(left < (right-kSMALL_ENOUGH)) {
-        dataType split_pt = Partition(rowToSort, secondRow, left, right);
-        Quicksort(rowToSort,secondRow, left, split_pt);
-        Quicksort(rowToSort,secondRow, split_pt+1, right);
+    if(nbValues >= kRADIX_THRESHOLD) radixSort(keys,values,nbValues);
+    else{
+        int depthLimit = 0;
+        for(dataType n = nbValues; n > 1; n >>= 1) depthLimit += 2;
+        introSort(keys,values,0,nbValues - 1,depthLimit);
     }
-    else SelectionSort(rowToSort, secondRow, left, right);
 }
 
+void SortableTable::introSort(dataType* keys,dataType* values,dataType left,dataType right,int depthLimit){
+    while(right - left >= kSMALL_ENOUGH){
+        if(depthLimit == 0){
+            heapSort(keys,values,left,right);
+            return;
+        }
+        depthLimit--;
 
-
-void SortableTable::SelectionSort(dataType left, dataType right){
-    for(dataType i = left; i < right; i++) {
-        dataType min = i;
-        for(dataType j=i+1; j <= right; j++)
-            if((*this)(1,j) < (*this)(1,min)) min = j;
-        dataType temp = (*this)(1,min);
-        (*this)(1,min) = (*this)(1,i);
-        (*this)(1,i) = temp;
+        //Recurse on the smaller part and loop on the bigger one, which bounds the depth of the stack.
+        dataType split = partition(keys,values,left,right);
+        if(split - left < right - split){
+            introSort(keys,values,left,split,depthLimit);
+            left = split + 1;
+        }
+        else{
+            introSort(keys,values,split + 1,right,depthLimit);
+            right = split;
+        }
     }
+    insertionSort(keys,values,left,right);
 }
 
-dataType SortableTable::Partition(dataType left, dataType right){  
-    dataType val = (*this)(1,left);
-    dataType lm = left-1;
-    dataType rm = right+1;
-    for(;;) {
+dataType SortableTable::partition(dataType* keys,dataType* values,dataType left,dataType right){
+    //The pivot is the median of the first, middle and last values, moved to the left.
+    dataType middle = left + (right - left) / 2;
+    if(keys[middle] < keys[left]) swapColumns(keys,values,middle,left);
+    if(keys[right] < keys[left]) swapColumns(keys,values,right,left);
+    if(keys[right] < keys[middle]) swapColumns(keys,values,right,middle);
+    swapColumns(keys,values,left,middle);
+
+    dataType val = keys[left];
+    dataType lm = left - 1;
+    dataType rm = right + 1;
+    for(;;){
         do
             rm--;
-        while ((*this)(1,rm) > val);
+        while(keys[rm] > val);
 
         do
             lm++;
-        while( (*this)(1,lm) < val);
+        while(keys[lm] < val);
+
+        if(lm < rm) swapColumns(keys,values,lm,rm);
+        else return rm;
+    }
+}
 
-        if(lm < rm) {
-            dataType tempr = (*this)(1,rm);
-            (*this)(1,rm) = (*this)(1,lm);
-            (*this)(1,lm) = tempr;
+void SortableTable::insertionSort(dataType* keys,dataType* values,dataType left,dataType right){
+    for(dataType i = left + 1; i <= right; ++i){
+        dataType key = keys[i];
+        dataType value = values != 0L ? values[i] : 0;
+        dataType j = i;
+        for(; j > left && keys[j - 1] > key; --j){
+            keys[j] = keys[j - 1];
+            if(values != 0L) values[j] = values[j - 1];
         }
-        else
-            return rm;
+        keys[j] = key;
+        if(values != 0L) values[j] = value;
     }
 }
 
-void SortableTable::Quicksort(dataType left, dataType right){
-    if(left < (right-kSMALL_ENOUGH)) {
-        dataType split_pt = Partition(left, right);
-        Quicksort(left, split_pt);
-        Quicksort(split_pt+1, right);
+void SortableTable::heapSort(dataType* keys,dataType* values,dataType left,dataType right){
+    dataType nbValues = right - left + 1;
+    keys += left;
+    if(values != 0L) values += left;
+
+    //Builds a heap with the biggest value on top, then moves the top to the end of the heap until it is empty.
+    for(dataType end = nbValues,start = nbValues / 2; end > 1;){
+        dataType position;
+        if(start > 0) position = --start;
+        else{
+            swapColumns(keys,values,0,--end);
+            position = 0;
+        }
+        for(;;){
+            dataType child = 2 * position + 1;
+            if(child >= end) break;
+            if(child + 1 < end && keys[child + 1] > keys[child]) child++;
+            if(keys[child] <= keys[position]) break;
+            swapColumns(keys,values,position,child);
+            position = child;
+        }
     }
-    else SelectionSort(left, right);
 }
 
+void SortableTable::radixSort(dataType* keys,dataType* values,dataType nbValues){
+    dataType min = keys[0];
+    dataType max = keys[0];
+    for(dataType i = 1; i < nbValues; ++i){
+        if(keys[i] < min) min = keys[i];
+        else if(keys[i] > max) max = keys[i];
+    }
+
+    //Only the digits needed by the range of the values are sorted.
+    int nbPasses = 0;
+    for(unsigned long range = static_cast<unsigned long>(max) - static_cast<unsigned long>(min); range != 0; range >>= kRADIX_BITS) nbPasses++;
+
+    //The values are cut in one range by thread, the ranges keep their order in the destination so each pass is stable.
+    int nbTasks = 1;
+    if(nbValues >= kPARALLEL_THRESHOLD){
+        nbTasks = TaskPool::globalInstance().threadCount();
+    }
+    QList<RadixTask*> tasks;
+    for(int i = 0; i < nbTasks; ++i) tasks.append(new RadixTask(nbValues * i / nbTasks,nbValues * (i + 1) / nbTasks,min));
+    TaskPool::Group group;
+
+    dataType* keysBuffer = new dataType[nbValues];
+    dataType* valuesBuffer = values != 0L ? new dataType[nbValues] : 0L;
+    dataType* keysSource = keys;
+    dataType* valuesSource = values;
+    dataType* keysDestination = keysBuffer;
+    dataType* valuesDestination = valuesBuffer;
+
+    for(int pass = 0; pass < nbPasses; ++pass){
+        for(int i = 0; i < nbTasks; ++i){
+            RadixTask* task = tasks[i];
+            task->shift = pass * kRADIX_BITS;
+            task->counting = true;
+            task->keys = keysSource;
+            task->values = valuesSource;
+            task->keysDestination = keysDestination;
+            task->valuesDestination = valuesDestination;
+        }
+        if(nbTasks == 1) tasks[0]->run();
+        else{
+            for(int i = 0; i < nbTasks; ++i) group.start(tasks[i]);
+            group.wait();
+        }
+
+        //The values of a digit start after the ones of the smaller digits, and after the ones of the same digit in the previous ranges.
+        dataType position = 0;
+        for(dataType digit = 0; digit < kRADIX_SIZE; ++digit){
+            for(int i = 0; i < nbTasks; ++i){
+                dataType& offset = tasks[i]->offsets[digit];
+                dataType count = offset;
+                offset = position;
+                position += count;
+            }
+        }
+
+        for(int i = 0; i < nbTasks; ++i) tasks[i]->counting = false;
+        if(nbTasks == 1) tasks[0]->run();
+        else{
+            for(int i = 0; i < nbTasks; ++i) group.start(tasks[i]);
+            group.wait();
+        }
 
+        qSwap(keysSource,keysDestination);
+        qSwap(valuesSource,valuesDestination);
+    }
 
+    //After an odd number of passes, the sorted values are in the buffers.
+    if(keysSource != keys){
+        memcpy(keys,keysSource,nbValues * sizeof(dataType));
+        if(values != 0L) memcpy(values,valuesSource,nbValues * sizeof(dataType));
+    }
 
+    qDeleteAll(tasks);
+    delete []keysBuffer;
+    delete []valuesBuffer;
+}
@@ -22,8 +22,11 @@
 #include "types.h"
 
 /**
-* This class is a one or two line Array of dataType with a sort feature on one of the lines. The sort 
-* is an implementation of the quick sort algorithm.
+* This class is a one or two line Array of dataType with a sort feature on one of the lines. Tables which are
+* already sorted or sorted in reverse order are detected in one pass. Small tables are sorted by an introsort
+* (a median of three quicksort falling back on a heapsort when the recursion gets too deep, and on an insertion
+* sort for the small subarrays), bigger ones by a least significant digit radix sort on the integer keys, whose
+* passes are shared between several threads above a size threshold.
 * @author Lynn Hazan
 */
 class SortableTable : public Array<dataType>{
@@ -46,19 +49,23 @@ public:
     SortableTable(const SortableTable& currentSortableTable);
 
     /**
-  * Sorts the two row table using @p rowToSort as the row to sort (row numbering start at 1).
+  * Sorts the two row table using @p rowToSort as the row to sort (row numbering start at 1),
+  * the other row being permuted the same way.
   */
     void sort(dataType rowToSort){
-        if(rowToSort == 1)
-            Quicksort(1, 2, 1, nbColumns);
+        if(nbRows == 1){
+            if(rowToSort == 1) sortRow(array,0L,nbColumns);
+        }
+        else if(rowToSort == 1)
+            sortRow(array,array + nbColumns,nbColumns);
         else if(rowToSort == 2)
-            Quicksort(2, 1, 1, nbColumns);
+            sortRow(array + nbColumns,array,nbColumns);
     }
 
     /**
-  * Sorts the one row table.
+  * Sorts the first row of the table.
   */
-    void sort(){Quicksort(1,nbColumns);}
+    void sort(){sortRow(array,0L,nbColumns);}
 
 
     /**Returns a subset of the table, the data from one row (@p row) contained
@@ -76,22 +83,30 @@ private:
 
     void setSize(dataType nbOfRows, dataType nbOfColumns){}
 
-    /*QuickSort algorithm.
-  * To speed the sort, two sort algorithms are combined.
-  * Quicksort() is used as the main algorithm, but when the subarrays get small enough,
-  * we switch to an alternative, a selection sort.
-  * The small enough is a value between 5 and 20.
+    /**Sorts the @p nbValues values of @p keys.
+  * @param keys the values to sort.
+  * @param values the values to permute the same way as @p keys, 0L if there are none.
+  * @param nbValues the number of values.
   */
+    static void sortRow(dataType* keys,dataType* values,dataType nbValues);
 
-    void SelectionSort(dataType rowToSort,dataType secondRow, dataType left, dataType right);
-    dataType Partition(dataType rowToSort,dataType secondRow, dataType left, dataType right);
-    void Quicksort(dataType rowToSort,dataType secondRow, dataType left, dataType right);
+    /**Introsort of the values of @p keys between @p left and @p right (0 based, included).
+  * @param depthLimit the number of partitions allowed before switching to a heapsort.
+  */
+    static void introSort(dataType* keys,dataType* values,dataType left,dataType right,int depthLimit);
+    static void insertionSort(dataType* keys,dataType* values,dataType left,dataType right);
+    static void heapSort(dataType* keys,dataType* values,dataType left,dataType right);
+    static dataType partition(dataType* keys,dataType* values,dataType left,dataType right);
 
-    void SelectionSort(dataType left, dataType right);
-    dataType Partition(dataType left, dataType right);
-    void Quicksort(dataType left, dataType right);
+    /**Least significant digit radix sort of the values of @p keys, on their offset from the smallest one.*/
+    static void radixSort(dataType* keys,dataType* values,dataType nbValues);
 
+    /**Size of the subarrays sorted by an insertion sort.*/
     static const dataType kSMALL_ENOUGH;
+    /**Number of values from which the radix sort is used.*/
+    static const dataType kRADIX_THRESHOLD;
+    /**Number of values from which the passes of the radix sort are shared between several threads.*/
+    static const dataType kPARALLEL_THRESHOLD;
 
 };
 
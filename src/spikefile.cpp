@@ -0,0 +1,185 @@
+/***************************************************************************
+                          spikefile.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "spikefile.h"
+
+//Qt include files
+#include <QDebug>
+#include <QtAlgorithms>
+
+//C include files
+#include <cstring>
+#if defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if defined(Q_OS_LINUX)
+#include <sys/uio.h>
+#endif
+
+const qint64 SpikeFile::kMAX_GAP = 256 * 1024;
+const qint64 SpikeFile::kMAX_READ_SIZE = 16 * 1024 * 1024;
+
+/**Largest number of records of a batch, a batch read needs up to two buffers by record and IOV_MAX is at least 1024.*/
+static const int kMAX_BATCH_RECORDS = 512;
+
+static bool recordLessThan(const SpikeFile::Record& record1,const SpikeFile::Record& record2){
+    return record1.offset < record2.offset;
+}
+
+SpikeFile::SpikeFile():file(0L),data(0L),fileSize(0){
+}
+
+SpikeFile::~SpikeFile(){
+    close();
+}
+
+bool SpikeFile::open(const QString& fileName){
+    close();
+    file = new QFile(fileName);
+    if(!file->open(QIODevice::ReadOnly)){
+        delete file;
+        file = 0L;
+        return false;
+    }
+    fileSize = file->size();
+    if(fileSize > 0) data = file->map(0,fileSize);
+    if(data == 0L) qDebug()<<"the spike file "<<fileName<<" could not be mapped, it will be read through the file";
+#if defined(Q_OS_UNIX)
+    //The waveforms are read spike by spike, the read-ahead is asked explicitly for each batch of spikes.
+    else posix_madvise(data,fileSize,POSIX_MADV_RANDOM);
+#endif
+    return true;
+}
+
+void SpikeFile::close(){
+    if(file == 0L) return;
+    if(data != 0L) file->unmap(data);
+    file->close();
+    delete file;
+    file = 0L;
+    data = 0L;
+    fileSize = 0;
+}
+
+qint64 SpikeFile::read(qint64 offset,void* destination,qint64 length) const{
+    qint64 available = 0;
+    if(offset >= 0 && offset < fileSize) available = qMin(length,fileSize - offset);
+
+    if(available > 0){
+        if(data != 0L) memcpy(destination,data + offset,available);
+        else{
+            mutex.lock();
+            if(!file->seek(offset) || file->read(static_cast<char*>(destination),available) != available) available = 0;
+            mutex.unlock();
+        }
+    }
+    if(available < length) memset(static_cast<char*>(destination) + available,0,length - available);
+    return available;
+}
+
+void SpikeFile::read(QVector<Record>& records,qint64 length) const{
+    if(records.isEmpty()) return;
+
+    //The spikes of a cluster are sorted by time, so the records are usually already in the order of the file.
+    for(int i = 1; i < records.size(); ++i){
+        if(records[i].offset < records[i - 1].offset){
+            qSort(records.begin(),records.end(),recordLessThan);
+            break;
+        }
+    }
+
+    if(data != 0L){
+#if defined(Q_OS_UNIX)
+        //Ask for all the batches before copying the first record, so the disk serves them in one sweep
+        //instead of one page fault at a time.
+        qint64 pageSize = sysconf(_SC_PAGESIZE);
+        for(int first = 0; first < records.size();){
+            int end = batchEnd(records,first,length);
+            qint64 start = records[first].offset;
+            qint64 stop = qMin(records[end - 1].offset + length,fileSize);
+            if(start >= 0 && start < stop){
+                start -= start % pageSize;
+                posix_madvise(data + start,stop - start,POSIX_MADV_WILLNEED);
+            }
+            first = end;
+        }
+#endif
+        for(int i = 0; i < records.size(); ++i) read(records[i].offset,records[i].destination,length);
+        return;
+    }
+
+    char* gapBuffer = new char[kMAX_GAP];
+    for(int first = 0; first < records.size();){
+        int end = batchEnd(records,first,length);
+        if(end - first == 1 || !readBatch(records,first,end,length,gapBuffer))
+            for(int i = first; i < end; ++i) read(records[i].offset,records[i].destination,length);
+        first = end;
+    }
+    delete []gapBuffer;
+}
+
+int SpikeFile::batchEnd(const QVector<Record>& records,int first,qint64 length) const{
+    int end = first + 1;
+    qint64 start = records[first].offset;
+    if(start < 0 || start + length > fileSize) return end;
+
+    qint64 previousEnd = start + length;
+    while(end < records.size() && end - first < kMAX_BATCH_RECORDS){
+        qint64 offset = records[end].offset;
+        if(offset < previousEnd || offset - previousEnd > kMAX_GAP || offset + length > fileSize || offset + length - start > kMAX_READ_SIZE) break;
+        previousEnd = offset + length;
+        ++end;
+    }
+    return end;
+}
+
+bool SpikeFile::readBatch(const QVector<Record>& records,int first,int end,qint64 length,char* gapBuffer) const{
+#if defined(Q_OS_LINUX)
+    //The bytes between two records go to gapBuffer, the records directly to their destination.
+    QVector<struct iovec> buffers;
+    buffers.reserve(2 * (end - first));
+    qint64 nbBytes = 0;
+    for(int i = first; i < end; ++i){
+        struct iovec buffer;
+        if(i > first){
+            qint64 gap = records[i].offset - records[i - 1].offset - length;
+            if(gap > 0){
+                buffer.iov_base = gapBuffer;
+                buffer.iov_len = gap;
+                buffers.append(buffer);
+                nbBytes += gap;
+            }
+        }
+        buffer.iov_base = records[i].destination;
+        buffer.iov_len = length;
+        buffers.append(buffer);
+        nbBytes += length;
+    }
+
+    //preadv does not move the position in the file, so the batches of several threads are read at the same time.
+    ssize_t nbRead = preadv(file->handle(),buffers.constData(),buffers.size(),records[first].offset);
+    return nbRead == nbBytes;
+#else
+    Q_UNUSED(records);
+    Q_UNUSED(first);
+    Q_UNUSED(end);
+    Q_UNUSED(length);
+    Q_UNUSED(gapBuffer);
+    return false;
+#endif
+}
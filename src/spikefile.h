@@ -0,0 +1,117 @@
+/***************************************************************************
+                          spikefile.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SPIKEFILE_H
+#define SPIKEFILE_H
+
+//Include files for QT
+#include <QString>
+#include <qfile.h>
+#include <qmutex.h>
+#include <QVector>
+
+/**
+* This class gives a read-only access to the binary spike file (.spk file), shared by all the threads
+* extracting waveforms. The file is opened and memory-mapped once, the waveforms being then copied
+* directly from the mapped pages. If the file cannot be mapped (address space too small for instance),
+* the reads go through the file.
+*
+* The waveforms of a cluster are spread over the whole file, they are read in batches: the records are
+* sorted by offset and the close ones are read together, in one large sequential read (or one
+* read-ahead request of the mapped pages) instead of one random access by spike.
+*/
+class SpikeFile{
+
+public:
+    /**Part of the spike file to copy, see read(QVector<Record>&,qint64).*/
+    struct Record{
+        Record():offset(0),destination(0L){}
+        Record(qint64 offset,void* destination):offset(offset),destination(destination){}
+
+        /**Offset in bytes in the spike file.*/
+        qint64 offset;
+        /**Where to copy the bytes.*/
+        void* destination;
+    };
+
+    SpikeFile();
+    ~SpikeFile();
+
+    /**Opens and maps the spike file @p fileName, closing the one previously opened if any.
+  * @param fileName name of the spike file.
+  * @return true if the file has been opened, false otherwise.
+  */
+    bool open(const QString& fileName);
+
+    /**Closes the spike file.*/
+    void close();
+
+    /**Returns true if a spike file is open.*/
+    inline bool isOpen() const{return file != 0L;}
+
+    /**Returns true if the spike file is memory-mapped.*/
+    inline bool isMapped() const{return data != 0L;}
+
+    /**Returns the size of the spike file in bytes.*/
+    inline qint64 size() const{return fileSize;}
+
+    /**Copies @p length bytes starting at the offset @p offset of the spike file to @p destination.
+  * The bytes beyond the end of the file are set to zero.
+  * @param offset offset in bytes in the spike file.
+  * @param destination where to copy the bytes.
+  * @param length number of bytes to copy.
+  * @return the number of bytes read from the file.
+  */
+    qint64 read(qint64 offset,void* destination,qint64 length) const;
+
+    /**Copies the records @p records, of @p length bytes each, to their destinations.
+  * The records are read by increasing offset, the ones separated by less than kMAX_GAP bytes
+  * being read together. The bytes beyond the end of the file are set to zero.
+  * @param records records to read, they are sorted by offset on return.
+  * @param length size of each record in bytes.
+  */
+    void read(QVector<Record>& records,qint64 length) const;
+
+    /**Largest number of bytes between two records read together.*/
+    static const qint64 kMAX_GAP;
+
+    /**Largest number of bytes read at once.*/
+    static const qint64 kMAX_READ_SIZE;
+
+private:
+    //Not implemented, the object owns a mapping.
+    SpikeFile(const SpikeFile&);
+    SpikeFile& operator=(const SpikeFile&);
+
+    /**Returns the index following the last record of the batch starting at @p first.
+  * The records of a batch are in the file, do not overlap and are close to each other.
+  */
+    int batchEnd(const QVector<Record>& records,int first,qint64 length) const;
+
+    /**Reads the records of @p records from @p first to @p end (excluded) in a single system call, when the file is not mapped.
+  * @return true if all the bytes have been read, false otherwise (always false on the systems without preadv).
+  */
+    bool readBatch(const QVector<Record>& records,int first,int end,qint64 length,char* gapBuffer) const;
+
+    QFile* file;
+    uchar* data;
+    qint64 fileSize;
+    /**Serializes the reads when the file is not mapped.*/
+    mutable QMutex mutex;
+};
+
+#endif
@@ -0,0 +1,69 @@
+/***************************************************************************
+                          spikemerge.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+//Application include files
+#include "spikemerge.h"
+
+//C include files
+#include <cstring>
+
+/**Moves down the run at @p position in @p heap until its current spike is smaller than the ones of its children.
+  * @param heap the indices of the runs, forming a binary heap on their current spike.
+  * @param heapSize the number of runs in the heap.
+  * @param position the position in the heap of the run to move.
+  * @param heads the current spike of each run.
+  */
+static inline void siftDownRun(int* heap,int heapSize,int position,const dataType* const* heads){
+    int run = heap[position];
+    dataType value = *heads[run];
+    while(true){
+        int child = 2 * position + 1;
+        if(child >= heapSize) break;
+        if(child + 1 < heapSize && *heads[heap[child + 1]] < *heads[heap[child]]) ++child;
+        if(value < *heads[heap[child]]) break;
+        heap[position] = heap[child];
+        position = child;
+    }
+    heap[position] = run;
+}
+
+void SpikeMerge::mergeRuns(const QVector<const dataType*>& runs,const QVector<dataType>& runSizes,dataType* clusterSpikes){
+    //Current spike and end of each run, and heap of the runs which are not exhausted.
+    int nbRuns = runs.size();
+    QVector<const dataType*> current(runs);
+    QVector<const dataType*> ends(nbRuns);
+    QVector<int> heap(nbRuns);
+    const dataType** heads = current.data();
+    int* heapData = heap.data();
+    int heapSize = 0;
+    for(int i = 0; i < nbRuns; ++i){
+        ends[i] = runs[i] + runSizes[i];
+        if(runSizes[i] > 0) heapData[heapSize++] = i;
+    }
+    for(int i = heapSize / 2 - 1; i >= 0; --i) siftDownRun(heapData,heapSize,i,heads);
+
+    //Take the smallest spike on top of the heap until a single run is left, which is copied as it is.
+    while(heapSize > 1){
+        int run = heapData[0];
+        *clusterSpikes++ = *heads[run]++;
+        if(heads[run] == ends[run]) heapData[0] = heapData[--heapSize];
+        siftDownRun(heapData,heapSize,0,heads);
+    }
+    if(heapSize == 1){
+        int run = heapData[0];
+        memcpy(clusterSpikes,heads[run],(ends[run] - heads[run]) * sizeof(dataType));
+    }
+}
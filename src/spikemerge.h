@@ -0,0 +1,43 @@
+/***************************************************************************
+                          spikemerge.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SPIKEMERGE_H
+#define SPIKEMERGE_H
+
+//Include files of the application
+#include "types.h"
+
+//Include files for QT
+#include <QVector>
+
+/**
+* This class merges by time the spikes of a cluster created from other clusters, knowing that the spikes
+* coming from each of them are already sorted. The runs are merged through a binary heap keyed on their
+* current spike, which costs O(n log k) for n spikes coming from k runs.
+*/
+class SpikeMerge{
+
+public:
+    /**Merges the runs of spikes in @p clusterSpikes.
+  * @param runs first spike of each run, the runs being sorted by increasing time.
+  * @param runSizes number of spikes of each run, a run can be empty.
+  * @param clusterSpikes first element of the destination receiving the spikes of all the runs.
+  */
+    static void mergeRuns(const QVector<const dataType*>& runs,const QVector<dataType>& runSizes,dataType* clusterSpikes);
+};
+
+#endif
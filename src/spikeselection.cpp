@@ -0,0 +1,120 @@
+/***************************************************************************
+                          spikeselection.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "spikeselection.h"
+#include "taskpool.h"
+
+//Qt include files
+#include <QRunnable>
+
+//C include files
+#include <cstring>
+
+const dataType SpikeSelection::kPARALLEL_THRESHOLD = 200000;
+const dataType SpikeSelection::kRANGE_SIZE = 65536;
+
+/**Task classifying a range of spikes of a cluster. The spikes inside the selection area are stored
+  * from the start of the buffer and the other ones from its end, both in the order of the range.
+  */
+class SelectionTask : public QRunnable{
+public:
+    SelectionTask(const PolygonMask& region,const FeatureArray::Column& valuesX,const FeatureArray::Column& valuesY,
+                  const dataType* spikeIndices,dataType nbSpikes)
+        :region(region),valuesX(valuesX),valuesY(valuesY),spikeIndices(spikeIndices),nbSpikes(nbSpikes),nbSelected(0){
+        setAutoDelete(false);
+        buffer = new dataType[nbSpikes];
+    }
+    ~SelectionTask(){delete []buffer;}
+
+    void run(){
+        dataType* selected = buffer;
+        dataType* kept = buffer + nbSpikes;
+        for(dataType i = 0; i < nbSpikes; ++i){
+            dataType featuresRowIndex = spikeIndices[i];
+            if(region.contains(valuesX[featuresRowIndex],valuesY[featuresRowIndex])) *selected++ = featuresRowIndex;
+            else *--kept = featuresRowIndex;
+        }
+        nbSelected = selected - buffer;
+    }
+
+    const PolygonMask& region;
+    FeatureArray::Column valuesX;
+    FeatureArray::Column valuesY;
+    const dataType* spikeIndices;
+    dataType nbSpikes;
+    dataType nbSelected;
+    dataType* buffer;
+};
+
+SpikeSelection::SpikeSelection(const PolygonMask& region,const FeatureArray::Column& valuesX,const FeatureArray::Column& valuesY)
+    :region(region),valuesX(valuesX),valuesY(valuesY),nbSpikes(0){
+}
+
+SpikeSelection::~SpikeSelection(){
+    qDeleteAll(tasks);
+}
+
+void SpikeSelection::addCluster(dataType clusterId,const dataType* spikeIndices,dataType nbSpikesOfCluster){
+    QList<SelectionTask*>& rangeTasks = clusterTasks[clusterId];
+    for(dataType start = 0; start < nbSpikesOfCluster; start += kRANGE_SIZE){
+        SelectionTask* task = new SelectionTask(region,valuesX,valuesY,spikeIndices + start,qMin(kRANGE_SIZE,nbSpikesOfCluster - start));
+        rangeTasks.append(task);
+        tasks.append(task);
+    }
+    nbSpikes += nbSpikesOfCluster;
+}
+
+void SpikeSelection::classify(){
+    if(nbSpikes < kPARALLEL_THRESHOLD || tasks.count() == 1){
+        for(int i = 0; i < tasks.count(); ++i) tasks[i]->run();
+        return;
+    }
+
+    TaskPool::Group group;
+    for(int i = 0; i < tasks.count(); ++i) group.start(tasks[i]);
+    group.wait();
+}
+
+dataType SpikeSelection::nbSelected(dataType clusterId) const{
+    const QList<SelectionTask*> rangeTasks = clusterTasks.value(clusterId);
+    dataType nbSelectedSpikes = 0;
+    for(int i = 0; i < rangeTasks.count(); ++i) nbSelectedSpikes += rangeTasks[i]->nbSelected;
+    return nbSelectedSpikes;
+}
+
+void SpikeSelection::copySelected(dataType clusterId,dataType* spikeIndices) const{
+    const QList<SelectionTask*> rangeTasks = clusterTasks.value(clusterId);
+    //The position of each range in the destination is the sum of the counts of the previous ones.
+    dataType position = 0;
+    for(int i = 0; i < rangeTasks.count(); ++i){
+        const SelectionTask* task = rangeTasks[i];
+        memcpy(spikeIndices + position,task->buffer,task->nbSelected * sizeof(dataType));
+        position += task->nbSelected;
+    }
+}
+
+void SpikeSelection::copyKept(dataType clusterId,dataType* spikeIndices) const{
+    const QList<SelectionTask*> rangeTasks = clusterTasks.value(clusterId);
+    dataType position = 0;
+    for(int i = 0; i < rangeTasks.count(); ++i){
+        const SelectionTask* task = rangeTasks[i];
+        const dataType* kept = task->buffer + task->nbSpikes;
+        dataType nbKept = task->nbSpikes - task->nbSelected;
+        for(dataType j = 0; j < nbKept; ++j) spikeIndices[position + j] = *--kept;
+        position += nbKept;
+    }
+}
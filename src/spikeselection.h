@@ -0,0 +1,91 @@
+/***************************************************************************
+                          spikeselection.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SPIKESELECTION_H
+#define SPIKESELECTION_H
+
+//Include files of the application
+#include "types.h"
+#include "featurearray.h"
+#include "polygonmask.h"
+
+//Include files for QT
+#include <QList>
+#include <qmap.h>
+
+class SelectionTask;
+
+/**
+* This class splits the spikes of some clusters between the ones inside a selection area and the others.
+* The spikes of each cluster are cut in ranges which are classified in parallel, each range storing its
+* spikes in its own buffer. The buffers are then merged in the destination tables at the positions given
+* by a prefix sum of the counts of the ranges, so the result is the same as the one of a sequential scan.
+* Small selections are classified by the calling thread only.
+*/
+class SpikeSelection{
+
+public:
+    /**Constructor.
+  * @param region the selection area, in feature coordinates.
+  * @param valuesX the values used as abscissa.
+  * @param valuesY the values used as ordinate.
+  */
+    SpikeSelection(const PolygonMask& region,const FeatureArray::Column& valuesX,const FeatureArray::Column& valuesY);
+    ~SpikeSelection();
+
+    /**Adds a cluster whose spikes have to be classified.
+  * @param clusterId the cluster id.
+  * @param spikeIndices the row index in the feature table of each spike of the cluster, the array has to stay valid until the copies are done.
+  * @param nbSpikes the number of spikes of the cluster.
+  */
+    void addCluster(dataType clusterId,const dataType* spikeIndices,dataType nbSpikes);
+
+    /**Classifies the spikes of all the clusters added.*/
+    void classify();
+
+    /**Returns the number of spikes of the cluster @p clusterId inside the selection area.*/
+    dataType nbSelected(dataType clusterId) const;
+
+    /**Copies the row indices of the spikes of the cluster @p clusterId inside the selection area,
+  * in the order of the cluster.
+  * @param clusterId the cluster id.
+  * @param spikeIndices first element of the nbSelected() values receiving the row indices.
+  */
+    void copySelected(dataType clusterId,dataType* spikeIndices) const;
+
+    /**Copies the spikes of the cluster @p clusterId outside the selection area, in the order of the cluster.
+  * @param clusterId the cluster id.
+  * @param spikeIndices first element of the values receiving the row indices.
+  */
+    void copyKept(dataType clusterId,dataType* spikeIndices) const;
+
+private:
+    /**Number of spikes under which the selection is classified by the calling thread only.*/
+    static const dataType kPARALLEL_THRESHOLD;
+    /**Number of spikes of the ranges classified in parallel.*/
+    static const dataType kRANGE_SIZE;
+
+    const PolygonMask& region;
+    FeatureArray::Column valuesX;
+    FeatureArray::Column valuesY;
+    dataType nbSpikes;
+    /**Ranges of each cluster, in the order of the spikes.*/
+    QMap<dataType,QList<SelectionTask*> > clusterTasks;
+    QList<SelectionTask*> tasks;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/***************************************************************************
+                          taskpool.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "taskpool.h"
+
+//Qt include files
+#include <QThread>
+
+/**Thread of the pool, it runs the queued tasks until the pool is destroyed.*/
+class TaskPool::Worker : public QThread{
+public:
+    explicit Worker(TaskPool& pool):pool(pool){}
+
+protected:
+    void run(){pool.work();}
+
+private:
+    TaskPool& pool;
+};
+
+TaskPool& TaskPool::globalInstance(){
+    static TaskPool pool;
+    return pool;
+}
+
+TaskPool::TaskPool():stopping(false){
+    nbThreads = QThread::idealThreadCount();
+    if(nbThreads < 1) nbThreads = 1;
+    for(int i = 0; i < nbThreads; ++i){
+        Worker* worker = new Worker(*this);
+        workers.append(worker);
+        worker->start();
+    }
+}
+
+TaskPool::~TaskPool(){
+    mutex.lock();
+    stopping = true;
+    taskAvailable.wakeAll();
+    mutex.unlock();
+    for(int i = 0; i < workers.count(); ++i) workers[i]->wait();
+    qDeleteAll(workers);
+}
+
+void TaskPool::work(){
+    mutex.lock();
+    while(true){
+        int priority = VISIBLE_VIEW;
+        while(priority <= PREFETCH && queues[priority].isEmpty()) ++priority;
+        if(priority > PREFETCH){
+            if(stopping) break;
+            taskAvailable.wait(&mutex);
+            continue;
+        }
+
+        Entry entry = queues[priority].takeFirst();
+        mutex.unlock();
+        entry.task->run();
+        mutex.lock();
+        //The task may be deleted by its owner as soon as the group is done.
+        if(--entry.group->nbPending == 0) entry.group->done.wakeAll();
+    }
+    mutex.unlock();
+}
+
+QRunnable* TaskPool::takeTask(Group* group){
+    for(int priority = VISIBLE_VIEW; priority <= PREFETCH; ++priority){
+        QList<Entry>& queue = queues[priority];
+        for(int i = 0; i < queue.count(); ++i)
+            if(queue[i].group == group) return queue.takeAt(i).task;
+    }
+    return 0L;
+}
+
+void TaskPool::moveTasks(Group* group,Priority priority,bool first){
+    QList<Entry> moved;
+    for(int i = VISIBLE_VIEW; i <= PREFETCH; ++i){
+        QList<Entry>& queue = queues[i];
+        for(int j = 0; j < queue.count();){
+            if(queue[j].group == group) moved.append(queue.takeAt(j));
+            else ++j;
+        }
+    }
+    if(first){
+        moved += queues[priority];
+        queues[priority] = moved;
+    }
+    else queues[priority] += moved;
+}
+
+TaskPool::Group::Group(TaskPool::Priority priority):pool(TaskPool::globalInstance()),priority(priority),nbPending(0),cancelled(false){
+}
+
+TaskPool::Group::~Group(){
+    wait();
+}
+
+void TaskPool::Group::start(QRunnable* task){
+    TaskPool::Entry entry;
+    entry.task = task;
+    entry.group = this;
+
+    QMutexLocker locker(&pool.mutex);
+    ++nbPending;
+    pool.queues[priority].append(entry);
+    pool.taskAvailable.wakeOne();
+}
+
+bool TaskPool::Group::startIfIdle(QRunnable* task,TaskPool::Priority newPriority){
+    TaskPool::Entry entry;
+    entry.task = task;
+    entry.group = this;
+
+    QMutexLocker locker(&pool.mutex);
+    if(nbPending > 0) return false;
+    priority = newPriority;
+    ++nbPending;
+    pool.queues[priority].append(entry);
+    pool.taskAvailable.wakeOne();
+    return true;
+}
+
+bool TaskPool::Group::wait(unsigned long time){
+    QMutexLocker locker(&pool.mutex);
+    while(nbPending > 0){
+        //Run the tasks nobody has started yet instead of waiting for a free thread.
+        QRunnable* task = pool.takeTask(this);
+        if(task != 0L){
+            locker.unlock();
+            task->run();
+            locker.relock();
+            if(--nbPending == 0) done.wakeAll();
+        }
+        else if(!done.wait(&pool.mutex,time) && time != ULONG_MAX) return nbPending == 0;
+    }
+    return true;
+}
+
+bool TaskPool::Group::isRunning() const{
+    QMutexLocker locker(&pool.mutex);
+    return nbPending > 0;
+}
+
+void TaskPool::Group::setPriority(TaskPool::Priority newPriority){
+    QMutexLocker locker(&pool.mutex);
+    if(newPriority == priority) return;
+    priority = newPriority;
+    pool.moveTasks(this,priority,false);
+}
+
+void TaskPool::Group::cancel(){
+    cancelled = true;
+    QMutexLocker locker(&pool.mutex);
+    pool.moveTasks(this,TaskPool::VISIBLE_VIEW,true);
+}
@@ -0,0 +1,180 @@
+/***************************************************************************
+                          taskpool.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+//include files for QT
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+
+//C include files
+#include <climits>
+
+/**
+  * Process-wide pool of threads running all the background computations of the application:
+  * the requests of the views (waveforms, correlograms, error matrix), the automatic saving and
+  * the parallel parts of the data processing. Only one thread by processor is created whatever
+  * the number of opened views.
+  *
+  * The tasks are queued in priority classes, a thread always takes the oldest task of the highest class.
+  * A thread waiting for a group of tasks runs itself the tasks of the group which have not been started yet,
+  * so a group started from inside the pool never waits for a free thread.
+  */
+class TaskPool {
+public:
+
+    /**Priority classes of the tasks, from the highest to the lowest.
+  * <ul>
+  * <li>VISIBLE_VIEW computation requested by a view shown on screen or by the user.</li>
+  * <li>HIDDEN_VIEW computation requested by a view which is not currently shown (e.g. in another tab).</li>
+  * <li>PREFETCH computation done in advance or in the background (e.g. the automatic saving).</li>
+  * </ul>
+  */
+    enum Priority{VISIBLE_VIEW = 0,HIDDEN_VIEW = 1,PREFETCH = 2};
+
+    class Group;
+    class Task;
+
+    /**Returns the pool shared by the whole application.*/
+    static TaskPool& globalInstance();
+
+    /**Returns the number of threads of the pool, which is also the number of parts in which to split a parallel computation.*/
+    int threadCount() const {return nbThreads;}
+
+private:
+    class Worker;
+    friend class Worker;
+    friend class Group;
+
+    /**A queued task and the group waiting for it.*/
+    struct Entry{
+        QRunnable* task;
+        Group* group;
+    };
+
+    TaskPool();
+    ~TaskPool();
+
+    /**Loop of the threads of the pool.*/
+    void work();
+
+    /**Removes and returns the first task of @p group from the queues, or 0L if all its tasks have been started. The mutex has to be locked.*/
+    QRunnable* takeTask(Group* group);
+
+    /**Moves the queued tasks of @p group to the class @p priority, at its head if @p first is true. The mutex has to be locked.*/
+    void moveTasks(Group* group,Priority priority,bool first);
+
+    QMutex mutex;
+    QWaitCondition taskAvailable;
+    /**Queued tasks of each priority class.*/
+    QList<Entry> queues[PREFETCH + 1];
+    QList<Worker*> workers;
+    int nbThreads;
+    bool stopping;
+};
+
+/**
+  * Set of tasks started on the pool which can be waited for together. The tasks are not deleted by the pool,
+  * they have to stay valid until the group is done. The destructor waits for the remaining tasks.
+  */
+class TaskPool::Group {
+public:
+    explicit Group(TaskPool::Priority priority = TaskPool::VISIBLE_VIEW);
+    ~Group();
+
+    /**Queues @p task in the class of the group.*/
+    void start(QRunnable* task);
+
+    /**
+  * Queues @p task in the class @p priority if no task of the group is queued or running, otherwise does nothing.
+  * @return true if the task has been queued, false otherwise.
+  */
+    bool startIfIdle(QRunnable* task,TaskPool::Priority priority);
+
+    /**
+  * Waits until all the tasks of the group are done, running in the calling thread the ones which have not been started yet.
+  * @param time maximum time to wait in milliseconds once all the tasks have been started.
+  * @return true if all the tasks are done, false if the time has expired.
+  */
+    bool wait(unsigned long time = ULONG_MAX);
+
+    /**Returns true if some tasks of the group are queued or running, false otherwise.*/
+    bool isRunning() const;
+
+    /**Changes the class of the group, the tasks already queued are moved to the new class.*/
+    void setPriority(TaskPool::Priority priority);
+
+    /**
+  * Sets the cancel token of the group. The tasks still queued are moved at the head of the highest class:
+  * they are expected to return immediately and their owner is usually waiting for them.
+  */
+    void cancel();
+
+    /**Returns true if the group has been cancelled, false otherwise.*/
+    bool isCancelled() const {return cancelled;}
+
+    /**Returns the cancel token of the group, to be given to the functions which have to stop when the group is cancelled.*/
+    const volatile bool* cancelToken() const {return &cancelled;}
+
+private:
+    friend class TaskPool;
+
+    TaskPool& pool;
+    TaskPool::Priority priority;
+    /**Number of tasks queued or running, protected by the mutex of the pool.*/
+    int nbPending;
+    QWaitCondition done;
+    volatile bool cancelled;
+};
+
+/**
+  * Base class of the long computations launched by the views or the document. Each one runs on the pool as a single task,
+  * with the same start/wait interface as a thread.
+  */
+class TaskPool::Task : public QRunnable {
+public:
+    Task():group(TaskPool::PREFETCH){setAutoDelete(false);}
+    virtual ~Task(){}
+
+    /**Queues the task in the class @p priority. A finished task can be started again, as for a thread
+  * nothing is done while the task is still queued or running.
+  */
+    void start(TaskPool::Priority priority){group.startIfIdle(this,priority);}
+
+    /**Waits until the task is done, see Group::wait.*/
+    bool wait(unsigned long time = ULONG_MAX){return group.wait(time);}
+
+    /**Returns true if the task is queued or running, false otherwise.*/
+    bool isRunning() const {return group.isRunning();}
+
+    /**Asks the task to stop as soon as possible.*/
+    void cancel(){group.cancel();}
+
+    /**Returns true if the task has been asked to stop, false otherwise.*/
+    bool isCancelled() const {return group.isCancelled();}
+
+    /**Returns the cancel token of the task.*/
+    const volatile bool* cancelToken() const {return group.cancelToken();}
+
+private:
+    Group group;
+};
+
+#endif
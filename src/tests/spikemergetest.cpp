@@ -0,0 +1,170 @@
+/***************************************************************************
+                          spikemergetest.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Klusters developers
+    email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Checks SpikeMerge::mergeRuns, which merges by time the spikes of a cluster made from other clusters,
+ * against the stepped merge it replaced, which scans the current spike of every run for each spike.
+ * Randomized sets of runs are merged by both and the results compared: a single run, runs including empty
+ * ones, only empty runs and no run at all. A large set of runs is then merged and both merges timed.
+ * The program returns 0 if all the merges agree, 1 otherwise.
+ *
+ * Usage: spikemergetest [nbSpikes] [nbRuns] [nbChecks]
+ */
+
+#include "spikemerge.h"
+#include "timer.h"
+
+//C include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+
+/**
+* The former stepped merge: the runs are laid out one after the other in @p spikes and, for each spike,
+* the current spike of every run left is compared to find the smallest one. Only the runs which are
+* not empty are given to it, as its callers did.
+*/
+static void steppedMerge(const std::vector<dataType>& spikes,const std::vector<dataType>& runSizes,std::vector<dataType>& sortedSpikes){
+    std::vector<dataType> positions;
+    std::vector<dataType> nbOfspikes;
+    dataType start = 0;
+    for(size_t i = 0; i < runSizes.size(); ++i){
+        if(runSizes[i] > 0){
+            positions.push_back(start);
+            nbOfspikes.push_back(runSizes[i]);
+        }
+        start += runSizes[i];
+    }
+    sortedSpikes.resize(spikes.size());
+    dataType position = 0;
+    while(!positions.empty()){
+        size_t indice = 0;
+        dataType value = spikes[positions[0]];
+        for(size_t i = 1; i < positions.size(); ++i){
+            if(spikes[positions[i]] < value){
+                value = spikes[positions[i]];
+                indice = i;
+            }
+        }
+        sortedSpikes[position++] = value;
+        positions[indice]++;
+        if(--nbOfspikes[indice] == 0){
+            positions.erase(positions.begin() + indice);
+            nbOfspikes.erase(nbOfspikes.begin() + indice);
+        }
+    }
+}
+
+/**
+* Draws @p nbSpikes distinct spike times split among @p nbRuns runs, each sorted by increasing time and laid out
+* one after the other in @p spikes. A run is left empty with the probability @p emptyRatio.
+*/
+static void fillRuns(dataType nbSpikes,int nbRuns,double emptyRatio,std::vector<dataType>& spikes,std::vector<dataType>& runSizes){
+    std::vector<int> runOfSpike(nbSpikes);
+    std::vector<bool> isEmpty(nbRuns);
+    int nbFilledRuns = 0;
+    for(int run = 0; run < nbRuns; ++run){
+        isEmpty[run] = rand() % 1000 < emptyRatio * 1000;
+        if(!isEmpty[run]) ++nbFilledRuns;
+    }
+    if(nbFilledRuns == 0) nbSpikes = 0;
+
+    //Each spike goes to a run which is not empty, the spike times increasing by a random step.
+    std::vector<int> filledRuns;
+    for(int run = 0; run < nbRuns; ++run) if(!isEmpty[run]) filledRuns.push_back(run);
+    runSizes.assign(nbRuns,0);
+    for(dataType i = 0; i < nbSpikes; ++i){
+        runOfSpike[i] = filledRuns[rand() % nbFilledRuns];
+        runSizes[runOfSpike[i]]++;
+    }
+    std::vector<dataType> starts(nbRuns,0);
+    for(int run = 1; run < nbRuns; ++run) starts[run] = starts[run - 1] + runSizes[run - 1];
+    spikes.resize(nbSpikes);
+    dataType time = 0;
+    for(dataType i = 0; i < nbSpikes; ++i){
+        time += 1 + rand() % 400;
+        spikes[starts[runOfSpike[i]]++] = time;
+    }
+}
+
+/**Merges the runs with both merges and returns true if they give the same spikes, sorted, accumulating the times.*/
+static bool checkMerge(const std::vector<dataType>& spikes,const std::vector<dataType>& runSizes,float& mergeTime,float& steppedTime){
+    QVector<const dataType*> runs;
+    QVector<dataType> sizes;
+    dataType start = 0;
+    for(size_t i = 0; i < runSizes.size(); ++i){
+        runs.append(spikes.empty() ? 0L : &spikes[0] + start);
+        sizes.append(runSizes[i]);
+        start += runSizes[i];
+    }
+    std::vector<dataType> merged(spikes.size() + 1,-1);
+    RestartTimer();
+    SpikeMerge::mergeRuns(runs,sizes,&merged[0]);
+    mergeTime += Timer();
+
+    std::vector<dataType> reference;
+    RestartTimer();
+    steppedMerge(spikes,runSizes,reference);
+    steppedTime += Timer();
+
+    //The merge must not write past the spikes of the runs.
+    if(merged.back() != -1) return false;
+    merged.pop_back();
+    std::vector<dataType> expected(spikes);
+    std::sort(expected.begin(),expected.end());
+    return merged == reference && merged == expected;
+}
+
+int main(int argc,char** argv){
+    dataType nbSpikes = argc > 1 ? atol(argv[1]) : 200000;
+    int nbRuns = argc > 2 ? atoi(argv[2]) : 40;
+    int nbChecks = argc > 3 ? atoi(argv[3]) : 2000;
+    if(nbSpikes < 1 || nbRuns < 1 || nbChecks < 1){
+        fprintf(stderr,"usage: %s [nbSpikes] [nbRuns] [nbChecks]\n",argv[0]);
+        return 1;
+    }
+
+    srand(1);
+    std::vector<dataType> spikes;
+    std::vector<dataType> runSizes;
+    float mergeTime = 0;
+    float steppedTime = 0;
+    int nbFailures = 0;
+
+    //Randomized small merges, covering no run, a single run, empty runs and only empty runs.
+    for(int check = 0; check < nbChecks; ++check){
+        int nbCheckRuns = check % 4 == 0 ? check % 8 / 4 : 1 + rand() % 12;
+        double emptyRatio = check % 3 == 0 ? 0.0 : (check % 3 == 1 ? 0.3 : 1.0);
+        fillRuns(rand() % 200,nbCheckRuns,emptyRatio,spikes,runSizes);
+        if(!checkMerge(spikes,runSizes,mergeTime,steppedTime)){
+            if(nbFailures < 10) printf("check %d: %d runs, %ld spikes, the merges differ\n",check,nbCheckRuns,static_cast<dataType>(spikes.size()));
+            ++nbFailures;
+        }
+    }
+    printf("%d randomized merges: %s\n",nbChecks,nbFailures == 0 ? "ok" : "FAILED");
+
+    //A large merge, as when grouping clusters or moving them to the noise or artifact cluster.
+    mergeTime = 0;
+    steppedTime = 0;
+    fillRuns(nbSpikes,nbRuns,0.0,spikes,runSizes);
+    bool correct = checkMerge(spikes,runSizes,mergeTime,steppedTime);
+    if(!correct) ++nbFailures;
+    printf("%ld spikes, %d runs  mergeRuns %8.3f s  stepped merge %8.3f s  %s\n",nbSpikes,nbRuns,mergeTime,steppedTime,correct ? "ok" : "NOT SORTED");
+
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -37,9 +37,8 @@ inline float Timer()
   struct timeval tv;
   struct timezone tz;
   gettimeofday(&tv,&tz);
-  float msec = static_cast<int>(tv.tv_usec/1000)/1000.0;
-  float msec0 = static_cast<int>(tv0.tv_usec/1000)/1000.0;
-  float time = (tv.tv_sec+msec)-(tv0.tv_sec+msec0);
+  //Subtract before converting to float, the number of seconds since the epoch does not fit in a float.
+  float time = static_cast<float>(tv.tv_sec - tv0.tv_sec) + static_cast<float>(tv.tv_usec - tv0.tv_usec) / 1000000.0;
   return time;
 }
 
@@ -68,9 +67,8 @@ inline float Timer()
   struct timeval tv;
   struct timeval tz;
   gettimeofday(&tv,&tz);
-  float msec = static_cast<int>(tv.tv_usec/1000)/1000.0;
-  float msec0 = static_cast<int>(tv0.tv_usec/1000)/1000.0;
-  float time = (tv.tv_sec+msec)-(tv0.tv_sec+msec0);
+  //Subtract before converting to float, the number of seconds since the epoch does not fit in a float.
+  float time = static_cast<float>(tv.tv_sec - tv0.tv_sec) + static_cast<float>(tv.tv_usec - tv0.tv_usec) / 1000000.0;
   return time;
 }
 #else
@@ -85,9 +83,8 @@ inline float Timer()
   struct timeval tv;
   struct timezone tz;
   gettimeofday(&tv,&tz);
-  float msec = static_cast<int>(tv.tv_usec/1000)/1000.0;
-  float msec0 = static_cast<int>(tv0.tv_usec/1000)/1000.0;
-  float time = (tv.tv_sec+msec)-(tv0.tv_sec+msec0);
+  //Subtract before converting to float, the number of seconds since the epoch does not fit in a float.
+  float time = static_cast<float>(tv.tv_sec - tv0.tv_sec) + static_cast<float>(tv.tv_usec - tv0.tv_usec) / 1000000.0;
   return time;
 }
 
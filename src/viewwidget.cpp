@@ -31,3 +31,8 @@ ViewWidget::~ViewWidget(){
     qDebug() << "in ~ViewWidget(): ";
 }
 
+TaskPool::Priority ViewWidget::taskPriority() const{
+    //A view which is in a tab not currently selected has an hidden ancestor.
+    if(isVisibleTo(window())) return TaskPool::VISIBLE_VIEW;
+    else return TaskPool::HIDDEN_VIEW;
+}
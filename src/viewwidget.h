@@ -30,6 +30,7 @@
 
 //include files for the application
 #include "baseframe.h"
+#include "taskpool.h"
 
 class KlustersDoc;
 class KlustersView;
@@ -173,6 +174,8 @@ public Q_SLOTS:
     virtual void undoUpdateClusters(QList<int>& modifiedClusters,bool active){}
     /**Enables the caller to know if there is any thread running launch by the viewWidget.*/
     virtual bool isThreadsRunning() const{return false;}
+    /**Returns the priority of the computations launched by the view, the views shown on screen being served first.*/
+    TaskPool::Priority taskPriority() const;
     /**Prints the currently display information on a printer via the painter @p printPainter.
   * @param printPainter painter on a printer.
   * @param metrics object providing information about the printer.
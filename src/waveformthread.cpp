@@ -25,34 +25,30 @@
 #include <QList>
 #include <QDebug>
 
-//Unix include file
-#include <unistd.h>
-
 void WaveformThread::getWaveformInformation(int clusterId,WaveformView::PresentationMode mode){
     this->clusterId = clusterId;
     treatSingleCluster = true;
     this->mode = mode;
-    start();
+    start(waveformView.taskPriority());
 }
 
 void WaveformThread::getWaveformInformation(const QList<int>& clusterIds,WaveformView::PresentationMode mode){
     this->clusterIds = clusterIds;
     treatSingleCluster = false;
     this->mode = mode;
-    start();
+    start(waveformView.taskPriority());
 }
 
 
 void WaveformThread::run(){
-    int sleepingAmount = 1;
     //If the triggering action is not the calculation of the mean and standard variation,
     //get the data and store them in waveformView.waveformInfoMap.
     //wait until the data are available. The status can be READY or IN_PROCESS.
     //In the later case, an other thread in working on the same cluster.
-    if(!meanRequested  && !haveToStopProcessing){
+    if(!meanRequested  && !isCancelled()){
         if(waveformView.presentationMode == WaveformView::SAMPLE){
             if(treatSingleCluster){
-                if(!haveToStopProcessing){
+                if(!isCancelled()){
                     Data::Status status = data.getSampleWaveformPoints(clusterId,waveformView.nbSpkToDisplay);
                     if(status == Data::NOT_AVAILABLE){
                         //Send an event to the waveformView to let it know that the data requested are not available.
@@ -62,8 +58,8 @@ void WaveformThread::run(){
                     }
                     else if(status == Data::IN_PROCESS){
                         while(true){
-                            if(haveToStopProcessing) break;
-                            sleep(sleepingAmount);
+                            if(isCancelled()) break;
+                            data.waitForWaveforms(clusterId,Data::SAMPLE,false,cancelToken());
                             status = data.getSampleWaveformPoints(clusterId,waveformView.nbSpkToDisplay);
                             if(status == Data::READY) break;
                             else if(status == Data::NOT_AVAILABLE){
@@ -78,19 +74,19 @@ void WaveformThread::run(){
             }
             //iterate on all the clusters contained in clusterIds before returning
             else{
-                if(!haveToStopProcessing){
+                if(!isCancelled()){
                     QList<int>::iterator iterator;
                     QList<int>::iterator end(clusterIds.end());
                     for(iterator = clusterIds.begin(); iterator != end; ++iterator){
-                        if(!haveToStopProcessing){
+                        if(!isCancelled()){
                             Data::Status status = data.getSampleWaveformPoints(*iterator,waveformView.nbSpkToDisplay);
                             //If the data for one cluster is not available, skip it (do not send an event to the waveformView)
                             if(status == Data::NOT_AVAILABLE)
                                 continue;
                             else if(status == Data::IN_PROCESS)
-                                while(!haveToStopProcessing && (data.getSampleWaveformPoints(*iterator,waveformView.nbSpkToDisplay) == Data::IN_PROCESS))
+                                while(!isCancelled() && (data.getSampleWaveformPoints(*iterator,waveformView.nbSpkToDisplay) == Data::IN_PROCESS))
                                 {
-                                    sleep(sleepingAmount);
+                                    data.waitForWaveforms(*iterator,Data::SAMPLE,false,cancelToken());
                                 }
                         } else {
                             break;
@@ -101,7 +97,7 @@ void WaveformThread::run(){
         }
         else if(waveformView.presentationMode == WaveformView::TIME_FRAME){
             if(treatSingleCluster){
-                if(!haveToStopProcessing){
+                if(!isCancelled()){
                     Data::Status status = data.getTimeFrameWaveformPoints(clusterId,waveformView.startTime,waveformView.endTime);
                     if(status == Data::NOT_AVAILABLE){
                         //Send an event to the waveformView to let it know that the data requested are not available.
@@ -111,8 +107,8 @@ void WaveformThread::run(){
                     }
                     else if(status == Data::IN_PROCESS){
                         while(true){
-                            if(haveToStopProcessing) break;
-                            sleep(sleepingAmount);
+                            if(isCancelled()) break;
+                            data.waitForWaveforms(clusterId,Data::TIME_FRAME,false,cancelToken());
                             status = data.getTimeFrameWaveformPoints(clusterId,waveformView.startTime,waveformView.endTime);
                             if(status == Data::READY) break;
                             else if(status == Data::NOT_AVAILABLE){
@@ -127,18 +123,18 @@ void WaveformThread::run(){
             }
             //iterate on all the clusters contained in clusterIds before returning
             else{
-                if(!haveToStopProcessing){
+                if(!isCancelled()){
                     QList<int>::iterator iterator;
                     QList<int>::iterator end(clusterIds.end());
                     for(iterator = clusterIds.begin(); iterator != end; ++iterator){
-                        if(!haveToStopProcessing){
+                        if(!isCancelled()){
                             Data::Status status = data.getTimeFrameWaveformPoints(*iterator,waveformView.startTime,waveformView.endTime);
                             //If the data for one cluster is not available, skip it (do not send an event to the waveformView)
                             if(status == Data::NOT_AVAILABLE) continue;
                             else if(status == Data::IN_PROCESS)
-                                while(!haveToStopProcessing && (data.getTimeFrameWaveformPoints(*iterator,waveformView.startTime,waveformView.endTime) == Data::IN_PROCESS))
+                                while(!isCancelled() && (data.getTimeFrameWaveformPoints(*iterator,waveformView.startTime,waveformView.endTime) == Data::IN_PROCESS))
                                 {
-                                    sleep(sleepingAmount);
+                                    data.waitForWaveforms(*iterator,Data::TIME_FRAME,false,cancelToken());
                                 }
                         } else {
                             break;
@@ -153,12 +149,12 @@ void WaveformThread::run(){
     //In the IN_PROCESS case, an other thread in working on the same cluster,
     //In the NOT_AVAILABLE case, the spikes have not been collected, get the data and
     //ask to calculate the data again.
-    if((meanRequested || waveformView.meanPresentation)  && !haveToStopProcessing){
+    if((meanRequested || waveformView.meanPresentation)  && !isCancelled()){
         if(waveformView.presentationMode == WaveformView::SAMPLE){
             if(treatSingleCluster){
-                if(!haveToStopProcessing){
+                if(!isCancelled()){
                     Data::Status status = data.calculateSampleMean(clusterId,waveformView.nbSpkToDisplay);
-                    if(status == Data::NOT_AVAILABLE && !haveToStopProcessing){
+                    if(status == Data::NOT_AVAILABLE && !isCancelled()){
                         Data::Status dataStatus = data.getSampleWaveformPoints(clusterId,waveformView.nbSpkToDisplay);
                         if(dataStatus == Data::NOT_AVAILABLE){
                             //Send an event to the waveformView to let it know that the data requested are not available.
@@ -168,8 +164,8 @@ void WaveformThread::run(){
                         }
                         else if(dataStatus == Data::IN_PROCESS){
                             while(true){
-                                if(haveToStopProcessing) break;
-                                sleep(sleepingAmount);
+                                if(isCancelled()) break;
+                                data.waitForWaveforms(clusterId,Data::SAMPLE,false,cancelToken());
                                 dataStatus = data.getSampleWaveformPoints(clusterId,waveformView.nbSpkToDisplay);
                                 if(dataStatus == Data::READY) break;
                                 else if(dataStatus == Data::NOT_AVAILABLE){
@@ -182,7 +178,7 @@ void WaveformThread::run(){
                         }
                         //Now that the data are available, compute the mean and standard deviation
                         while(true){
-                            if(haveToStopProcessing) break;
+                            if(isCancelled()) break;
                             status = data.calculateSampleMean(clusterId,waveformView.nbSpkToDisplay);
                             if(status == Data::READY) break;
                             else if(status == Data::NOT_AVAILABLE){
@@ -191,13 +187,13 @@ void WaveformThread::run(){
                                 QApplication::postEvent(&waveformView,event);
                                 return;
                             }
-                            sleep(sleepingAmount);
+                            data.waitForWaveforms(clusterId,Data::SAMPLE,true,cancelToken());
                         }
                     }
                     else if(status == Data::IN_PROCESS){
                         while(true){
-                            if(haveToStopProcessing) break;
-                            sleep(sleepingAmount);
+                            if(isCancelled()) break;
+                            data.waitForWaveforms(clusterId,Data::SAMPLE,true,cancelToken());
                             status = data.calculateSampleMean(clusterId,waveformView.nbSpkToDisplay);
                             if(status == Data::READY) break;
                             else if(status == Data::NOT_AVAILABLE){
@@ -212,34 +208,34 @@ void WaveformThread::run(){
             } //one cluster
             //iterate on all the clusters contained in clusterIds before returning
             else{
-                if(!haveToStopProcessing){
+                if(!isCancelled()){
                     QList<int>::iterator iterator;
                     QList<int>::iterator end(clusterIds.end());
                     for(iterator = clusterIds.begin(); iterator != end; ++iterator){
-                        if(!haveToStopProcessing){
+                        if(!isCancelled()){
                             Data::Status status = data.calculateSampleMean(*iterator,waveformView.nbSpkToDisplay);
-                            if(status == Data::NOT_AVAILABLE && !haveToStopProcessing){
+                            if(status == Data::NOT_AVAILABLE && !isCancelled()){
                                 Data::Status dataStatus = data.getSampleWaveformPoints(*iterator,waveformView.nbSpkToDisplay);
 
                                 //If the data for one cluster is not available, skip it (do not send an event to the waveformView)
                                 if(dataStatus == Data::NOT_AVAILABLE) continue;
                                 if(dataStatus == Data::IN_PROCESS || (dataStatus == Data::READY)){
                                     while(true){
-                                        if(haveToStopProcessing) break;
+                                        if(isCancelled()) break;
                                         if(dataStatus == Data::READY){
                                             //Now that the data are available, compute the mean and standard deviation
                                             while(true){
-                                                if(haveToStopProcessing)
+                                                if(isCancelled())
                                                     break;
                                                 status = data.calculateSampleMean(*iterator,waveformView.nbSpkToDisplay);
                                                 if(status == Data::READY || status == Data::NOT_AVAILABLE)
                                                     break;
-                                                sleep(sleepingAmount);
+                                                data.waitForWaveforms(*iterator,Data::SAMPLE,true,cancelToken());
                                             }
                                             break;
                                         }
                                         else{
-                                            sleep(sleepingAmount);
+                                            data.waitForWaveforms(*iterator,Data::SAMPLE,false,cancelToken());
                                             dataStatus = data.getSampleWaveformPoints(*iterator,waveformView.nbSpkToDisplay);
                                             if(dataStatus == Data::NOT_AVAILABLE)
                                                 break;
@@ -250,9 +246,9 @@ void WaveformThread::run(){
                             else if(status == Data::IN_PROCESS){
                                 //If the data for one cluster is not available, skip it (do not send an event to the waveformView)
                                 while(true){
-                                    if(haveToStopProcessing)
+                                    if(isCancelled())
                                         break;
-                                    sleep(sleepingAmount);
+                                    data.waitForWaveforms(*iterator,Data::SAMPLE,true,cancelToken());
                                     status = data.calculateSampleMean(*iterator,waveformView.nbSpkToDisplay);
                                     if(status == Data::READY || status == Data::NOT_AVAILABLE)
                                         break;
@@ -266,9 +262,9 @@ void WaveformThread::run(){
         }//Sample
         else if(waveformView.presentationMode == WaveformView::TIME_FRAME){
             if(treatSingleCluster){
-                if(!haveToStopProcessing){
+                if(!isCancelled()){
                     Data::Status status = data.calculateTimeFrameMean(clusterId,waveformView.startTime,waveformView.endTime);
-                    if(status == Data::NOT_AVAILABLE && !haveToStopProcessing){
+                    if(status == Data::NOT_AVAILABLE && !isCancelled()){
                         Data::Status dataStatus = data.getTimeFrameWaveformPoints(clusterId,waveformView.startTime,waveformView.endTime);
                         if(dataStatus == Data::NOT_AVAILABLE){
                             //Send an event to the waveformView to let it know that the data requested are not available.
@@ -278,9 +274,9 @@ void WaveformThread::run(){
                         }
                         else if(dataStatus == Data::IN_PROCESS){
                             while(true){
-                                if(haveToStopProcessing)
+                                if(isCancelled())
                                     break;
-                                sleep(sleepingAmount);
+                                data.waitForWaveforms(clusterId,Data::TIME_FRAME,false,cancelToken());
                                 dataStatus = data.getTimeFrameWaveformPoints(clusterId,waveformView.startTime,waveformView.endTime);
                                 if(dataStatus == Data::READY)  {
                                     break;
@@ -294,7 +290,7 @@ void WaveformThread::run(){
                         }
                         //Now that the data are available, compute the mean and standard deviation
                         while(true){
-                            if(haveToStopProcessing) break;
+                            if(isCancelled()) break;
                             status = data.calculateTimeFrameMean(clusterId,waveformView.startTime,waveformView.endTime);
                             if(status == Data::READY) break;
                             else if(status == Data::NOT_AVAILABLE){
@@ -303,13 +299,13 @@ void WaveformThread::run(){
                                 QApplication::postEvent(&waveformView,event);
                                 return;
                             }
-                            sleep(sleepingAmount);
+                            data.waitForWaveforms(clusterId,Data::TIME_FRAME,true,cancelToken());
                         }
                     }
                     else if(status == Data::IN_PROCESS){
                         while(true){
-                            if(haveToStopProcessing) break;
-                            sleep(sleepingAmount);
+                            if(isCancelled()) break;
+                            data.waitForWaveforms(clusterId,Data::TIME_FRAME,true,cancelToken());
                             status = data.calculateTimeFrameMean(clusterId,waveformView.startTime,waveformView.endTime);
                             if(status == Data::READY) break;
                             else if(status == Data::NOT_AVAILABLE){
@@ -324,32 +320,32 @@ void WaveformThread::run(){
             }//one cluster
             //iterate on all the clusters contained in clusterIds before returning
             else{
-                if(!haveToStopProcessing){
+                if(!isCancelled()){
                     QList<int>::iterator iterator;
                     QList<int>::iterator end(clusterIds.end());
                     for(iterator = clusterIds.begin(); iterator != end; ++iterator){
-                        if(!haveToStopProcessing){
+                        if(!isCancelled()){
                             Data::Status status = data.calculateTimeFrameMean(*iterator,waveformView.startTime,waveformView.endTime);
-                            if(status == Data::NOT_AVAILABLE && !haveToStopProcessing){
+                            if(status == Data::NOT_AVAILABLE && !isCancelled()){
                                 Data::Status dataStatus = data.getTimeFrameWaveformPoints(*iterator,waveformView.startTime,waveformView.endTime);
                                 //If the data for one cluster is not available, skip it (do not send an event to the waveformView)
                                 if(dataStatus == Data::NOT_AVAILABLE)
                                     continue;
                                 if(dataStatus == Data::IN_PROCESS  || (dataStatus == Data::READY)){
                                     while(true){
-                                        if(haveToStopProcessing) break;
+                                        if(isCancelled()) break;
                                         if(dataStatus == Data::READY){
                                             //Now that the data are available, compute the mean and standard deviation
                                             while(true){
-                                                if(haveToStopProcessing) break;
+                                                if(isCancelled()) break;
                                                 status = data.calculateTimeFrameMean(*iterator,waveformView.startTime,waveformView.endTime);
                                                 if(status == Data::READY || status == Data::NOT_AVAILABLE) break;
-                                                sleep(sleepingAmount);
+                                                data.waitForWaveforms(*iterator,Data::TIME_FRAME,true,cancelToken());
                                             }
                                             break;
                                         }
                                         else{
-                                            sleep(sleepingAmount);
+                                            data.waitForWaveforms(*iterator,Data::TIME_FRAME,false,cancelToken());
                                             dataStatus = data.getTimeFrameWaveformPoints(*iterator,waveformView.startTime,waveformView.endTime);
                                             if(dataStatus == Data::NOT_AVAILABLE)
                                                 break;
@@ -360,8 +356,8 @@ void WaveformThread::run(){
                             else if(status == Data::IN_PROCESS){
                                 //If the data for one cluster is not available, skip it (do not send an event to the waveformView)
                                 while(true){
-                                    if(haveToStopProcessing) break;
-                                    sleep(sleepingAmount);
+                                    if(isCancelled()) break;
+                                    data.waitForWaveforms(*iterator,Data::TIME_FRAME,true,cancelToken());
                                     status = data.calculateTimeFrameMean(*iterator,waveformView.startTime,waveformView.endTime);
                                     if(status == Data::READY || status == Data::NOT_AVAILABLE) break;
                                 }
@@ -382,7 +378,8 @@ void WaveformThread::run(){
 void WaveformThread::getMean(WaveformView::PresentationMode mode){
     meanRequested = true;
     this->mode = mode;
-    start();
+    //The mean is computed in advance, it is not displayed yet.
+    start(TaskPool::PREFETCH);
 }
 
 void WaveformThread::getMean(const QList<int>& clusterIds,WaveformView::PresentationMode mode){
@@ -393,6 +390,6 @@ void WaveformThread::getMean(const QList<int>& clusterIds,WaveformView::Presenta
     this->clusterIds = clusterIds;
     treatSingleCluster = false;
     this->mode = mode;
-    start();
+    start(waveformView.taskPriority());
 }
 
@@ -21,22 +21,20 @@
 //include files for the application
 #include "waveformview.h"
 #include "data.h"
+#include "taskpool.h"
 
 //include files for QT
-#include <qthread.h>
-
-
 #include <QEvent>
 #include <QList>
 
-/**Thread used to retrieve the waveforms and compute the means and standard deviations
- * which will be displayed in the WaveformView.
- * No heavy computation is done is this class, the thread calls the Data object which
+/**Task used to retrieve the waveforms and compute the means and standard deviations
+ * which will be displayed in the WaveformView. It runs on the TaskPool.
+ * No heavy computation is done is this class, the task calls the Data object which
  * will do the work.
  *@author Lynn Hazan
  */
 
-class WaveformThread : public QThread {
+class WaveformThread : public TaskPool::Task {
 
 public: 
     //Only the method getWaveforms of WaveformView has access to the private part of WaveformThread,
@@ -59,7 +57,10 @@ public:
     bool isMeanRequested() const {return  meanRequested;}
 
     /**Asks the thread to stop his work as soon as possible.*/
-    void stopProcessing(){haveToStopProcessing = true;}
+    void stopProcessing(){
+        cancel();
+        data.wakeUpWaitingThreads();
+    }
 
     class GetWaveformsEvent;
     friend class GetWaveformsEvent;
@@ -118,7 +119,7 @@ protected:
     void run();
 
 private:
-    WaveformThread(WaveformView& view,Data& d):waveformView(view),meanRequested(false),data(d),haveToStopProcessing(false){}
+    WaveformThread(WaveformView& view,Data& d):waveformView(view),meanRequested(false),data(d){}
 
     WaveformView& waveformView;
     int clusterId;
@@ -127,8 +128,6 @@ private:
     bool meanRequested;
     Data& data;
     WaveformView::PresentationMode mode;
-    /**True if the thread has to stop processing, false otherwise.*/
-    bool haveToStopProcessing;
 };
 
 #endif
@@ -460,6 +460,13 @@ void WaveformView::drawWaveforms(QPainter& painter,const QList<int>& clusterList
     ItemColors& clusterColors = doc.clusterColors();
     Data& clusteringData = doc.data();
 
+    //Keep the memory used by the waveforms within the budget before creating the iterators,
+    //without discarding the waveforms of the clusters shown in any waveform view.
+    QList<int> keptClusters = doc.clustersInWaveformViews();
+    for(iterator = clusterList.begin(); iterator != clusterList.end(); ++iterator)
+        if(!keptClusters.contains(*iterator)) keptClusters.append(*iterator);
+    clusteringData.evictWaveforms(keptClusters);
+
     //The abscissa of the system coordinate center for the current cluster
     int X = X0;
     //If it is an update that means that there some clusters to redraw.